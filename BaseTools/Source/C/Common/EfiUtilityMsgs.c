@@ -789,6 +789,39 @@ Returns:
   mPrintLimitsSet         = 1;
 }
 
+VOID
+ResetUtilityStatus (
+  VOID
+  )
+/*++
+
+Routine Description:
+  Reset the status, the print level, the print limits and the error and
+  warning counts to their initial values. A utility that is called several
+  times in the same process, like GenSec and GenFfs in the GenTools Python
+  extension, calls this function first so that an error or an option of a
+  previous call has no effect on the next one.
+
+Arguments:
+  None.
+
+Returns:
+  NA
+
+--*/
+{
+  mStatus                 = STATUS_SUCCESS;
+  mPrintLogLevel          = INFO_LOG_LEVEL;
+  mSourceFileName         = NULL;
+  mSourceFileLineNum      = 0;
+  mErrorCount             = 0;
+  mWarningCount           = 0;
+  mMaxErrors              = 0;
+  mMaxWarnings            = 0;
+  mMaxWarningsPlusErrors  = 0;
+  mPrintLimitsSet         = 0;
+}
+
 STATIC
 VOID
 PrintLimitExceeded (
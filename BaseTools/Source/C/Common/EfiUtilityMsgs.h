@@ -163,6 +163,15 @@ SetPrintLimits (
   )
 ;
 
+//
+// Reset the status, the print level and limits, and the error and warning
+// counts, for a utility that is called several times in the same process.
+//
+VOID
+ResetUtilityStatus (
+  VOID
+  );
+
 #ifdef __cplusplus
 }
 #endif
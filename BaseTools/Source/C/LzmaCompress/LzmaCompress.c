@@ -28,10 +28,26 @@
 #include "Sdk/C/LzmaDec.h"
 #include "Sdk/C/LzmaEnc.h"
 #include "Sdk/C/Bra.h"
+#include "Sdk/C/CpuArch.h"
+#include "Sdk/C/Threads.h"
 #include "CommonLib.h"
 
 #define LZMA_HEADER_SIZE (LZMA_PROPS_SIZE + 8)
 
+//
+// Parallel mode splits the input into chunks that are compressed independently,
+// so that the decoder can decompress them concurrently. The output starts with
+// a header (signature, decoded size, chunk size and chunk count, as UINT32
+// values), followed by the compressed size of every chunk as UINT32 values, then
+// by the chunks. Every chunk is a complete LZMA stream with its own header.
+// This is the LZMA_PARALLEL_HEADER format of the LZMA parallel GUIDed section.
+//
+#define LZMA_PARALLEL_SIGNATURE           0x504D5A4C
+#define LZMA_PARALLEL_HEADER_SIZE         16
+#define LZMA_PARALLEL_DEFAULT_CHUNK_SIZE  (1 << 20)
+#define LZMA_PARALLEL_MAX_CHUNK_SIZE      (1 << 27)
+#define LZMA_MAX_THREAD_COUNT             64
+
 typedef enum {
   NoConverter, 
   X86Converter,
@@ -49,10 +65,38 @@ static ISzAlloc g_Alloc = { SzAlloc, SzFree };
 
 static Bool mQuietMode = False;
 static CONVERTER_TYPE mConType = NoConverter;
+static Bool mParallelMode = False;
+static UInt32 mChunkSize = LZMA_PARALLEL_DEFAULT_CHUNK_SIZE;
+static UInt32 mThreadCount = 1;
+
+//
+// The chunks of the parallel mode are spread over the threads, each chunk being
+// compressed into its own slot of the output buffer. The output does not depend
+// on the number of threads.
+//
+typedef struct
+{
+  const Byte *inBuffer;
+  size_t inSize;
+  const CLzmaEncProps *props;
+  UInt32 chunkCount;
+  UInt32 threadCount;
+  Byte *slots;
+  size_t slotSize;
+  size_t *chunkOutSize;
+} CParallelEncoder;
+
+typedef struct
+{
+  CParallelEncoder *encoder;
+  UInt32 threadIndex;
+  SRes res;
+  CThread thread;
+} CParallelWorker;
 
 #define UTILITY_NAME "LzmaCompress"
 #define UTILITY_MAJOR_VERSION 0
-#define UTILITY_MINOR_VERSION 2
+#define UTILITY_MINOR_VERSION 3
 #define INTEL_COPYRIGHT \
   "Copyright (c) 2009-2012, Intel Corporation. All rights reserved."
 void PrintHelp(char *buffer)
@@ -65,6 +109,15 @@ void PrintHelp(char *buffer)
              "  -d: decode file\n"
              "  -o FileName, --output FileName: specify the output filename\n"
              "  --f86: enable converter for x86 code\n"
+             "  --parallel: split the file into chunks that are compressed\n"
+             "              independently, so that they can be decoded in parallel\n"
+             "  --chunk-size Size: set the size of the chunks in bytes for\n"
+             "                     --parallel, 1 to 128MB. The default is 1MB\n"
+             "  --threads N: compress with N threads, N being 1 to 64. The\n"
+             "               chunks of --parallel are spread over the threads,\n"
+             "               otherwise the match finder runs in its own threads.\n"
+             "               The output is identical to the default one when N\n"
+             "               is 1\n"
              "  -v, --verbose: increase output messages\n"
              "  -q, --quiet: reduce output messages\n"
              "  --debug [0-9]: set debug level\n"
@@ -97,6 +150,160 @@ void PrintVersion(char *buffer)
   sprintf (buffer, "%s Version %d.%d %s ", UTILITY_NAME, UTILITY_MAJOR_VERSION, UTILITY_MINOR_VERSION, __BUILD_VERSION);
 }
 
+static SRes EncodeChunk(CParallelEncoder *p, UInt32 chunkIndex)
+{
+  SRes res;
+  const Byte *chunkIn = p->inBuffer + (size_t)chunkIndex * mChunkSize;
+  Byte *chunkOut = p->slots + (size_t)chunkIndex * p->slotSize;
+  size_t chunkInSize;
+  size_t outSizeProcessed = p->slotSize - LZMA_HEADER_SIZE;
+  size_t outPropsSize = LZMA_PROPS_SIZE;
+  int i;
+
+  chunkInSize = p->inSize - (size_t)chunkIndex * mChunkSize;
+  if (chunkInSize > mChunkSize)
+    chunkInSize = mChunkSize;
+
+  for (i = 0; i < 8; i++)
+    chunkOut[i + LZMA_PROPS_SIZE] = (Byte)((UInt64)chunkInSize >> (8 * i));
+
+  res = LzmaEncode(chunkOut + LZMA_HEADER_SIZE, &outSizeProcessed,
+      chunkIn, chunkInSize, p->props, chunkOut, &outPropsSize, 0,
+      NULL, &g_Alloc, &g_Alloc);
+
+  p->chunkOutSize[chunkIndex] = LZMA_HEADER_SIZE + outSizeProcessed;
+  return res;
+}
+
+static THREAD_FUNC_DECL EncodeChunksThread(void *param)
+{
+  CParallelWorker *worker = (CParallelWorker *)param;
+  CParallelEncoder *p = worker->encoder;
+  UInt32 chunkIndex;
+
+  worker->res = SZ_OK;
+  for (chunkIndex = worker->threadIndex;
+       chunkIndex < p->chunkCount && worker->res == SZ_OK;
+       chunkIndex += p->threadCount)
+    worker->res = EncodeChunk(p, chunkIndex);
+  return 0;
+}
+
+static SRes EncodeParallel(ISeqOutStream *outStream, const Byte *inBuffer, size_t inSize, CLzmaEncProps *props)
+{
+  SRes res;
+  CParallelEncoder encoder;
+  CParallelWorker *workers = 0;
+  CLzmaEncProps chunkProps;
+  Byte header[LZMA_PARALLEL_HEADER_SIZE];
+  Byte size[4];
+  UInt32 chunkIndex;
+  UInt32 threadIndex;
+  UInt32 dictSize;
+  int i;
+
+  //
+  // A section has at least one chunk, so an empty file can't be encoded, as
+  // without --parallel
+  //
+  if (inSize == 0)
+    return SZ_ERROR_INPUT_EOF;
+  if ((UInt64)inSize > 0xFFFFFFFF)
+    return SZ_ERROR_PARAM;
+
+  //
+  // A chunk is encoded on its own, so a dictionary bigger than the chunk only
+  // costs match finder memory, once per thread
+  //
+  chunkProps = *props;
+  dictSize = chunkProps.dictSize;
+  for (i = 11; i <= 30; i++) {
+    if (mChunkSize <= ((UInt32)2 << i)) {
+      dictSize = (UInt32)2 << i;
+      break;
+    }
+    if (mChunkSize <= ((UInt32)3 << i)) {
+      dictSize = (UInt32)3 << i;
+      break;
+    }
+  }
+  if (chunkProps.dictSize > dictSize)
+    chunkProps.dictSize = dictSize;
+
+  encoder.inBuffer = inBuffer;
+  encoder.inSize = inSize;
+  encoder.props = &chunkProps;
+  encoder.chunkCount = (UInt32)((inSize - 1) / mChunkSize + 1);
+  encoder.threadCount = mThreadCount < encoder.chunkCount ? mThreadCount : encoder.chunkCount;
+  // every chunk may need 105% of its size + 64KB, like a whole file
+  encoder.slotSize = LZMA_HEADER_SIZE + mChunkSize / 20 * 21 + (1 << 16);
+  encoder.slots = (Byte *)MyAlloc(encoder.slotSize * encoder.chunkCount);
+  encoder.chunkOutSize = (size_t *)MyAlloc(sizeof(size_t) * encoder.chunkCount);
+  workers = (CParallelWorker *)MyAlloc(sizeof(CParallelWorker) * encoder.threadCount);
+  if (encoder.slots == 0 || encoder.chunkOutSize == 0 || workers == 0) {
+    res = SZ_ERROR_MEM;
+    goto Done;
+  }
+
+  //
+  // The first worker runs on the current thread
+  //
+  for (threadIndex = 0; threadIndex < encoder.threadCount; threadIndex++) {
+    workers[threadIndex].encoder = &encoder;
+    workers[threadIndex].threadIndex = threadIndex;
+    workers[threadIndex].res = SZ_OK;
+    Thread_Construct(&workers[threadIndex].thread);
+    if (threadIndex != 0 &&
+        Thread_Create(&workers[threadIndex].thread, EncodeChunksThread, &workers[threadIndex]) != 0)
+      workers[threadIndex].res = SZ_ERROR_THREAD;
+  }
+  EncodeChunksThread(&workers[0]);
+
+  res = SZ_OK;
+  for (threadIndex = 0; threadIndex < encoder.threadCount; threadIndex++) {
+    if (Thread_WasCreated(&workers[threadIndex].thread)) {
+      Thread_Wait(&workers[threadIndex].thread);
+      Thread_Close(&workers[threadIndex].thread);
+    }
+    if (res == SZ_OK)
+      res = workers[threadIndex].res;
+  }
+  if (res != SZ_OK)
+    goto Done;
+
+  SetUi32(header, LZMA_PARALLEL_SIGNATURE);
+  SetUi32(header + 4, (UInt32)inSize);
+  SetUi32(header + 8, mChunkSize);
+  SetUi32(header + 12, encoder.chunkCount);
+  if (outStream->Write(outStream, header, sizeof(header)) != sizeof(header)) {
+    res = SZ_ERROR_WRITE;
+    goto Done;
+  }
+
+  for (chunkIndex = 0; chunkIndex < encoder.chunkCount; chunkIndex++) {
+    SetUi32(size, (UInt32)encoder.chunkOutSize[chunkIndex]);
+    if (outStream->Write(outStream, size, sizeof(size)) != sizeof(size)) {
+      res = SZ_ERROR_WRITE;
+      goto Done;
+    }
+  }
+
+  for (chunkIndex = 0; chunkIndex < encoder.chunkCount; chunkIndex++) {
+    if (outStream->Write(outStream, encoder.slots + (size_t)chunkIndex * encoder.slotSize,
+          encoder.chunkOutSize[chunkIndex]) != encoder.chunkOutSize[chunkIndex]) {
+      res = SZ_ERROR_WRITE;
+      goto Done;
+    }
+  }
+
+Done:
+  MyFree(workers);
+  MyFree(encoder.chunkOutSize);
+  MyFree(encoder.slots);
+
+  return res;
+}
+
 static SRes Encode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize)
 {
   SRes res;
@@ -108,6 +315,12 @@ static SRes Encode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 file
   CLzmaEncProps props;
 
   LzmaEncProps_Init(&props);
+  //
+  // The multithreaded match finder is only used when more than one thread is
+  // requested, so that the default output stays the same. The chunks of the
+  // parallel mode are compressed by several threads instead.
+  //
+  props.numThreads = (mThreadCount > 1 && !mParallelMode) ? 2 : 1;
   LzmaEncProps_Normalize(&props);
 
   if (inSize != 0) {
@@ -123,6 +336,11 @@ static SRes Encode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 file
     goto Done;
   }
 
+  if (mParallelMode) {
+    res = EncodeParallel(outStream, inBuffer, inSize, &props);
+    goto Done;
+  }
+
   // we allocate 105% of original size + 64KB for output buffer
   outSize = (size_t)fileSize / 20 * 21 + (1 << 16);
   outBuffer = (Byte *)MyAlloc(outSize);
@@ -181,6 +399,65 @@ Done:
   return res;
 }
 
+static SRes DecodeParallel(ISeqOutStream *outStream, const Byte *inBuffer, size_t inSize)
+{
+  SRes res;
+  Byte *outBuffer = 0;
+  size_t outSize;
+  size_t inPos;
+  UInt32 chunkSize;
+  UInt32 chunkCount;
+  UInt32 chunkIndex;
+  ELzmaStatus status;
+
+  if (inSize < LZMA_PARALLEL_HEADER_SIZE || GetUi32(inBuffer) != LZMA_PARALLEL_SIGNATURE)
+    return SZ_ERROR_DATA;
+
+  outSize = GetUi32(inBuffer + 4);
+  chunkSize = GetUi32(inBuffer + 8);
+  chunkCount = GetUi32(inBuffer + 12);
+  if (outSize == 0 || chunkSize == 0 ||
+      chunkCount != (UInt32)((outSize - 1) / chunkSize + 1) ||
+      chunkCount > (inSize - LZMA_PARALLEL_HEADER_SIZE) / 4)
+    return SZ_ERROR_DATA;
+
+  outBuffer = (Byte *)MyAlloc(outSize);
+  if (outBuffer == 0)
+    return SZ_ERROR_MEM;
+
+  res = SZ_OK;
+  inPos = LZMA_PARALLEL_HEADER_SIZE + (size_t)chunkCount * 4;
+  for (chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++) {
+    size_t chunkInSize = GetUi32(inBuffer + LZMA_PARALLEL_HEADER_SIZE + chunkIndex * 4);
+    size_t chunkOutSize = outSize - (size_t)chunkIndex * chunkSize;
+    size_t inSizePure;
+
+    if (chunkOutSize > chunkSize)
+      chunkOutSize = chunkSize;
+    if (chunkInSize < LZMA_HEADER_SIZE || chunkInSize > inSize - inPos) {
+      res = SZ_ERROR_DATA;
+      goto Done;
+    }
+
+    inSizePure = chunkInSize - LZMA_HEADER_SIZE;
+    res = LzmaDecode(outBuffer + (size_t)chunkIndex * chunkSize, &chunkOutSize,
+        inBuffer + inPos + LZMA_HEADER_SIZE, &inSizePure,
+        inBuffer + inPos, LZMA_PROPS_SIZE, LZMA_FINISH_END, &status, &g_Alloc);
+    if (res != SZ_OK)
+      goto Done;
+
+    inPos += chunkInSize;
+  }
+
+  if (outStream->Write(outStream, outBuffer, outSize) != outSize)
+    res = SZ_ERROR_WRITE;
+
+Done:
+  MyFree(outBuffer);
+
+  return res;
+}
+
 static SRes Decode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize)
 {
   SRes res;
@@ -206,6 +483,11 @@ static SRes Decode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 file
     goto Done;
   }
 
+  if (mParallelMode) {
+    res = DecodeParallel(outStream, inBuffer, inSize);
+    goto Done;
+  }
+
   for (i = 0; i < 8; i++)
     outSize64 += ((UInt64)inBuffer[LZMA_PROPS_SIZE + i]) << (i * 8);
 
@@ -256,6 +538,8 @@ int main2(int numArgs, const char *args[], char *rs)
   const char *outputFile = "file.tmp";
   int param;
   UInt64 fileSize;
+  char *end;
+  unsigned long value;
 
   FileSeqInStream_CreateVTable(&inStream);
   File_Construct(&inStream.file);
@@ -275,6 +559,30 @@ int main2(int numArgs, const char *args[], char *rs)
       modeWasSet = True;
     } else if (strcmp(args[param], "--f86") == 0) {
       mConType = X86Converter;
+    } else if (strcmp(args[param], "--parallel") == 0) {
+      mParallelMode = True;
+    } else if (strcmp(args[param], "--chunk-size") == 0) {
+      if (numArgs < (param + 2)) {
+        return PrintUserError(rs);
+      }
+      value = strtoul(args[++param], &end, 0);
+      if (*args[param] == '\0' || *end != '\0' ||
+          value < 1 || value > LZMA_PARALLEL_MAX_CHUNK_SIZE) {
+        PrintHelp(rs);
+        return PrintError(rs, "Invalid chunk size, it must be 1 to 128MB");
+      }
+      mChunkSize = (UInt32) value;
+    } else if (strcmp(args[param], "--threads") == 0) {
+      if (numArgs < (param + 2)) {
+        return PrintUserError(rs);
+      }
+      value = strtoul(args[++param], &end, 0);
+      if (*args[param] == '\0' || *end != '\0' ||
+          value < 1 || value > LZMA_MAX_THREAD_COUNT) {
+        PrintHelp(rs);
+        return PrintError(rs, "Invalid thread count, it must be 1 to 64");
+      }
+      mThreadCount = (UInt32) value;
     } else if (strcmp(args[param], "-o") == 0 ||
                strcmp(args[param], "--output") == 0) {
       if (numArgs < (param + 2)) {
@@ -323,6 +631,13 @@ int main2(int numArgs, const char *args[], char *rs)
     return PrintUserError(rs);
   }
 
+  //
+  // The chunks of the parallel mode are decoded without any converter
+  //
+  if (mParallelMode && mConType != NoConverter) {
+    return PrintError(rs, "--parallel can not be used with --f86");
+  }
+
   {
     size_t t4 = sizeof(UInt32);
     size_t t8 = sizeof(UInt64);
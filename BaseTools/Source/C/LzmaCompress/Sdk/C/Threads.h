@@ -6,6 +6,16 @@
 
 #include "Types.h"
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+typedef unsigned THREAD_FUNC_RET_TYPE;
+#define THREAD_FUNC_CALL_TYPE MY_STD_CALL
+#define THREAD_FUNC_DECL THREAD_FUNC_RET_TYPE THREAD_FUNC_CALL_TYPE
+
+#ifdef _WIN32
+
 typedef struct _CThread
 {
   HANDLE handle;
@@ -13,26 +23,82 @@ typedef struct _CThread
 
 #define Thread_Construct(thread) (thread)->handle = NULL
 #define Thread_WasCreated(thread) ((thread)->handle != NULL)
- 
-typedef unsigned THREAD_FUNC_RET_TYPE;
-#define THREAD_FUNC_CALL_TYPE MY_STD_CALL
-#define THREAD_FUNC_DECL THREAD_FUNC_RET_TYPE THREAD_FUNC_CALL_TYPE
-
-WRes Thread_Create(CThread *thread, THREAD_FUNC_RET_TYPE (THREAD_FUNC_CALL_TYPE *startAddress)(void *), LPVOID parameter);
-WRes Thread_Wait(CThread *thread);
-WRes Thread_Close(CThread *thread);
 
 typedef struct _CEvent
 {
   HANDLE handle;
 } CEvent;
 
-typedef CEvent CAutoResetEvent;
-typedef CEvent CManualResetEvent;
-
 #define Event_Construct(event) (event)->handle = NULL
 #define Event_IsCreated(event) ((event)->handle != NULL)
 
+typedef struct _CSemaphore
+{
+  HANDLE handle;
+} CSemaphore;
+
+#define Semaphore_Construct(p) (p)->handle = NULL
+
+typedef CRITICAL_SECTION CCriticalSection;
+
+#define CriticalSection_Delete(p) DeleteCriticalSection(p)
+#define CriticalSection_Enter(p) EnterCriticalSection(p)
+#define CriticalSection_Leave(p) LeaveCriticalSection(p)
+
+#else
+
+/* POSIX threads port, with the events and the semaphores built on a mutex
+   and a condition variable */
+
+typedef struct _CThread
+{
+  pthread_t thread;
+  int created;
+  THREAD_FUNC_RET_TYPE (THREAD_FUNC_CALL_TYPE *startAddress)(void *);
+  void *parameter;
+} CThread;
+
+#define Thread_Construct(thread) (thread)->created = 0
+#define Thread_WasCreated(thread) ((thread)->created != 0)
+
+typedef struct _CEvent
+{
+  int created;
+  int manualReset;
+  int state;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} CEvent;
+
+#define Event_Construct(event) (event)->created = 0
+#define Event_IsCreated(event) ((event)->created != 0)
+
+typedef struct _CSemaphore
+{
+  int created;
+  UInt32 count;
+  UInt32 maxCount;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} CSemaphore;
+
+#define Semaphore_Construct(p) (p)->created = 0
+
+typedef pthread_mutex_t CCriticalSection;
+
+#define CriticalSection_Delete(p) pthread_mutex_destroy(p)
+#define CriticalSection_Enter(p) pthread_mutex_lock(p)
+#define CriticalSection_Leave(p) pthread_mutex_unlock(p)
+
+#endif
+
+WRes Thread_Create(CThread *thread, THREAD_FUNC_RET_TYPE (THREAD_FUNC_CALL_TYPE *startAddress)(void *), void *parameter);
+WRes Thread_Wait(CThread *thread);
+WRes Thread_Close(CThread *thread);
+
+typedef CEvent CAutoResetEvent;
+typedef CEvent CManualResetEvent;
+
 WRes ManualResetEvent_Create(CManualResetEvent *event, int initialSignaled);
 WRes ManualResetEvent_CreateNotSignaled(CManualResetEvent *event);
 WRes AutoResetEvent_Create(CAutoResetEvent *event, int initialSignaled);
@@ -42,27 +108,13 @@ WRes Event_Reset(CEvent *event);
 WRes Event_Wait(CEvent *event);
 WRes Event_Close(CEvent *event);
 
-
-typedef struct _CSemaphore
-{
-  HANDLE handle;
-} CSemaphore;
-
-#define Semaphore_Construct(p) (p)->handle = NULL
-
 WRes Semaphore_Create(CSemaphore *p, UInt32 initiallyCount, UInt32 maxCount);
 WRes Semaphore_ReleaseN(CSemaphore *p, UInt32 num);
 WRes Semaphore_Release1(CSemaphore *p);
 WRes Semaphore_Wait(CSemaphore *p);
 WRes Semaphore_Close(CSemaphore *p);
 
-
-typedef CRITICAL_SECTION CCriticalSection;
-
 WRes CriticalSection_Init(CCriticalSection *p);
-#define CriticalSection_Delete(p) DeleteCriticalSection(p)
-#define CriticalSection_Enter(p) EnterCriticalSection(p)
-#define CriticalSection_Leave(p) LeaveCriticalSection(p)
 
 #endif
 
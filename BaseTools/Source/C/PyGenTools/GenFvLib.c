@@ -0,0 +1,52 @@
+/** @file
+GenFv built as a function of the GenTools extension module. The main() function
+of the tool is renamed GenFvToolMain(). GenFvMain() resets the global state
+GenFvInternalLib.c keeps from one FV image to the next one, then calls it.
+
+Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available 
+under the terms and conditions of the BSD License which accompanies this 
+distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#define main GenFvToolMain
+#include "../GenFv/GenFv.c"
+#undef main
+
+#include "../GenFv/GenFvInternalLib.c"
+
+int
+GenFvMain (
+  int   argc,
+  CHAR8 *argv[]
+  )
+/*++
+
+Routine Description:
+
+  Reset the global state of GenFvInternalLib.c and run GenFv.
+
+Arguments:
+
+  argc   Number of command line parameters.
+  argv   Array of pointers to command line parameter strings.
+
+Returns:
+
+  The exit status of GenFv.
+
+--*/
+{
+  mArm                 = FALSE;
+  MaxFfsAlignment      = 0;
+  mIsLargeFfs          = FALSE;
+  mFvBaseAddressNumber = 0;
+  memset (mFileGuidArray, 0, sizeof (mFileGuidArray));
+
+  return GenFvToolMain (argc, argv);
+}
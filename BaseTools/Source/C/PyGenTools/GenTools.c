@@ -0,0 +1,353 @@
+/** @file
+GenSec, GenFfs and GenFv as functions of a Python extension module.
+
+GenFds generates every section, FFS file and FV image of a platform with GenSec,
+GenFfs and GenFv. Calling them in the GenFds process saves the creation of a
+process for each of these files. The functions take the command line options of
+the tools and return their exit status, so that they are interchangeable with
+the tools.
+
+Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available 
+under the terms and conditions of the BSD License which accompanies this 
+distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "GenToolsAlloc.h"
+#include <pythread.h>
+#include <Common/UefiBaseTypes.h>
+#include <EfiUtilityMsgs.h>
+
+//
+// GenToolsAlloc.h renames these functions in the tools, this file uses the ones
+// of the C library
+//
+#undef malloc
+#undef realloc
+#undef free
+#undef fopen
+#undef fclose
+
+typedef
+int
+(*GEN_TOOL_MAIN) (
+  int   argc,
+  CHAR8 *argv[]
+  );
+
+//
+// The main() functions of GenSec, GenFfs and GenFv, renamed by GenSecLib.c,
+// GenFfsLib.c and GenFvLib.c
+//
+int
+GenSecMain (
+  int   argc,
+  CHAR8 *argv[]
+  );
+
+int
+GenFfsMain (
+  int   argc,
+  CHAR8 *argv[]
+  );
+
+int
+GenFvMain (
+  int   argc,
+  CHAR8 *argv[]
+  );
+
+//
+// The tools share the global state of EfiUtilityMsgs.c and are not reentrant,
+// so only one of them runs at a time
+//
+STATIC PyThread_type_lock mToolLock = NULL;
+
+//
+// The buffers and the files of the running tool which are not freed or closed
+// yet. Nothing is recorded out of the tools, and a buffer which can't be
+// recorded is only leaked.
+//
+typedef struct {
+  VOID          **Entries;
+  UINTN         Count;
+  UINTN         MaxCount;
+} RESOURCE_LIST;
+
+STATIC BOOLEAN        mRecording = FALSE;
+STATIC RESOURCE_LIST  mBufferList = { NULL, 0, 0 };
+STATIC RESOURCE_LIST  mFileList = { NULL, 0, 0 };
+
+STATIC
+VOID
+AddResource (
+  RESOURCE_LIST *List,
+  VOID          *Resource
+  )
+{
+  VOID          **Entries;
+  UINTN         MaxCount;
+
+  if (!mRecording || Resource == NULL) {
+    return;
+  }
+  if (List->Count == List->MaxCount) {
+    MaxCount = (List->MaxCount == 0) ? 64 : List->MaxCount * 2;
+    Entries  = realloc (List->Entries, MaxCount * sizeof (VOID *));
+    if (Entries == NULL) {
+      return;
+    }
+    List->Entries  = Entries;
+    List->MaxCount = MaxCount;
+  }
+  List->Entries[List->Count++] = Resource;
+}
+
+/*
+ Returns TRUE if the resource was recorded, FALSE if it was allocated by the
+ C library or out of the tools.
+*/
+STATIC
+BOOLEAN
+RemoveResource (
+  RESOURCE_LIST *List,
+  VOID          *Resource
+  )
+{
+  UINTN         Index;
+
+  //
+  // The last allocated buffers are usually the first ones freed
+  //
+  for (Index = List->Count; Index > 0; Index--) {
+    if (List->Entries[Index - 1] == Resource) {
+      List->Entries[Index - 1] = List->Entries[--List->Count];
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+void *
+GenToolsMalloc (
+  size_t        Size
+  )
+{
+  VOID          *Buffer;
+
+  Buffer = malloc (Size);
+  AddResource (&mBufferList, Buffer);
+  return Buffer;
+}
+
+void *
+GenToolsRealloc (
+  void          *Buffer,
+  size_t        Size
+  )
+{
+  VOID          *NewBuffer;
+  BOOLEAN       Recorded;
+
+  //
+  // The buffer is forgotten before realloc() frees it, and recorded again when
+  // realloc() fails and keeps it
+  //
+  Recorded  = RemoveResource (&mBufferList, Buffer);
+  NewBuffer = realloc (Buffer, Size);
+  if (NewBuffer != NULL) {
+    if (Recorded || Buffer == NULL) {
+      AddResource (&mBufferList, NewBuffer);
+    }
+  } else if (Recorded && Size != 0) {
+    AddResource (&mBufferList, Buffer);
+  }
+  return NewBuffer;
+}
+
+void
+GenToolsFree (
+  void          *Buffer
+  )
+{
+  RemoveResource (&mBufferList, Buffer);
+  free (Buffer);
+}
+
+FILE *
+GenToolsFopen (
+  const char    *FileName,
+  const char    *Mode
+  )
+{
+  FILE          *File;
+
+  File = fopen (FileName, Mode);
+  AddResource (&mFileList, File);
+  return File;
+}
+
+int
+GenToolsFclose (
+  FILE          *File
+  )
+{
+  RemoveResource (&mFileList, File);
+  return fclose (File);
+}
+
+/*
+ Free the buffers and close the files the tool left on its error paths.
+*/
+STATIC
+VOID
+ReleaseToolResources (
+  VOID
+  )
+{
+  while (mFileList.Count != 0) {
+    fclose (mFileList.Entries[--mFileList.Count]);
+  }
+  while (mBufferList.Count != 0) {
+    free (mBufferList.Entries[--mBufferList.Count]);
+  }
+}
+
+/*
+ Call the main() function of a tool with a sequence of options.
+
+ The global interpreter lock is released while the tool runs, so that the
+ other Python threads run at the same time. The tools themselves run one at a
+ time.
+*/
+STATIC
+PyObject*
+CallTool (
+  GEN_TOOL_MAIN Main,
+  CHAR8         *ToolName,
+  PyObject      *Args
+  )
+{
+  PyObject      *Options;
+  PyObject      *Sequence;
+  Py_ssize_t    Count;
+  Py_ssize_t    Index;
+  CHAR8         **Argv;
+  int           Status;
+
+  Status = PyArg_ParseTuple(
+            Args,
+            "O",
+            &Options
+            );
+  if (Status == 0) {
+    return NULL;
+  }
+
+  Sequence = PySequence_Fast(Options, "The options must be a sequence of strings");
+  if (Sequence == NULL) {
+    return NULL;
+  }
+
+  Count = PySequence_Fast_GET_SIZE(Sequence);
+  Argv  = malloc ((Count + 2) * sizeof (CHAR8 *));
+  if (Argv == NULL) {
+    Py_DECREF(Sequence);
+    return PyErr_NoMemory();
+  }
+
+  Argv[0] = ToolName;
+  for (Index = 0; Index < Count; Index++) {
+    Argv[Index + 1] = PyString_AsString(PySequence_Fast_GET_ITEM(Sequence, Index));
+    if (Argv[Index + 1] == NULL) {
+      free (Argv);
+      Py_DECREF(Sequence);
+      return NULL;
+    }
+  }
+  Argv[Count + 1] = NULL;
+
+  Py_BEGIN_ALLOW_THREADS
+  PyThread_acquire_lock (mToolLock, WAIT_LOCK);
+  //
+  // Forget the errors and the print level of the previous call
+  //
+  ResetUtilityStatus ();
+  mRecording = TRUE;
+  Status = Main ((int) Count + 1, Argv);
+  mRecording = FALSE;
+  ReleaseToolResources ();
+  fflush (stdout);
+  fflush (stderr);
+  PyThread_release_lock (mToolLock);
+  Py_END_ALLOW_THREADS
+
+  free (Argv);
+  Py_DECREF(Sequence);
+  return PyInt_FromLong(Status);
+}
+
+/*
+ GenSec(options)
+*/
+STATIC
+PyObject*
+GenSec (
+  PyObject    *Self,
+  PyObject    *Args
+  )
+{
+  return CallTool (GenSecMain, "GenSec", Args);
+}
+
+/*
+ GenFfs(options)
+*/
+STATIC
+PyObject*
+GenFfs (
+  PyObject    *Self,
+  PyObject    *Args
+  )
+{
+  return CallTool (GenFfsMain, "GenFfs", Args);
+}
+
+/*
+ GenFv(options)
+*/
+STATIC
+PyObject*
+GenFv (
+  PyObject    *Self,
+  PyObject    *Args
+  )
+{
+  return CallTool (GenFvMain, "GenFv", Args);
+}
+
+STATIC CHAR8 GenSecDocs[] = "GenSec(): Run GenSec with a list of options and return its exit status\n";
+STATIC CHAR8 GenFfsDocs[] = "GenFfs(): Run GenFfs with a list of options and return its exit status\n";
+STATIC CHAR8 GenFvDocs[] = "GenFv(): Run GenFv with a list of options and return its exit status\n";
+
+STATIC PyMethodDef GenTools_Funcs[] = {
+  {"GenSec", (PyCFunction)GenSec, METH_VARARGS, GenSecDocs},
+  {"GenFfs", (PyCFunction)GenFfs, METH_VARARGS, GenFfsDocs},
+  {"GenFv", (PyCFunction)GenFv, METH_VARARGS, GenFvDocs},
+  {NULL, NULL, 0, NULL}
+};
+
+PyMODINIT_FUNC
+initGenTools(VOID) {
+  mToolLock = PyThread_allocate_lock ();
+  if (mToolLock == NULL) {
+    PyErr_NoMemory ();
+    return;
+  }
+  Py_InitModule3("GenTools", GenTools_Funcs, "GenSec, GenFfs and GenFv Extension Module");
+}
@@ -0,0 +1,65 @@
+/** @file
+Record the buffers and the files of the tools run by the GenTools extension module.
+
+Every source file of the module is compiled with this file included first. The
+tools don't free all their buffers nor close all their files on their error
+paths, which is harmless when a tool exits, but would leak in the long lived
+GenFds process. GenTools.c records what a tool allocates and opens while it
+runs, and frees or closes what is left when the tool returns.
+
+Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available
+under the terms and conditions of the BSD License which accompanies this
+distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _GEN_TOOLS_ALLOC_H_
+#define _GEN_TOOLS_ALLOC_H_
+
+//
+// Python.h is included before the headers of the C library in an extension
+// module, and the C library is declared before the functions are renamed
+//
+#include <Python.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void *
+GenToolsMalloc (
+  size_t        Size
+  );
+
+void *
+GenToolsRealloc (
+  void          *Buffer,
+  size_t        Size
+  );
+
+void
+GenToolsFree (
+  void          *Buffer
+  );
+
+FILE *
+GenToolsFopen (
+  const char    *FileName,
+  const char    *Mode
+  );
+
+int
+GenToolsFclose (
+  FILE          *File
+  );
+
+#define malloc(Size)            GenToolsMalloc (Size)
+#define realloc(Buffer, Size)   GenToolsRealloc (Buffer, Size)
+#define free(Buffer)            GenToolsFree (Buffer)
+#define fopen(FileName, Mode)   GenToolsFopen (FileName, Mode)
+#define fclose(File)            GenToolsFclose (File)
+
+#endif
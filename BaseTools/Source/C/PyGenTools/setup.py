@@ -0,0 +1,57 @@
+## @file
+# package and install GenTools extension
+#
+#  Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+#
+#  This program and the accompanying materials
+#  are licensed and made available under the terms and conditions of the BSD License
+#  which accompanies this distribution.  The full text of the license may be found at
+#  http://opensource.org/licenses/bsd-license.php
+#
+#  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+
+##
+# Import Modules
+#
+from distutils.core import setup, Extension
+import os
+import sys
+
+if 'BASE_TOOLS_PATH' not in os.environ:
+    raise "Please define BASE_TOOLS_PATH to the root of base tools tree"
+
+BaseToolsDir = os.environ['BASE_TOOLS_PATH']
+CommonDir = os.path.join(BaseToolsDir, 'Source', 'C', 'Common')
+setup(
+    name="GenTools",
+    version="0.01",
+    ext_modules=[
+        Extension(
+            'GenTools',
+            sources=[
+                os.path.join(CommonDir, 'BasePeCoff.c'),
+                os.path.join(CommonDir, 'CommonLib.c'),
+                os.path.join(CommonDir, 'Crc32.c'),
+                os.path.join(CommonDir, 'EfiCompress.c'),
+                os.path.join(CommonDir, 'EfiUtilityMsgs.c'),
+                os.path.join(CommonDir, 'FvLib.c'),
+                os.path.join(CommonDir, 'ParseInf.c'),
+                os.path.join(CommonDir, 'PeCoffLoaderEx.c'),
+                'GenSecLib.c',
+                'GenFfsLib.c',
+                'GenFvLib.c',
+                'GenTools.c'
+                ],
+            include_dirs=[
+                os.path.join(BaseToolsDir, 'Source', 'C', 'Include'),
+                os.path.join(BaseToolsDir, 'Source', 'C', 'Include', 'Ia32'),
+                CommonDir
+                ],
+            # The buffers and the files of the tools are recorded, see GenToolsAlloc.h
+            extra_compile_args=['/FIGenToolsAlloc.h'] if sys.platform == 'win32' else ['-include', 'GenToolsAlloc.h'],
+            libraries=[] if sys.platform == 'win32' else ['uuid'],
+            )
+        ],
+  )
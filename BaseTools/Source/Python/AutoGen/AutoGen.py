@@ -32,6 +32,7 @@ from Common.DataType import *
 from Common.Misc import *
 from Common.String import *
 import Common.GlobalData as GlobalData
+from Common.BuildTiming import BuildTiming
 from GenFds.FdfParser import *
 from CommonDataClass.CommonClass import SkuInfoClass
 from Workspace.BuildClassObject import *
@@ -3400,6 +3401,7 @@ class ModuleAutoGen(AutoGen):
             for LibraryAutoGen in self.LibraryAutoGenList:
                 LibraryAutoGen.CreateMakeFile()
 
+        BeginTime = BuildTiming.Begin()
         if len(self.CustomMakefile) == 0:
             Makefile = GenMake.ModuleMakefile(self)
         else:
@@ -3410,6 +3412,7 @@ class ModuleAutoGen(AutoGen):
         else:
             EdkLogger.debug(EdkLogger.DEBUG_9, "Skipped the generation of makefile for module %s [%s]" %
                             (self.Name, self.Arch))
+        BuildTiming.End('MakeFile', '%s [%s]' % (self.MetaFile, self.Arch), BeginTime)
 
         self.IsMakeFileCreated = True
 
@@ -3440,6 +3443,7 @@ class ModuleAutoGen(AutoGen):
             for LibraryAutoGen in self.LibraryAutoGenList:
                 LibraryAutoGen.CreateCodeFile()
 
+        BeginTime = BuildTiming.Begin()
         AutoGenList = []
         IgoredAutoGenList = []
 
@@ -3482,6 +3486,7 @@ class ModuleAutoGen(AutoGen):
         else:
             EdkLogger.debug(EdkLogger.DEBUG_9, "Generated [%s] (skipped %s) files for module %s [%s]" %
                             (" ".join(AutoGenList), " ".join(IgoredAutoGenList), self.Name, self.Arch))
+        BuildTiming.End('AutoGen', '%s [%s]' % (self.MetaFile, self.Arch), BeginTime)
 
         self.IsCodeFileCreated = True
         return AutoGenList
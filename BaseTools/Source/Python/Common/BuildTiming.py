@@ -0,0 +1,180 @@
+## @file
+# Record of the wall clock and CPU time spent in the steps of a build
+#
+#  The steps are recorded only if the TIMING build report is requested. Every
+#  step is recorded with the process and the thread it ran in, so the steps of
+#  the GenFds process and of the AutoGen processes can be merged in the record
+#  of the build process, and shown on a time line.
+#
+#  Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+#
+#  This program and the accompanying materials
+#  are licensed and made available under the terms and conditions of the BSD License
+#  which accompanies this distribution.  The full text of the license may be found at
+#  http://opensource.org/licenses/bsd-license.php
+#
+#  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+
+##
+# Import Modules
+#
+import Common.LongFilePathOs as os
+import errno
+import json
+import subprocess
+import threading
+import time
+from os import times
+from Common.LongFilePathSupport import OpenLongFilePath as open
+
+try:
+    from os import wait4
+except ImportError:
+    # The CPU time of the tools is not measured on Windows
+    wait4 = None
+
+## Process started by Popen, whose CPU time is measured when it is waited for
+#
+#  The CPU time includes the time of the processes the tool waited for, so the
+#  CPU time of make includes the time of the compilers it started.
+#
+class TimedPopen(subprocess.Popen):
+    CpuTime = None
+
+    def wait(self):
+        if wait4 == None:
+            return subprocess.Popen.wait(self)
+        while self.returncode == None:
+            try:
+                (Pid, Status, Usage) = wait4(self.pid, 0)
+            except OSError, X:
+                if X.errno == errno.EINTR:
+                    continue
+                if X.errno != errno.ECHILD:
+                    raise
+                # Somebody else waited for the process
+                self.returncode = 0
+                break
+            self.CpuTime = Usage.ru_utime + Usage.ru_stime
+            self._handle_exitstatus(Status)
+        return self.returncode
+
+## Get the CPU time of the current process
+def GetCpuTime():
+    Times = times()
+    return Times[0] + Times[1]
+
+## The steps recorded in the current process
+#
+#   A step is a tuple of the category, the name, the start time, the wall clock
+#   time, the CPU time, the process id and the thread. Several threads may have
+#   the same name, so the thread is also identified by its id.
+#
+class BuildTiming:
+    Enabled = False
+    StepList = []
+    _Lock = threading.Lock()
+
+    ## Start recording the steps
+    @staticmethod
+    def Enable():
+        BuildTiming.Enabled = True
+
+    ## Begin the measure of a step
+    #
+    #   @retval tuple           The time the step began, to give to End(), or
+    #                           None if the steps are not recorded
+    #
+    @staticmethod
+    def Begin():
+        if not BuildTiming.Enabled:
+            return None
+        return (time.time(), GetCpuTime())
+
+    ## End the measure of a step and record it
+    #
+    #   @param  Category        The kind of step
+    #   @param  Name            The name of the step
+    #   @param  BeginTime       The value returned by Begin()
+    #   @param  Proc            The TimedPopen object of the tool if the step
+    #                           ran in another process, whose CPU time may not
+    #                           be known, None if it ran in this process
+    #
+    @staticmethod
+    def End(Category, Name, BeginTime, Proc=None):
+        if BeginTime == None:
+            return
+        if Proc != None:
+            CpuTime = Proc.CpuTime
+        else:
+            CpuTime = GetCpuTime() - BeginTime[1]
+        Thread = threading.currentThread()
+        BuildTiming._Lock.acquire()
+        BuildTiming.StepList.append((Category, Name, BeginTime[0], time.time() - BeginTime[0], CpuTime,
+                                     os.getpid(), "%s %d" % (Thread.getName(), Thread.ident)))
+        BuildTiming._Lock.release()
+
+    ## Add the steps recorded by another process
+    #
+    #   @param  StepList        The steps recorded by the other process
+    #
+    @staticmethod
+    def Extend(StepList):
+        BuildTiming._Lock.acquire()
+        BuildTiming.StepList.extend([tuple(Step) for Step in StepList])
+        BuildTiming._Lock.release()
+
+    ## Save the steps in a file, to be loaded by the process which started this one
+    #
+    #   @param  FileName        Path of the file
+    #
+    @staticmethod
+    def Save(FileName):
+        File = open(FileName, 'w')
+        try:
+            json.dump(BuildTiming.StepList, File)
+        finally:
+            File.close()
+
+    ## Load the steps saved by another process
+    #
+    #   @param  FileName        Path of the file
+    #
+    @staticmethod
+    def Load(FileName):
+        if not os.path.isfile(FileName):
+            return
+        File = open(FileName, 'r')
+        try:
+            BuildTiming.Extend(json.load(File))
+        finally:
+            File.close()
+
+    ## Save the steps in the trace event format of the Chrome trace viewer
+    #
+    #   Every step is a complete event. The times are in micro-seconds from the
+    #   beginning of the first step.
+    #
+    #   @param  FileName        Path of the file
+    #
+    @staticmethod
+    def SaveChromeTrace(FileName):
+        EventList = []
+        if BuildTiming.StepList:
+            Origin = min([Step[2] for Step in BuildTiming.StepList])
+        ThreadId = {}
+        for (Category, Name, Start, WallTime, CpuTime, Pid, Thread) in BuildTiming.StepList:
+            if (Pid, Thread) not in ThreadId:
+                ThreadId[Pid, Thread] = len(ThreadId) + 1
+                EventList.append({"name" : "thread_name", "ph" : "M", "pid" : Pid, "tid" : ThreadId[Pid, Thread],
+                                  "args" : {"name" : Thread}})
+            EventList.append({"name" : Name, "cat" : Category, "ph" : "X", "pid" : Pid, "tid" : ThreadId[Pid, Thread],
+                              "ts" : int((Start - Origin) * 1000000), "dur" : int(WallTime * 1000000),
+                              "args" : {"cpu" : CpuTime}})
+        File = open(FileName, 'w')
+        try:
+            json.dump({"traceEvents" : EventList, "displayTimeUnit" : "ms"}, File, indent=1)
+        finally:
+            File.close()
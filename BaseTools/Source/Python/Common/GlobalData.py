@@ -60,11 +60,24 @@ gConfDirectory = ''
 #
 gDatabasePath = ".cache/build.db"
 
+#
+# The number of meta files whose parsed data was reused from the database or
+# that were parsed again, and the time the reused files took to be parsed
+#
+gMetaFileReused = 0
+gMetaFileParsed = 0
+gParseTimeSaved = 0.0
+
 #
 # Build flag for binary build
 #
 gIgnoreSource = False
 
+#
+# The maximum number of concurrent threads, also used by GenFds
+#
+gThreadNumber = 1
+
 #
 # FDF parser
 #
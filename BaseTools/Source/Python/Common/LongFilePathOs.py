@@ -67,6 +67,7 @@ F_OK = os.F_OK
 sep = os.sep
 linesep = os.linesep
 getenv = os.getenv
+getpid = os.getpid
 pathsep = os.pathsep
 name = os.name
 SEEK_SET = os.SEEK_SET
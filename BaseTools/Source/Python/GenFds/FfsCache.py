@@ -0,0 +1,273 @@
+## @file
+# Content addressed cache of the sections and FFS files generated by GenFds
+#
+#  The output of GenSec, GenFfs and the GUIDed section tools only depends on the
+#  tool, its options and the contents of its input files. The cache key is built
+#  from these, so an output is reused whenever the same tool is called with the
+#  same options on the same input data, even if the input files were regenerated
+#  or the FDF file was touched. The least recently used outputs are removed once
+#  the cache grows bigger than its maximum size.
+#
+#  Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+#
+#  This program and the accompanying materials
+#  are licensed and made available under the terms and conditions of the BSD License
+#  which accompanies this distribution.  The full text of the license may be found at
+#  http://opensource.org/licenses/bsd-license.php
+#
+#  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+
+##
+# Import Modules
+#
+import Common.LongFilePathOs as os
+import hashlib
+import threading
+from Common.LongFilePathSupport import OpenLongFilePath as open
+from Common.LongFilePathSupport import CopyLongFilePath
+
+## Content addressed cache of tool outputs
+#
+#   The cache is used by the threads of GenFdsGlobalVariable.CallInThreads(), so
+#   the counters and the digests below are only accessed with __Lock held.
+#
+class FfsCache:
+    CacheDir = None
+    MaxSize = 1024 * 1024 * 1024
+    Hits = 0
+    Misses = 0
+    Removed = 0
+
+    __Lock = threading.Lock()
+
+    # The digests of the files hashed so far, keyed by path, with the size and
+    # time stamp the digest was computed for
+    __FileDigest = {}
+    # The identity of the tools found so far, keyed by the tool name
+    __ToolDigest = {}
+
+    ## SetCacheDir()
+    #
+    #   @param  CacheDir        Directory of the cache, or None to disable it
+    #
+    #   @param  MaxSize         Maximum size of the cache in bytes, or None to keep it unbounded
+    #
+    @staticmethod
+    def SetCacheDir(CacheDir, MaxSize=1024 * 1024 * 1024):
+        if CacheDir not in [None, ''] and not os.path.exists(CacheDir):
+            os.makedirs(CacheDir)
+        FfsCache.CacheDir = CacheDir
+        FfsCache.MaxSize = MaxSize
+
+    ## Get the digest of the contents of a file
+    #
+    #   @param  FileName        Path of the file
+    #
+    #   @retval string          The digest, or None if the file doesn't exist
+    #
+    @staticmethod
+    def __GetFileDigest(FileName):
+        if not os.path.isfile(FileName):
+            return None
+        Stat = os.stat(FileName)
+        with FfsCache.__Lock:
+            Entry = FfsCache.__FileDigest.get(FileName)
+        if Entry != None and Entry[0] == Stat.st_size and Entry[1] == Stat.st_mtime:
+            return Entry[2]
+
+        Hash = hashlib.sha1()
+        File = open(FileName, 'rb')
+        try:
+            while True:
+                Data = File.read(0x100000)
+                if not Data:
+                    break
+                Hash.update(Data)
+        finally:
+            File.close()
+        with FfsCache.__Lock:
+            FfsCache.__FileDigest[FileName] = (Stat.st_size, Stat.st_mtime, Hash.hexdigest())
+        return Hash.hexdigest()
+
+    ## Get the identity of a tool
+    #
+    #   A rebuilt tool has a different size or time stamp, so it does not reuse
+    #   the outputs of the previous build of the tool.
+    #
+    #   @param  Tool            Name or path of the tool
+    #
+    #   @retval string          The identity of the tool
+    #
+    @staticmethod
+    def __GetToolDigest(Tool):
+        with FfsCache.__Lock:
+            Identity = FfsCache.__ToolDigest.get(Tool)
+        if Identity != None:
+            return Identity
+
+        Identity = Tool
+        if os.path.dirname(Tool) != '':
+            SearchList = [Tool]
+        else:
+            SearchList = [os.path.join(Dir, Tool) for Dir in os.environ.get('PATH', '').split(os.pathsep)]
+        for Path in SearchList:
+            for Candidate in [Path, Path + '.exe']:
+                if os.path.isfile(Candidate):
+                    Stat = os.stat(Candidate)
+                    Identity = '%s %d %d' % (Candidate, Stat.st_size, Stat.st_mtime)
+                    break
+            else:
+                continue
+            break
+        with FfsCache.__Lock:
+            FfsCache.__ToolDigest[Tool] = Identity
+        return Identity
+
+    ## Get the cache key of a tool call
+    #
+    #   The path of the output and the paths of the input files are replaced by
+    #   the contents of the input files.
+    #
+    #   @param  Cmd             Command line of the tool
+    #   @param  Output          Path of output file
+    #   @param  Input           Path list of input files
+    #   @param  ToolFile        Path of the module running the tool in the GenFds
+    #                           process, or None if the tool is found in PATH
+    #
+    #   @retval string          The cache key, or None if the call can't be cached
+    #
+    @staticmethod
+    def GetKey(Cmd, Output, Input, ToolFile=None):
+        if FfsCache.CacheDir in [None, '']:
+            return None
+
+        Hash = hashlib.sha1()
+        if ToolFile != None:
+            Hash.update(Cmd[0] + '\0' + FfsCache.__GetToolDigest(ToolFile))
+        else:
+            Hash.update(FfsCache.__GetToolDigest(Cmd[0]))
+        for Arg in Cmd[1:]:
+            if Arg == Output:
+                Hash.update('\0<output>')
+            elif Arg in Input:
+                Digest = FfsCache.__GetFileDigest(Arg)
+                if Digest == None:
+                    return None
+                Hash.update('\0<input>' + Digest)
+            else:
+                Hash.update('\0' + Arg)
+        return Hash.hexdigest()
+
+    ## Copy the cached output of a tool call to the output file
+    #
+    #   @param  Key             The cache key of the tool call
+    #   @param  Output          Path of output file
+    #
+    #   @retval True            if the output was found in the cache
+    #   @retval False           if the tool needs to be called
+    #
+    @staticmethod
+    def Restore(Key, Output):
+        if Key == None:
+            return False
+        CacheFile = os.path.join(FfsCache.CacheDir, Key[0:2], Key)
+        if not os.path.isfile(CacheFile):
+            with FfsCache.__Lock:
+                FfsCache.Misses += 1
+            return False
+        CopyLongFilePath(CacheFile, Output)
+        try:
+            # The time stamp of an entry tells when it was last used
+            os.utime(CacheFile, None)
+        except OSError:
+            pass
+        with FfsCache.__Lock:
+            FfsCache.Hits += 1
+        return True
+
+    ## Save the output of a tool call in the cache
+    #
+    #   The output is copied to a temporary file of the process and the thread
+    #   first and then renamed, so that a cache entry is never seen partially
+    #   written.
+    #
+    #   @param  Key             The cache key of the tool call
+    #   @param  Output          Path of output file
+    #
+    @staticmethod
+    def Save(Key, Output):
+        if Key == None or not os.path.isfile(Output):
+            return
+        CacheDir = os.path.join(FfsCache.CacheDir, Key[0:2])
+        CacheFile = os.path.join(CacheDir, Key)
+        TempFile = '%s.%d.%d.tmp' % (CacheFile, os.getpid(), threading.current_thread().ident)
+        try:
+            if not os.path.exists(CacheDir):
+                os.makedirs(CacheDir)
+            CopyLongFilePath(Output, TempFile)
+            if not os.path.exists(CacheFile):
+                os.rename(TempFile, CacheFile)
+        except (IOError, OSError):
+            # The cache is only an optimization, the build goes on without it
+            pass
+        if os.path.exists(TempFile):
+            os.remove(TempFile)
+
+    ## Remove the least recently used entries until the cache fits in its maximum size
+    #
+    #   It is called once the image is generated, when no thread uses the cache.
+    #   The entries being removed by another build sharing the cache are skipped.
+    #
+    @staticmethod
+    def Trim():
+        if FfsCache.CacheDir in [None, ''] or FfsCache.MaxSize == None:
+            return
+        EntryList = []
+        Total = 0
+        for Root, Dirs, Files in os.walk(FfsCache.CacheDir):
+            for Name in Files:
+                if Name.endswith('.tmp'):
+                    continue
+                Path = os.path.join(Root, Name)
+                try:
+                    Stat = os.stat(Path)
+                except OSError:
+                    continue
+                EntryList.append((Stat.st_mtime, Stat.st_size, Path))
+                Total += Stat.st_size
+        if Total <= FfsCache.MaxSize:
+            return
+
+        EntryList.sort()
+        for (Time, Size, Path) in EntryList:
+            if Total <= FfsCache.MaxSize:
+                break
+            try:
+                os.remove(Path)
+            except OSError:
+                continue
+            Total -= Size
+            FfsCache.Removed += 1
+
+    ## Get the report of the cache
+    #
+    #   @retval string          The number of hits and misses, or None if the cache is disabled
+    #
+    @staticmethod
+    def GetReport():
+        if FfsCache.CacheDir in [None, '']:
+            return None
+        with FfsCache.__Lock:
+            Hits = FfsCache.Hits
+            Misses = FfsCache.Misses
+        Total = Hits + Misses
+        if Total == 0:
+            Report = 'FFS cache: no section or FFS file needed to be generated'
+        else:
+            Report = 'FFS cache: %d hits, %d misses (%d%% reused) in %s' % \
+                     (Hits, Misses, Hits * 100 / Total, FfsCache.CacheDir)
+        if FfsCache.Removed != 0:
+            Report += ', %d least recently used entries removed' % FfsCache.Removed
+        return Report
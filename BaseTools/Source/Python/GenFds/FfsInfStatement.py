@@ -19,6 +19,7 @@
 import Rule
 import Common.LongFilePathOs as os
 import StringIO
+import copy
 from struct import *
 from GenFdsGlobalVariable import GenFdsGlobalVariable
 import Ffs
@@ -398,9 +399,11 @@ class FfsInfStatement(FfsInfStatementClassObject):
                 self.Rule = "BINARY"
                 
         #
-        # Get the rule of how to generate Ffs file
+        # Get the rule of how to generate Ffs file. The sections of a rule keep
+        # the state of the module being generated, and several modules may be
+        # generated at the same time, so each module uses its own copy.
         #
-        Rule = self.__GetRule__()
+        Rule = copy.deepcopy(self.__GetRule__())
         GenFdsGlobalVariable.VerboseLogger( "Packing binaries from inf file : %s" %self.InfFileName)
         #
         # Convert Fv File Type for PI1.1 SMM driver.
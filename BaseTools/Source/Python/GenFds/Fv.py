@@ -24,6 +24,7 @@ import Ffs
 import AprioriSection
 from GenFdsGlobalVariable import GenFdsGlobalVariable
 from GenFds import GenFds
+from FfsInfStatement import FfsInfStatement
 from CommonDataClass.FdfClass import FvClassObject
 from Common.Misc import SaveFileOnChange
 from Common.LongFilePathSupport import CopyLongFilePath
@@ -110,8 +111,7 @@ class FV (FvClassObject):
                                            T_CHAR_LF)
 
         # Process Modules in FfsList
-        for FfsFile in self.FfsList :
-            FileName = FfsFile.GenFfs(MacroDict, FvParentAddr=BaseAddress)
+        for FileName in self.__GenFfsList__(MacroDict, [], BaseAddress):
             FfsFileList.append(FileName)
             self.FvInfFile.writelines("EFI_FILE_NAME = " + \
                                        FileName          + \
@@ -162,8 +162,7 @@ class FV (FvClassObject):
 
             if FvChildAddr != []:
                 # Update Ffs again
-                for FfsFile in self.FfsList :
-                    FileName = FfsFile.GenFfs(MacroDict, FvChildAddr, BaseAddress)
+                self.__GenFfsList__(MacroDict, FvChildAddr, BaseAddress)
                 
                 if GenFdsGlobalVariable.LargeFileInFvFlags[-1]:
                     FFSGuid = GenFdsGlobalVariable.EFI_FIRMWARE_FILE_SYSTEM3_GUID;
@@ -206,6 +205,38 @@ class FV (FvClassObject):
         GenFdsGlobalVariable.LargeFileInFvFlags.pop()
         return FvOutputFile
 
+    ## __GenFfsList__()
+    #
+    #   Generate the FFS files of the modules in FfsList
+    #
+    #   The FFS files of the INF statements don't depend on each other, so they are
+    #   generated by several threads when GenFds runs with more than one thread,
+    #   after the FFS files of the other statements.
+    #
+    #   @param  self        The object pointer
+    #   @param  MacroDict   macro value pair
+    #   @param  FvChildAddr base addresses of the FVs inside this FV
+    #   @param  BaseAddress base address of FV
+    #   @retval list        Generated FFS file paths, in the order of FfsList
+    #
+    def __GenFfsList__(self, MacroDict, FvChildAddr, BaseAddress):
+        FileNameList = [None] * len(self.FfsList)
+        InfIndexList = []
+        for Index in range(0, len(self.FfsList)):
+            FfsFile = self.FfsList[Index]
+            if GenFdsGlobalVariable.ThreadNumber > 1 and isinstance(FfsFile, FfsInfStatement):
+                InfIndexList.append(Index)
+            else:
+                FileNameList[Index] = FfsFile.GenFfs(MacroDict, FvChildAddr, BaseAddress)
+
+        FunctionList = []
+        for Index in InfIndexList:
+            FunctionList.append(lambda FfsFile=self.FfsList[Index]: FfsFile.GenFfs(MacroDict, FvChildAddr, BaseAddress))
+        ResultList = GenFdsGlobalVariable.CallInThreads(FunctionList)
+        for Index in range(0, len(InfIndexList)):
+            FileNameList[InfIndexList[Index]] = ResultList[Index]
+        return FileNameList
+
     ## __InitializeInf__()
     #
     #   Initilize the inf file to create FV
@@ -22,6 +22,8 @@ import linecache
 import FdfParser
 import Common.BuildToolError as BuildToolError
 from GenFdsGlobalVariable import GenFdsGlobalVariable
+from FfsCache import FfsCache
+from Common.BuildTiming import BuildTiming
 from Workspace.WorkspaceDatabase import WorkspaceDatabase
 from Workspace.BuildClassObject import PcdClassObject
 from Workspace.BuildClassObject import ModuleBuildClassObject
@@ -71,6 +73,21 @@ def main():
             
         if Options.FixedAddress != None:
             GenFdsGlobalVariable.FixedLoadAddress = True
+
+        if Options.ThreadNumber != None and Options.ThreadNumber > 1:
+            GenFdsGlobalVariable.ThreadNumber = Options.ThreadNumber
+
+        if Options.TimingFile:
+            BuildTiming.Enable()
+
+        if Options.NoFfsCache:
+            GenFdsGlobalVariable.FfsCacheDir = None
+        elif Options.FfsCacheDir:
+            GenFdsGlobalVariable.FfsCacheDir = os.path.normpath(Options.FfsCacheDir)
+        if Options.FfsCacheSize != None:
+            if Options.FfsCacheSize <= 0:
+                EdkLogger.error("GenFds", OPTION_VALUE_INVALID, "The FFS cache size must be a positive number of MB")
+            GenFdsGlobalVariable.FfsCacheSize = Options.FfsCacheSize * 1024 * 1024
             
         if Options.quiet != None:
             EdkLogger.SetLevel(EdkLogger.QUIET)
@@ -281,6 +298,16 @@ def main():
         """Display FV space info."""
         GenFds.DisplayFvSpaceInfo(FdfParserObj)
 
+        """Display FFS cache hits and misses."""
+        FfsCache.Trim()
+        CacheReport = FfsCache.GetReport()
+        if CacheReport != None:
+            GenFdsGlobalVariable.InfLogger('\n' + CacheReport)
+
+        """Save the tool calls for the TIMING build report."""
+        if Options.TimingFile:
+            BuildTiming.Save(Options.TimingFile)
+
     except FdfParser.Warning, X:
         EdkLogger.error(X.ToolName, FORMAT_INVALID, File=X.FileName, Line=X.LineNumber, ExtraData=X.Message, RaiseError = False)
         ReturnCode = FORMAT_INVALID
@@ -344,6 +371,12 @@ def myOptionParser():
     Parser.add_option("-s", "--specifyaddress", dest="FixedAddress", action="store_true", type=None, help="Specify driver load address.")
     Parser.add_option("--conf", action="store", type="string", dest="ConfDirectory", help="Specify the customized Conf directory.")
     Parser.add_option("--ignore-sources", action="store_true", dest="IgnoreSources", default=False, help="Focus to a binary build and ignore all source files")
+    Parser.add_option("-n", action="callback", type="int", dest="ThreadNumber", callback=SingleCheckCallback,
+                      help="Generate the FFS files of the INF statements of a FV in this number of threads. Less than 2 will generate them one by one.")
+    Parser.add_option("--ffs-cache", action="store", type="string", dest="FfsCacheDir", help="Specify the directory of the FFS cache, which may be shared by several builds. The default is the FfsCache directory in the FV output directory.")
+    Parser.add_option("--no-ffs-cache", action="store_true", dest="NoFfsCache", default=False, help="Disable the FFS cache, always call the tools to generate sections and FFS files.")
+    Parser.add_option("--ffs-cache-size", action="store", type="int", dest="FfsCacheSize", help="Specify the maximum size of the FFS cache in MB, the least recently used entries are removed beyond it. The default is 1024.")
+    Parser.add_option("--timing-file", action="store", type="string", dest="TimingFile", help="Save the wall clock and CPU time of every tool call to the specified file, for the TIMING build report.")
 
     (Options, args) = Parser.parse_args()
     return Options
@@ -20,6 +20,7 @@ import sys
 import subprocess
 import struct
 import array
+import threading
 
 from Common.BuildToolError import *
 from Common import EdkLogger
@@ -27,10 +28,23 @@ from Common.Misc import SaveFileOnChange
 
 from Common.TargetTxtClassObject import TargetTxtClassObject
 from Common.ToolDefClassObject import ToolDefClassObject
+from Common.ToolDefClassObject import ToolDefDict
 from AutoGen.BuildEngine import BuildRule
 import Common.DataType as DataType
 from Common.Misc import PathClass
 from Common.LongFilePathSupport import OpenLongFilePath as open
+from FfsCache import FfsCache
+from Common.BuildTiming import BuildTiming
+from Common.BuildTiming import TimedPopen
+
+#
+# The GenTools extension module, built from BaseTools/Source/C/PyGenTools, runs
+# GenSec, GenFfs and GenFv in the GenFds process
+#
+try:
+    import GenTools
+except ImportError:
+    GenTools = None
 
 ## Global variables
 #
@@ -63,10 +77,18 @@ class GenFdsGlobalVariable:
     FdfFileTimeStamp = 0
     FixedLoadAddress = False
     PlatformName = ''
+    # Directory of the FFS cache, '' for the default one, None to disable the cache
+    FfsCacheDir = ''
+    FfsCacheSize = 1024 * 1024 * 1024
+    # The number of threads that generate the FFS files of a FV
+    ThreadNumber = 1
+    # The state of the current thread of CallInThreads()
+    ThreadState = threading.local()
     
     BuildRuleFamily = "MSFT"
     ToolChainFamily = "MSFT"
     __BuildRuleDatabase = None
+    __ToolDefinition = None
     
     #
     # The list whose element are flags to indicate if large FFS or SECTION files exist in FV.
@@ -116,6 +138,16 @@ class GenFdsGlobalVariable:
                     GenFdsGlobalVariable.ToolChainFamily = ToolDefinition[DataType.TAB_TOD_DEFINES_FAMILY][GenFdsGlobalVariable.ToolChainTag]
         return GenFdsGlobalVariable.__BuildRuleDatabase
 
+    ## GetToolDefinition
+    #
+    #   Load tools_def.txt once for all the GUIDed sections that look up their tool in it
+    #
+    @staticmethod
+    def GetToolDefinition():
+        if GenFdsGlobalVariable.__ToolDefinition == None:
+            GenFdsGlobalVariable.__ToolDefinition = ToolDefDict(GenFdsGlobalVariable.ConfDir)
+        return GenFdsGlobalVariable.__ToolDefinition
+
     ## GetBuildRules
     #    @param Inf: object of InfBuildData
     #    @param Arch: current arch
@@ -283,6 +315,9 @@ class GenFdsGlobalVariable:
         GenFdsGlobalVariable.FfsDir = os.path.join(GenFdsGlobalVariable.FvDir, 'Ffs')
         if not os.path.exists(GenFdsGlobalVariable.FfsDir) :
             os.makedirs(GenFdsGlobalVariable.FfsDir)
+        if GenFdsGlobalVariable.FfsCacheDir == '':
+            GenFdsGlobalVariable.FfsCacheDir = os.path.join(GenFdsGlobalVariable.FvDir, 'FfsCache')
+        FfsCache.SetCacheDir(GenFdsGlobalVariable.FfsCacheDir, GenFdsGlobalVariable.FfsCacheSize)
         if ArchList != None:
             GenFdsGlobalVariable.ArchList = ArchList
 
@@ -401,7 +436,7 @@ class GenFdsGlobalVariable:
             if not GenFdsGlobalVariable.NeedsUpdate(Output, list(Input) + [CommandFile]):
                 return
 
-            GenFdsGlobalVariable.CallExternalTool(Cmd, "Failed to generate section")
+            GenFdsGlobalVariable.CallCachedTool(Cmd, Output, Input, "Failed to generate section")
         else:
             Cmd += ["-o", Output]
             Cmd += Input
@@ -409,7 +444,7 @@ class GenFdsGlobalVariable:
             SaveFileOnChange(CommandFile, ' '.join(Cmd), False)
             if GenFdsGlobalVariable.NeedsUpdate(Output, list(Input) + [CommandFile]):
                 GenFdsGlobalVariable.DebugLogger(EdkLogger.DEBUG_5, "%s needs update because of newer %s" % (Output, Input))
-                GenFdsGlobalVariable.CallExternalTool(Cmd, "Failed to generate section")
+                GenFdsGlobalVariable.CallCachedTool(Cmd, Output, Input, "Failed to generate section")
 
             if (os.path.getsize(Output) >= GenFdsGlobalVariable.LARGE_FILE_SIZE and
                 GenFdsGlobalVariable.LargeFileInFvFlags):
@@ -447,7 +482,7 @@ class GenFdsGlobalVariable:
             return
         GenFdsGlobalVariable.DebugLogger(EdkLogger.DEBUG_5, "%s needs update because of newer %s" % (Output, Input))
 
-        GenFdsGlobalVariable.CallExternalTool(Cmd, "Failed to generate FFS")
+        GenFdsGlobalVariable.CallCachedTool(Cmd, Output, Input, "Failed to generate FFS")
 
     @staticmethod
     def GenerateFirmwareVolume(Output, Input, BaseAddress=None, ForceRebase=None, Capsule=False, Dump=False,
@@ -582,7 +617,144 @@ class GenFdsGlobalVariable:
         Cmd += ["-o", Output]
         Cmd += Input
 
-        GenFdsGlobalVariable.CallExternalTool(Cmd, "Failed to call " + ToolPath, returnValue)
+        GenFdsGlobalVariable.CallCachedTool(Cmd, Output, Input, "Failed to call " + ToolPath, returnValue)
+
+    ## CallCachedTool()
+    #
+    #   Call an external tool, unless its output for the same options and the
+    #   same input data is found in the FFS cache.
+    #
+    #   @param  Cmd             Command line of the tool
+    #   @param  Output          Path of output file
+    #   @param  Input           Path list of input files
+    #   @param  errorMess       Error message if the tool fails
+    #   @param  returnValue     Returns the return value of the tool, see CallExternalTool()
+    #
+    @staticmethod
+    def CallCachedTool(Cmd, Output, Input, errorMess, returnValue=[]):
+        #
+        # A tool run in process is identified by the GenTools module, not by the
+        # tool of the same name found in PATH
+        #
+        ToolFile = None
+        if GenFdsGlobalVariable.GetInProcessTool(Cmd) != None:
+            ToolFile = GenTools.__file__
+        Key = FfsCache.GetKey(Cmd, Output, Input, ToolFile)
+        if FfsCache.Restore(Key, Output):
+            GenFdsGlobalVariable.DebugLogger(EdkLogger.DEBUG_5, "%s is found in the FFS cache" % Output)
+            if returnValue != []:
+                returnValue[0] = 0
+            return
+
+        GenFdsGlobalVariable.CallExternalTool(Cmd, errorMess, returnValue)
+        if returnValue == [] or returnValue[0] == 0:
+            FfsCache.Save(Key, Output)
+
+    ## GetInProcessTool()
+    #
+    #   @param  Cmd             Command line of the tool
+    #
+    #   @retval function        The function of the GenTools extension module running the tool
+    #   @retval None            if the tool must be called in a new process
+    #
+    @staticmethod
+    def GetInProcessTool(Cmd):
+        if GenTools == None or Cmd[0] not in ('GenSec', 'GenFfs', 'GenFv'):
+            return None
+        #
+        # The command line is given to a shell otherwise, don't try to handle
+        # the quotes and the spaces the same way
+        #
+        for Arg in Cmd[1:]:
+            for Char in ' \t"\'':
+                if Char in Arg:
+                    return None
+        return getattr(GenTools, Cmd[0])
+
+    ## CallInProcessTool()
+    #
+    #   Call GenSec, GenFfs or GenFv in the GenFds process with the GenTools
+    #   extension module, which saves the creation of a process for each section,
+    #   FFS file and FV image. The module runs one tool at a time, but the lock of
+    #   CallInThreads() is released while it runs, so the other threads run
+    #   Python code and external tools meanwhile.
+    #
+    #   @param  Cmd             Command line of the tool
+    #
+    #   @retval int             The return value of the tool
+    #   @retval None            if the tool must be called in a new process
+    #
+    @staticmethod
+    def CallInProcessTool(Cmd):
+        Tool = GenFdsGlobalVariable.GetInProcessTool(Cmd)
+        if Tool == None:
+            return None
+        State = GenFdsGlobalVariable.ReleaseThreadLock()
+        try:
+            return Tool(Cmd[1:])
+        finally:
+            GenFdsGlobalVariable.AcquireThreadLock(State)
+
+    ## ReleaseThreadLock()
+    #
+    #   Let the other threads of CallInThreads() run while the current thread
+    #   waits for a tool.
+    #
+    #   @retval object          The state to give to AcquireThreadLock()
+    #
+    @staticmethod
+    def ReleaseThreadLock():
+        Lock = getattr(GenFdsGlobalVariable.ThreadState, 'Lock', None)
+        if Lock == None:
+            return None
+        State = (Lock, GenFdsGlobalVariable.LargeFileInFvFlags)
+        Lock.release()
+        return State
+
+    ## AcquireThreadLock()
+    #
+    #   Wait for the lock released by ReleaseThreadLock(), and restore the state
+    #   of the current thread.
+    #
+    #   @param  State           The value returned by ReleaseThreadLock()
+    #
+    @staticmethod
+    def AcquireThreadLock(State):
+        if State != None:
+            State[0].acquire()
+            GenFdsGlobalVariable.LargeFileInFvFlags = State[1]
+
+    ## CallSubprocess()
+    #
+    #   Call an external tool in a new process and wait for it.
+    #
+    #   @param  Cmd             Command line of the tool
+    #
+    #   @retval tuple           The return value, the standard output, the standard error and
+    #                           the TimedPopen object of the tool
+    #
+    @staticmethod
+    def CallSubprocess(Cmd):
+        #
+        # Let the other threads of CallInThreads() run while the tool runs
+        #
+        State = GenFdsGlobalVariable.ReleaseThreadLock()
+        PopenError = None
+        try:
+            try:
+                PopenObject = TimedPopen(' '.join(Cmd), stdout=subprocess.PIPE, stderr= subprocess.PIPE, shell=True)
+            except Exception, X:
+                PopenError = X
+            else:
+                (out, error) = PopenObject.communicate()
+        finally:
+            GenFdsGlobalVariable.AcquireThreadLock(State)
+        if PopenError != None:
+            EdkLogger.error("GenFds", COMMAND_FAILURE, ExtraData="%s: %s" % (str(PopenError), Cmd[0]))
+
+        while PopenObject.returncode == None :
+            PopenObject.wait()
+        return (PopenObject.returncode, out, error, PopenObject)
 
     def CallExternalTool (cmd, errorMess, returnValue=[]):
 
@@ -603,26 +775,112 @@ class GenFdsGlobalVariable:
             if GenFdsGlobalVariable.SharpCounter % GenFdsGlobalVariable.SharpNumberPerLine == 0:
                 sys.stdout.write('\n')
 
-        try:
-            PopenObject = subprocess.Popen(' '.join(cmd), stdout=subprocess.PIPE, stderr= subprocess.PIPE, shell=True)
-        except Exception, X:
-            EdkLogger.error("GenFds", COMMAND_FAILURE, ExtraData="%s: %s" % (str(X), cmd[0]))
-        (out, error) = PopenObject.communicate()
+        BeginTime = BuildTiming.Begin()
+        ReturnCode = GenFdsGlobalVariable.CallInProcessTool(cmd)
+        if ReturnCode != None:
+            # The messages of the tool were printed as they came
+            out = error = ''
+            PopenObject = None
+        else:
+            (ReturnCode, out, error, PopenObject) = GenFdsGlobalVariable.CallSubprocess(cmd)
+        if BeginTime != None:
+            GenFdsGlobalVariable.RecordToolStep(cmd, BeginTime, PopenObject)
 
-        while PopenObject.returncode == None :
-            PopenObject.wait()
         if returnValue != [] and returnValue[0] != 0:
             #get command return value
-            returnValue[0] = PopenObject.returncode
+            returnValue[0] = ReturnCode
             return
-        if PopenObject.returncode != 0 or GenFdsGlobalVariable.VerboseMode or GenFdsGlobalVariable.DebugLevel != -1:
-            GenFdsGlobalVariable.InfLogger ("Return Value = %d" %PopenObject.returncode)
+        if ReturnCode != 0 or GenFdsGlobalVariable.VerboseMode or GenFdsGlobalVariable.DebugLevel != -1:
+            GenFdsGlobalVariable.InfLogger ("Return Value = %d" %ReturnCode)
             GenFdsGlobalVariable.InfLogger (out)
             GenFdsGlobalVariable.InfLogger (error)
-            if PopenObject.returncode != 0:
+            if ReturnCode != 0:
                 print "###", cmd
                 EdkLogger.error("GenFds", COMMAND_FAILURE, errorMess)
 
+    ## RecordToolStep()
+    #
+    #   Record a tool call for the TIMING build report. The GUIDed section tools
+    #   compressing their input and the compression sections are recorded as
+    #   compression steps.
+    #
+    #   @param  Cmd             Command line of the tool
+    #   @param  BeginTime       The value returned by BuildTiming.Begin() before the call
+    #   @param  PopenObject     The TimedPopen object of the tool, None if it ran in this process
+    #
+    @staticmethod
+    def RecordToolStep(Cmd, BeginTime, PopenObject):
+        Tool = os.path.basename(Cmd[0])
+        Name = Tool
+        if '-o' in Cmd and list(Cmd).index('-o') + 1 < len(Cmd):
+            Name += ' ' + Cmd[list(Cmd).index('-o') + 1]
+        if 'Compress' in Tool or 'EFI_SECTION_COMPRESSION' in Cmd:
+            Category = 'Compression'
+        else:
+            Category = 'Tool'
+        BuildTiming.End(Category, Name, BeginTime, PopenObject)
+
+    ## CallInThreads()
+    #
+    #   Call functions in up to ThreadNumber threads and wait for all of them.
+    #
+    #   Only one of the threads runs Python code at a time. A thread releases the
+    #   lock only while it waits for an external tool, so the external tools the
+    #   functions call run in parallel. The state the functions keep across a tool
+    #   call must not be shared by two functions, this is why FfsInfStatement
+    #   generates each module with its own copy of the rule. Each thread has its
+    #   own LargeFileInFvFlags, which is merged to the one of the caller at the end.
+    #
+    #   @param  FunctionList    The functions to call
+    #
+    #   @retval list            The return values of the functions, in the order of FunctionList
+    #
+    @staticmethod
+    def CallInThreads(FunctionList):
+        if GenFdsGlobalVariable.ThreadNumber <= 1 or len(FunctionList) <= 1 or \
+           getattr(GenFdsGlobalVariable.ThreadState, 'Lock', None) != None:
+            return [Function() for Function in FunctionList]
+
+        Lock = threading.Lock()
+        ResultList = [None] * len(FunctionList)
+        LargeFileList = [False] * len(FunctionList)
+        ErrorList = []
+        NextIndex = [0]
+
+        def Worker():
+            Lock.acquire()
+            GenFdsGlobalVariable.ThreadState.Lock = Lock
+            try:
+                while NextIndex[0] < len(FunctionList) and ErrorList == []:
+                    Index = NextIndex[0]
+                    NextIndex[0] += 1
+                    GenFdsGlobalVariable.LargeFileInFvFlags = [False]
+                    try:
+                        ResultList[Index] = FunctionList[Index]()
+                    except:
+                        ErrorList.append(sys.exc_info())
+                    LargeFileList[Index] = GenFdsGlobalVariable.LargeFileInFvFlags[0]
+            finally:
+                GenFdsGlobalVariable.ThreadState.Lock = None
+                Lock.release()
+
+        LargeFileInFvFlags = GenFdsGlobalVariable.LargeFileInFvFlags
+        ThreadList = []
+        for Index in range(0, min(GenFdsGlobalVariable.ThreadNumber, len(FunctionList))):
+            Thread = threading.Thread(target=Worker)
+            Thread.setName("GenFds-Thread-%d" % Index)
+            Thread.start()
+            ThreadList.append(Thread)
+        for Thread in ThreadList:
+            Thread.join()
+        GenFdsGlobalVariable.LargeFileInFvFlags = LargeFileInFvFlags
+
+        if ErrorList != []:
+            raise ErrorList[0][0], ErrorList[0][1], ErrorList[0][2]
+        if True in LargeFileList and LargeFileInFvFlags:
+            LargeFileInFvFlags[-1] = True
+        return ResultList
+
     def VerboseLogger (msg):
         EdkLogger.verbose(msg)
 
@@ -21,7 +21,6 @@ from Ffs import Ffs
 import Common.LongFilePathOs as os
 from GenFdsGlobalVariable import GenFdsGlobalVariable
 from CommonDataClass.FdfClass import GuidSectionClassObject
-from Common import ToolDefClassObject
 import sys
 from Common import EdkLogger
 from Common.BuildToolError import *
@@ -260,7 +259,7 @@ class GuidSection(GuidSectionClassObject) :
         if self.KeyStringList == None or self.KeyStringList == []:
             Target = GenFdsGlobalVariable.TargetName
             ToolChain = GenFdsGlobalVariable.ToolChainTag
-            ToolDb = ToolDefClassObject.ToolDefDict(GenFdsGlobalVariable.ConfDir).ToolsDefTxtDatabase
+            ToolDb = GenFdsGlobalVariable.GetToolDefinition().ToolsDefTxtDatabase
             if ToolChain not in ToolDb['TOOL_CHAIN_TAG']:
                 EdkLogger.error("GenFds", GENFDS_ERROR, "Can not find external tool because tool tag %s is not defined in tools_def.txt!" % ToolChain)
             self.KeyStringList = [Target+'_'+ToolChain+'_'+self.CurrentArchList[0]]
@@ -268,7 +267,7 @@ class GuidSection(GuidSectionClassObject) :
                 if Target + '_' + ToolChain + '_' + Arch not in self.KeyStringList:
                     self.KeyStringList.append(Target + '_' + ToolChain + '_' + Arch)
 
-        ToolDefinition = ToolDefClassObject.ToolDefDict(GenFdsGlobalVariable.ConfDir).ToolsDefTxtDictionary
+        ToolDefinition = GenFdsGlobalVariable.GetToolDefinition().ToolsDefTxtDictionary
         ToolPathTmp = None
         ToolOption = None
         for ToolDef in ToolDefinition.items():
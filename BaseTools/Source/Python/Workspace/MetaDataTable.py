@@ -168,7 +168,9 @@ class TableFile(Table):
         Path VARCHAR,
         FullPath VARCHAR NOT NULL,
         Model INTEGER DEFAULT 0,
-        TimeStamp SINGLE NOT NULL
+        TimeStamp SINGLE NOT NULL,
+        Digest VARCHAR,
+        ParseTime REAL DEFAULT 0
         '''
     def __init__(self, Cursor):
         Table.__init__(self, Cursor, 'File')
@@ -183,9 +185,11 @@ class TableFile(Table):
     # @param FullPath:  FullPath of a File
     # @param Model:     Model of a File
     # @param TimeStamp: TimeStamp of a File
+    # @param Digest:    Digest of the contents of a File
+    # @param ParseTime: Time in seconds the last parsing of a File took
     #
-    def Insert(self, Name, ExtName, Path, FullPath, Model, TimeStamp):
-        (Name, ExtName, Path, FullPath) = ConvertToSqlString((Name, ExtName, Path, FullPath))
+    def Insert(self, Name, ExtName, Path, FullPath, Model, TimeStamp, Digest='', ParseTime=0):
+        (Name, ExtName, Path, FullPath, Digest) = ConvertToSqlString((Name, ExtName, Path, FullPath, Digest))
         return Table.Insert(
             self,
             Name,
@@ -193,7 +197,9 @@ class TableFile(Table):
             Path,
             FullPath,
             Model,
-            TimeStamp
+            TimeStamp,
+            Digest,
+            ParseTime
             )
 
     ## InsertFile
@@ -262,6 +268,48 @@ class TableFile(Table):
     def SetFileTimeStamp(self, FileId, TimeStamp):
         self.Exec("update %s set TimeStamp=%s where ID='%s'" % (self.Table, TimeStamp, FileId))
 
+    ## Get the digest of the contents of a given file
+    #
+    #   @param  FileId      ID of file
+    #
+    #   @retval digest      Digest value of given file in the table
+    #
+    def GetFileDigest(self, FileId):
+        QueryScript = "select Digest from %s where ID = '%s'" % (self.Table, FileId)
+        RecordList = self.Exec(QueryScript)
+        if len(RecordList) == 0:
+            return None
+        return RecordList[0][0]
+
+    ## Update the digest of the contents of a given file
+    #
+    #   @param  FileId      ID of file
+    #   @param  Digest      Digest of the contents of file
+    #
+    def SetFileDigest(self, FileId, Digest):
+        self.Exec("update %s set Digest=%s where ID='%s'" % (self.Table, ConvertToSqlString([Digest])[0], FileId))
+
+    ## Get the time the last parsing of a given file took
+    #
+    #   @param  FileId      ID of file
+    #
+    #   @retval seconds     ParseTime value of given file in the table
+    #
+    def GetFileParseTime(self, FileId):
+        QueryScript = "select ParseTime from %s where ID = '%s'" % (self.Table, FileId)
+        RecordList = self.Exec(QueryScript)
+        if len(RecordList) == 0 or RecordList[0][0] == None:
+            return 0
+        return RecordList[0][0]
+
+    ## Update the time the last parsing of a given file took
+    #
+    #   @param  FileId      ID of file
+    #   @param  ParseTime   Time in seconds
+    #
+    def SetFileParseTime(self, FileId, ParseTime):
+        self.Exec("update %s set ParseTime=%f where ID='%s'" % (self.Table, ParseTime, FileId))
+
     ## Get list of file with given type
     #
     #   @param  FileType    Type value of file
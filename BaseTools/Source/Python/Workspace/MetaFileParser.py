@@ -29,6 +29,7 @@ from Common.Misc import GuidStructureStringToGuidString, CheckPcdDatum, PathClas
 from Common.Expression import *
 from CommonDataClass.Exceptions import *
 from Common.LongFilePathSupport import OpenLongFilePath as open
+from Common.BuildTiming import BuildTiming
 
 from MetaFileTable import MetaFileStorage
 from MetaFileCommentParser import CheckInfComment
@@ -222,10 +223,17 @@ class MetaFileParser(object):
         if not self._Finished:
             if self._RawTable.IsIntegrity():
                 self._Finished = True
+                GlobalData.gMetaFileReused += 1
+                GlobalData.gParseTimeSaved += self._RawTable.GetParseTime()
             else:
                 self._Table = self._RawTable
                 self._PostProcessed = False
+                BeginTime = BuildTiming.Begin()
+                StartTime = time.time()
                 self.Start()
+                self._RawTable.SetParseTime(time.time() - StartTime)
+                BuildTiming.End('Parse', str(self.MetaFile), BeginTime)
+                GlobalData.gMetaFileParsed += 1
 
         # No specific ARCH or Platform given, use raw data
         if self._RawTable and (len(DataInfo) == 1 or DataInfo[1] == None):
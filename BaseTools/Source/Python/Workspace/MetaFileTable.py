@@ -15,11 +15,13 @@
 # Import Modules
 #
 import uuid
+import hashlib
 
 import Common.EdkLogger as EdkLogger
 
 from MetaDataTable import Table, TableFile
 from MetaDataTable import ConvertToSqlString
+from Common.LongFilePathSupport import OpenLongFilePath as open
 from CommonDataClass.DataClass import MODEL_FILE_DSC, MODEL_FILE_DEC, MODEL_FILE_INF, \
                                       MODEL_FILE_OTHERS
 
@@ -48,24 +50,48 @@ class MetaFileTable(Table):
         Table.__init__(self, Cursor, TableName, FileId, Temporary)
         self.Create(not self.IsIntegrity())
 
+    ## Check if the parsed data in the table is the one of the current file
+    #
+    #   The time stamp of the file is checked first. If it changed, the digest
+    #   of the contents of the file is checked, so that a file that was touched
+    #   or checked out again with the same contents is not parsed again.
+    #
     def IsIntegrity(self):
         try:
             TimeStamp = self.MetaFile.TimeStamp
             Result = self.Cur.execute("select ID from %s where ID<0" % (self.Table)).fetchall()
             if not Result:
-                # update the timestamp in database
-                self._FileIndexTable.SetFileTimeStamp(self.IdBase, TimeStamp)                
+                # update the timestamp and the digest in database
+                self._FileIndexTable.SetFileTimeStamp(self.IdBase, TimeStamp)
+                self._FileIndexTable.SetFileDigest(self.IdBase, self.GetDigest())
                 return False
 
             if TimeStamp != self._FileIndexTable.GetFileTimeStamp(self.IdBase):
                 # update the timestamp in database
                 self._FileIndexTable.SetFileTimeStamp(self.IdBase, TimeStamp)
-                return False
+                if self.GetDigest() != self._FileIndexTable.GetFileDigest(self.IdBase):
+                    return False
         except Exception, Exc:
             EdkLogger.debug(EdkLogger.DEBUG_5, str(Exc))
             return False
         return True
 
+    ## Get the digest of the contents of the file
+    def GetDigest(self):
+        File = open(self.MetaFile.Path, 'rb')
+        try:
+            return hashlib.md5(File.read()).hexdigest()
+        finally:
+            File.close()
+
+    ## Get the time the last parsing of the file took
+    def GetParseTime(self):
+        return self._FileIndexTable.GetFileParseTime(self.IdBase)
+
+    ## Record the time the parsing of the file took
+    def SetParseTime(self, ParseTime):
+        self._FileIndexTable.SetFileParseTime(self.IdBase, ParseTime)
+
 ## Python class representation of table storing module data
 class ModuleTable(MetaFileTable):
     _ID_STEP_ = 0.00000001
@@ -17,6 +17,7 @@
 import sqlite3
 import Common.LongFilePathOs as os
 import pickle
+import gc
 import uuid
 
 import Common.EdkLogger as EdkLogger
@@ -2743,17 +2744,12 @@ class WorkspaceDatabase(object):
             if self._CheckWhetherDbNeedRenew(RenewDb, DbPath):
                 os.remove(DbPath)
         
-        # create db with optimized parameters
-        self.Conn = sqlite3.connect(DbPath, isolation_level='DEFERRED')
-        self.Conn.execute("PRAGMA synchronous=OFF")
-        self.Conn.execute("PRAGMA temp_store=MEMORY")
-        self.Conn.execute("PRAGMA count_changes=OFF")
-        self.Conn.execute("PRAGMA cache_size=8192")
-        #self.Conn.execute("PRAGMA page_size=8192")
-
-        # to avoid non-ascii character conversion issue
-        self.Conn.text_factory = str
-        self.Cur = self.Conn.cursor()
+        # GenFds uses the db from several threads. They only access it while they
+        # hold the lock of GenFdsGlobalVariable.CallInThreads(), which is released
+        # only around the external tools, so the accesses are serialized.
+        self.DbPath = DbPath
+        self._ForkedConn = None
+        self._Connect()
 
         # create table for internal uses
         self.TblDataModel = TableDataModel(self.Cur)
@@ -2856,6 +2852,67 @@ determine whether database file is out of date!\n")
             self.Conn.close()
             self._DbClosedFlag = True
 
+    ## Open the connection to the database
+    def _Connect(self):
+        # create db with optimized parameters
+        self.Conn = sqlite3.connect(self.DbPath, isolation_level='DEFERRED', check_same_thread=False)
+        self.Conn.execute("PRAGMA synchronous=OFF")
+        self.Conn.execute("PRAGMA temp_store=MEMORY")
+        self.Conn.execute("PRAGMA count_changes=OFF")
+        self.Conn.execute("PRAGMA cache_size=8192")
+        #self.Conn.execute("PRAGMA page_size=8192")
+
+        # to avoid non-ascii character conversion issue
+        self.Conn.text_factory = str
+        self.Cur = self.Conn.cursor()
+
+    ## Get the tables another connection to the database cannot read
+    #
+    #   The temporary tables, like the ones of the DSC file, only exist in the
+    #   connection which created them, and so do all the tables of a database in
+    #   memory.
+    #
+    #   @retval list    The name, the statement creating the table and the
+    #                   records of each table
+    #
+    def GetPrivateTables(self):
+        SqlCommand = "select name, sql from sqlite_temp_master where type='table'"
+        if self.DbPath == ':memory:':
+            SqlCommand += " union all select name, sql from sqlite_master where type='table'"
+        TableList = []
+        for Name, Sql in self.Cur.execute(SqlCommand).fetchall():
+            TableList.append((Name, Sql, self.Cur.execute("select * from %s" % Name).fetchall()))
+        return TableList
+
+    ## Connect to the database again in a forked process
+    #
+    #   A connection must not be used in a process forked after it was opened:
+    #   the locks of the database file are not inherited, while the state of the
+    #   connection is. The forked process opens a connection of its own, in which
+    #   the private tables of the parent process are copied as temporary tables,
+    #   and every table is moved to it. The inherited connection is never closed,
+    #   since closing it is no safer than using it.
+    #
+    #   @param  TableList   The tables GetPrivateTables() got in the parent process
+    #   @param  ReadOnly    Prevent the process from changing the database
+    #
+    def Reconnect(self, TableList, ReadOnly=True):
+        OldCur = self.Cur
+        self._ForkedConn = self.Conn
+        self._Connect()
+        for Name, Sql, RecordList in TableList:
+            self.Cur.execute(Sql.replace("CREATE TABLE", "CREATE TEMP TABLE", 1))
+            if RecordList:
+                SqlCommand = "insert into %s values (%s)" % (Name, ','.join(['?'] * len(RecordList[0])))
+                self.Cur.executemany(SqlCommand, RecordList)
+        self.Conn.commit()
+        if ReadOnly:
+            self.Conn.execute("PRAGMA query_only=ON")
+
+        for Object in gc.get_objects():
+            if isinstance(Object, Table) and Object.Cur is OldCur:
+                Object.Cur = self.Cur
+
     ## Summarize all packages in the database
     def GetPackageList(self, Platform, Arch, TargetName, ToolChainTag):
         self.Platform = Platform
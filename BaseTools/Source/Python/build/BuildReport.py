@@ -41,6 +41,7 @@ from Common.DataType import TAB_BRG_PCD
 from Common.DataType import TAB_BRG_LIBRARY
 from Common.DataType import TAB_BACK_SLASH
 from Common.LongFilePathSupport import OpenLongFilePath as open
+from Common.BuildTiming import BuildTiming
 
 ## Pattern to extract contents in EDK DXS files
 gDxsDependencyPattern = re.compile(r"DEPENDENCY_START(.+)DEPENDENCY_END", re.DOTALL)
@@ -1505,6 +1506,69 @@ class PlatformReport(object):
             if "EXECUTION_ORDER" in ReportType:
                 self.PredictionReport.GenerateReport(File, None)
 
+##
+# Reports build timing information
+#
+# This class reports where the build time went: the meta-data parsing, the
+# AutoGen of every module, the make of every module, and every tool called by
+# GenFds. The steps are also saved for the Chrome trace viewer.
+#
+class TimingReport(object):
+    ##
+    # Constructor function for class TimingReport
+    #
+    # @param self            The object pointer
+    # @param ReportFile      The file name of the build report
+    #
+    def __init__(self, ReportFile):
+        self.StepList = sorted(BuildTiming.StepList, key=lambda Step: Step[3], reverse=True)
+        self.TraceFile = os.path.splitext(ReportFile)[0] + "_trace.json"
+
+    ##
+    # Generate report for the build timing.
+    #
+    # The total time of every kind of step is followed by all the steps, the
+    # longest first. The wall clock times of the steps run in parallel overlap,
+    # so their total may be longer than the build. The CPU time of the steps run
+    # in another process is not known on every system.
+    #
+    # @param self            The object pointer
+    # @param File            The file object for report
+    #
+    def GenerateReport(self, File):
+        CategoryList = []
+        CategoryTime = {}
+        for (Category, Name, Start, WallTime, CpuTime, Pid, Thread) in self.StepList:
+            if Category not in CategoryTime:
+                CategoryList.append(Category)
+                CategoryTime[Category] = [0, 0.0, 0.0]
+            CategoryTime[Category][0] += 1
+            CategoryTime[Category][1] += WallTime
+            if CpuTime != None:
+                CategoryTime[Category][2] += CpuTime
+
+        FileWrite(File, gSectionStart)
+        FileWrite(File, "Build Timing")
+        FileWrite(File, "Trace File:         %s" % os.path.abspath(self.TraceFile))
+        FileWrite(File, gSectionSep)
+        FileWrite(File, "%-12s %8s %12s %12s" % ("Category", "Steps", "Wall (s)", "CPU (s)"))
+        FileWrite(File, gSubSectionSep)
+        for Category in sorted(CategoryList):
+            FileWrite(File, "%-12s %8d %12.3f %12.3f" % (Category, CategoryTime[Category][0],
+                                                         CategoryTime[Category][1], CategoryTime[Category][2]))
+        FileWrite(File, gSectionSep)
+        FileWrite(File, "%12s %12s  %-12s %s" % ("Wall (s)", "CPU (s)", "Category", "Step"))
+        FileWrite(File, gSubSectionSep)
+        for (Category, Name, Start, WallTime, CpuTime, Pid, Thread) in self.StepList:
+            if CpuTime == None:
+                CpuTimeStr = "-"
+            else:
+                CpuTimeStr = "%.3f" % CpuTime
+            FileWrite(File, "%12.3f %12s  %-12s %s" % (WallTime, CpuTimeStr, Category, Name))
+        FileWrite(File, gSectionEnd)
+
+        BuildTiming.SaveChromeTrace(self.TraceFile)
+
 ## BuildReport class
 #
 #  This base class contain the routines to collect data and then
@@ -1533,6 +1597,8 @@ class BuildReport(object):
                         self.ReportType.append(ReportTypeItem)
             else:
                 self.ReportType = ["PCD", "LIBRARY", "BUILD_FLAGS", "DEPEX", "FLASH", "FIXED_ADDRESS"]
+            if "TIMING" in self.ReportType:
+                BuildTiming.Enable()
     ##
     # Adds platform report to the list
     #
@@ -1561,6 +1627,8 @@ class BuildReport(object):
                 File = StringIO('')
                 for (Wa, MaList) in self.ReportList:
                     PlatformReport(Wa, MaList, self.ReportType).GenerateReport(File, BuildDuration, self.ReportType)
+                if "TIMING" in self.ReportType:
+                    TimingReport(self.ReportFile).GenerateReport(File)
                 Content = FileLinesSplit(File.getvalue(), gLineMaxLength)
                 SaveFileOnChange(self.ReportFile, Content, True)
                 EdkLogger.quiet("Build report can be found at %s" % os.path.abspath(self.ReportFile))
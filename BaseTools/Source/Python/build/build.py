@@ -25,6 +25,7 @@ import time
 import platform
 import traceback
 import encodings.ascii
+import multiprocessing
 
 from struct import *
 from threading import *
@@ -43,6 +44,8 @@ from Common.BuildToolError import *
 from Workspace.WorkspaceDatabase import *
 
 from BuildReport import BuildReport
+from Common.BuildTiming import BuildTiming
+from Common.BuildTiming import TimedPopen
 from GenPatchPcdTable.GenPatchPcdTable import *
 from PatchPcdValue.PatchPcdValue import *
 
@@ -64,6 +67,12 @@ gToolsDefinition = "tools_def.txt"
 TemporaryTablePattern = re.compile(r'^_\d+_\d+_[a-fA-F0-9]+$')
 TmpTableDict = {}
 
+## The ModuleAutoGen objects whose code and makefile are generated by the AutoGen
+## processes, and the workspace database they are based on. The processes get
+## them when they are forked.
+gAutoGenObjectList = []
+gAutoGenDatabase = None
+
 ## Check environment PATH variable to make sure the specified tool is found
 #
 #   If the tool is found in the PATH, then True is returned
@@ -240,8 +249,10 @@ def ReadMessage(From, To, ExitFlag):
 #
 # @param  Command               A list or string containing the call of the program
 # @param  WorkingDir            The directory in which the program will be running
+# @param  Category              The kind of step recorded for the TIMING report
+# @param  Name                  The name of the step, the command if None
 #
-def LaunchCommand(Command, WorkingDir):
+def LaunchCommand(Command, WorkingDir, Category='Tool', Name=None):
     # if working directory doesn't exist, Popen() will raise an exception
     if not os.path.isdir(WorkingDir):
         EdkLogger.error("build", FILE_NOT_FOUND, ExtraData=WorkingDir)
@@ -256,9 +267,10 @@ def LaunchCommand(Command, WorkingDir):
 
     Proc = None
     EndOfProcedure = None
+    BeginTime = BuildTiming.Begin()
     try:
         # launch the command
-        Proc = Popen(Command, stdout=PIPE, stderr=PIPE, env=os.environ, cwd=WorkingDir, bufsize=-1)
+        Proc = TimedPopen(Command, stdout=PIPE, stderr=PIPE, env=os.environ, cwd=WorkingDir, bufsize=-1)
 
         # launch two threads to read the STDOUT and STDERR
         EndOfProcedure = Event()
@@ -291,12 +303,58 @@ def LaunchCommand(Command, WorkingDir):
     if Proc.stderr:
         StdErrThread.join()
 
+    if Name == None:
+        if type(Command) != type(""):
+            Name = " ".join(Command)
+        else:
+            Name = Command
+    BuildTiming.End(Category, Name, BeginTime, Proc)
+
     # check the return code of the program
     if Proc.returncode != 0:
         if type(Command) != type(""):
             Command = " ".join(Command)
         EdkLogger.error("build", COMMAND_FAILURE, ExtraData="%s [%s]" % (Command, WorkingDir))
 
+## Initialize an AutoGen process
+#
+#   The process connects to the workspace database again, since the connection of
+#   the build process cannot be used after the fork. It only reads the database.
+#   If it needs to change it, the change fails and the build process generates the
+#   code and makefile again.
+#
+#   @param  TableList   The private tables of the database in the build process
+#
+def InitAutoGenProcess(TableList):
+    gAutoGenDatabase.Reconnect(TableList)
+
+## Generate the code and makefile of a module or library in an AutoGen process
+#
+#   The code and makefiles of the libraries are not generated with the modules
+#   using them, but as items of their own, so that every file is written by one
+#   process only.
+#
+#   @param  Index       The index of the object in gAutoGenObjectList
+#
+#   @retval tuple       The index, the state of the object the build process needs,
+#                       the error code if the generation failed, and the steps
+#                       recorded for the TIMING report
+#
+def AutoGenInProcess(Index):
+    Ma = gAutoGenObjectList[Index]
+    GlobalData.gGlobalDefines['ARCH'] = Ma.Arch
+    FirstStep = len(BuildTiming.StepList)
+    try:
+        Ma.CreateCodeFile(False)
+        Ma.CreateMakeFile(False)
+    except FatalError, X:
+        # The error has been reported already
+        return (Index, None, X.args[0], [])
+    except:
+        # Let the build process report the error
+        return (Index, None, None, [])
+    return (Index, Ma.DepexGenerated, None, BuildTiming.StepList[FirstStep:])
+
 ## The smallest unit that can be built in multi-thread build mode
 #
 # This is the base class of build unit. The "Obj" parameter must provide
@@ -640,7 +698,7 @@ class BuildTask:
     #
     def _CommandThread(self, Command, WorkingDir):
         try:
-            LaunchCommand(Command, WorkingDir)
+            LaunchCommand(Command, WorkingDir, 'Make', repr(self.BuildItem))
             self.CompleteFlag = True
         except:
             #
@@ -842,6 +900,7 @@ class Build():
 
         if self.ThreadNumber == 0:
             self.ThreadNumber = 1
+        GlobalData.gThreadNumber = self.ThreadNumber
 
         if not self.PlatformFile:
             PlatformFile = self.TargetTxt.TargetTxtDictionary[DataType.TAB_TAT_DEFINES_ACTIVE_PLATFORM]
@@ -1060,7 +1119,7 @@ class Build():
 
         # genfds
         if Target == 'fds':
-            LaunchCommand(AutoGenObject.GenFdsCommand, AutoGenObject.MakeFileDir)
+            self._GenFds(AutoGenObject, AutoGenObject.MakeFileDir)
             return True
 
         # run
@@ -1590,11 +1649,13 @@ class Build():
                 # multi-thread exit flag
                 ExitFlag = threading.Event()
                 ExitFlag.clear()
+                PaList = []
                 for Arch in Wa.ArchList:
                     GlobalData.gGlobalDefines['ARCH'] = Arch
                     Pa = PlatformAutoGen(Wa, self.PlatformFile, BuildTarget, ToolChain, Arch)
                     if Pa == None:
                         continue
+                    PaList.append(Pa)
                     ModuleList = []
                     for Inf in Pa.Platform.Modules:
                         ModuleList.append(Inf)
@@ -1611,40 +1672,17 @@ class Build():
                         
                         if Ma == None:
                             continue
-                        # Not to auto-gen for targets 'clean', 'cleanlib', 'cleanall', 'run', 'fds'
-                        if self.Target not in ['clean', 'cleanlib', 'cleanall', 'run', 'fds']:
-                            # for target which must generate AutoGen code and makefile
-                            if not self.SkipAutoGen or self.Target == 'genc':
-                                Ma.CreateCodeFile(True)
-                            if self.Target == "genc":
-                                continue
-
-                            if not self.SkipAutoGen or self.Target == 'genmake':
-                                Ma.CreateMakeFile(True)
-                            if self.Target == "genmake":
-                                continue
                         self.BuildModules.append(Ma)
-                    self.Progress.Stop("done!")
-
-                    for Ma in self.BuildModules:
-                        # Generate build task for the module
-                        if not Ma.IsBinaryModule:
-                            Bt = BuildTask.New(ModuleMakeUnit(Ma, self.Target))
-                        # Break build if any build thread has error
-                        if BuildTask.HasError():
-                            # we need a full version of makefile for platform
-                            ExitFlag.set()
-                            BuildTask.WaitForComplete()
-                            Pa.CreateMakeFile(False)
-                            EdkLogger.error("build", BUILD_ERROR, "Failed to build module", ExtraData=GlobalData.gBuildingModule)
-                        # Start task scheduler
-                        if not BuildTask.IsOnGoing():
-                            BuildTask.StartScheduler(self.ThreadNumber, ExitFlag)
-
-                    # in case there's an interruption. we need a full version of makefile for platform
+
+                # Generate C code files and makefiles, and build the modules as soon as they are generated
+                self._AutoGenModules(PaList, ExitFlag)
+                self.Progress.Stop("done!")
+
+                # in case there's an interruption. we need a full version of makefile for platform
+                for Pa in PaList:
                     Pa.CreateMakeFile(False)
-                    if BuildTask.HasError():
-                        EdkLogger.error("build", BUILD_ERROR, "Failed to build module", ExtraData=GlobalData.gBuildingModule)
+                if BuildTask.HasError():
+                    EdkLogger.error("build", BUILD_ERROR, "Failed to build module", ExtraData=GlobalData.gBuildingModule)
 
                 #
                 # Save temp tables to a TmpTableDict.
@@ -1698,7 +1736,7 @@ class Build():
                         #
                         # Generate FD image if there's a FDF file found
                         #
-                        LaunchCommand(Wa.GenFdsCommand, os.getcwd())
+                        self._GenFds(Wa, os.getcwd())
 
                         #
                         # Create MAP file for all platform FVs after GenFds.
@@ -1709,6 +1747,129 @@ class Build():
                     #
                     self._SaveMapFile(MapBuffer, Wa)
 
+    ## Generate the C code files and makefiles of the modules to build, and start their build
+    #
+    #   The build task of a module is created as soon as the files of the module
+    #   and of its libraries are generated, so that make starts on the first
+    #   modules while the files of the other ones are generated.
+    #
+    #   With more than one thread, the files are generated by a pool of processes
+    #   forked from the build process, on the systems that can fork it. Every
+    #   module and library is generated by one process, so the files are the same
+    #   as the ones generated by the build process alone. The progress thread is
+    #   stopped while the processes are forked, so that no other thread holds a
+    #   lock the processes inherit.
+    #
+    #   @param  PaList      The PlatformAutoGen objects of the archs to build
+    #   @param  ExitFlag    The exit flag of the task scheduler
+    #
+    def _AutoGenModules(self, PaList, ExitFlag):
+        global gAutoGenObjectList, gAutoGenDatabase
+
+        if self.SkipAutoGen or self.ThreadNumber == 1 or sys.platform == 'win32':
+            for Ma in self.BuildModules:
+                if not self.SkipAutoGen:
+                    GlobalData.gGlobalDefines['ARCH'] = Ma.Arch
+                    Ma.CreateCodeFile(True)
+                    Ma.CreateMakeFile(True)
+                self._StartModuleBuild(Ma, PaList, ExitFlag)
+            return
+
+        #
+        # Every library is generated once, before the first module using it
+        #
+        IndexDict = {}
+        for Ma in self.BuildModules:
+            for Item in Ma.LibraryAutoGenList + [Ma]:
+                Key = (str(Item.MetaFile), Item.Arch)
+                if Key not in IndexDict:
+                    IndexDict[Key] = len(gAutoGenObjectList)
+                    gAutoGenObjectList.append(Item)
+
+        # The modules waiting for the generation of each object, and the number
+        # of objects each module waits for
+        WaitingModules = [[] for Item in gAutoGenObjectList]
+        WaitCount = []
+        for Ma in self.BuildModules:
+            ItemSet = set([IndexDict[(str(Item.MetaFile), Item.Arch)] for Item in Ma.LibraryAutoGenList + [Ma]])
+            for Index in ItemSet:
+                WaitingModules[Index].append(len(WaitCount))
+            WaitCount.append(len(ItemSet))
+
+        # The processes must see all the changes of the build process in the database
+        gAutoGenDatabase = self.Db
+        self.Db.Conn.commit()
+        self.Progress.Stop("done!")
+        Pool = multiprocessing.Pool(self.ThreadNumber, InitAutoGenProcess, (self.Db.GetPrivateTables(),))
+        self.Progress.Start("Generating code and makefiles")
+        try:
+            for Index, DepexGenerated, ErrorCode, StepList in Pool.imap_unordered(AutoGenInProcess, range(len(gAutoGenObjectList))):
+                Ma = gAutoGenObjectList[Index]
+                BuildTiming.Extend(StepList)
+                if DepexGenerated == None:
+                    if ErrorCode != None:
+                        raise FatalError(ErrorCode)
+                    GlobalData.gGlobalDefines['ARCH'] = Ma.Arch
+                    Ma.CreateCodeFile(False)
+                    Ma.CreateMakeFile(False)
+                else:
+                    Ma.DepexGenerated = DepexGenerated
+                    Ma.IsCodeFileCreated = True
+                    Ma.IsMakeFileCreated = True
+
+                for Module in WaitingModules[Index]:
+                    WaitCount[Module] -= 1
+                    if WaitCount[Module] == 0:
+                        self._StartModuleBuild(self.BuildModules[Module], PaList, ExitFlag)
+            Pool.close()
+        finally:
+            Pool.terminate()
+            Pool.join()
+            gAutoGenObjectList = []
+            gAutoGenDatabase = None
+
+    ## Create the build task of a module and start the task scheduler
+    #
+    #   @param  Ma          The ModuleAutoGen object of the module
+    #   @param  PaList      The PlatformAutoGen objects of the archs to build
+    #   @param  ExitFlag    The exit flag of the task scheduler
+    #
+    def _StartModuleBuild(self, Ma, PaList, ExitFlag):
+        # Generate build task for the module
+        if not Ma.IsBinaryModule:
+            Bt = BuildTask.New(ModuleMakeUnit(Ma, self.Target))
+        # Break build if any build thread has error
+        if BuildTask.HasError():
+            # we need a full version of makefile for platform
+            ExitFlag.set()
+            BuildTask.WaitForComplete()
+            for Pa in PaList:
+                Pa.CreateMakeFile(False)
+            EdkLogger.error("build", BUILD_ERROR, "Failed to build module", ExtraData=GlobalData.gBuildingModule)
+        # Start task scheduler
+        if not BuildTask.IsOnGoing():
+            BuildTask.StartScheduler(self.ThreadNumber, ExitFlag)
+
+    ## Launch GenFds for a platform
+    #
+    #   The steps of GenFds are recorded in a file, and added to the steps of the
+    #   build for the TIMING report.
+    #
+    #   @param  AutoGenObject   The AutoGen object of the platform
+    #   @param  WorkingDir      The directory in which GenFds will be running
+    #
+    def _GenFds(self, AutoGenObject, WorkingDir):
+        Command = AutoGenObject.GenFdsCommand
+        TimingFile = None
+        if BuildTiming.Enabled:
+            TimingFile = os.path.join(AutoGenObject.BuildDir, "GenFdsTiming.json")
+            if os.path.exists(TimingFile):
+                os.remove(TimingFile)
+            Command += " --timing-file %s" % TimingFile
+        LaunchCommand(Command, WorkingDir, 'GenFds', 'GenFds')
+        if TimingFile != None:
+            BuildTiming.Load(TimingFile)
+
     ## Generate GuidedSectionTools.txt in the FV directories.
     #
     def CreateGuidedSectionToolsFile(self):
@@ -1903,8 +2064,9 @@ def MyOptionParser():
     Parser.add_option("-D", "--define", action="append", type="string", dest="Macros", help="Macro: \"Name [= Value]\".")
 
     Parser.add_option("-y", "--report-file", action="store", dest="ReportFile", help="Create/overwrite the report to the specified filename.")
-    Parser.add_option("-Y", "--report-type", action="append", type="choice", choices=['PCD','LIBRARY','FLASH','DEPEX','BUILD_FLAGS','FIXED_ADDRESS', 'EXECUTION_ORDER'], dest="ReportType", default=[],
-        help="Flags that control the type of build report to generate.  Must be one of: [PCD, LIBRARY, FLASH, DEPEX, BUILD_FLAGS, FIXED_ADDRESS, EXECUTION_ORDER].  "\
+    Parser.add_option("-Y", "--report-type", action="append", type="choice", choices=['PCD','LIBRARY','FLASH','DEPEX','BUILD_FLAGS','FIXED_ADDRESS', 'EXECUTION_ORDER', 'TIMING'], dest="ReportType", default=[],
+        help="Flags that control the type of build report to generate.  Must be one of: [PCD, LIBRARY, FLASH, DEPEX, BUILD_FLAGS, FIXED_ADDRESS, EXECUTION_ORDER, TIMING].  "\
+             "TIMING also saves the steps of the build in a Chrome trace file next to the report file.  "\
              "To specify more than one flag, repeat this option on the command line and the default flag set is [PCD, LIBRARY, FLASH, DEPEX, BUILD_FLAGS, FIXED_ADDRESS]")
     Parser.add_option("-F", "--flag", action="store", type="string", dest="Flag",
         help="Specify the specific option to parse EDK UNI file. Must be one of: [-c, -s]. -c is for EDK framework UNI file, and -s is for EDK UEFI UNI file. "\
@@ -2100,6 +2262,10 @@ def Main():
     EdkLogger.SetLevel(EdkLogger.QUIET)
     EdkLogger.quiet("\n- %s -" % Conclusion)
     EdkLogger.quiet(time.strftime("Build end time: %H:%M:%S, %b.%d %Y", time.localtime()))
+    if GlobalData.gMetaFileReused + GlobalData.gMetaFileParsed > 0:
+        EdkLogger.quiet("Meta-data parse time saved: %.1fs, %d of %d files reused from %s" % \
+                        (GlobalData.gParseTimeSaved, GlobalData.gMetaFileReused,
+                         GlobalData.gMetaFileReused + GlobalData.gMetaFileParsed, GlobalData.gDatabasePath))
     EdkLogger.quiet("Build total time: %s\n" % BuildDurationStr)
     return ReturnCode
 
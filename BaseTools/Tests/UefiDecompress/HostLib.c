@@ -0,0 +1,58 @@
+/** @file
+  The MdePkg library functions needed to run BaseUefiDecompressLib on the host.
+
+Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Base.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+VOID *
+EFIAPI
+SetMem (
+  OUT VOID  *Buffer,
+  IN UINTN  Length,
+  IN UINT8  Value
+  )
+{
+  UINT8  *Pointer;
+
+  for (Pointer = Buffer; Length > 0; Length--) {
+    *Pointer++ = Value;
+  }
+  return Buffer;
+}
+
+VOID *
+EFIAPI
+SetMem16 (
+  OUT VOID   *Buffer,
+  IN UINTN   Length,
+  IN UINT16  Value
+  )
+{
+  UINT16  *Pointer;
+
+  for (Pointer = Buffer, Length /= sizeof (UINT16); Length > 0; Length--) {
+    *Pointer++ = Value;
+  }
+  return Buffer;
+}
+
+UINT32
+EFIAPI
+ReadUnaligned32 (
+  IN CONST UINT32  *Buffer
+  )
+{
+  return *Buffer;
+}
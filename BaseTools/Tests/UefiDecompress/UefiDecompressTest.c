@@ -0,0 +1,717 @@
+/** @file
+  Host test and benchmark of the UEFI decompress library of MdePkg.
+
+  MdePkg/Library/BaseUefiDecompressLib is built for the host and compared with
+  the decompressor of the BaseTools (Common/Decompress.c), which is the reference:
+
+  - Round trip: fixtures compressed with EfiCompress() must decode back to the
+    original data with both decompressors.
+  - Fuzz: corrupted copies of the compressed fixtures must make both
+    decompressors return the same status and the same data.
+  - Benchmark: the decoding speed of both decompressors on every fixture.
+
+  Usage: UefiDecompressTest [-f FuzzIterations] [-b] [File ...]
+
+  The files given on the command line are used as fixtures as well as the
+  generated ones. -b runs the benchmark.
+
+Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <setjmp.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "Compress.h"
+#include "Decompress.h"
+
+//
+// MdePkg/Library/BaseUefiDecompressLib, built for the host with EFIAPI defined
+// as nothing.
+//
+UINTN
+UefiDecompressGetInfo (
+  IN  CONST VOID  *Source,
+  IN  UINT32      SourceSize,
+  OUT UINT32      *DestinationSize,
+  OUT UINT32      *ScratchSize
+  );
+
+UINTN
+UefiDecompress (
+  IN CONST VOID  *Source,
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  );
+
+//
+// The largest output of a fuzzed stream. The fixtures are fuzzed after being
+// cut down to this size.
+//
+#define FUZZ_MAX_ORIG_SIZE    0x20000
+
+//
+// A corrupted stream may make a decompressor copy from as far as 4GB after the
+// start of the output buffer, so the fuzzed output buffers are placed at the
+// start of a 4GB zero filled region where such reads are harmless and give the
+// same data for both decompressors.
+//
+#define FUZZ_GUARD_SIZE       0x100000000ULL
+
+typedef struct {
+  CHAR8   *Name;
+  UINT8   *Data;
+  UINT32  Size;
+  UINT8   *Compressed;
+  UINT32  CompressedSize;
+} FIXTURE;
+
+FIXTURE  *mFixtures;
+UINTN    mFixtureCount;
+UINT32   mSeed = 1;
+
+/**
+  Get the next value of the pseudo random generator.
+
+  @return A 31 bits pseudo random value.
+
+**/
+UINT32
+Random (
+  VOID
+  )
+{
+  mSeed = mSeed * 1103515245 + 12345;
+  return (mSeed >> 1) & 0x7FFFFFFF;
+}
+
+/**
+  Compress a fixture and add it to the fixture list.
+
+  @param  Name    The name of the fixture.
+  @param  Data    The data of the fixture, allocated with malloc().
+  @param  Size    The size of the data.
+
+**/
+VOID
+AddFixture (
+  IN CHAR8   *Name,
+  IN UINT8   *Data,
+  IN UINT32  Size
+  )
+{
+  FIXTURE     *Fixture;
+  EFI_STATUS  Status;
+
+  mFixtures = realloc (mFixtures, (mFixtureCount + 1) * sizeof (FIXTURE));
+  if (mFixtures == NULL) {
+    fprintf (stderr, "Out of memory\n");
+    exit (1);
+  }
+
+  Fixture                 = &mFixtures[mFixtureCount++];
+  Fixture->Name           = Name;
+  Fixture->Data           = Data;
+  Fixture->Size           = Size;
+  Fixture->CompressedSize = 0;
+  Fixture->Compressed     = NULL;
+
+  Status = EfiCompress (Data, Size, NULL, &Fixture->CompressedSize);
+  if (Status == EFI_BUFFER_TOO_SMALL) {
+    Fixture->Compressed = malloc (Fixture->CompressedSize);
+    if (Fixture->Compressed == NULL) {
+      fprintf (stderr, "Out of memory\n");
+      exit (1);
+    }
+    Status = EfiCompress (Data, Size, Fixture->Compressed, &Fixture->CompressedSize);
+  }
+
+  if (EFI_ERROR (Status)) {
+    fprintf (stderr, "%s: EfiCompress() failed\n", Name);
+    exit (1);
+  }
+}
+
+/**
+  Generate fixtures shaped like the data found in firmware volumes.
+
+**/
+VOID
+GenerateFixtures (
+  VOID
+  )
+{
+  static CHAR8  *Words[] = {
+    "EFI_STATUS", "Status", "return", "Index", "Buffer", "Size", "gBS->", "Protocol",
+    "Handle", "if (EFI_ERROR (Status)) {\n", "}\n", "  ", "    ", "Device", "Path", ";\n"
+  };
+  CHAR8   *Word;
+  UINT8   *Data;
+  UINT32  Size;
+  UINT32  Index;
+  UINT32  Length;
+
+  //
+  // Zero filled, like the uninitialized data of an image
+  //
+  Size = 0x40000;
+  Data = calloc (Size, 1);
+  AddFixture ("zero", Data, Size);
+
+  //
+  // Random, which does not compress
+  //
+  Size = 0x10000;
+  Data = malloc (Size);
+  for (Index = 0; Index < Size; Index++) {
+    Data[Index] = (UINT8) (Random () >> 16);
+  }
+  AddFixture ("random", Data, Size);
+
+  //
+  // Text, like the strings and the UNI packages of a driver
+  //
+  Size = 0x80000;
+  Data = malloc (Size);
+  for (Index = 0; Index < Size; Index += Length) {
+    Word   = Words[Random () % (sizeof (Words) / sizeof (Words[0]))];
+    Length = (UINT32) strlen (Word);
+    Length = (Length < Size - Index) ? Length : Size - Index;
+    memcpy (Data + Index, Word, Length);
+  }
+  AddFixture ("text", Data, Size);
+
+  //
+  // Code, with a few frequent opcodes, small immediates and repeated sequences
+  //
+  Size = 0x80000;
+  Data = malloc (Size);
+  for (Index = 0; Index < Size; Index++) {
+    switch (Random () % 8) {
+    case 0:
+    case 1:
+      Data[Index] = (UINT8) (0x48 + Random () % 4);
+      break;
+    case 2:
+      Data[Index] = 0x89;
+      break;
+    case 3:
+      Data[Index] = (UINT8) (Random () % 16);
+      break;
+    case 4:
+      if (Index > 64) {
+        Length = 4 + Random () % 28;
+        for (; Length > 0 && Index < Size; Length--, Index++) {
+          Data[Index] = Data[Index - 48];
+        }
+        Index--;
+        break;
+      }
+    default:
+      Data[Index] = (UINT8) (Random () >> 16);
+      break;
+    }
+  }
+  AddFixture ("code", Data, Size);
+
+  //
+  // Tiny streams
+  //
+  for (Size = 1; Size <= 4; Size++) {
+    Data = malloc (Size);
+    memset (Data, 'A' + Size, Size);
+    AddFixture ("tiny", Data, Size);
+  }
+}
+
+/**
+  Read a file given on the command line as a fixture.
+
+  @param  FileName    The name of the file.
+
+**/
+VOID
+ReadFixture (
+  IN CHAR8  *FileName
+  )
+{
+  FILE    *File;
+  UINT8   *Data;
+  long    Size;
+
+  File = fopen (FileName, "rb");
+  if (File == NULL) {
+    fprintf (stderr, "%s: can not open the file\n", FileName);
+    exit (1);
+  }
+
+  fseek (File, 0, SEEK_END);
+  Size = ftell (File);
+  fseek (File, 0, SEEK_SET);
+  Data = malloc (Size + 1);
+  if (Data == NULL || Size == 0 || fread (Data, 1, Size, File) != (size_t) Size) {
+    fprintf (stderr, "%s: can not read the file\n", FileName);
+    exit (1);
+  }
+  fclose (File);
+
+  //
+  // Name the fixture after the file name without its directory
+  //
+  AddFixture (strrchr (FileName, '/') != NULL ? strrchr (FileName, '/') + 1 : FileName, Data, (UINT32) Size);
+}
+
+/**
+  Decode a stream with the reference decompressor.
+
+  @return The status of EfiDecompress().
+
+**/
+EFI_STATUS
+ReferenceDecode (
+  IN  UINT8   *Source,
+  IN  UINT32  SourceSize,
+  OUT UINT8   *Destination,
+  IN  UINT32  DestinationSize,
+  IN  UINT8   *Scratch,
+  IN  UINT32  ScratchSize
+  )
+{
+  return EfiDecompress (Source, SourceSize, Destination, DestinationSize, Scratch, ScratchSize);
+}
+
+/**
+  Decode a stream with the MdePkg decompressor.
+
+  @return The status of UefiDecompress(), converted to EFI_STATUS.
+
+**/
+EFI_STATUS
+LibraryDecode (
+  IN  UINT8   *Source,
+  IN  UINT32  SourceSize,
+  OUT UINT8   *Destination,
+  IN  UINT32  DestinationSize,
+  IN  UINT8   *Scratch,
+  IN  UINT32  ScratchSize
+  )
+{
+  UINT32  Size;
+  UINT32  Needed;
+
+  if (UefiDecompressGetInfo (Source, SourceSize, &Size, &Needed) != 0 || Size != DestinationSize || Needed > ScratchSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  return UefiDecompress (Source, Destination, Scratch) == 0 ? EFI_SUCCESS : EFI_INVALID_PARAMETER;
+}
+
+/**
+  Check that both decompressors give back the original data of every fixture.
+
+  @return The number of failures.
+
+**/
+UINTN
+TestRoundTrip (
+  VOID
+  )
+{
+  FIXTURE     *Fixture;
+  UINTN       Index;
+  UINTN       Failures;
+  UINT32      Size;
+  UINT32      LibrarySize;
+  UINT32      ScratchSize;
+  UINT32      LibraryScratchSize;
+  UINT8       *Output;
+  UINT8       *Scratch;
+
+  Failures = 0;
+  for (Index = 0; Index < mFixtureCount; Index++) {
+    Fixture = &mFixtures[Index];
+
+    if (EfiGetInfo (Fixture->Compressed, Fixture->CompressedSize, &Size, &ScratchSize) != EFI_SUCCESS ||
+        UefiDecompressGetInfo (Fixture->Compressed, Fixture->CompressedSize, &LibrarySize, &LibraryScratchSize) != 0 ||
+        Size != Fixture->Size || LibrarySize != Fixture->Size) {
+      printf ("FAIL  round trip %s: bad stream header\n", Fixture->Name);
+      Failures++;
+      continue;
+    }
+
+    Output  = malloc (Size);
+    Scratch = malloc (ScratchSize > LibraryScratchSize ? ScratchSize : LibraryScratchSize);
+
+    memset (Output, 0xCC, Size);
+    if (ReferenceDecode (Fixture->Compressed, Fixture->CompressedSize, Output, Size, Scratch, ScratchSize) != EFI_SUCCESS ||
+        memcmp (Output, Fixture->Data, Size) != 0) {
+      printf ("FAIL  round trip %s: reference decompressor\n", Fixture->Name);
+      Failures++;
+    }
+
+    memset (Output, 0xCC, Size);
+    if (LibraryDecode (Fixture->Compressed, Fixture->CompressedSize, Output, Size, Scratch, LibraryScratchSize) != EFI_SUCCESS ||
+        memcmp (Output, Fixture->Data, Size) != 0) {
+      printf ("FAIL  round trip %s: MdePkg decompressor\n", Fixture->Name);
+      Failures++;
+    }
+
+    free (Output);
+    free (Scratch);
+  }
+
+  printf ("%s  round trip of %u fixtures\n", Failures == 0 ? "PASS" : "FAIL", (unsigned) mFixtureCount);
+  return Failures;
+}
+
+#ifndef _WIN32
+sigjmp_buf  mFaultJump;
+
+/**
+  Resume the fuzz test after a decompressor accessed a guard page.
+
+  @param  Signal    The signal number.
+
+**/
+VOID
+FaultHandler (
+  IN int  Signal
+  )
+{
+  siglongjmp (mFaultJump, 1);
+}
+
+/**
+  Allocate a scratch buffer that ends at a guard page.
+
+  @param  Size      The size of the scratch buffer.
+
+  @return The scratch buffer, or NULL if it can not be allocated.
+
+**/
+UINT8 *
+AllocateGuardedScratch (
+  IN UINT32  Size
+  )
+{
+  UINT8   *Region;
+  size_t  PageSize;
+  size_t  RegionSize;
+
+  PageSize   = (size_t) sysconf (_SC_PAGESIZE);
+  Size       = (Size + 7) & ~7U;
+  RegionSize = (Size + PageSize - 1) / PageSize * PageSize + PageSize;
+  Region     = mmap (NULL, RegionSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (Region == MAP_FAILED) {
+    return NULL;
+  }
+
+  mprotect (Region + RegionSize - PageSize, PageSize, PROT_NONE);
+  return Region + RegionSize - PageSize - Size;
+}
+
+/**
+  Decode a stream and catch the accesses to the guard page after the scratch
+  buffer.
+
+  @return The status of the decompressor, or EFI_ABORTED if it faulted.
+
+**/
+EFI_STATUS
+GuardedDecode (
+  IN  EFI_STATUS  (*Decode) (UINT8 *, UINT32, UINT8 *, UINT32, UINT8 *, UINT32),
+  IN  UINT8       *Source,
+  IN  UINT32      SourceSize,
+  OUT UINT8       *Destination,
+  IN  UINT32      DestinationSize,
+  IN  UINT8       *Scratch,
+  IN  UINT32      ScratchSize
+  )
+{
+  if (sigsetjmp (mFaultJump, 1) != 0) {
+    return EFI_ABORTED;
+  }
+
+  return Decode (Source, SourceSize, Destination, DestinationSize, Scratch, ScratchSize);
+}
+#endif
+
+/**
+  Fuzz both decompressors with corrupted copies of the fixtures.
+
+  Every iteration flips a few bits, overwrites a few bytes or truncates the
+  stream of a fixture, then requires both decompressors to return the same
+  status and the same output.
+
+  Code lengths that oversubscribe the Huffman code by a multiple of 1U << 16
+  pass the check of MakeTable() in both decompressors and make it write past
+  its table, so the output of such streams is undefined. They are recognized
+  by the reference decompressor faulting on the guard page that follows its
+  scratch data, and are skipped.
+
+  @param  Iterations    The number of corrupted streams to decode.
+
+  @return The number of corrupted streams decoded differently.
+
+**/
+UINTN
+TestFuzz (
+  IN UINTN  Iterations
+  )
+{
+#ifdef _WIN32
+  printf ("SKIP  fuzz: not supported on Windows\n");
+  return 0;
+#else
+  FIXTURE           *Fixture;
+  UINTN             Iteration;
+  UINTN             Failures;
+  UINTN             Skipped;
+  UINTN             Count;
+  UINT8             *Stream;
+  UINT32            StreamSize;
+  UINT32            OrigSize;
+  UINT32            Offset;
+  UINT8             *Output[2];
+  UINT8             *Scratch[2];
+  UINT32            ScratchSize[2];
+  UINT32            Size;
+  EFI_STATUS        Status[2];
+  struct sigaction  Action;
+
+  if (sizeof (VOID *) < 8) {
+    printf ("SKIP  fuzz: a 64-bit host is required\n");
+    return 0;
+  }
+
+  EfiGetInfo (mFixtures[0].Compressed, mFixtures[0].CompressedSize, &Size, &ScratchSize[0]);
+  UefiDecompressGetInfo (mFixtures[0].Compressed, mFixtures[0].CompressedSize, &Size, &ScratchSize[1]);
+
+  for (Count = 0; Count < 2; Count++) {
+    Output[Count] = mmap (
+                      NULL,
+                      (size_t) (FUZZ_GUARD_SIZE + FUZZ_MAX_ORIG_SIZE),
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                      -1,
+                      0
+                      );
+    Scratch[Count] = AllocateGuardedScratch (ScratchSize[Count]);
+    if (Output[Count] == MAP_FAILED || Scratch[Count] == NULL) {
+      printf ("SKIP  fuzz: can not map the buffers\n");
+      return 0;
+    }
+  }
+
+  memset (&Action, 0, sizeof (Action));
+  Action.sa_handler = FaultHandler;
+  Action.sa_flags   = SA_NODEFER;
+  sigaction (SIGSEGV, &Action, NULL);
+  sigaction (SIGBUS, &Action, NULL);
+
+  Stream   = NULL;
+  Failures = 0;
+  Skipped  = 0;
+  for (Iteration = 0; Iteration < Iterations; Iteration++) {
+    Fixture = &mFixtures[Random () % mFixtureCount];
+    if (Fixture->CompressedSize <= 8) {
+      continue;
+    }
+
+    free (Stream);
+    Stream     = malloc (Fixture->CompressedSize);
+    StreamSize = Fixture->CompressedSize;
+    memcpy (Stream, Fixture->Compressed, StreamSize);
+
+    switch (Random () % 3) {
+    case 0:
+      for (Count = 1 + Random () % 4; Count > 0; Count--) {
+        Offset = 8 + Random () % (StreamSize - 8);
+        Stream[Offset] ^= (UINT8) (1 << (Random () % 8));
+      }
+      break;
+    case 1:
+      for (Count = 1 + Random () % 4; Count > 0; Count--) {
+        Stream[8 + Random () % (StreamSize - 8)] = (UINT8) Random ();
+      }
+      break;
+    default:
+      StreamSize = 8 + Random () % (StreamSize - 8);
+      *(UINT32 *) Stream = StreamSize - 8;
+      break;
+    }
+
+    //
+    // Decode no more than FUZZ_MAX_ORIG_SIZE bytes of the stream
+    //
+    OrigSize = ((UINT32 *) Stream)[1];
+    if (OrigSize > FUZZ_MAX_ORIG_SIZE) {
+      OrigSize = FUZZ_MAX_ORIG_SIZE;
+      ((UINT32 *) Stream)[1] = OrigSize;
+    }
+
+    for (Count = 0; Count < 2; Count++) {
+      memset (Output[Count], 0, OrigSize);
+      memset (Scratch[Count], 0, ScratchSize[Count]);
+    }
+
+    Status[0] = GuardedDecode (ReferenceDecode, Stream, StreamSize, Output[0], OrigSize, Scratch[0], ScratchSize[0]);
+    if (Status[0] == EFI_ABORTED) {
+      Skipped++;
+      continue;
+    }
+    Status[1] = GuardedDecode (LibraryDecode, Stream, StreamSize, Output[1], OrigSize, Scratch[1], ScratchSize[1]);
+
+    if (Status[0] != Status[1] ||
+        (Status[0] == EFI_SUCCESS && memcmp (Output[0], Output[1], OrigSize) != 0)) {
+      if (Failures < 10) {
+        printf ("FAIL  fuzz iteration %u on %s\n", (unsigned) Iteration, Fixture->Name);
+      }
+      Failures++;
+    }
+  }
+
+  signal (SIGSEGV, SIG_DFL);
+  signal (SIGBUS, SIG_DFL);
+  free (Stream);
+  munmap (Output[0], (size_t) (FUZZ_GUARD_SIZE + FUZZ_MAX_ORIG_SIZE));
+  munmap (Output[1], (size_t) (FUZZ_GUARD_SIZE + FUZZ_MAX_ORIG_SIZE));
+
+  printf (
+    "%s  fuzz: %u corrupted streams, %u skipped, %u decoded differently\n",
+    Failures == 0 ? "PASS" : "FAIL",
+    (unsigned) Iterations,
+    (unsigned) Skipped,
+    (unsigned) Failures
+    );
+  return Failures;
+#endif
+}
+
+/**
+  Measure the decoding speed of a decompressor on a fixture.
+
+  @param  Fixture   The fixture to decode.
+  @param  Decode    The decompressor.
+
+  @return The speed in MB/s.
+
+**/
+double
+MeasureDecode (
+  IN FIXTURE  *Fixture,
+  IN EFI_STATUS (*Decode) (UINT8 *, UINT32, UINT8 *, UINT32, UINT8 *, UINT32)
+  )
+{
+  UINT8    *Output;
+  UINT8    *Scratch;
+  UINT32   ScratchSize;
+  UINT32   Size;
+  UINTN    Rounds;
+  clock_t  Begin;
+  clock_t  Elapsed;
+
+  EfiGetInfo (Fixture->Compressed, Fixture->CompressedSize, &Size, &ScratchSize);
+  UefiDecompressGetInfo (Fixture->Compressed, Fixture->CompressedSize, &Size, &Size);
+  ScratchSize = (ScratchSize > Size ? ScratchSize : Size);
+  Output      = malloc (Fixture->Size);
+  Scratch     = malloc (ScratchSize);
+
+  Rounds  = 0;
+  Begin   = clock ();
+  do {
+    Decode (Fixture->Compressed, Fixture->CompressedSize, Output, Fixture->Size, Scratch, ScratchSize);
+    Rounds++;
+    Elapsed = clock () - Begin;
+  } while (Elapsed < CLOCKS_PER_SEC / 2);
+
+  free (Output);
+  free (Scratch);
+
+  return (double) Fixture->Size * Rounds / (1024 * 1024) / ((double) Elapsed / CLOCKS_PER_SEC);
+}
+
+/**
+  Print the decoding speed of both decompressors on every fixture.
+
+**/
+VOID
+Benchmark (
+  VOID
+  )
+{
+  UINTN   Index;
+  double  Reference;
+  double  Library;
+
+  printf ("\n%-24s %10s %10s %12s %12s %8s\n", "Fixture", "Size", "Compressed", "Ref MB/s", "MdePkg MB/s", "Speedup");
+  for (Index = 0; Index < mFixtureCount; Index++) {
+    if (mFixtures[Index].Size < 0x1000) {
+      continue;
+    }
+    Reference = MeasureDecode (&mFixtures[Index], ReferenceDecode);
+    Library   = MeasureDecode (&mFixtures[Index], LibraryDecode);
+    printf (
+      "%-24s %10u %10u %12.1f %12.1f %7.2fx\n",
+      mFixtures[Index].Name,
+      (unsigned) mFixtures[Index].Size,
+      (unsigned) mFixtures[Index].CompressedSize,
+      Reference,
+      Library,
+      Library / Reference
+      );
+  }
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  UINTN    Iterations;
+  BOOLEAN  RunBenchmark;
+  UINTN    Failures;
+  int      Index;
+
+  Iterations   = 20000;
+  RunBenchmark = FALSE;
+  for (Index = 1; Index < argc; Index++) {
+    if (strcmp (argv[Index], "-f") == 0 && Index + 1 < argc) {
+      Iterations = strtoul (argv[++Index], NULL, 0);
+    } else if (strcmp (argv[Index], "-b") == 0) {
+      RunBenchmark = TRUE;
+    } else if (argv[Index][0] == '-') {
+      fprintf (stderr, "Usage: %s [-f FuzzIterations] [-b] [File ...]\n", argv[0]);
+      return 2;
+    } else {
+      ReadFixture (argv[Index]);
+    }
+  }
+
+  GenerateFixtures ();
+
+  Failures  = TestRoundTrip ();
+  Failures += TestFuzz (Iterations);
+
+  if (RunBenchmark) {
+    Benchmark ();
+  }
+
+  return Failures == 0 ? 0 : 1;
+}
@@ -26,6 +26,7 @@ typedef struct {
   GUID                                    *ExtractHandlerGuidTable;
   EXTRACT_GUIDED_SECTION_DECODE_HANDLER   *ExtractDecodeHandlerTable;
   EXTRACT_GUIDED_SECTION_GET_INFO_HANDLER *ExtractGetInfoHandlerTable;
+  EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  *ExtractStreamHandlerTable;
 } PRE_PI_EXTRACT_GUIDED_SECTION_DATA;
 
 PRE_PI_EXTRACT_GUIDED_SECTION_DATA *
@@ -91,6 +92,7 @@ ExtractGuidedSectionRegisterHandlers (
   //
   CopyGuid (&SavedData->ExtractHandlerGuidTable [SavedData->NumberOfExtractHandler], SectionGuid);
   SavedData->ExtractDecodeHandlerTable [SavedData->NumberOfExtractHandler] = DecodeHandler;
+  ZeroMem (&SavedData->ExtractStreamHandlerTable [SavedData->NumberOfExtractHandler], sizeof (EXTRACT_GUIDED_SECTION_STREAM_HANDLERS));
   SavedData->ExtractGetInfoHandlerTable [SavedData->NumberOfExtractHandler++] = GetInfoHandler;
 
   return RETURN_SUCCESS;
@@ -209,6 +211,140 @@ ExtractGuidedSectionDecode (
           );
 }
 
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionRegisterStreamHandlers (
+  IN CONST  GUID                                          *SectionGuid,
+  IN        EXTRACT_GUIDED_SECTION_STREAM_INIT_HANDLER    InitHandler,
+  IN        EXTRACT_GUIDED_SECTION_STREAM_FEED_HANDLER    FeedHandler,
+  IN        EXTRACT_GUIDED_SECTION_STREAM_FINISH_HANDLER  FinishHandler
+  )
+{
+  PRE_PI_EXTRACT_GUIDED_SECTION_DATA  *SavedData;
+  UINT32                              Index;
+
+  ASSERT (SectionGuid != NULL);
+  ASSERT (InitHandler != NULL);
+  ASSERT (FeedHandler != NULL);
+  ASSERT (FinishHandler != NULL);
+
+  SavedData = GetSavedData();
+
+  //
+  // The handlers of the guided section must have been registered before.
+  //
+  for (Index = 0; Index < SavedData->NumberOfExtractHandler; Index ++) {
+    if (CompareGuid (&SavedData->ExtractHandlerGuidTable[Index], SectionGuid)) {
+      SavedData->ExtractStreamHandlerTable[Index].InitHandler   = InitHandler;
+      SavedData->ExtractStreamHandlerTable[Index].FeedHandler   = FeedHandler;
+      SavedData->ExtractStreamHandlerTable[Index].FinishHandler = FinishHandler;
+      return RETURN_SUCCESS;
+    }
+  }
+
+  return RETURN_NOT_FOUND;
+}
+
+EXTRACT_GUIDED_SECTION_STREAM_HANDLERS *
+GetStreamHandlers (
+  IN CONST VOID  *InputSection
+  )
+{
+  PRE_PI_EXTRACT_GUIDED_SECTION_DATA  *SavedData;
+  UINT32                              Index;
+
+  SavedData = GetSavedData();
+
+  //
+  // Search the match registered handlers for the input guided section.
+  //
+  for (Index = 0; Index < SavedData->NumberOfExtractHandler; Index ++) {
+    if (CompareGuid (&SavedData->ExtractHandlerGuidTable[Index], &(((EFI_GUID_DEFINED_SECTION *) InputSection)->SectionDefinitionGuid))) {
+      if (SavedData->ExtractStreamHandlerTable[Index].InitHandler == NULL) {
+        return NULL;
+      }
+      return &SavedData->ExtractStreamHandlerTable[Index];
+    }
+  }
+
+  return NULL;
+}
+
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionStreamInit (
+  IN  CONST VOID    *InputSection,
+  IN        VOID    *ScratchBuffer
+  )
+{
+  EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  *StreamHandlers;
+
+  if (InputSection == NULL) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  ASSERT (ScratchBuffer != NULL);
+
+  StreamHandlers = GetStreamHandlers (InputSection);
+  if (StreamHandlers == NULL) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  return StreamHandlers->InitHandler (InputSection, ScratchBuffer);
+}
+
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionStreamFeed (
+  IN  CONST VOID    *InputSection,
+  IN OUT    VOID    *OutputBuffer,
+  IN OUT    UINT32  *OutputSize,
+  IN        VOID    *ScratchBuffer
+  )
+{
+  EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  *StreamHandlers;
+
+  if (InputSection == NULL) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  ASSERT (OutputBuffer != NULL);
+  ASSERT (OutputSize != NULL);
+  ASSERT (ScratchBuffer != NULL);
+
+  StreamHandlers = GetStreamHandlers (InputSection);
+  if (StreamHandlers == NULL) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  return StreamHandlers->FeedHandler (InputSection, OutputBuffer, OutputSize, ScratchBuffer);
+}
+
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionStreamFinish (
+  IN  CONST VOID    *InputSection,
+  IN        VOID    *ScratchBuffer,
+  OUT       UINT32  *AuthenticationStatus
+  )
+{
+  EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  *StreamHandlers;
+
+  if (InputSection == NULL) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  ASSERT (ScratchBuffer != NULL);
+  ASSERT (AuthenticationStatus != NULL);
+
+  StreamHandlers = GetStreamHandlers (InputSection);
+  if (StreamHandlers == NULL) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  return StreamHandlers->FinishHandler (InputSection, ScratchBuffer, AuthenticationStatus);
+}
+
 RETURN_STATUS
 EFIAPI
 ExtractGuidedSectionLibConstructor (
@@ -236,6 +372,11 @@ ExtractGuidedSectionLibConstructor (
     return RETURN_OUT_OF_RESOURCES;
   }
 
+  SavedData.ExtractStreamHandlerTable = (EXTRACT_GUIDED_SECTION_STREAM_HANDLERS *)AllocatePool(PcdGet32(PcdMaximumGuidedExtractHandler) * sizeof(EXTRACT_GUIDED_SECTION_STREAM_HANDLERS));
+  if (SavedData.ExtractStreamHandlerTable == NULL) {
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
   //
   // the initialized number is Zero.
   //
@@ -29,7 +29,33 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define LZMAF86_CUSTOM_DECOMPRESS_GUID  \
   { 0xD42AE6BD, 0x1352, 0x4bfb, { 0x90, 0x9A, 0xCA, 0x72, 0xA6, 0xEA, 0xE8, 0x89 } }
 
+///
+/// The Global ID used to identify a section of an FFS file of type
+/// EFI_SECTION_GUID_DEFINED, whose contents have been split into chunks that
+/// are compressed independently using LZMA, so that they can be decompressed
+/// concurrently.
+///
+#define LZMA_PARALLEL_CUSTOM_DECOMPRESS_GUID  \
+  { 0x76b75c8e, 0x35c8, 0x41ad, { 0xbc, 0x05, 0x66, 0xaf, 0xbb, 0xe5, 0x4c, 0xc7 } }
+
+#define LZMA_PARALLEL_SIGNATURE  SIGNATURE_32 ('L', 'Z', 'M', 'P')
+
+///
+/// The header of the data of an LZMA parallel GUIDed section. It is followed by
+/// a table of ChunkCount UINT32 values giving the compressed size of each chunk,
+/// then by the chunks themselves. Every chunk is a complete LZMA stream, header
+/// included, which decodes to ChunkSize bytes, except the last one which decodes
+/// to the rest of DecodedSize.
+///
+typedef struct {
+  UINT32  Signature;
+  UINT32  DecodedSize;
+  UINT32  ChunkSize;
+  UINT32  ChunkCount;
+} LZMA_PARALLEL_HEADER;
+
 extern GUID gLzmaCustomDecompressGuid;
 extern GUID gLzmaF86CustomDecompressGuid;
+extern GUID gLzmaParallelCustomDecompressGuid;
 
 #endif
@@ -309,6 +309,7 @@ BdsLibConnectAllDriversToAllControllers (
 {
   EFI_STATUS  Status;
 
+  PERF_START (NULL, "ConnectAll", "BDS", 0);
   do {
     //
     // Connect All EFI 1.10 drivers following EFI 1.10 algorithm
@@ -324,6 +325,7 @@ BdsLibConnectAllDriversToAllControllers (
     Status = gDS->Dispatch ();
 
   } while (!EFI_ERROR (Status));
+  PERF_END (NULL, "ConnectAll", "BDS", 0);
 
 }
 
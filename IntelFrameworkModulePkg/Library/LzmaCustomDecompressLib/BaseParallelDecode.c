@@ -0,0 +1,44 @@
+/** @file
+  Decode the chunks of an LZMA parallel GUIDed section one after the other on
+  the current processor, for the phases that have no multi-processor service.
+
+  Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "LzmaDecompressLibInternal.h"
+
+/**
+  Decode all the chunks of an LZMA parallel GUIDed section, on as many
+  processors as the library instance can use.
+
+  @param[in, out] Context   The state of the section being decoded.
+
+  @retval  RETURN_SUCCESS            All the chunks were decoded.
+  @retval  RETURN_INVALID_PARAMETER  At least one chunk is corrupted.
+
+**/
+RETURN_STATUS
+LzmaParallelDecodeChunks (
+  IN OUT LZMA_PARALLEL_CONTEXT  *Context
+  )
+{
+  RETURN_STATUS  Status;
+  UINT32         Index;
+
+  for (Index = 0; Index < Context->ChunkCount; Index++) {
+    Status = LzmaParallelDecodeChunk (Context, Index);
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return RETURN_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/** @file
+  Decode the chunks of an LZMA parallel GUIDed section concurrently on the
+  application processors through the MP Services Protocol.
+
+  Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <PiDxe.h>
+#include "LzmaDecompressLibInternal.h"
+#include <Library/BaseLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Protocol/MpService.h>
+#include <Protocol/Timer.h>
+
+/**
+  Decode chunks of an LZMA parallel GUIDed section until there is none left.
+
+  Every processor running this procedure takes the next chunk that nobody has
+  taken yet, so the chunks are spread over the processors whatever their sizes.
+
+  @param[in, out] Buffer    The LZMA_PARALLEL_CONTEXT of the section being decoded.
+
+**/
+VOID
+EFIAPI
+LzmaParallelDecodeProcedure (
+  IN OUT VOID  *Buffer
+  )
+{
+  LZMA_PARALLEL_CONTEXT  *Context;
+  UINT32                 Index;
+
+  Context = (LZMA_PARALLEL_CONTEXT *) Buffer;
+  while (TRUE) {
+    Index = InterlockedIncrement (&Context->NextChunk) - 1;
+    if (Index >= Context->ChunkCount) {
+      break;
+    }
+
+    if (RETURN_ERROR (LzmaParallelDecodeChunk (Context, Index))) {
+      InterlockedIncrement (&Context->FailedChunks);
+    }
+  }
+}
+
+/**
+  Decode all the chunks of an LZMA parallel GUIDed section, on as many
+  processors as the library instance can use.
+
+  The enabled APs are started in non-blocking mode, so the BSP decodes chunks
+  at the same time and then waits for the APs to finish. The BSP decodes all
+  the chunks when there is no MP Services Protocol yet or no enabled AP.
+
+  The MP Services Protocol signals the end of a non-blocking request from a
+  timer event, so the APs are started in blocking mode when the caller runs at
+  TPL_CALLBACK or above, or when the Timer Architectural Protocol is not
+  installed yet and the timer events never run. The BSP then decodes the
+  chunks that are left.
+
+  @param[in, out] Context   The state of the section being decoded.
+
+  @retval  RETURN_SUCCESS            All the chunks were decoded.
+  @retval  RETURN_INVALID_PARAMETER  At least one chunk is corrupted.
+
+**/
+RETURN_STATUS
+LzmaParallelDecodeChunks (
+  IN OUT LZMA_PARALLEL_CONTEXT  *Context
+  )
+{
+  EFI_STATUS                Status;
+  EFI_MP_SERVICES_PROTOCOL  *MpServices;
+  EFI_EVENT                 WaitEvent;
+  EFI_TPL                   OldTpl;
+  VOID                      *Timer;
+
+  WaitEvent = NULL;
+  if (Context->ChunkCount > 1) {
+    Status = gBS->LocateProtocol (&gEfiMpServiceProtocolGuid, NULL, (VOID **) &MpServices);
+    if (!EFI_ERROR (Status)) {
+      OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+      gBS->RestoreTPL (OldTpl);
+      if ((OldTpl < TPL_CALLBACK) &&
+          !EFI_ERROR (gBS->LocateProtocol (&gEfiTimerArchProtocolGuid, NULL, &Timer))) {
+        Status = gBS->CreateEvent (0, TPL_CALLBACK, NULL, NULL, &WaitEvent);
+        if (EFI_ERROR (Status)) {
+          WaitEvent = NULL;
+        }
+      }
+
+      if (WaitEvent != NULL) {
+        Status = MpServices->StartupAllAPs (
+                               MpServices,
+                               LzmaParallelDecodeProcedure,
+                               FALSE,
+                               WaitEvent,
+                               0,
+                               Context,
+                               NULL
+                               );
+        if (EFI_ERROR (Status)) {
+          gBS->CloseEvent (WaitEvent);
+          WaitEvent = NULL;
+        }
+      }
+
+      if ((WaitEvent == NULL) && (Status != EFI_NOT_STARTED)) {
+        MpServices->StartupAllAPs (
+                      MpServices,
+                      LzmaParallelDecodeProcedure,
+                      FALSE,
+                      NULL,
+                      0,
+                      Context,
+                      NULL
+                      );
+      }
+    }
+  }
+
+  LzmaParallelDecodeProcedure (Context);
+
+  if (WaitEvent != NULL) {
+    while (gBS->CheckEvent (WaitEvent) == EFI_NOT_READY) {
+      CpuPause ();
+    }
+    gBS->CloseEvent (WaitEvent);
+  }
+
+  if (Context->FailedChunks != 0) {
+    return RETURN_INVALID_PARAMETER;
+  }
+  return RETURN_SUCCESS;
+}
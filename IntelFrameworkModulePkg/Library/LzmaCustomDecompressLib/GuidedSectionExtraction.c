@@ -180,9 +180,119 @@ LzmaGuidedSectionExtraction (
   }
 }
 
+/**
+  Start to decompress a LZMA compressed GUIDed section incrementally.
+
+  @param[in]  InputSection  A pointer to a GUIDed section of an FFS formatted file.
+  @param[in]  ScratchBuffer A caller allocated buffer of the size returned by LzmaGuidedSectionGetInfo(),
+                            which holds the state of the decode operation until it is finished.
+
+  @retval  RETURN_SUCCESS            The decode operation was started.
+  @retval  RETURN_INVALID_PARAMETER  The section specified by InputSection can not be decoded.
+
+**/
+RETURN_STATUS
+EFIAPI
+LzmaGuidedSectionStreamInit (
+  IN CONST  VOID    *InputSection,
+  IN        VOID    *ScratchBuffer
+  )
+{
+  ASSERT (InputSection != NULL);
+  ASSERT (ScratchBuffer != NULL);
+
+  if (IS_SECTION2 (InputSection)) {
+    if (!CompareGuid (
+        &gLzmaCustomDecompressGuid,
+        &(((EFI_GUID_DEFINED_SECTION2 *) InputSection)->SectionDefinitionGuid))) {
+      return RETURN_INVALID_PARAMETER;
+    }
+
+    return LzmaUefiDecompressStreamInit (
+             (UINT8 *) InputSection + ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->DataOffset,
+             SECTION2_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->DataOffset,
+             ScratchBuffer
+             );
+  } else {
+    if (!CompareGuid (
+        &gLzmaCustomDecompressGuid,
+        &(((EFI_GUID_DEFINED_SECTION *) InputSection)->SectionDefinitionGuid))) {
+      return RETURN_INVALID_PARAMETER;
+    }
+
+    return LzmaUefiDecompressStreamInit (
+             (UINT8 *) InputSection + ((EFI_GUID_DEFINED_SECTION *) InputSection)->DataOffset,
+             SECTION_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION *) InputSection)->DataOffset,
+             ScratchBuffer
+             );
+  }
+}
 
 /**
-  Register LzmaDecompress and LzmaDecompressGetInfo handlers with LzmaCustomerDecompressGuid.
+  Decompress the next window of a LZMA compressed GUIDed section.
+
+  @param[in]      InputSection  A pointer to a GUIDed section of an FFS formatted file.
+  @param[in, out] OutputBuffer  A pointer to the buffer that holds the decoded data.
+  @param[in, out] OutputSize    On input, the offset in OutputBuffer at which this window ends.
+                                On output, the size, in bytes, of the data decoded so far.
+  @param[in]      ScratchBuffer The scratch buffer given to LzmaGuidedSectionStreamInit().
+
+  @retval  RETURN_SUCCESS            The window was decoded.
+  @retval  RETURN_INVALID_PARAMETER  The section specified by InputSection can not be decoded.
+
+**/
+RETURN_STATUS
+EFIAPI
+LzmaGuidedSectionStreamFeed (
+  IN CONST  VOID    *InputSection,
+  IN OUT    VOID    *OutputBuffer,
+  IN OUT    UINT32  *OutputSize,
+  IN        VOID    *ScratchBuffer
+  )
+{
+  ASSERT (InputSection != NULL);
+  ASSERT (OutputBuffer != NULL);
+  ASSERT (OutputSize != NULL);
+  ASSERT (ScratchBuffer != NULL);
+
+  return LzmaUefiDecompressStreamFeed (ScratchBuffer, OutputBuffer, OutputSize);
+}
+
+/**
+  Finish to decompress a LZMA compressed GUIDed section incrementally.
+
+  @param[in]  InputSection  A pointer to a GUIDed section of an FFS formatted file.
+  @param[in]  ScratchBuffer The scratch buffer given to LzmaGuidedSectionStreamInit().
+  @param[out] AuthenticationStatus
+                            A pointer to the authentication status of the decoded output buffer.
+
+  @retval  RETURN_SUCCESS            The section specified by InputSection was completely decoded.
+  @retval  RETURN_INVALID_PARAMETER  Not all of the section specified by InputSection was decoded.
+
+**/
+RETURN_STATUS
+EFIAPI
+LzmaGuidedSectionStreamFinish (
+  IN CONST  VOID    *InputSection,
+  IN        VOID    *ScratchBuffer,
+  OUT       UINT32  *AuthenticationStatus
+  )
+{
+  ASSERT (InputSection != NULL);
+  ASSERT (ScratchBuffer != NULL);
+
+  //
+  // Authentication is set to Zero, which may be ignored.
+  //
+  *AuthenticationStatus = 0;
+
+  return LzmaUefiDecompressStreamFinish (ScratchBuffer);
+}
+
+/**
+  Register LzmaDecompress and LzmaDecompressGetInfo handlers with LzmaCustomerDecompressGuid,
+  together with the handlers that decode it incrementally, and the LZMA parallel handlers
+  with LzmaParallelCustomDecompressGuid.
 
   @retval  RETURN_SUCCESS            Register successfully.
   @retval  RETURN_OUT_OF_RESOURCES   No enough memory to store this handler.
@@ -192,10 +302,31 @@ EFIAPI
 LzmaDecompressLibConstructor (
   )
 {
+  RETURN_STATUS  Status;
+
+  Status = ExtractGuidedSectionRegisterHandlers (
+             &gLzmaCustomDecompressGuid,
+             LzmaGuidedSectionGetInfo,
+             LzmaGuidedSectionExtraction
+             );
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = ExtractGuidedSectionRegisterStreamHandlers (
+             &gLzmaCustomDecompressGuid,
+             LzmaGuidedSectionStreamInit,
+             LzmaGuidedSectionStreamFeed,
+             LzmaGuidedSectionStreamFinish
+             );
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
   return ExtractGuidedSectionRegisterHandlers (
-          &gLzmaCustomDecompressGuid,
-          LzmaGuidedSectionGetInfo,
-          LzmaGuidedSectionExtraction
-          );      
+          &gLzmaParallelCustomDecompressGuid,
+          LzmaParallelGuidedSectionGetInfo,
+          LzmaParallelGuidedSectionExtraction
+          );
 }
 
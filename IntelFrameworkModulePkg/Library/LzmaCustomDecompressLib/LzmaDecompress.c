@@ -17,8 +17,6 @@
 #include "Sdk/C/7zVersion.h"
 #include "Sdk/C/LzmaDec.h"
 
-#define SCRATCH_BUFFER_REQUEST_SIZE SIZE_64KB
-
 typedef struct
 {
   ISzAlloc Functions;
@@ -26,6 +24,15 @@ typedef struct
   UINTN    BufferSize;
 } ISzAllocWithData;
 
+///
+/// The state of an incremental decode, kept at the start of the scratch buffer.
+///
+typedef struct {
+  CLzmaDec     Decoder;
+  CONST UINT8  *Source;      ///< The compressed data not consumed yet.
+  SizeT        SourceSize;   ///< The size of the compressed data not consumed yet.
+} LZMA_STREAM_CONTEXT;
+
 /**
   Allocation routine used by LZMA decompression.
 
@@ -75,8 +82,6 @@ SzFree (
   //
 }
 
-#define LZMA_HEADER_SIZE (LZMA_PROPS_SIZE + 8)
-
 /**
   Get the size of the uncompressed buffer by parsing EncodeData header.
 
@@ -218,3 +223,142 @@ LzmaUefiDecompress (
   }
 }
 
+/**
+  Starts to decompress a Lzma compressed source buffer incrementally.
+
+  The state of the decompression is kept in Scratch, which must be at least
+  as large as the scratch size returned by LzmaUefiDecompressGetInfo().
+
+  @param  Source      The source buffer containing the compressed data.
+  @param  SourceSize  The size of source buffer.
+  @param  Scratch     A temporary scratch buffer that holds the state of the
+                      decompression until it is finished.
+
+  @retval  RETURN_SUCCESS The decompression was started.
+  @retval  RETURN_INVALID_PARAMETER 
+                          The source buffer specified by Source is corrupted 
+                          (not in a valid compressed format).
+**/
+RETURN_STATUS
+EFIAPI
+LzmaUefiDecompressStreamInit (
+  IN CONST VOID  *Source,
+  IN UINTN       SourceSize,
+  IN OUT VOID    *Scratch
+  )
+{
+  LZMA_STREAM_CONTEXT  *Context;
+  ISzAllocWithData     AllocFuncs;
+
+  if (SourceSize < LZMA_HEADER_SIZE) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  //
+  // The probabilities of the decoder are allocated after the context.
+  //
+  Context = (LZMA_STREAM_CONTEXT *) Scratch;
+  AllocFuncs.Functions.Alloc  = SzAlloc;
+  AllocFuncs.Functions.Free   = SzFree;
+  AllocFuncs.Buffer           = (UINT8 *) Scratch + ALIGN_VALUE (sizeof (LZMA_STREAM_CONTEXT), sizeof (UINT64));
+  AllocFuncs.BufferSize       = SCRATCH_BUFFER_REQUEST_SIZE - ALIGN_VALUE (sizeof (LZMA_STREAM_CONTEXT), sizeof (UINT64));
+
+  LzmaDec_Construct (&Context->Decoder);
+  if (LzmaDec_AllocateProbs (&Context->Decoder, Source, LZMA_PROPS_SIZE, &(AllocFuncs.Functions)) != SZ_OK) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Context->Decoder.dicBufSize = (SizeT) GetDecodedSizeOfBuf ((UINT8 *) Source);
+  LzmaDec_Init (&Context->Decoder);
+
+  Context->Source     = (CONST UINT8 *) Source + LZMA_HEADER_SIZE;
+  Context->SourceSize = (SizeT) (SourceSize - LZMA_HEADER_SIZE);
+  return RETURN_SUCCESS;
+}
+
+/**
+  Decompresses the next window of a Lzma compressed source buffer.
+
+  The data is decompressed from the end of the previous window up to the
+  offset specified by DestinationSize. The data decompressed by the previous
+  windows must be at the same offsets in Destination, because the data being
+  decompressed refers to it, but Destination may differ from one window to
+  the next.
+
+  @param  Scratch         The scratch buffer given to LzmaUefiDecompressStreamInit().
+  @param  Destination     The destination buffer to store the decompressed data.
+  @param  DestinationSize On input, the offset in Destination at which this window
+                          ends. On output, the size of the data decompressed so far.
+
+  @retval  RETURN_SUCCESS The window was decompressed.
+  @retval  RETURN_INVALID_PARAMETER 
+                          The source buffer is corrupted (not in a valid
+                          compressed format).
+**/
+RETURN_STATUS
+EFIAPI
+LzmaUefiDecompressStreamFeed (
+  IN OUT VOID    *Scratch,
+  IN OUT VOID    *Destination,
+  IN OUT UINT32  *DestinationSize
+  )
+{
+  LZMA_STREAM_CONTEXT  *Context;
+  SRes                 LzmaResult;
+  ELzmaStatus          Status;
+  SizeT                Limit;
+  SizeT                EncodedDataSize;
+
+  Context = (LZMA_STREAM_CONTEXT *) Scratch;
+  Context->Decoder.dic = Destination;
+
+  Limit = MIN ((SizeT) *DestinationSize, Context->Decoder.dicBufSize);
+  if (Limit > Context->Decoder.dicPos) {
+    EncodedDataSize = Context->SourceSize;
+    LzmaResult = LzmaDec_DecodeToDic (
+                   &Context->Decoder,
+                   Limit,
+                   Context->Source,
+                   &EncodedDataSize,
+                   LZMA_FINISH_ANY,
+                   &Status
+                   );
+    Context->Source     += EncodedDataSize;
+    Context->SourceSize -= EncodedDataSize;
+
+    //
+    // The window is only short when the compressed data is truncated or ends early.
+    //
+    if (LzmaResult != SZ_OK || Context->Decoder.dicPos != Limit) {
+      return RETURN_INVALID_PARAMETER;
+    }
+  }
+
+  *DestinationSize = (UINT32) Context->Decoder.dicPos;
+  return RETURN_SUCCESS;
+}
+
+/**
+  Finishes to decompress a Lzma compressed source buffer incrementally.
+
+  @param  Scratch     The scratch buffer given to LzmaUefiDecompressStreamInit().
+
+  @retval  RETURN_SUCCESS All the data was decompressed.
+  @retval  RETURN_INVALID_PARAMETER 
+                          Not all the data was decompressed.
+**/
+RETURN_STATUS
+EFIAPI
+LzmaUefiDecompressStreamFinish (
+  IN OUT VOID    *Scratch
+  )
+{
+  LZMA_STREAM_CONTEXT  *Context;
+
+  Context = (LZMA_STREAM_CONTEXT *) Scratch;
+  if (Context->Decoder.dicPos != Context->Decoder.dicBufSize) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  return RETURN_SUCCESS;
+}
@@ -22,6 +22,29 @@
 #include <Library/ExtractGuidedSectionLib.h>
 #include <Guid/LzmaDecompress.h>
 
+#include "Sdk/C/Types.h"
+#include "Sdk/C/LzmaDec.h"
+
+#define SCRATCH_BUFFER_REQUEST_SIZE SIZE_64KB
+
+#define LZMA_HEADER_SIZE (LZMA_PROPS_SIZE + 8)
+
+///
+/// The state shared by the processors decoding the chunks of an LZMA parallel
+/// GUIDed section.
+///
+typedef struct {
+  CONST UINT8   *Data;          ///< The section data, starting with the LZMA_PARALLEL_HEADER.
+  CONST UINT32  *ChunkSizes;    ///< The compressed size of each chunk.
+  UINT32        *ChunkOffsets;  ///< The offset of each chunk from Data.
+  UINT32        ChunkCount;
+  UINT32        ChunkSize;      ///< The decoded size of every chunk but the last one.
+  UINT8         *Destination;
+  UINT8         *Scratch;       ///< SCRATCH_BUFFER_REQUEST_SIZE bytes per chunk.
+  UINT32        NextChunk;      ///< The index of the next chunk to decode.
+  UINT32        FailedChunks;   ///< The number of chunks that could not be decoded.
+} LZMA_PARALLEL_CONTEXT;
+
 /**
   Given a Lzma compressed source buffer, this function retrieves the size of 
   the uncompressed buffer and the size of the scratch buffer required 
@@ -92,5 +115,152 @@ LzmaUefiDecompress (
   IN OUT VOID    *Scratch
   );
 
+/**
+  Starts to decompress a Lzma compressed source buffer incrementally.
+
+  The state of the decompression is kept in Scratch, which must be at least
+  as large as the scratch size returned by LzmaUefiDecompressGetInfo().
+
+  @param  Source      The source buffer containing the compressed data.
+  @param  SourceSize  The size of source buffer.
+  @param  Scratch     A temporary scratch buffer that holds the state of the
+                      decompression until it is finished.
+
+  @retval  RETURN_SUCCESS The decompression was started.
+  @retval  RETURN_INVALID_PARAMETER 
+                          The source buffer specified by Source is corrupted 
+                          (not in a valid compressed format).
+**/
+RETURN_STATUS
+EFIAPI
+LzmaUefiDecompressStreamInit (
+  IN CONST VOID  *Source,
+  IN UINTN       SourceSize,
+  IN OUT VOID    *Scratch
+  );
+
+/**
+  Decompresses the next window of a Lzma compressed source buffer.
+
+  The data is decompressed from the end of the previous window up to the
+  offset specified by DestinationSize. The data decompressed by the previous
+  windows must be at the same offsets in Destination, because the data being
+  decompressed refers to it, but Destination may differ from one window to
+  the next.
+
+  @param  Scratch         The scratch buffer given to LzmaUefiDecompressStreamInit().
+  @param  Destination     The destination buffer to store the decompressed data.
+  @param  DestinationSize On input, the offset in Destination at which this window
+                          ends. On output, the size of the data decompressed so far.
+
+  @retval  RETURN_SUCCESS The window was decompressed.
+  @retval  RETURN_INVALID_PARAMETER 
+                          The source buffer is corrupted (not in a valid
+                          compressed format).
+**/
+RETURN_STATUS
+EFIAPI
+LzmaUefiDecompressStreamFeed (
+  IN OUT VOID    *Scratch,
+  IN OUT VOID    *Destination,
+  IN OUT UINT32  *DestinationSize
+  );
+
+/**
+  Finishes to decompress a Lzma compressed source buffer incrementally.
+
+  @param  Scratch     The scratch buffer given to LzmaUefiDecompressStreamInit().
+
+  @retval  RETURN_SUCCESS All the data was decompressed.
+  @retval  RETURN_INVALID_PARAMETER 
+                          Not all the data was decompressed.
+**/
+RETURN_STATUS
+EFIAPI
+LzmaUefiDecompressStreamFinish (
+  IN OUT VOID    *Scratch
+  );
+
+/**
+  Examines an LZMA parallel GUIDed section and returns the size of the decoded
+  buffer and the size of the scratch buffer required to decode it.
+
+  @param[in]  InputSection       A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] OutputBufferSize   A pointer to the size, in bytes, of an output buffer required
+                                 if the buffer specified by InputSection were decoded.
+  @param[out] ScratchBufferSize  A pointer to the size, in bytes, required as scratch space
+                                 if the buffer specified by InputSection were decoded.
+  @param[out] SectionAttribute   A pointer to the attributes of the GUIDed section. See the Attributes
+                                 field of EFI_GUID_DEFINED_SECTION in the PI Specification.
+
+  @retval  RETURN_SUCCESS            The information about InputSection was returned.
+  @retval  RETURN_INVALID_PARAMETER  The information can not be retrieved from the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+LzmaParallelGuidedSectionGetInfo (
+  IN  CONST VOID  *InputSection,
+  OUT UINT32      *OutputBufferSize,
+  OUT UINT32      *ScratchBufferSize,
+  OUT UINT16      *SectionAttribute
+  );
+
+/**
+  Decompress an LZMA parallel GUIDed section into a caller allocated output buffer.
+
+  @param[in]  InputSection  A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] OutputBuffer  A pointer to a buffer that contains the result of a decode operation.
+  @param[out] ScratchBuffer A caller allocated buffer that may be required by this function
+                            as a scratch buffer to perform the decode operation.
+  @param[out] AuthenticationStatus
+                            A pointer to the authentication status of the decoded output buffer.
+
+  @retval  RETURN_SUCCESS            The buffer specified by InputSection was decoded.
+  @retval  RETURN_INVALID_PARAMETER  The section specified by InputSection can not be decoded.
+
+**/
+RETURN_STATUS
+EFIAPI
+LzmaParallelGuidedSectionExtraction (
+  IN CONST  VOID    *InputSection,
+  OUT       VOID    **OutputBuffer,
+  OUT       VOID    *ScratchBuffer,        OPTIONAL
+  OUT       UINT32  *AuthenticationStatus
+  );
+
+/**
+  Decode one chunk of an LZMA parallel GUIDed section.
+
+  This function may run on any processor.
+
+  @param[in, out] Context   The state of the section being decoded.
+  @param[in]      Index     The index of the chunk to decode.
+
+  @retval  RETURN_SUCCESS            The chunk was decoded.
+  @retval  RETURN_INVALID_PARAMETER  The chunk is corrupted.
+
+**/
+RETURN_STATUS
+LzmaParallelDecodeChunk (
+  IN OUT LZMA_PARALLEL_CONTEXT  *Context,
+  IN     UINT32                 Index
+  );
+
+/**
+  Decode all the chunks of an LZMA parallel GUIDed section, on as many
+  processors as the library instance can use.
+
+  @param[in, out] Context   The state of the section being decoded.
+
+  @retval  RETURN_SUCCESS            All the chunks were decoded.
+  @retval  RETURN_INVALID_PARAMETER  At least one chunk is corrupted.
+
+**/
+RETURN_STATUS
+LzmaParallelDecodeChunks (
+  IN OUT LZMA_PARALLEL_CONTEXT  *Context
+  );
+
 #endif
 
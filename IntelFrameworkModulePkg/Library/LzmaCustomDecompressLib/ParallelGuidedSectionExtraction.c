@@ -0,0 +1,264 @@
+/** @file
+  LZMA Parallel Decompress GUIDed Section Extraction Library.
+
+  An LZMA parallel GUIDed section holds a chunk table followed by chunks that
+  are compressed independently with LZMA. The chunks do not depend on each
+  other, so they can be decoded concurrently, each one into its own part of the
+  output buffer and with its own part of the scratch buffer. How the chunks are
+  dispatched to the processors is up to the library instance.
+
+  Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "LzmaDecompressLibInternal.h"
+
+/**
+  Locate the data of an LZMA parallel GUIDed section and check its header.
+
+  @param[in]  InputSection      A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] Header            The header of the section data.
+  @param[out] DataSize          The size, in bytes, of the section data.
+  @param[out] SectionAttribute  The attributes of the GUIDed section.
+
+  @retval  RETURN_SUCCESS            The header of the section data is valid.
+  @retval  RETURN_INVALID_PARAMETER  The section is not an LZMA parallel GUIDed section,
+                                     or its header is corrupted.
+
+**/
+RETURN_STATUS
+LzmaParallelGetSectionData (
+  IN  CONST VOID                  *InputSection,
+  OUT CONST LZMA_PARALLEL_HEADER  **Header,
+  OUT UINTN                       *DataSize,
+  OUT UINT16                      *SectionAttribute
+  )
+{
+  EFI_GUID                    *InputGuid;
+  CONST LZMA_PARALLEL_HEADER  *DataHeader;
+  UINTN                       Size;
+  UINT32                      ChunkCount;
+
+  if (IS_SECTION2 (InputSection)) {
+    InputGuid         = &(((EFI_GUID_DEFINED_SECTION2 *) InputSection)->SectionDefinitionGuid);
+    DataHeader        = (LZMA_PARALLEL_HEADER *) ((UINT8 *) InputSection + ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->DataOffset);
+    Size              = SECTION2_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->DataOffset;
+    *SectionAttribute = ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->Attributes;
+  } else {
+    InputGuid         = &(((EFI_GUID_DEFINED_SECTION *) InputSection)->SectionDefinitionGuid);
+    DataHeader        = (LZMA_PARALLEL_HEADER *) ((UINT8 *) InputSection + ((EFI_GUID_DEFINED_SECTION *) InputSection)->DataOffset);
+    Size              = SECTION_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION *) InputSection)->DataOffset;
+    *SectionAttribute = ((EFI_GUID_DEFINED_SECTION *) InputSection)->Attributes;
+  }
+
+  if (!CompareGuid (&gLzmaParallelCustomDecompressGuid, InputGuid)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if (Size < sizeof (LZMA_PARALLEL_HEADER) ||
+      DataHeader->Signature != LZMA_PARALLEL_SIGNATURE ||
+      DataHeader->DecodedSize == 0 ||
+      DataHeader->ChunkSize == 0) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  //
+  // The chunk count is implied by the sizes, and the chunk table and the
+  // scratch buffer of all the chunks must fit.
+  //
+  ChunkCount = (DataHeader->DecodedSize - 1) / DataHeader->ChunkSize + 1;
+  if (DataHeader->ChunkCount != ChunkCount ||
+      ChunkCount > (Size - sizeof (LZMA_PARALLEL_HEADER)) / sizeof (UINT32) ||
+      ChunkCount > MAX_UINT32 / (SCRATCH_BUFFER_REQUEST_SIZE + sizeof (UINT64))) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  *Header   = DataHeader;
+  *DataSize = Size;
+  return RETURN_SUCCESS;
+}
+
+/**
+  Examines an LZMA parallel GUIDed section and returns the size of the decoded
+  buffer and the size of the scratch buffer required to decode it.
+
+  The scratch buffer holds the chunk offsets, then a SCRATCH_BUFFER_REQUEST_SIZE
+  area for every chunk so that all the chunks can be decoded at the same time.
+
+  If InputSection is NULL, then ASSERT().
+  If OutputBufferSize is NULL, then ASSERT().
+  If ScratchBufferSize is NULL, then ASSERT().
+  If SectionAttribute is NULL, then ASSERT().
+
+  @param[in]  InputSection       A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] OutputBufferSize   A pointer to the size, in bytes, of an output buffer required
+                                 if the buffer specified by InputSection were decoded.
+  @param[out] ScratchBufferSize  A pointer to the size, in bytes, required as scratch space
+                                 if the buffer specified by InputSection were decoded.
+  @param[out] SectionAttribute   A pointer to the attributes of the GUIDed section. See the Attributes
+                                 field of EFI_GUID_DEFINED_SECTION in the PI Specification.
+
+  @retval  RETURN_SUCCESS            The information about InputSection was returned.
+  @retval  RETURN_INVALID_PARAMETER  The information can not be retrieved from the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+LzmaParallelGuidedSectionGetInfo (
+  IN  CONST VOID  *InputSection,
+  OUT UINT32      *OutputBufferSize,
+  OUT UINT32      *ScratchBufferSize,
+  OUT UINT16      *SectionAttribute
+  )
+{
+  RETURN_STATUS               Status;
+  CONST LZMA_PARALLEL_HEADER  *Header;
+  UINTN                       DataSize;
+
+  ASSERT (InputSection != NULL);
+  ASSERT (OutputBufferSize != NULL);
+  ASSERT (ScratchBufferSize != NULL);
+  ASSERT (SectionAttribute != NULL);
+
+  Status = LzmaParallelGetSectionData (InputSection, &Header, &DataSize, SectionAttribute);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  *OutputBufferSize  = Header->DecodedSize;
+  *ScratchBufferSize = (UINT32) (ALIGN_VALUE (Header->ChunkCount * sizeof (UINT32), sizeof (UINT64)) +
+                                  Header->ChunkCount * SCRATCH_BUFFER_REQUEST_SIZE);
+  return RETURN_SUCCESS;
+}
+
+/**
+  Decompress an LZMA parallel GUIDed section into a caller allocated output buffer.
+
+  The chunk table is checked against the section size and the chunk headers
+  before any chunk is decoded, then the chunks are decoded by
+  LzmaParallelDecodeChunks().
+
+  If InputSection is NULL, then ASSERT().
+  If OutputBuffer is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+  If AuthenticationStatus is NULL, then ASSERT().
+
+  @param[in]  InputSection  A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] OutputBuffer  A pointer to a buffer that contains the result of a decode operation.
+  @param[out] ScratchBuffer A caller allocated buffer that may be required by this function
+                            as a scratch buffer to perform the decode operation.
+  @param[out] AuthenticationStatus
+                            A pointer to the authentication status of the decoded output buffer.
+                            See the definition of authentication status in the EFI_PEI_GUIDED_SECTION_EXTRACTION_PPI
+                            section of the PI Specification. EFI_AUTH_STATUS_PLATFORM_OVERRIDE must
+                            never be set by this handler.
+
+  @retval  RETURN_SUCCESS            The buffer specified by InputSection was decoded.
+  @retval  RETURN_INVALID_PARAMETER  The section specified by InputSection can not be decoded.
+
+**/
+RETURN_STATUS
+EFIAPI
+LzmaParallelGuidedSectionExtraction (
+  IN CONST  VOID    *InputSection,
+  OUT       VOID    **OutputBuffer,
+  OUT       VOID    *ScratchBuffer,        OPTIONAL
+  OUT       UINT32  *AuthenticationStatus
+  )
+{
+  RETURN_STATUS               Status;
+  CONST LZMA_PARALLEL_HEADER  *Header;
+  UINTN                       DataSize;
+  UINT16                      SectionAttribute;
+  LZMA_PARALLEL_CONTEXT       Context;
+  UINTN                       Offset;
+  UINT32                      Index;
+  UINT32                      ChunkDecodedSize;
+  UINT32                      ExpectedSize;
+  UINT32                      ScratchSize;
+
+  ASSERT (OutputBuffer != NULL);
+  ASSERT (InputSection != NULL);
+  ASSERT (ScratchBuffer != NULL);
+
+  Status = LzmaParallelGetSectionData (InputSection, &Header, &DataSize, &SectionAttribute);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Authentication is set to Zero, which may be ignored.
+  //
+  *AuthenticationStatus = 0;
+
+  Context.Data         = (CONST UINT8 *) Header;
+  Context.ChunkSizes   = (CONST UINT32 *) (Header + 1);
+  Context.ChunkOffsets = (UINT32 *) ScratchBuffer;
+  Context.ChunkCount   = Header->ChunkCount;
+  Context.ChunkSize    = Header->ChunkSize;
+  Context.Destination  = (UINT8 *) *OutputBuffer;
+  Context.Scratch      = (UINT8 *) ScratchBuffer + ALIGN_VALUE (Header->ChunkCount * sizeof (UINT32), sizeof (UINT64));
+  Context.NextChunk    = 0;
+  Context.FailedChunks = 0;
+
+  //
+  // Every chunk must lie within the section and decode to exactly its part of
+  // the output buffer, so that the chunks can not overlap when they are
+  // decoded concurrently.
+  //
+  Offset = sizeof (LZMA_PARALLEL_HEADER) + Header->ChunkCount * sizeof (UINT32);
+  for (Index = 0; Index < Header->ChunkCount; Index++) {
+    if (Context.ChunkSizes[Index] < LZMA_HEADER_SIZE || Context.ChunkSizes[Index] > DataSize - Offset) {
+      return RETURN_INVALID_PARAMETER;
+    }
+
+    LzmaUefiDecompressGetInfo (
+      Context.Data + Offset,
+      Context.ChunkSizes[Index],
+      &ChunkDecodedSize,
+      &ScratchSize
+      );
+    ExpectedSize = MIN (Header->ChunkSize, Header->DecodedSize - Index * Header->ChunkSize);
+    if (ChunkDecodedSize != ExpectedSize) {
+      return RETURN_INVALID_PARAMETER;
+    }
+
+    Context.ChunkOffsets[Index] = (UINT32) Offset;
+    Offset += Context.ChunkSizes[Index];
+  }
+
+  return LzmaParallelDecodeChunks (&Context);
+}
+
+/**
+  Decode one chunk of an LZMA parallel GUIDed section.
+
+  This function may run on any processor.
+
+  @param[in, out] Context   The state of the section being decoded.
+  @param[in]      Index     The index of the chunk to decode.
+
+  @retval  RETURN_SUCCESS            The chunk was decoded.
+  @retval  RETURN_INVALID_PARAMETER  The chunk is corrupted.
+
+**/
+RETURN_STATUS
+LzmaParallelDecodeChunk (
+  IN OUT LZMA_PARALLEL_CONTEXT  *Context,
+  IN     UINT32                 Index
+  )
+{
+  return LzmaUefiDecompress (
+           Context->Data + Context->ChunkOffsets[Index],
+           Context->ChunkSizes[Index],
+           Context->Destination + (UINTN) Index * Context->ChunkSize,
+           Context->Scratch + (UINTN) Index * SCRATCH_BUFFER_REQUEST_SIZE
+           );
+}
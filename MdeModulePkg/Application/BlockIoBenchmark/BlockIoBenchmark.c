@@ -0,0 +1,411 @@
+/** @file
+  Shell application that measures the read throughput of the block devices. For
+  every block device with a media, it reads the beginning of the media with the
+  blocking Block I/O Protocol, then with the Block I/O 2 Protocol with several
+  requests in flight, and prints the throughput of each run.
+
+  The media is only read, never written.
+
+  Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Uefi.h>
+#include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
+#include <Protocol/DevicePath.h>
+#include <Library/BaseLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/TimerLib.h>
+
+//
+// The number of bytes read by every run, if the media is large enough
+//
+#define BLOCK_IO_BENCHMARK_SIZE  SIZE_64MB
+
+//
+// The sizes of the read requests measured
+//
+UINTN  mBlockIoBenchmarkRequestSize[] = { SIZE_128KB, SIZE_1MB };
+
+//
+// The numbers of Block I/O 2 requests in flight measured
+//
+UINTN  mBlockIoBenchmarkDepth[] = { 1, 8, 32 };
+
+/**
+  Get the time elapsed between two values of the performance counter.
+
+  @param[in] Begin          The performance counter value at the beginning.
+  @param[in] End            The performance counter value at the end.
+
+  @return The elapsed time in nanoseconds.
+
+**/
+UINT64
+GetElapsedTime (
+  IN UINT64  Begin,
+  IN UINT64  End
+  )
+{
+  UINT64  StartValue;
+  UINT64  EndValue;
+  UINT64  Ticks;
+
+  GetPerformanceCounterProperties (&StartValue, &EndValue);
+  if (StartValue > EndValue) {
+    //
+    // The performance counter counts down
+    //
+    if (End <= Begin) {
+      Ticks = Begin - End;
+    } else {
+      Ticks = (Begin - EndValue) + (StartValue - End);
+    }
+  } else {
+    if (End >= Begin) {
+      Ticks = End - Begin;
+    } else {
+      Ticks = (EndValue - Begin) + (End - StartValue);
+    }
+  }
+
+  return GetTimeInNanoSecond (Ticks);
+}
+
+/**
+  Print the throughput of a run.
+
+  @param[in] Protocol       The name of the protocol measured.
+  @param[in] RequestSize    The size of the read requests in bytes.
+  @param[in] Depth          The number of requests in flight.
+  @param[in] Size           The number of bytes read.
+  @param[in] Time           The time of the run in nanoseconds.
+  @param[in] Status         The status of the run.
+
+**/
+VOID
+PrintThroughput (
+  IN CHAR16      *Protocol,
+  IN UINTN       RequestSize,
+  IN UINTN       Depth,
+  IN UINT64      Size,
+  IN UINT64      Time,
+  IN EFI_STATUS  Status
+  )
+{
+  if (EFI_ERROR (Status)) {
+    Print (L"  %-9s %5d KB x %2d: failed - %r\n", Protocol, (UINT32) (RequestSize / SIZE_1KB), (UINT32) Depth, Status);
+    return;
+  }
+
+  //
+  // Bytes per microsecond are MB/s
+  //
+  Print (
+    L"  %-9s %5d KB x %2d: %6ld MB/s\n",
+    Protocol,
+    (UINT32) (RequestSize / SIZE_1KB),
+    (UINT32) Depth,
+    DivU64x64Remainder (MultU64x32 (Size, 1000), MAX (Time, 1), NULL)
+    );
+}
+
+/**
+  Read the beginning of a media with the Block I/O Protocol.
+
+  @param[in] BlockIo        The Block I/O Protocol of the device.
+  @param[in] Buffer         The buffer of a read request.
+  @param[in] RequestSize    The size of the read requests in bytes.
+  @param[in] Size           The number of bytes to read.
+  @param[out] Time          The time of the run in nanoseconds.
+
+  @retval EFI_SUCCESS       The media was read.
+  @retval other             A read request failed.
+
+**/
+EFI_STATUS
+RunBlockIoBenchmark (
+  IN  EFI_BLOCK_IO_PROTOCOL  *BlockIo,
+  IN  VOID                   *Buffer,
+  IN  UINTN                  RequestSize,
+  IN  UINT64                 Size,
+  OUT UINT64                 *Time
+  )
+{
+  EFI_STATUS  Status;
+  UINT64      Offset;
+  UINT64      Begin;
+
+  Begin = GetPerformanceCounter ();
+  for (Offset = 0; Offset < Size; Offset += RequestSize) {
+    Status = BlockIo->ReadBlocks (
+                        BlockIo,
+                        BlockIo->Media->MediaId,
+                        DivU64x32 (Offset, BlockIo->Media->BlockSize),
+                        RequestSize,
+                        Buffer
+                        );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+  *Time = GetElapsedTime (Begin, GetPerformanceCounter ());
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Read the beginning of a media with the Block I/O 2 Protocol, with a number
+  of requests in flight.
+
+  Every request has its own buffer and token. The token events are polled, and
+  a new request is sent as soon as one completes.
+
+  @param[in] BlockIo2       The Block I/O 2 Protocol of the device.
+  @param[in] Buffer         The buffers of the read requests, one after the other.
+  @param[in] RequestSize    The size of the read requests in bytes.
+  @param[in] Depth          The number of requests in flight.
+  @param[in] Size           The number of bytes to read.
+  @param[out] Time          The time of the run in nanoseconds.
+
+  @retval EFI_SUCCESS           The media was read.
+  @retval EFI_OUT_OF_RESOURCES  The token events could not be created.
+  @retval other                 A read request failed.
+
+**/
+EFI_STATUS
+RunBlockIo2Benchmark (
+  IN  EFI_BLOCK_IO2_PROTOCOL  *BlockIo2,
+  IN  UINT8                   *Buffer,
+  IN  UINTN                   RequestSize,
+  IN  UINTN                   Depth,
+  IN  UINT64                  Size,
+  OUT UINT64                  *Time
+  )
+{
+  EFI_STATUS           Status;
+  EFI_BLOCK_IO2_TOKEN  *Tokens;
+  BOOLEAN              *InFlight;
+  UINTN                Index;
+  UINTN                Created;
+  UINTN                Pending;
+  UINT64               Offset;
+  UINT64               Begin;
+
+  Tokens   = AllocateZeroPool (Depth * sizeof (EFI_BLOCK_IO2_TOKEN));
+  InFlight = AllocateZeroPool (Depth * sizeof (BOOLEAN));
+  if ((Tokens == NULL) || (InFlight == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    Created = 0;
+    goto Done;
+  }
+
+  Status = EFI_SUCCESS;
+  for (Created = 0; Created < Depth; Created++) {
+    Status = gBS->CreateEvent (0, 0, NULL, NULL, &Tokens[Created].Event);
+    if (EFI_ERROR (Status)) {
+      goto Done;
+    }
+  }
+
+  Offset  = 0;
+  Pending = 0;
+  Begin   = GetPerformanceCounter ();
+  do {
+    for (Index = 0; Index < Depth; Index++) {
+      if (InFlight[Index]) {
+        if (gBS->CheckEvent (Tokens[Index].Event) != EFI_SUCCESS) {
+          continue;
+        }
+        InFlight[Index] = FALSE;
+        Pending--;
+        if (EFI_ERROR (Tokens[Index].TransactionStatus)) {
+          Status = Tokens[Index].TransactionStatus;
+        }
+      }
+
+      //
+      // Send the next request in the free slot, unless a request failed
+      //
+      if ((Offset < Size) && !EFI_ERROR (Status)) {
+        Tokens[Index].TransactionStatus = EFI_SUCCESS;
+        Status = BlockIo2->ReadBlocksEx (
+                             BlockIo2,
+                             BlockIo2->Media->MediaId,
+                             DivU64x32 (Offset, BlockIo2->Media->BlockSize),
+                             &Tokens[Index],
+                             RequestSize,
+                             Buffer + Index * RequestSize
+                             );
+        if (!EFI_ERROR (Status)) {
+          InFlight[Index] = TRUE;
+          Pending++;
+          Offset += RequestSize;
+        }
+      }
+    }
+  } while (Pending > 0);
+  *Time = GetElapsedTime (Begin, GetPerformanceCounter ());
+
+Done:
+  for (Index = 0; Index < Created; Index++) {
+    gBS->CloseEvent (Tokens[Index].Event);
+  }
+  if (Tokens != NULL) {
+    FreePool (Tokens);
+  }
+  if (InFlight != NULL) {
+    FreePool (InFlight);
+  }
+
+  return Status;
+}
+
+/**
+  Measure the read throughput of a block device.
+
+  @param[in] Handle         The handle of the block device.
+  @param[in] BlockIo        The Block I/O Protocol of the device.
+
+**/
+VOID
+BenchmarkBlockDevice (
+  IN EFI_HANDLE             Handle,
+  IN EFI_BLOCK_IO_PROTOCOL  *BlockIo
+  )
+{
+  EFI_STATUS              Status;
+  EFI_BLOCK_IO2_PROTOCOL  *BlockIo2;
+  EFI_BLOCK_IO_MEDIA      *Media;
+  CHAR16                  *DevicePathText;
+  UINT64                  MediaSize;
+  UINT64                  Size;
+  UINTN                   RequestSize;
+  UINTN                   Depth;
+  UINTN                   SizeIndex;
+  UINTN                   DepthIndex;
+  UINTN                   Pages;
+  VOID                    *Buffer;
+  UINT64                  Time;
+
+  Media = BlockIo->Media;
+
+  DevicePathText = ConvertDevicePathToText (DevicePathFromHandle (Handle), FALSE, FALSE);
+  Print (L"%s\n", (DevicePathText != NULL) ? DevicePathText : L"(no device path)");
+  if (DevicePathText != NULL) {
+    FreePool (DevicePathText);
+  }
+  Print (L"  block size %d, last block 0x%lx\n", Media->BlockSize, Media->LastBlock);
+
+  Status = gBS->HandleProtocol (Handle, &gEfiBlockIo2ProtocolGuid, (VOID **) &BlockIo2);
+  if (EFI_ERROR (Status)) {
+    BlockIo2 = NULL;
+    Print (L"  no Block I/O 2 Protocol\n");
+  }
+
+  MediaSize = MultU64x32 (Media->LastBlock + 1, Media->BlockSize);
+
+  for (SizeIndex = 0; SizeIndex < sizeof (mBlockIoBenchmarkRequestSize) / sizeof (mBlockIoBenchmarkRequestSize[0]); SizeIndex++) {
+    RequestSize = mBlockIoBenchmarkRequestSize[SizeIndex];
+    if ((RequestSize % Media->BlockSize) != 0) {
+      continue;
+    }
+
+    //
+    // Every run reads the same whole requests from the beginning of the media
+    //
+    Size = MIN (MediaSize, BLOCK_IO_BENCHMARK_SIZE);
+    Size = Size - ModU64x32 (Size, (UINT32) RequestSize);
+    if (Size == 0) {
+      continue;
+    }
+
+    //
+    // The buffers are allocated in pages, which satisfies the alignment of
+    // every device known.
+    //
+    Pages  = EFI_SIZE_TO_PAGES (RequestSize * mBlockIoBenchmarkDepth[sizeof (mBlockIoBenchmarkDepth) / sizeof (mBlockIoBenchmarkDepth[0]) - 1]);
+    Buffer = AllocatePages (Pages);
+    if (Buffer == NULL) {
+      Print (L"  %5d KB: not enough memory for the buffers\n", (UINT32) (RequestSize / SIZE_1KB));
+      continue;
+    }
+
+    Status = RunBlockIoBenchmark (BlockIo, Buffer, RequestSize, Size, &Time);
+    PrintThroughput (L"BlockIo", RequestSize, 1, Size, Time, Status);
+
+    if (BlockIo2 != NULL) {
+      for (DepthIndex = 0; DepthIndex < sizeof (mBlockIoBenchmarkDepth) / sizeof (mBlockIoBenchmarkDepth[0]); DepthIndex++) {
+        Depth  = mBlockIoBenchmarkDepth[DepthIndex];
+        Status = RunBlockIo2Benchmark (BlockIo2, Buffer, RequestSize, Depth, Size, &Time);
+        PrintThroughput (L"BlockIo2", RequestSize, Depth, Size, Time, Status);
+      }
+    }
+
+    FreePages (Buffer, Pages);
+  }
+}
+
+/**
+  The user Entry Point for Application. The user code starts with this function
+  as the real entry point for the application.
+
+  @param[in] ImageHandle    The firmware allocated handle for the EFI image.
+  @param[in] SystemTable    A pointer to the EFI System Table.
+
+  @retval EFI_SUCCESS       The entry point is executed successfully.
+  @retval other             Some error occurs when executing this entry point.
+
+**/
+EFI_STATUS
+EFIAPI
+UefiMain (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS             Status;
+  EFI_HANDLE             *Handles;
+  UINTN                  HandleCount;
+  UINTN                  Index;
+  EFI_BLOCK_IO_PROTOCOL  *BlockIo;
+
+  Print (L"Block I/O read benchmark\n");
+
+  Status = gBS->LocateHandleBuffer (ByProtocol, &gEfiBlockIoProtocolGuid, NULL, &HandleCount, &Handles);
+  if (EFI_ERROR (Status)) {
+    Print (L"No block device found\n");
+    return Status;
+  }
+
+  for (Index = 0; Index < HandleCount; Index++) {
+    Status = gBS->HandleProtocol (Handles[Index], &gEfiBlockIoProtocolGuid, (VOID **) &BlockIo);
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    //
+    // The partitions are measured with their disk
+    //
+    if (BlockIo->Media->LogicalPartition || !BlockIo->Media->MediaPresent) {
+      continue;
+    }
+
+    BenchmarkBlockDevice (Handles[Index], BlockIo);
+  }
+
+  FreePool (Handles);
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,212 @@
+/** @file
+  Shell application that measures the cost of the timer services. For several
+  numbers of timer events, it arms, re-arms and cancels every timer and prints
+  the average cost of each operation.
+
+  Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+
+//
+// The timers are armed between 10 and 20 seconds in the future, in 100ns units,
+// so that none of them expires while the benchmark runs.
+//
+#define TIMER_BENCHMARK_BASE_DELAY    100000000
+#define TIMER_BENCHMARK_DELAY_SPREAD  100000000
+
+//
+// The numbers of timer events measured
+//
+UINTN  mTimerBenchmarkCount[] = { 16, 128, 1024, 4096 };
+
+/**
+  Get the time elapsed between two values of the performance counter.
+
+  @param[in] Begin          The performance counter value at the beginning.
+  @param[in] End            The performance counter value at the end.
+
+  @return The elapsed time in nanoseconds.
+
+**/
+UINT64
+GetElapsedTime (
+  IN UINT64  Begin,
+  IN UINT64  End
+  )
+{
+  UINT64  StartValue;
+  UINT64  EndValue;
+  UINT64  Ticks;
+
+  GetPerformanceCounterProperties (&StartValue, &EndValue);
+  if (StartValue > EndValue) {
+    //
+    // The performance counter counts down
+    //
+    if (End <= Begin) {
+      Ticks = Begin - End;
+    } else {
+      Ticks = (Begin - EndValue) + (StartValue - End);
+    }
+  } else {
+    if (End >= Begin) {
+      Ticks = End - Begin;
+    } else {
+      Ticks = (EndValue - Begin) + (End - StartValue);
+    }
+  }
+
+  return GetTimeInNanoSecond (Ticks);
+}
+
+/**
+  Get the next trigger time of the benchmark, spread over the benchmark delay
+  range like the timers of independent drivers.
+
+  @param[in, out] Seed      The state of the pseudo random generator.
+
+  @return The trigger time in 100ns units.
+
+**/
+UINT64
+GetNextTriggerTime (
+  IN OUT UINT32  *Seed
+  )
+{
+  *Seed = *Seed * 1103515245 + 12345;
+  return TIMER_BENCHMARK_BASE_DELAY + (*Seed >> 8) % TIMER_BENCHMARK_DELAY_SPREAD;
+}
+
+/**
+  Measure the cost of arming, re-arming and cancelling a number of timers.
+
+  @param[in] Count          The number of timer events.
+
+  @retval EFI_SUCCESS           The timers were measured.
+  @retval EFI_OUT_OF_RESOURCES  The timer events could not be created.
+
+**/
+EFI_STATUS
+RunTimerBenchmark (
+  IN UINTN  Count
+  )
+{
+  EFI_STATUS  Status;
+  EFI_EVENT   *Events;
+  UINTN       Index;
+  UINTN       Created;
+  UINT32      Seed;
+  UINT64      Begin;
+  UINT64      ArmTime;
+  UINT64      RearmTime;
+  UINT64      CancelTime;
+
+  Events = AllocateZeroPool (Count * sizeof (EFI_EVENT));
+  if (Events == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = EFI_SUCCESS;
+  for (Created = 0; Created < Count; Created++) {
+    Status = gBS->CreateEvent (EVT_TIMER, 0, NULL, NULL, &Events[Created]);
+    if (EFI_ERROR (Status)) {
+      goto Done;
+    }
+  }
+
+  //
+  // Arm every timer once
+  //
+  Seed  = 1;
+  Begin = GetPerformanceCounter ();
+  for (Index = 0; Index < Count; Index++) {
+    gBS->SetTimer (Events[Index], TimerRelative, GetNextTriggerTime (&Seed));
+  }
+  ArmTime = GetElapsedTime (Begin, GetPerformanceCounter ());
+
+  //
+  // Re-arm every timer as a periodic timer, which first removes it from the
+  // timer queue
+  //
+  Begin = GetPerformanceCounter ();
+  for (Index = 0; Index < Count; Index++) {
+    gBS->SetTimer (Events[Index], TimerPeriodic, GetNextTriggerTime (&Seed));
+  }
+  RearmTime = GetElapsedTime (Begin, GetPerformanceCounter ());
+
+  //
+  // Cancel every timer
+  //
+  Begin = GetPerformanceCounter ();
+  for (Index = 0; Index < Count; Index++) {
+    gBS->SetTimer (Events[Index], TimerCancel, 0);
+  }
+  CancelTime = GetElapsedTime (Begin, GetPerformanceCounter ());
+
+  Print (
+    L"%5d timers: arm %6ld ns/op, re-arm %6ld ns/op, cancel %6ld ns/op\n",
+    (UINT32) Count,
+    DivU64x32 (ArmTime, (UINT32) Count),
+    DivU64x32 (RearmTime, (UINT32) Count),
+    DivU64x32 (CancelTime, (UINT32) Count)
+    );
+
+Done:
+  for (Index = 0; Index < Created; Index++) {
+    gBS->CloseEvent (Events[Index]);
+  }
+  FreePool (Events);
+
+  if (EFI_ERROR (Status)) {
+    Print (L"%5d timers: failed to create the timer events - %r\n", (UINT32) Count, Status);
+  }
+  return Status;
+}
+
+/**
+  The user Entry Point for Application. The user code starts with this function
+  as the real entry point for the application.
+
+  @param[in] ImageHandle    The firmware allocated handle for the EFI image.
+  @param[in] SystemTable    A pointer to the EFI System Table.
+
+  @retval EFI_SUCCESS       The entry point is executed successfully.
+  @retval other             Some error occurs when executing this entry point.
+
+**/
+EFI_STATUS
+EFIAPI
+UefiMain (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+
+  Print (L"Timer service benchmark\n");
+
+  for (Index = 0; Index < sizeof (mTimerBenchmarkCount) / sizeof (mTimerBenchmarkCount[0]); Index++) {
+    Status = RunTimerBenchmark (mTimerBenchmarkCount[Index]);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
@@ -528,6 +528,7 @@ AhciBuildCommand (
   UINTN      MemAddr;
   DATA_64    Data64;
   UINT32     Offset;
+  EFI_AHCI_COMMAND_LIST      *PortCmdList;
 
   //
   // Filling the PRDT
@@ -594,16 +595,17 @@ AhciBuildCommand (
     AhciRegisters->AhciCommandTable->PrdtTable[PrdtNumber - 1].AhciPrdtIoc = 1;
   }
 
+  PortCmdList = AhciRegisters->AhciCmdList + (UINTN) Port * EFI_AHCI_MAX_COMMAND_SLOTS;
   CopyMem (
-    (VOID *) ((UINTN) AhciRegisters->AhciCmdList + (UINTN) CommandSlotNumber * sizeof (EFI_AHCI_COMMAND_LIST)),
+    &PortCmdList[CommandSlotNumber],
     CommandList,
     sizeof (EFI_AHCI_COMMAND_LIST)
     );
 
   Data64.Uint64 = (UINT64)(UINTN) AhciRegisters->AhciCommandTablePciAddr;
-  AhciRegisters->AhciCmdList[CommandSlotNumber].AhciCmdCtba  = Data64.Uint32.Lower32;
-  AhciRegisters->AhciCmdList[CommandSlotNumber].AhciCmdCtbau = Data64.Uint32.Upper32;
-  AhciRegisters->AhciCmdList[CommandSlotNumber].AhciCmdPmp   = PortMultiplier;
+  PortCmdList[CommandSlotNumber].AhciCmdCtba  = Data64.Uint32.Lower32;
+  PortCmdList[CommandSlotNumber].AhciCmdCtbau = Data64.Uint32.Upper32;
+  PortCmdList[CommandSlotNumber].AhciCmdPmp   = PortMultiplier;
 
 }
 
@@ -813,7 +815,7 @@ AhciPioTransfer (
           break;
         }
 
-        PrdCount = *(volatile UINT32 *) (&(AhciRegisters->AhciCmdList[0].AhciCmdPrdbc));
+        PrdCount = *(volatile UINT32 *) (&(AhciRegisters->AhciCmdList[Port * EFI_AHCI_MAX_COMMAND_SLOTS].AhciCmdPrdbc));
         if (PrdCount == DataCount) {
           Status = EFI_SUCCESS;
           break;
@@ -1255,28 +1257,25 @@ AhciStopCommand (
 }
 
 /**
-  Start command for give slot on specific port.
+  Start the DMA engine of the port, so commands can be issued to its slots.
 
   @param  PciIo              The PCI IO protocol instance.
   @param  Port               The number of port.
-  @param  CommandSlot        The number of Command Slot.
   @param  Timeout            The timeout value of start, uses 100ns as a unit.
 
-  @retval EFI_DEVICE_ERROR   The command start unsuccessfully.
+  @retval EFI_DEVICE_ERROR   The port start unsuccessfully.
   @retval EFI_TIMEOUT        The operation is time out.
-  @retval EFI_SUCCESS        The command start successfully.
+  @retval EFI_SUCCESS        The port start successfully.
 
 **/
 EFI_STATUS
 EFIAPI
-AhciStartCommand (
+AhciStartPort (
   IN  EFI_PCI_IO_PROTOCOL       *PciIo,
   IN  UINT8                     Port,
-  IN  UINT8                     CommandSlot,
   IN  UINT64                    Timeout
   )
 {
-  UINT32     CmdSlotBit;
   EFI_STATUS Status;
   UINT32     PortStatus;
   UINT32     StartCmd;
@@ -1289,8 +1288,6 @@ AhciStartCommand (
   //
   Capability = AhciReadReg(PciIo, EFI_AHCI_CAPABILITY_OFFSET);
 
-  CmdSlotBit = (UINT32) (1 << CommandSlot);
-
   AhciClearPortStatus (
     PciIo,
     Port
@@ -1337,6 +1334,42 @@ AhciStartCommand (
   Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CMD;
   AhciOrReg (PciIo, Offset, EFI_AHCI_PORT_CMD_ST | StartCmd);
 
+  return EFI_SUCCESS;
+}
+
+/**
+  Start command for give slot on specific port.
+
+  @param  PciIo              The PCI IO protocol instance.
+  @param  Port               The number of port.
+  @param  CommandSlot        The number of Command Slot.
+  @param  Timeout            The timeout value of start, uses 100ns as a unit.
+
+  @retval EFI_DEVICE_ERROR   The command start unsuccessfully.
+  @retval EFI_TIMEOUT        The operation is time out.
+  @retval EFI_SUCCESS        The command start successfully.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciStartCommand (
+  IN  EFI_PCI_IO_PROTOCOL       *PciIo,
+  IN  UINT8                     Port,
+  IN  UINT8                     CommandSlot,
+  IN  UINT64                    Timeout
+  )
+{
+  UINT32     CmdSlotBit;
+  EFI_STATUS Status;
+  UINT32     Offset;
+
+  CmdSlotBit = (UINT32) (1 << CommandSlot);
+
+  Status = AhciStartPort (PciIo, Port, Timeout);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
   //
   // Setting the command
   //
@@ -2055,10 +2088,11 @@ AhciCreateTransferDescriptor (
 
   //
   // Allocate memory for command list
-  // Note that the implemenation is a single task model which only use a command list for all ports.
+  // Every port has its own command list of 32 entries, as a port using native
+  // command queuing keeps several commands in its list.
   //
   Buffer = NULL;
-  MaxCommandListSize = MaxCommandSlotNumber * sizeof (EFI_AHCI_COMMAND_LIST);
+  MaxCommandListSize = MaxPortNumber * EFI_AHCI_MAX_COMMAND_SLOTS * sizeof (EFI_AHCI_COMMAND_LIST);
   Status = PciIo->AllocateBuffer (
                     PciIo,
                     AllocateAnyPages,
@@ -2305,7 +2339,7 @@ AhciModeInitialization (
       Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_FBU;
       AhciWriteReg (PciIo, Offset, Data64.Uint32.Upper32);
 
-      Data64.Uint64 = (UINTN) (AhciRegisters->AhciCmdListPciAddr);
+      Data64.Uint64 = (UINTN) (AhciRegisters->AhciCmdListPciAddr) + sizeof (EFI_AHCI_COMMAND_LIST) * EFI_AHCI_MAX_COMMAND_SLOTS * Port;
       Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CLB;
       AhciWriteReg (PciIo, Offset, Data64.Uint32.Lower32);
       Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CLBU;
@@ -2513,6 +2547,16 @@ AhciModeInitialization (
       CreateNewDeviceInfo (Instance, Port, 0, DeviceType, &Buffer);
       if (DeviceType == EfiIdeHarddisk) {
         REPORT_STATUS_CODE (EFI_PROGRESS_CODE, (EFI_PERIPHERAL_FIXED_MEDIA | EFI_P_PC_ENABLE));
+
+        //
+        // Use native command queuing if both the HBA and the device support it.
+        // Word 76 bit 8 of the identify data tells the device supports it, and word 75
+        // gives its queue depth minus one.
+        //
+        if (((Capability & EFI_AHCI_CAP_SNCQ) != 0) &&
+            ((Buffer.AtaData.serial_ata_capabilities & BIT8) != 0)) {
+          AhciNcqInitPort (Instance, Port, (Buffer.AtaData.queue_depth & 0x1F) + 1);
+        }
       }
     }
   }
@@ -2520,3 +2564,615 @@ AhciModeInitialization (
   return EFI_SUCCESS;
 }
 
+
+/**
+  Allocate the command tables used by the queued commands of a port, and record
+  the port as using native command queuing.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+  @param[in]  QueueDepth        The number of commands the device can queue.
+
+  @retval EFI_SUCCESS           The port uses native command queuing.
+  @retval EFI_UNSUPPORTED       The HBA or the device can't queue several commands.
+  @retval EFI_OUT_OF_RESOURCES  The command tables can't be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciNcqInitPort (
+  IN  ATA_ATAPI_PASS_THRU_INSTANCE    *Instance,
+  IN  UINT8                           Port,
+  IN  UINT32                          QueueDepth
+  )
+{
+  EFI_STATUS            Status;
+  EFI_PCI_IO_PROTOCOL   *PciIo;
+  EFI_AHCI_NCQ_PORT     *NcqPort;
+  UINT32                Capability;
+  UINT32                SlotCount;
+  UINTN                 TableSize;
+  UINTN                 Bytes;
+  VOID                  *Buffer;
+  EFI_PHYSICAL_ADDRESS  CommandTablePciAddr;
+
+  PciIo      = Instance->PciIo;
+  Capability = AhciReadReg (PciIo, EFI_AHCI_CAPABILITY_OFFSET);
+
+  //
+  // The depth of the queue is limited by the number of command slots of the HBA.
+  //
+  SlotCount = MIN (QueueDepth, ((Capability & 0x1F00) >> 8) + 1);
+  if (SlotCount < 2) {
+    return EFI_UNSUPPORTED;
+  }
+
+  NcqPort = AllocateZeroPool (sizeof (EFI_AHCI_NCQ_PORT));
+  if (NcqPort == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Buffer    = NULL;
+  TableSize = SlotCount * sizeof (EFI_AHCI_NCQ_COMMAND_TABLE);
+  Status = PciIo->AllocateBuffer (
+                    PciIo,
+                    AllocateAnyPages,
+                    EfiBootServicesData,
+                    EFI_SIZE_TO_PAGES (TableSize),
+                    &Buffer,
+                    0
+                    );
+  if (EFI_ERROR (Status)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Error3;
+  }
+
+  ZeroMem (Buffer, TableSize);
+  Bytes  = TableSize;
+  Status = PciIo->Map (
+                    PciIo,
+                    EfiPciIoOperationBusMasterCommonBuffer,
+                    Buffer,
+                    &Bytes,
+                    &CommandTablePciAddr,
+                    &NcqPort->MapCommandTable
+                    );
+  if (EFI_ERROR (Status) || (Bytes != TableSize)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Error2;
+  }
+
+  if (((Capability & EFI_AHCI_CAP_S64A) == 0) && (CommandTablePciAddr > 0x100000000ULL)) {
+    //
+    // The AHCI HBA doesn't support 64bit addressing, so should not get a >4G pci bus master address.
+    //
+    Status = EFI_DEVICE_ERROR;
+    goto Error1;
+  }
+
+  NcqPort->CommandTable        = Buffer;
+  NcqPort->CommandTablePciAddr = (EFI_AHCI_NCQ_COMMAND_TABLE *)(UINTN)CommandTablePciAddr;
+  NcqPort->SlotCount           = SlotCount;
+  Instance->NcqPort[Port]      = NcqPort;
+
+  DEBUG ((EFI_D_INFO, "port [%d] uses native command queuing with %d slots\n", Port, SlotCount));
+  return EFI_SUCCESS;
+
+Error1:
+  PciIo->Unmap (PciIo, NcqPort->MapCommandTable);
+Error2:
+  PciIo->FreeBuffer (PciIo, EFI_SIZE_TO_PAGES (TableSize), Buffer);
+Error3:
+  FreePool (NcqPort);
+  return Status;
+}
+
+/**
+  Stop the queued commands of a port, and free the command tables of the port.
+
+  The tasks of the stopped commands are left in the task list.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+
+**/
+VOID
+EFIAPI
+AhciNcqFreePort (
+  IN  ATA_ATAPI_PASS_THRU_INSTANCE    *Instance,
+  IN  UINT8                           Port
+  )
+{
+  EFI_PCI_IO_PROTOCOL   *PciIo;
+  EFI_AHCI_NCQ_PORT     *NcqPort;
+  UINT32                Slot;
+
+  PciIo   = Instance->PciIo;
+  NcqPort = Instance->NcqPort[Port];
+  if (NcqPort == NULL) {
+    return;
+  }
+
+  if ((NcqPort->ActiveSlots != 0) || NcqPort->Recovering) {
+    AhciStopCommand (PciIo, Port, ATA_ATAPI_TIMEOUT);
+    AhciDisableFisReceive (PciIo, Port, ATA_ATAPI_TIMEOUT);
+
+    for (Slot = 0; Slot < NcqPort->SlotCount; Slot++) {
+      if ((NcqPort->ActiveSlots & (BIT0 << Slot)) != 0) {
+        PciIo->Unmap (PciIo, NcqPort->SlotTask[Slot]->Map);
+      }
+    }
+
+    if (NcqPort->Recovering) {
+      PciIo->Unmap (PciIo, NcqPort->MapErrorLog);
+    }
+  }
+
+  PciIo->Unmap (PciIo, NcqPort->MapCommandTable);
+  PciIo->FreeBuffer (
+           PciIo,
+           EFI_SIZE_TO_PAGES (NcqPort->SlotCount * sizeof (EFI_AHCI_NCQ_COMMAND_TABLE)),
+           NcqPort->CommandTable
+           );
+  FreePool (NcqPort);
+  Instance->NcqPort[Port] = NULL;
+}
+
+/**
+  Issue a READ/WRITE FPDMA QUEUED command in a free slot of its port.
+
+  The function returns as soon as the command is issued. Its completion is found
+  by AhciNcqCheckCompletion().
+
+  @param[in]       Instance     A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in, out]  Task         Pointer to the ATA_NONBLOCK_TASK of the command.
+
+  @retval EFI_SUCCESS           The command is issued.
+  @retval EFI_NOT_READY         All the slots of the port are in use, or the port
+                                is being recovered.
+  @retval EFI_UNSUPPORTED       The port doesn't use native command queuing.
+  @retval EFI_BAD_BUFFER_SIZE   The data buffer can't be mapped or is too big.
+  @retval EFI_DEVICE_ERROR      The port can't be started.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciNcqTransfer (
+  IN     ATA_ATAPI_PASS_THRU_INSTANCE *Instance,
+  IN OUT ATA_NONBLOCK_TASK            *Task
+  )
+{
+  EFI_STATUS                        Status;
+  EFI_PCI_IO_PROTOCOL               *PciIo;
+  EFI_AHCI_NCQ_PORT                 *NcqPort;
+  EFI_ATA_PASS_THRU_COMMAND_PACKET  *Packet;
+  EFI_AHCI_NCQ_COMMAND_TABLE        *CommandTable;
+  EFI_AHCI_COMMAND_LIST             *CommandList;
+  EFI_PCI_IO_PROTOCOL_OPERATION     Flag;
+  EFI_PHYSICAL_ADDRESS              PhyAddr;
+  VOID                              *Buffer;
+  UINT32                            DataCount;
+  UINTN                             MapLength;
+  BOOLEAN                           Read;
+  UINT8                             Port;
+  UINT32                            Slot;
+  UINT32                            SlotBit;
+  UINT32                            PrdtNumber;
+  UINT32                            PrdtIndex;
+  UINT32                            Offset;
+  DATA_64                           Data64;
+
+  PciIo   = Instance->PciIo;
+  Port    = (UINT8) Task->Port;
+  Packet  = Task->Packet;
+  NcqPort = Instance->NcqPort[Port];
+  if (NcqPort == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (NcqPort->Recovering) {
+    return EFI_NOT_READY;
+  }
+
+  //
+  // Look for a free slot.
+  //
+  for (Slot = 0; Slot < NcqPort->SlotCount; Slot++) {
+    if ((NcqPort->ActiveSlots & (BIT0 << Slot)) == 0) {
+      break;
+    }
+  }
+  if (Slot == NcqPort->SlotCount) {
+    return EFI_NOT_READY;
+  }
+  SlotBit = (UINT32) (BIT0 << Slot);
+
+  Read = (BOOLEAN) (Packet->Acb->AtaCommand != ATA_CMD_WRITE_FPDMA_QUEUED);
+  if (Read) {
+    Buffer    = Packet->InDataBuffer;
+    DataCount = Packet->InTransferLength;
+    Flag      = EfiPciIoOperationBusMasterWrite;
+  } else {
+    Buffer    = Packet->OutDataBuffer;
+    DataCount = Packet->OutTransferLength;
+    Flag      = EfiPciIoOperationBusMasterRead;
+  }
+
+  PrdtNumber = (DataCount + EFI_AHCI_MAX_DATA_PER_PRDT - 1) / EFI_AHCI_MAX_DATA_PER_PRDT;
+  if ((PrdtNumber == 0) || (PrdtNumber > EFI_AHCI_NCQ_MAX_PRDT)) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  MapLength = DataCount;
+  Status = PciIo->Map (
+                    PciIo,
+                    Flag,
+                    Buffer,
+                    &MapLength,
+                    &PhyAddr,
+                    &Task->Map
+                    );
+  if (EFI_ERROR (Status)) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+  if (MapLength != DataCount) {
+    PciIo->Unmap (PciIo, Task->Map);
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  //
+  // Build the command table of the slot. The sector count register holds the tag of
+  // the command, and the device register only the bit 6 which must be set.
+  //
+  CommandTable = &NcqPort->CommandTable[Slot];
+  ZeroMem (CommandTable, sizeof (EFI_AHCI_NCQ_COMMAND_TABLE));
+  AhciBuildCommandFis (&CommandTable->CommandFis, Packet->Acb);
+  CommandTable->CommandFis.AhciCFisPmNum       = (UINT8) Task->PortMultiplier;
+  CommandTable->CommandFis.AhciCFisSecCount    = (UINT8) (Slot << 3);
+  CommandTable->CommandFis.AhciCFisSecCountExp = 0;
+  CommandTable->CommandFis.AhciCFisDevHead     = BIT6;
+
+  for (PrdtIndex = 0; PrdtIndex < PrdtNumber; PrdtIndex++) {
+    Data64.Uint64 = PhyAddr + MultU64x32 (PrdtIndex, EFI_AHCI_MAX_DATA_PER_PRDT);
+    CommandTable->PrdtTable[PrdtIndex].AhciPrdtDba  = Data64.Uint32.Lower32;
+    CommandTable->PrdtTable[PrdtIndex].AhciPrdtDbau = Data64.Uint32.Upper32;
+    CommandTable->PrdtTable[PrdtIndex].AhciPrdtDbc  = MIN (DataCount - PrdtIndex * EFI_AHCI_MAX_DATA_PER_PRDT, EFI_AHCI_MAX_DATA_PER_PRDT) - 1;
+  }
+  CommandTable->PrdtTable[PrdtNumber - 1].AhciPrdtIoc = 1;
+
+  //
+  // Fill the entry of the slot in the command list of the port.
+  //
+  CommandList = Instance->AhciRegisters.AhciCmdList + (UINTN) Port * EFI_AHCI_MAX_COMMAND_SLOTS + Slot;
+  ZeroMem (CommandList, sizeof (EFI_AHCI_COMMAND_LIST));
+  CommandList->AhciCmdCfl   = EFI_AHCI_FIS_REGISTER_H2D_LENGTH / 4;
+  CommandList->AhciCmdW     = Read ? 0 : 1;
+  CommandList->AhciCmdPmp   = Task->PortMultiplier;
+  CommandList->AhciCmdPrdtl = PrdtNumber;
+  Data64.Uint64 = (UINT64)(UINTN) &NcqPort->CommandTablePciAddr[Slot];
+  CommandList->AhciCmdCtba  = Data64.Uint32.Lower32;
+  CommandList->AhciCmdCtbau = Data64.Uint32.Upper32;
+
+  //
+  // The port is left running while it has queued commands.
+  //
+  if (NcqPort->ActiveSlots == 0) {
+    Status = AhciStartPort (PciIo, Port, ATA_ATAPI_TIMEOUT);
+    if (EFI_ERROR (Status)) {
+      PciIo->Unmap (PciIo, Task->Map);
+      return EFI_DEVICE_ERROR;
+    }
+  }
+
+  Task->IsStart           = TRUE;
+  NcqPort->SlotTask[Slot] = Task;
+  NcqPort->ActiveSlots   |= SlotBit;
+
+  //
+  // PxSACT must be set before PxCI. Writing 0 to the other bits of these
+  // registers has no effect.
+  //
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SACT;
+  AhciWriteReg (PciIo, Offset, SlotBit);
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CI;
+  AhciWriteReg (PciIo, Offset, SlotBit);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Complete the queued command of a slot: its task is removed from the task list,
+  its event is signaled and it is freed.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+  @param[in]  Slot              The slot of the command.
+  @param[in]  Failed            Whether the command failed.
+
+**/
+VOID
+EFIAPI
+AhciNcqCompleteSlot (
+  IN  ATA_ATAPI_PASS_THRU_INSTANCE    *Instance,
+  IN  UINT8                           Port,
+  IN  UINT32                          Slot,
+  IN  BOOLEAN                         Failed
+  )
+{
+  EFI_AHCI_NCQ_PORT     *NcqPort;
+  ATA_NONBLOCK_TASK     *Task;
+
+  NcqPort = Instance->NcqPort[Port];
+  Task    = NcqPort->SlotTask[Slot];
+
+  NcqPort->ActiveSlots   &= ~(UINT32) (BIT0 << Slot);
+  NcqPort->SlotTask[Slot] = NULL;
+
+  Instance->PciIo->Unmap (Instance->PciIo, Task->Map);
+
+  AhciDumpPortStatus (Instance->PciIo, Port, Task->Packet->Asb);
+  if (Failed) {
+    Task->Packet->Asb->AtaStatus = 0x01;
+  } else {
+    //
+    // PxTFD holds the error of another command when one failed after this one
+    // completed.
+    //
+    Task->Packet->Asb->AtaStatus &= (UINT8) ~BIT0;
+    Task->Packet->Asb->AtaError   = 0;
+  }
+
+  RemoveEntryList (&Task->Link);
+  gBS->SignalEvent (Task->Event);
+  FreePool (Task);
+}
+
+/**
+  Recover a port on which a queued command failed or timed out.
+
+  Stopping the port clears PxSACT and PxCI, so all the queued commands still
+  active on the port fail. The device is then got out of its error state by
+  reading the NCQ command error log. The read is only issued here,
+  AhciNcqCheckRecovery() finds its completion, so the timer doesn't wait for
+  the device.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+
+**/
+VOID
+EFIAPI
+AhciNcqRecoverPort (
+  IN  ATA_ATAPI_PASS_THRU_INSTANCE    *Instance,
+  IN  UINT8                           Port
+  )
+{
+  EFI_PCI_IO_PROTOCOL         *PciIo;
+  EFI_AHCI_NCQ_PORT           *NcqPort;
+  EFI_AHCI_NCQ_COMMAND_TABLE  *CommandTable;
+  EFI_AHCI_COMMAND_LIST       *CommandList;
+  EFI_ATA_COMMAND_BLOCK       AtaCommandBlock;
+  EFI_PHYSICAL_ADDRESS        PhyAddr;
+  UINTN                       MapLength;
+  UINT32                      Slot;
+  UINT32                      Offset;
+  DATA_64                     Data64;
+  EFI_STATUS                  Status;
+
+  PciIo   = Instance->PciIo;
+  NcqPort = Instance->NcqPort[Port];
+
+  AhciStopCommand (PciIo, Port, ATA_ATAPI_TIMEOUT);
+
+  for (Slot = 0; Slot < NcqPort->SlotCount; Slot++) {
+    if ((NcqPort->ActiveSlots & (BIT0 << Slot)) != 0) {
+      AhciNcqCompleteSlot (Instance, Port, Slot, TRUE);
+    }
+  }
+
+  AhciClearPortStatus (PciIo, Port);
+
+  MapLength = sizeof (NcqPort->ErrorLog);
+  Status = PciIo->Map (
+                    PciIo,
+                    EfiPciIoOperationBusMasterWrite,
+                    NcqPort->ErrorLog,
+                    &MapLength,
+                    &PhyAddr,
+                    &NcqPort->MapErrorLog
+                    );
+  if (!EFI_ERROR (Status) && (MapLength != sizeof (NcqPort->ErrorLog))) {
+    PciIo->Unmap (PciIo, NcqPort->MapErrorLog);
+    Status = EFI_OUT_OF_RESOURCES;
+  }
+
+  if (!EFI_ERROR (Status)) {
+    //
+    // The log is read in slot 0 with the command table of the port, as the command
+    // table shared by the other commands may be in use by another port.
+    //
+    ZeroMem (&AtaCommandBlock, sizeof (EFI_ATA_COMMAND_BLOCK));
+    AtaCommandBlock.AtaCommand      = ATA_CMD_READ_LOG_EXT;
+    AtaCommandBlock.AtaSectorNumber = EFI_AHCI_NCQ_ERROR_LOG;
+    AtaCommandBlock.AtaSectorCount  = 1;
+
+    CommandTable = &NcqPort->CommandTable[0];
+    ZeroMem (CommandTable, sizeof (EFI_AHCI_NCQ_COMMAND_TABLE));
+    AhciBuildCommandFis (&CommandTable->CommandFis, &AtaCommandBlock);
+
+    Data64.Uint64 = PhyAddr;
+    CommandTable->PrdtTable[0].AhciPrdtDba  = Data64.Uint32.Lower32;
+    CommandTable->PrdtTable[0].AhciPrdtDbau = Data64.Uint32.Upper32;
+    CommandTable->PrdtTable[0].AhciPrdtDbc  = sizeof (NcqPort->ErrorLog) - 1;
+    CommandTable->PrdtTable[0].AhciPrdtIoc  = 1;
+
+    CommandList = Instance->AhciRegisters.AhciCmdList + (UINTN) Port * EFI_AHCI_MAX_COMMAND_SLOTS;
+    ZeroMem (CommandList, sizeof (EFI_AHCI_COMMAND_LIST));
+    CommandList->AhciCmdCfl   = EFI_AHCI_FIS_REGISTER_H2D_LENGTH / 4;
+    CommandList->AhciCmdPrdtl = 1;
+    Data64.Uint64 = (UINT64)(UINTN) &NcqPort->CommandTablePciAddr[0];
+    CommandList->AhciCmdCtba  = Data64.Uint32.Lower32;
+    CommandList->AhciCmdCtbau = Data64.Uint32.Upper32;
+
+    Status = AhciStartPort (PciIo, Port, ATA_ATAPI_TIMEOUT);
+    if (EFI_ERROR (Status)) {
+      PciIo->Unmap (PciIo, NcqPort->MapErrorLog);
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "port [%d] NCQ error log can't be read, Status = %r\n", Port, Status));
+    AhciStopCommand (PciIo, Port, ATA_ATAPI_TIMEOUT);
+    AhciDisableFisReceive (PciIo, Port, ATA_ATAPI_TIMEOUT);
+    return;
+  }
+
+  NcqPort->Recovering        = TRUE;
+  NcqPort->RecoverRetryTimes = DivU64x32 (ATA_ATAPI_TIMEOUT, 1000) + 1;
+
+  Offset = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CI;
+  AhciWriteReg (PciIo, Offset, BIT0);
+}
+
+/**
+  Check whether the NCQ command error log read by AhciNcqRecoverPort() is done,
+  and leave the port stopped when it is, so the port takes commands again.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+
+**/
+VOID
+EFIAPI
+AhciNcqCheckRecovery (
+  IN  ATA_ATAPI_PASS_THRU_INSTANCE    *Instance,
+  IN  UINT8                           Port
+  )
+{
+  EFI_PCI_IO_PROTOCOL   *PciIo;
+  EFI_AHCI_NCQ_PORT     *NcqPort;
+  UINT32                PortInterrupt;
+  UINT32                Offset;
+
+  PciIo   = Instance->PciIo;
+  NcqPort = Instance->NcqPort[Port];
+
+  Offset        = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_IS;
+  PortInterrupt = AhciReadReg (PciIo, Offset);
+  Offset        = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CI;
+
+  if (((PortInterrupt & EFI_AHCI_PORT_IS_ERROR_MASK) == 0) &&
+      ((AhciReadReg (PciIo, Offset) & BIT0) != 0)) {
+    if (NcqPort->RecoverRetryTimes != 0) {
+      NcqPort->RecoverRetryTimes--;
+      return;
+    }
+    DEBUG ((EFI_D_ERROR, "port [%d] NCQ error log can't be read, Status = %r\n", Port, EFI_TIMEOUT));
+  }
+
+  AhciStopCommand (PciIo, Port, ATA_ATAPI_TIMEOUT);
+  AhciDisableFisReceive (PciIo, Port, ATA_ATAPI_TIMEOUT);
+  PciIo->Unmap (PciIo, NcqPort->MapErrorLog);
+  NcqPort->Recovering = FALSE;
+
+  if ((PortInterrupt & EFI_AHCI_PORT_IS_ERROR_MASK) != 0) {
+    DEBUG ((EFI_D_ERROR, "port [%d] NCQ error log can't be read, Status = %r\n", Port, EFI_DEVICE_ERROR));
+  } else if ((NcqPort->ErrorLog[0] & BIT7) == 0) {
+    DEBUG ((EFI_D_ERROR, "port [%d] queued command with tag [%d] failed\n", Port, NcqPort->ErrorLog[0] & 0x1F));
+  }
+}
+
+/**
+  Complete the queued commands the devices have finished, and recover the ports
+  on which a queued command failed or timed out.
+
+  The task of a completed command is removed from the task list, its event is
+  signaled and it is freed.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+
+**/
+VOID
+EFIAPI
+AhciNcqCheckCompletion (
+  IN  ATA_ATAPI_PASS_THRU_INSTANCE    *Instance
+  )
+{
+  EFI_PCI_IO_PROTOCOL   *PciIo;
+  EFI_AHCI_NCQ_PORT     *NcqPort;
+  ATA_NONBLOCK_TASK     *Task;
+  UINT8                 Port;
+  UINT32                Slot;
+  UINT32                Pending;
+  UINT32                Offset;
+  UINT32                PortInterrupt;
+  BOOLEAN               TimedOut;
+
+  PciIo = Instance->PciIo;
+
+  for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+    NcqPort = Instance->NcqPort[Port];
+    if (NcqPort == NULL) {
+      continue;
+    }
+
+    if (NcqPort->Recovering) {
+      AhciNcqCheckRecovery (Instance, Port);
+      continue;
+    }
+
+    if (NcqPort->ActiveSlots == 0) {
+      continue;
+    }
+
+    Offset        = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_IS;
+    PortInterrupt = AhciReadReg (PciIo, Offset);
+
+    //
+    // The device clears the PxSACT bit of a command when it completes it. The
+    // commands it completed before an error succeeded, so they are completed
+    // first, and only the ones still pending are failed by the recovery.
+    //
+    Offset  = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_SACT;
+    Pending = AhciReadReg (PciIo, Offset);
+    Offset  = EFI_AHCI_PORT_START + Port * EFI_AHCI_PORT_REG_WIDTH + EFI_AHCI_PORT_CI;
+    Pending |= AhciReadReg (PciIo, Offset);
+
+    TimedOut = FALSE;
+    for (Slot = 0; Slot < NcqPort->SlotCount; Slot++) {
+      if ((NcqPort->ActiveSlots & (BIT0 << Slot)) == 0) {
+        continue;
+      }
+      if ((Pending & (BIT0 << Slot)) == 0) {
+        AhciNcqCompleteSlot (Instance, Port, Slot, FALSE);
+        continue;
+      }
+
+      if ((PortInterrupt & EFI_AHCI_PORT_IS_ERROR_MASK) != 0) {
+        continue;
+      }
+
+      Task = NcqPort->SlotTask[Slot];
+      if (!Task->InfiniteWait) {
+        if (Task->RetryTimes == 0) {
+          TimedOut = TRUE;
+        } else {
+          Task->RetryTimes--;
+        }
+      }
+    }
+
+    if ((PortInterrupt & EFI_AHCI_PORT_IS_ERROR_MASK) != 0) {
+      AhciNcqRecoverPort (Instance, Port);
+    } else if (TimedOut) {
+      DEBUG ((EFI_D_ERROR, "port [%d] queued command timed out\n", Port));
+      AhciNcqRecoverPort (Instance, Port);
+    } else if (NcqPort->ActiveSlots == 0) {
+      //
+      // Leave the port stopped like the other commands do.
+      //
+      AhciStopCommand (PciIo, Port, ATA_ATAPI_TIMEOUT);
+      AhciDisableFisReceive (PciIo, Port, ATA_ATAPI_TIMEOUT);
+    }
+  }
+}
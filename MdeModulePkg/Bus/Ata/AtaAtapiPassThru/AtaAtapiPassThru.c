@@ -384,23 +384,62 @@ AsyncNonBlockingTransferRoutine (
   )
 {
   LIST_ENTRY                   *Entry;
+  LIST_ENTRY                   *NextEntry;
   LIST_ENTRY                   *EntryHeader;
   ATA_NONBLOCK_TASK            *Task;
+  ATA_NONBLOCK_TASK            *PortTask;
   EFI_STATUS                   Status;
   ATA_ATAPI_PASS_THRU_INSTANCE *Instance;
+  UINT32                       PortBit;
+  UINT32                       BusyPorts;
+  BOOLEAN                      IsBusy;
 
   Instance   = (ATA_ATAPI_PASS_THRU_INSTANCE *) Context;
   EntryHeader = &Instance->NonBlockingTaskList;
+
   //
-  // Get the Taks from the Taks List and execute it, until there is
-  // no task in the list or the device is busy with task (EFI_NOT_READY).
+  // Complete the queued commands the devices have finished.
   //
-  while (TRUE) {
-    if (!IsListEmpty (EntryHeader)) {
-      Entry = GetFirstNode (EntryHeader);
-      Task  = ATA_NON_BLOCK_TASK_FROM_ENTRY (Entry);
-    } else {
-      return;
+  if (Instance->Mode == EfiAtaAhciMode) {
+    AhciNcqCheckCompletion (Instance);
+  }
+
+  //
+  // Get the Taks from the Taks List and execute them in order. The queued commands
+  // are issued as long as their port has free slots. The other commands share the
+  // resource of the controller, so only one of them runs at a time (until it returns
+  // EFI_NOT_READY no more), and it needs its port to itself. A task which can't be
+  // executed yet keeps the later tasks of its port waiting.
+  //
+  BusyPorts = Instance->BlockingPorts;
+  IsBusy    = FALSE;
+  for (Entry = GetFirstNode (EntryHeader); !IsNull (EntryHeader, Entry); Entry = NextEntry) {
+    NextEntry = GetNextNode (EntryHeader, Entry);
+    Task      = ATA_NON_BLOCK_TASK_FROM_ENTRY (Entry);
+    PortBit   = (UINT32) (BIT0 << (Task->Port & 0x1F));
+
+    if (Task->Packet->Protocol == EFI_ATA_PASS_THRU_PROTOCOL_FPDMA) {
+      if (Task->IsStart || ((BusyPorts & PortBit) != 0)) {
+        continue;
+      }
+
+      Status = AhciNcqTransfer (Instance, Task);
+      if (Status == EFI_NOT_READY) {
+        BusyPorts |= PortBit;
+      } else if (EFI_ERROR (Status)) {
+        Task->Packet->Asb->AtaStatus = 0x01;
+        RemoveEntryList (&Task->Link);
+        gBS->SignalEvent (Task->Event);
+        FreePool (Task);
+      }
+      continue;
+    }
+
+    if (IsBusy || ((BusyPorts & PortBit) != 0) ||
+        ((Task->Port < EFI_AHCI_MAX_PORTS) && (Instance->NcqPort[Task->Port] != NULL) &&
+         ((Instance->NcqPort[Task->Port]->ActiveSlots != 0) || Instance->NcqPort[Task->Port]->Recovering))) {
+      BusyPorts |= PortBit;
+      continue;
     }
 
     Status = AtaPassThruPassThruExecute (
@@ -412,11 +451,22 @@ AsyncNonBlockingTransferRoutine (
                );
 
     //
-    // If the data transfer meet a error, remove all tasks in the list since these tasks are
-    // associated with one task from Ata Bus and signal the event with error status.
+    // If the data transfer meet a error, remove the tasks of the port which are not
+    // started since these tasks are associated with one task from Ata Bus and signal
+    // the event with error status.
     //
     if ((Status != EFI_NOT_READY) && (Status != EFI_SUCCESS)) {
-      DestroyAsynTaskList (Instance, TRUE);
+      for (; !IsNull (EntryHeader, Entry); Entry = NextEntry) {
+        NextEntry = GetNextNode (EntryHeader, Entry);
+        PortTask  = ATA_NON_BLOCK_TASK_FROM_ENTRY (Entry);
+        if ((PortTask->Port == Task->Port) &&
+            ((PortTask == Task) || !PortTask->IsStart)) {
+          RemoveEntryList (&PortTask->Link);
+          PortTask->Packet->Asb->AtaStatus = 0x01;
+          gBS->SignalEvent (PortTask->Event);
+          FreePool (PortTask);
+        }
+      }
       break;
     }
 
@@ -425,7 +475,8 @@ AsyncNonBlockingTransferRoutine (
     // is not finished yet. Otherwise the operation is successful.
     //
     if (Status == EFI_NOT_READY) {
-      break;
+      IsBusy     = TRUE;
+      BusyPorts |= PortBit;
     } else {
       RemoveEntryList (&Task->Link);
       gBS->SignalEvent (Task->Event);
@@ -852,6 +903,7 @@ AtaAtapiPassThruStop (
   EFI_PCI_IO_PROTOCOL               *PciIo;
   EFI_AHCI_REGISTERS                *AhciRegisters;
   UINT64                            Supports;
+  UINT8                             Port;
 
   DEBUG ((EFI_D_INFO, "==AtaAtapiPassThru Stop== Controller = %x\n", Controller));
 
@@ -898,6 +950,11 @@ AtaAtapiPassThruStop (
     gBS->CloseEvent (Instance->TimerEvent);
     Instance->TimerEvent = NULL;
   }
+  if (Instance->Mode == EfiAtaAhciMode) {
+    for (Port = 0; Port < EFI_AHCI_MAX_PORTS; Port++) {
+      AhciNcqFreePort (Instance, Port);
+    }
+  }
   DestroyAsynTaskList (Instance, FALSE);
   //
   // Free allocated resource
@@ -1247,6 +1304,7 @@ AtaPassThruPassThru (
   IN     EFI_EVENT                        Event OPTIONAL
   )
 {
+  EFI_STATUS                      Status;
   ATA_ATAPI_PASS_THRU_INSTANCE    *Instance;
   LIST_ENTRY                      *Node;
   EFI_ATA_DEVICE_INFO             *DeviceInfo;
@@ -1255,6 +1313,7 @@ AtaPassThruPassThru (
   UINT32                          MaxSectorCount;
   ATA_NONBLOCK_TASK               *Task;
   EFI_TPL                         OldTpl;
+  EFI_AHCI_NCQ_PORT               *NcqPort;
 
   Instance = ATA_PASS_THRU_PRIVATE_DATA_FROM_THIS (This);
 
@@ -1302,6 +1361,19 @@ AtaPassThruPassThru (
   //
   DeviceInfo     = ATA_ATAPI_DEVICE_INFO_FROM_THIS (Node);
   IdentifyData   = DeviceInfo->IdentifyData;
+
+  //
+  // The queued commands are only supported in non-blocking mode, by the ports of
+  // an AHCI controller using native command queuing.
+  //
+  NcqPort = NULL;
+  if ((Instance->Mode == EfiAtaAhciMode) && (Port < EFI_AHCI_MAX_PORTS)) {
+    NcqPort = Instance->NcqPort[Port];
+  }
+  if ((Packet->Protocol == EFI_ATA_PASS_THRU_PROTOCOL_FPDMA) &&
+      ((NcqPort == NULL) || (PortMultiplierPort != 0) || (Event == NULL))) {
+    return EFI_UNSUPPORTED;
+  }
   MaxSectorCount = 0x100;
   if ((IdentifyData->AtaData.command_set_supported_83 & (BIT10 | BIT15 | BIT14)) == 0x4400) {
     Capacity = *((UINT64 *)IdentifyData->AtaData.maximum_lba_for_48bit_addressing);
@@ -1352,13 +1424,36 @@ AtaPassThruPassThru (
 
     return EFI_SUCCESS;
   } else {
-    return AtaPassThruPassThruExecute (
-             Port,
-             PortMultiplierPort,
-             Packet,
-             Instance,
-             NULL
-             );
+    //
+    // The queued commands of the port complete before a blocking command uses it,
+    // and the timer issues no other task to the port until the command returns.
+    // Delay 100us to simulate the blocking time out checking.
+    //
+    if (NcqPort != NULL) {
+      OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+      while ((NcqPort->ActiveSlots != 0) || NcqPort->Recovering) {
+        AsyncNonBlockingTransferRoutine (NULL, Instance);
+        MicroSecondDelay (100);
+      }
+      Instance->BlockingPorts |= (UINT32) (BIT0 << Port);
+      gBS->RestoreTPL (OldTpl);
+    }
+
+    Status = AtaPassThruPassThruExecute (
+               Port,
+               PortMultiplierPort,
+               Packet,
+               Instance,
+               NULL
+               );
+
+    if (NcqPort != NULL) {
+      OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+      Instance->BlockingPorts &= ~(UINT32) (BIT0 << Port);
+      gBS->RestoreTPL (OldTpl);
+    }
+
+    return Status;
   }
 }
 
@@ -79,6 +79,27 @@ typedef struct {
   EFI_IDENTIFY_DATA                 *IdentifyData;
 } EFI_ATA_DEVICE_INFO;
 
+//
+// Native command queuing state of an AHCI port. The slot number of a queued
+// command is also its tag.
+//
+typedef struct {
+  EFI_AHCI_NCQ_COMMAND_TABLE        *CommandTable;          // One command table per slot
+  EFI_AHCI_NCQ_COMMAND_TABLE        *CommandTablePciAddr;
+  VOID                              *MapCommandTable;
+  UINT32                            SlotCount;
+  UINT32                            ActiveSlots;            // Bit map of the slots in use
+  ATA_NONBLOCK_TASK                 *SlotTask[EFI_AHCI_MAX_COMMAND_SLOTS];
+  //
+  // After a queued command failed, the NCQ command error log is read in slot 0
+  // and the port takes no other command until it is read.
+  //
+  BOOLEAN                           Recovering;
+  UINT64                            RecoverRetryTimes;
+  VOID                              *MapErrorLog;
+  UINT8                             ErrorLog[512];
+} EFI_AHCI_NCQ_PORT;
+
 typedef struct {
   UINT32                            Signature;
 
@@ -120,6 +141,15 @@ typedef struct {
   //
   EFI_EVENT                         TimerEvent;
   LIST_ENTRY                        NonBlockingTaskList;
+
+  //
+  // The ports using native command queuing in AHCI mode, NULL for the others.
+  //
+  EFI_AHCI_NCQ_PORT                 *NcqPort[EFI_AHCI_MAX_PORTS];
+  //
+  // Bit map of the ports running a blocking command, the timer issues no task to them.
+  //
+  UINT32                            BlockingPorts;
 } ATA_ATAPI_PASS_THRU_INSTANCE;
 
 //
@@ -1193,6 +1223,83 @@ AhciPioTransfer (
   IN     ATA_NONBLOCK_TASK          *Task
   );
 
+/**
+  Allocate the command tables used by the queued commands of a port, and record
+  the port as using native command queuing.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+  @param[in]  QueueDepth        The number of commands the device can queue.
+
+  @retval EFI_SUCCESS           The port uses native command queuing.
+  @retval EFI_UNSUPPORTED       The HBA or the device can't queue several commands.
+  @retval EFI_OUT_OF_RESOURCES  The command tables can't be allocated.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciNcqInitPort (
+  IN  ATA_ATAPI_PASS_THRU_INSTANCE    *Instance,
+  IN  UINT8                           Port,
+  IN  UINT32                          QueueDepth
+  );
+
+/**
+  Stop the queued commands of a port, and free the command tables of the port.
+
+  The tasks of the stopped commands are left in the task list.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in]  Port              The number of port.
+
+**/
+VOID
+EFIAPI
+AhciNcqFreePort (
+  IN  ATA_ATAPI_PASS_THRU_INSTANCE    *Instance,
+  IN  UINT8                           Port
+  );
+
+/**
+  Issue a READ/WRITE FPDMA QUEUED command in a free slot of its port.
+
+  The function returns as soon as the command is issued. Its completion is found
+  by AhciNcqCheckCompletion().
+
+  @param[in]       Instance     A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+  @param[in, out]  Task         Pointer to the ATA_NONBLOCK_TASK of the command.
+
+  @retval EFI_SUCCESS           The command is issued.
+  @retval EFI_NOT_READY         All the slots of the port are in use, or the port
+                                is being recovered.
+  @retval EFI_UNSUPPORTED       The port doesn't use native command queuing.
+  @retval EFI_BAD_BUFFER_SIZE   The data buffer can't be mapped or is too big.
+  @retval EFI_DEVICE_ERROR      The port can't be started.
+
+**/
+EFI_STATUS
+EFIAPI
+AhciNcqTransfer (
+  IN     ATA_ATAPI_PASS_THRU_INSTANCE *Instance,
+  IN OUT ATA_NONBLOCK_TASK            *Task
+  );
+
+/**
+  Complete the queued commands the devices have finished, and recover the ports
+  on which a queued command failed or timed out.
+
+  The task of a completed command is removed from the task list, its event is
+  signaled and it is freed.
+
+  @param[in]  Instance          A pointer to the ATA_ATAPI_PASS_THRU_INSTANCE instance.
+
+**/
+VOID
+EFIAPI
+AhciNcqCheckCompletion (
+  IN  ATA_ATAPI_PASS_THRU_INSTANCE    *Instance
+  );
+
 /**
   Send ATA command into device with NON_DATA protocol
 
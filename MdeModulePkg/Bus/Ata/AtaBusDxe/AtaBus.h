@@ -137,6 +137,11 @@ typedef struct {
 
   BOOLEAN                               UdmaValid;
   BOOLEAN                               Lba48Bit;
+  //
+  // Whether the non-blocking reads and writes use the READ/WRITE FPDMA QUEUED
+  // commands, so several of them are outstanding at the same time.
+  //
+  BOOLEAN                               Ncq;
 
   //
   // Cached data for ATA identify data
@@ -343,6 +343,15 @@ IdentifyAtaDevice (
     AtaDevice->Lba48Bit = FALSE;
   }
 
+  //
+  // Check whether the device supports native command queuing (WORD 76 bit 8).
+  // The ATA pass through may still not queue its commands, then the DMA commands
+  // are used.
+  //
+  if (AtaDevice->UdmaValid && ((IdentifyData->serial_ata_capabilities & BIT8) != 0)) {
+    AtaDevice->Ncq = TRUE;
+  }
+
   //
   // Block Media Information:
   //
@@ -477,8 +486,15 @@ TransferAtaDevice (
   IN EFI_EVENT                            Event OPTIONAL
   )
 {
+  EFI_STATUS                        Status;
   EFI_ATA_COMMAND_BLOCK             *Acb;
   EFI_ATA_PASS_THRU_COMMAND_PACKET  *Packet;
+  BOOLEAN                           Queued;
+
+  //
+  // The non-blocking transfers are queued in the device if it supports it.
+  //
+  Queued = (BOOLEAN) (AtaDevice->Ncq && (TaskPacket != NULL));
 
   //
   // Ensure AtaDevice->UdmaValid, AtaDevice->Lba48Bit and IsWrite are valid boolean values
@@ -505,6 +521,23 @@ TransferAtaDevice (
     Acb->AtaDeviceHead = (UINT8) (Acb->AtaDeviceHead | RShiftU64 (StartLba, 24));
   }
 
+  if (Queued) {
+    //
+    // The queued commands always use 48-bit addressing and give the sector count
+    // in the features register. The ATA pass through puts the tag of the command
+    // in the sector count register.
+    //
+    Acb->AtaCommand         = IsWrite ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED;
+    Acb->AtaDeviceHead      = BIT6;
+    Acb->AtaSectorNumberExp = (UINT8) RShiftU64 (StartLba, 24);
+    Acb->AtaCylinderLowExp  = (UINT8) RShiftU64 (StartLba, 32);
+    Acb->AtaCylinderHighExp = (UINT8) RShiftU64 (StartLba, 40);
+    Acb->AtaFeatures        = (UINT8) TransferLength;
+    Acb->AtaFeaturesExp     = (UINT8) (TransferLength >> 8);
+    Acb->AtaSectorCount     = 0;
+    Acb->AtaSectorCountExp  = 0;
+  }
+
   //
   // Prepare for ATA pass through packet.
   //
@@ -523,6 +556,9 @@ TransferAtaDevice (
   }
 
   Packet->Protocol = mAtaPassThruCmdProtocols[AtaDevice->UdmaValid][IsWrite];
+  if (Queued) {
+    Packet->Protocol = EFI_ATA_PASS_THRU_PROTOCOL_FPDMA;
+  }
   Packet->Length = EFI_ATA_PASS_THRU_LENGTH_SECTOR_COUNT;
   //
   // |------------------------|-----------------|------------------------|-----------------|
@@ -557,7 +593,24 @@ TransferAtaDevice (
     Packet->Timeout  = EFI_TIMER_PERIOD_SECONDS (DivU64x32 (MultU64x32 (TransferLength, AtaDevice->BlockMedia.BlockSize), 3300000) + 31);
   }
 
-  return AtaDevicePassThru (AtaDevice, TaskPacket, Event);
+  Status = AtaDevicePassThru (AtaDevice, TaskPacket, Event);
+  if (Queued && (Status == EFI_UNSUPPORTED)) {
+    //
+    // The ATA pass through doesn't queue the commands of this device, so use the
+    // DMA commands from now on.
+    //
+    DEBUG ((EFI_D_INFO, "AtaBus - Port %x doesn't queue the commands\n", AtaDevice->Port));
+    AtaDevice->Ncq = FALSE;
+    if (Packet->Asb != NULL) {
+      FreeAlignedBuffer (Packet->Asb, sizeof (EFI_ATA_STATUS_BLOCK));
+    }
+    if (Packet->Acb != NULL) {
+      FreePool (Packet->Acb);
+    }
+    return TransferAtaDevice (AtaDevice, TaskPacket, Buffer, StartLba, TransferLength, IsWrite, Event);
+  }
+
+  return Status;
 }
 
 /**
@@ -812,7 +865,11 @@ AccessAtaDevice(
   if ((Token != NULL) && (Token->Event != NULL)) {
     OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
 
-    if (!IsListEmpty (&AtaDevice->AtaSubTaskList)) {
+    //
+    // The device runs the queued commands of several tokens at the same time, the
+    // other commands are sent one token after the other.
+    //
+    if (!AtaDevice->Ncq && !IsListEmpty (&AtaDevice->AtaSubTaskList)) {
       AtaTask = AllocateZeroPool (sizeof (ATA_BUS_ASYN_TASK));
       if (AtaTask == NULL) {
         gBS->RestoreTPL (OldTpl);
@@ -117,6 +117,7 @@ EnumerateNvmeDevNamespace (
     Device->ControllerHandle    = Private->ControllerHandle;
     Device->DriverBindingHandle = Private->DriverBindingHandle;
     Device->Controller          = Private;
+    InitializeListHead (&Device->AsyncQueue);
 
     //
     // Build BlockIo media structure
@@ -147,6 +148,15 @@ EnumerateNvmeDevNamespace (
     Device->BlockIo.WriteBlocks  = NvmeBlockIoWriteBlocks;
     Device->BlockIo.FlushBlocks  = NvmeBlockIoFlushBlocks;
 
+    //
+    // Create BlockIo2 Protocol instance
+    //
+    Device->BlockIo2.Media          = &Device->Media;
+    Device->BlockIo2.Reset          = NvmeBlockIoResetEx;
+    Device->BlockIo2.ReadBlocksEx   = NvmeBlockIoReadBlocksEx;
+    Device->BlockIo2.WriteBlocksEx  = NvmeBlockIoWriteBlocksEx;
+    Device->BlockIo2.FlushBlocksEx  = NvmeBlockIoFlushBlocksEx;
+
     //
     // Create DiskInfo Protocol instance
     //
@@ -197,6 +207,8 @@ EnumerateNvmeDevNamespace (
                     Device->DevicePath,
                     &gEfiBlockIoProtocolGuid,
                     &Device->BlockIo,
+                    &gEfiBlockIo2ProtocolGuid,
+                    &Device->BlockIo2,
                     &gEfiDiskInfoProtocolGuid,
                     &Device->DiskInfo,
                     NULL
@@ -350,6 +362,15 @@ UnregisterNvmeNamespace (
 
   Device = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO (BlockIo);
 
+  //
+  // Wait for the BlockIo2 requests of the namespace to complete, as their
+  // completion is reported through the device private data. They are completed
+  // by the polling routine itself, and the commands which do not complete fail
+  // after their timeout, so the queue always drains.
+  //
+  NvmeWaitAsyncQueueEmpty (Device->Controller);
+  ASSERT (IsListEmpty (&Device->AsyncQueue));
+
   //
   // Close the child handle
   //
@@ -361,8 +382,8 @@ UnregisterNvmeNamespace (
          );
 
   //
-  // The Nvm Express driver installs the BlockIo and DiskInfo in the DriverBindingStart().
-  // Here should uninstall both of them.
+  // The Nvm Express driver installs the BlockIo, BlockIo2 and DiskInfo in the DriverBindingStart().
+  // Here should uninstall all of them.
   //
   Status = gBS->UninstallMultipleProtocolInterfaces (
                   Handle,
@@ -370,6 +391,8 @@ UnregisterNvmeNamespace (
                   Device->DevicePath,
                   &gEfiBlockIoProtocolGuid,
                   &Device->BlockIo,
+                  &gEfiBlockIo2ProtocolGuid,
+                  &Device->BlockIo2,
                   &gEfiDiskInfoProtocolGuid,
                   &Device->DiskInfo,
                   NULL
@@ -398,6 +421,331 @@ UnregisterNvmeNamespace (
   return EFI_SUCCESS;
 }
 
+/**
+  Release the resources of a command of the asynchronous I/O queue, and its
+  entry in the queue.
+
+  @param[in]  Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  AsyncRequest   The command to release.
+
+**/
+VOID
+NvmeReleaseAsyncRequest (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private,
+  IN NVME_PASS_THRU_ASYNC_REQ           *AsyncRequest
+  )
+{
+  EFI_PCI_IO_PROTOCOL                  *PciIo;
+
+  PciIo = Private->PciIo;
+
+  //
+  // Free the resources allocated before cmd submission
+  //
+  if (AsyncRequest->MapData != NULL) {
+    PciIo->Unmap (PciIo, AsyncRequest->MapData);
+  }
+  if (AsyncRequest->MapMeta != NULL) {
+    PciIo->Unmap (PciIo, AsyncRequest->MapMeta);
+  }
+  if (AsyncRequest->MapPrpList != NULL) {
+    PciIo->Unmap (PciIo, AsyncRequest->MapPrpList);
+  }
+  if (AsyncRequest->PrpListHost != NULL) {
+    PciIo->FreeBuffer (
+             PciIo,
+             AsyncRequest->PrpListNo,
+             AsyncRequest->PrpListHost
+             );
+  }
+
+  RemoveEntryList (&AsyncRequest->Link);
+  Private->AsyncPassThruCount--;
+  if (AsyncRequest->TimedOut) {
+    Private->AsyncTimedOutCount--;
+  }
+
+  FreePool (AsyncRequest);
+}
+
+/**
+  Complete the BlockIo2 subtask of a command of the asynchronous I/O queue, or
+  signal the event of its caller.
+
+  The command is released when the controller completed it. When it timed out,
+  it is only marked so, and released when the controller completes it or is
+  reset.
+
+  @param[in]  Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]  AsyncRequest   The command to complete.
+  @param[in]  Status         EFI_SUCCESS if the controller completed the command,
+                             or the error which failed it.
+
+**/
+VOID
+NvmeCompleteAsyncRequest (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private,
+  IN NVME_PASS_THRU_ASYNC_REQ           *AsyncRequest,
+  IN EFI_STATUS                         Status
+  )
+{
+  NVME_BLKIO2_SUBTASK                  *Subtask;
+  EFI_EVENT                            CallerEvent;
+
+  Subtask     = AsyncRequest->Subtask;
+  CallerEvent = AsyncRequest->CallerEvent;
+
+  if (Status == EFI_TIMEOUT) {
+    AsyncRequest->Packet      = NULL;
+    AsyncRequest->Subtask     = NULL;
+    AsyncRequest->CallerEvent = NULL;
+    AsyncRequest->Timeout     = 0;
+    AsyncRequest->TimedOut    = TRUE;
+    Private->AsyncTimedOutCount++;
+  } else {
+    NvmeReleaseAsyncRequest (Private, AsyncRequest);
+  }
+
+  if (Subtask != NULL) {
+    NvmeCompleteSubtask (Subtask, Status);
+  } else {
+    gBS->SignalEvent (CallerEvent);
+  }
+}
+
+/**
+  Call back function when the timer event is signaled.
+
+  It completes the commands of the asynchronous I/O queue which are finished,
+  and fails the ones which timed out, then sends the queued BlockIo2 subtasks
+  while the queue has free entries.
+
+  The BlockIo2 subtasks are completed here rather than through events, so that
+  the requests are completed whatever the TPL of the code waiting for them.
+
+  @param[in]  Event     The Event this notify function registered to. It is
+                        NULL when the function is called directly, in which
+                        case the timeouts of the commands are not updated.
+  @param[in]  Context   Pointer to the context data registered to the
+                        Event.
+
+**/
+VOID
+EFIAPI
+ProcessAsyncTaskList (
+  IN EFI_EVENT                    Event,
+  IN VOID*                        Context
+  )
+{
+  NVME_CONTROLLER_PRIVATE_DATA         *Private;
+  EFI_PCI_IO_PROTOCOL                  *PciIo;
+  NVME_CQ                              *Cq;
+  UINT16                               QueueId;
+  UINT32                               Data;
+  LIST_ENTRY                           *Link;
+  LIST_ENTRY                           *NextLink;
+  NVME_PASS_THRU_ASYNC_REQ             *AsyncRequest;
+  NVME_BLKIO2_SUBTASK                  *Subtask;
+  NVME_BLKIO2_REQUEST                  *BlkIo2Request;
+  EFI_BLOCK_IO2_TOKEN                  *Token;
+  BOOLEAN                              HasNewItem;
+  EFI_STATUS                           Status;
+
+  Private    = (NVME_CONTROLLER_PRIVATE_DATA*)Context;
+  PciIo      = Private->PciIo;
+  QueueId    = NVME_ASYNC_IO_QUEUE;
+  Cq         = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
+  HasNewItem = FALSE;
+
+  //
+  // Complete the finished commands first, so that their queue entries can be
+  // used by the subtasks sent below.
+  //
+  while (Cq->Pt != Private->Pt[QueueId]) {
+    ASSERT (Cq->Sqid == QueueId);
+
+    HasNewItem = TRUE;
+
+    //
+    // Find the command with given Command Id. The late completion of a command
+    // which timed out only releases it, its caller is completed already.
+    //
+    for (Link = GetFirstNode (&Private->AsyncPassThruQueue);
+         !IsNull (&Private->AsyncPassThruQueue, Link);
+         Link = GetNextNode (&Private->AsyncPassThruQueue, Link)) {
+      AsyncRequest = NVME_PASS_THRU_ASYNC_REQ_FROM_THIS (Link);
+      if (AsyncRequest->CommandId == Cq->Cid) {
+        if (AsyncRequest->TimedOut) {
+          NvmeReleaseAsyncRequest (Private, AsyncRequest);
+          break;
+        }
+
+        //
+        // Copy the Respose Queue entry for this command to the callers
+        // response buffer.
+        //
+        CopyMem (
+          AsyncRequest->Packet->NvmeResponse,
+          Cq,
+          sizeof(NVM_EXPRESS_RESPONSE)
+          );
+        AsyncRequest->Packet->ControllerStatus = NVM_EXPRESS_STATUS_CONTROLLER_READY;
+        NvmeCompleteAsyncRequest (Private, AsyncRequest, EFI_SUCCESS);
+        break;
+      }
+    }
+
+    if (Private->CqHdbl[QueueId].Cqh == Private->QueueSize[QueueId]) {
+      Private->CqHdbl[QueueId].Cqh = 0;
+      Private->Pt[QueueId] ^= 1;
+    } else {
+      Private->CqHdbl[QueueId].Cqh++;
+    }
+
+    Cq = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
+  }
+
+  if (HasNewItem) {
+    Data = ReadUnaligned32 ((UINT32*)&Private->CqHdbl[QueueId]);
+    PciIo->Mem.Write (
+                 PciIo,
+                 EfiPciIoWidthUint32,
+                 NVME_BAR,
+                 NVME_CQHDBL_OFFSET(QueueId, Private->Cap.Dstrd),
+                 1,
+                 &Data
+                 );
+  }
+
+  //
+  // On each tick of the timer, fail the commands whose CommandTimeout has
+  // elapsed, the same way a blocking command times out. Their entries in the
+  // queue stay reserved until the controller completes them.
+  //
+  if (Event != NULL) {
+    for (Link = GetFirstNode (&Private->AsyncPassThruQueue);
+         !IsNull (&Private->AsyncPassThruQueue, Link);
+         Link = NextLink) {
+      NextLink     = GetNextNode (&Private->AsyncPassThruQueue, Link);
+      AsyncRequest = NVME_PASS_THRU_ASYNC_REQ_FROM_THIS (Link);
+      if (AsyncRequest->Timeout == 0) {
+        continue;
+      }
+
+      if (AsyncRequest->Timeout > NVME_HC_ASYNC_TIMER) {
+        AsyncRequest->Timeout -= NVME_HC_ASYNC_TIMER;
+        continue;
+      }
+
+      DEBUG ((EFI_D_ERROR, "NvmExpress: asynchronous command %d timed out\n", AsyncRequest->CommandId));
+      AsyncRequest->Packet->ControllerStatus = NVM_EXPRESS_STATUS_CONTROLLER_TIMEOUT_COMMAND;
+      NvmeCompleteAsyncRequest (Private, AsyncRequest, EFI_TIMEOUT);
+    }
+  }
+
+  //
+  // Submit asynchronous subtasks to the NVMe Submission Queue
+  //
+  while (!IsListEmpty (&Private->UnsubmittedSubtasks)) {
+    Link          = GetFirstNode (&Private->UnsubmittedSubtasks);
+    Subtask       = NVME_BLKIO2_SUBTASK_FROM_LINK (Link);
+    BlkIo2Request = Subtask->BlockIo2Request;
+    Token         = BlkIo2Request->Token;
+
+    //
+    // If any previous subtask fails, do not send the subsequent ones.
+    //
+    Status = EFI_DEVICE_ERROR;
+    if (Token->TransactionStatus == EFI_SUCCESS) {
+      Status = NvmExpressPassThruInternal (
+                 &Private->Passthru,
+                 Subtask->NamespaceId,
+                 &Subtask->CommandPacket,
+                 NULL,
+                 Subtask
+                 );
+      if (Status == EFI_NOT_READY) {
+        //
+        // The queue is full, the subtask is sent when a command completes.
+        //
+        break;
+      }
+    }
+
+    RemoveEntryList (Link);
+    BlkIo2Request->UnsubmittedSubtaskNum--;
+    InsertTailList (&BlkIo2Request->SubtasksQueue, Link);
+
+    if (EFI_ERROR (Status)) {
+      NvmeCompleteSubtask (Subtask, Status);
+    }
+  }
+}
+
+/**
+  Wait until all the commands of the asynchronous I/O queue are completed,
+  including the BlockIo2 subtasks which are not sent to the controller yet.
+
+  The queue is processed by the caller, so this function may be called at
+  any TPL up to TPL_CALLBACK. The timer still runs at those TPLs, so the
+  commands which never complete are failed after their timeout. The commands
+  which timed out are not waited for, their callers are completed already.
+
+  @param[in]  Private   The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeWaitAsyncQueueEmpty (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private
+  )
+{
+  EFI_TPL                               OldTpl;
+  BOOLEAN                               IsEmpty;
+
+  while (TRUE) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    ProcessAsyncTaskList (NULL, Private);
+    IsEmpty = (Private->AsyncPassThruCount == Private->AsyncTimedOutCount) &&
+              IsListEmpty (&Private->UnsubmittedSubtasks);
+    gBS->RestoreTPL (OldTpl);
+
+    if (IsEmpty) {
+      break;
+    }
+
+    gBS->Stall (10);
+  }
+}
+
+/**
+  Release the commands of the asynchronous I/O queue which timed out.
+
+  The controller must be disabled, so that it does not transfer data for the
+  commands nor post their completions any more.
+
+  @param[in]  Private   The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeReleaseTimedOutCommands (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private
+  )
+{
+  LIST_ENTRY                            *Link;
+  LIST_ENTRY                            *NextLink;
+  NVME_PASS_THRU_ASYNC_REQ              *AsyncRequest;
+
+  for (Link = GetFirstNode (&Private->AsyncPassThruQueue);
+       !IsNull (&Private->AsyncPassThruQueue, Link);
+       Link = NextLink) {
+    NextLink     = GetNextNode (&Private->AsyncPassThruQueue, Link);
+    AsyncRequest = NVME_PASS_THRU_ASYNC_REQ_FROM_THIS (Link);
+    if (AsyncRequest->TimedOut) {
+      NvmeReleaseAsyncRequest (Private, AsyncRequest);
+    }
+  }
+}
+
 /**
   Tests to see if this driver supports a given controller. If a child device is provided,
   it further tests to see if this driver supports creating a handle for the specified child device.
@@ -654,19 +1002,21 @@ NvmExpressDriverBindingStart (
     }
 
     //
-    // 4 x 4kB aligned buffers will be carved out of this buffer.
+    // 6 x 4kB aligned buffers will be carved out of this buffer.
     // 1st 4kB boundary is the start of the admin submission queue.
     // 2nd 4kB boundary is the start of the admin completion queue.
     // 3rd 4kB boundary is the start of I/O submission queue #1.
     // 4th 4kB boundary is the start of I/O completion queue #1.
+    // 5th 4kB boundary is the start of I/O submission queue #2.
+    // 6th 4kB boundary is the start of I/O completion queue #2.
     //
-    // Allocate 4 pages of memory, then map it for bus master read and write.
+    // Allocate 6 pages of memory, then map it for bus master read and write.
     //
     Status = PciIo->AllocateBuffer (
                       PciIo,
                       AllocateAnyPages,
                       EfiBootServicesData,
-                      4,
+                      6,
                       (VOID**)&Private->Buffer,
                       0
                       );
@@ -674,7 +1024,7 @@ NvmExpressDriverBindingStart (
       goto Exit2;
     }
 
-    Bytes = EFI_PAGES_TO_SIZE (4);
+    Bytes = EFI_PAGES_TO_SIZE (6);
     Status = PciIo->Map (
                       PciIo,
                       EfiPciIoOperationBusMasterCommonBuffer,
@@ -684,12 +1034,12 @@ NvmExpressDriverBindingStart (
                       &Private->Mapping
                       );
 
-    if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (4))) {
+    if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (6))) {
       goto Exit2;
     }
 
     Private->BufferPciAddr = (UINT8 *)(UINTN)MappedAddr;
-    ZeroMem (Private->Buffer, EFI_PAGES_TO_SIZE (4));
+    ZeroMem (Private->Buffer, EFI_PAGES_TO_SIZE (6));
 
     Private->Signature = NVME_CONTROLLER_PRIVATE_DATA_SIGNATURE;
     Private->ControllerHandle          = Controller;
@@ -702,7 +1052,10 @@ NvmExpressDriverBindingStart (
     Private->Passthru.GetNextNamespace = NvmExpressGetNextNamespace;
     Private->Passthru.BuildDevicePath  = NvmExpressBuildDevicePath;
     Private->Passthru.GetNamespace     = NvmExpressGetNamespace;
-    Private->PassThruMode.Attributes   = NVM_EXPRESS_PASS_THRU_ATTRIBUTES_PHYSICAL;
+    Private->PassThruMode.Attributes   = NVM_EXPRESS_PASS_THRU_ATTRIBUTES_PHYSICAL |
+                                         NVM_EXPRESS_PASS_THRU_ATTRIBUTES_NONBLOCKIO;
+    InitializeListHead (&Private->AsyncPassThruQueue);
+    InitializeListHead (&Private->UnsubmittedSubtasks);
 
     Status = NvmeControllerInit (Private);
 
@@ -710,6 +1063,29 @@ NvmExpressDriverBindingStart (
       goto Exit2;
     }
 
+    //
+    // Start the asynchronous I/O completion monitor
+    //
+    Status = gBS->CreateEvent (
+                    EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                    TPL_NOTIFY,
+                    ProcessAsyncTaskList,
+                    Private,
+                    &Private->TimerEvent
+                    );
+    if (EFI_ERROR (Status)) {
+      goto Exit2;
+    }
+
+    Status = gBS->SetTimer (
+                    Private->TimerEvent,
+                    TimerPeriodic,
+                    NVME_HC_ASYNC_TIMER
+                    );
+    if (EFI_ERROR (Status)) {
+      goto Exit2;
+    }
+
     Status = gBS->InstallMultipleProtocolInterfaces (
                     &Controller,
                     &gEfiCallerIdGuid,
@@ -773,12 +1149,16 @@ Exit1:
          NULL
          );
 Exit2:
+  if ((Private != NULL) && (Private->TimerEvent != NULL)) {
+    gBS->CloseEvent (Private->TimerEvent);
+  }
+
   if ((Private != NULL) && (Private->Mapping != NULL)) {
     PciIo->Unmap (PciIo, Private->Mapping);
   }
 
   if ((Private != NULL) && (Private->Buffer != NULL)) {
-    PciIo->FreeBuffer (PciIo, 4, Private->Buffer);
+    PciIo->FreeBuffer (PciIo, 6, Private->Buffer);
   }
 
   if (Private != NULL) {
@@ -863,12 +1243,25 @@ NvmExpressDriverBindingStop (
             NULL
             );
 
+      if (Private->TimerEvent != NULL) {
+        gBS->CloseEvent (Private->TimerEvent);
+      }
+
+      //
+      // The controller may still use the buffers of the commands which timed
+      // out, so it is disabled before they are released.
+      //
+      if (Private->AsyncTimedOutCount != 0) {
+        NvmeDisableController (Private);
+        NvmeReleaseTimedOutCommands (Private);
+      }
+
       if (Private->Mapping != NULL) {
         Private->PciIo->Unmap (Private->PciIo, Private->Mapping);
       }
 
       if (Private->Buffer != NULL) {
-        Private->PciIo->FreeBuffer (Private->PciIo, 4, Private->Buffer);
+        Private->PciIo->FreeBuffer (Private->PciIo, 6, Private->Buffer);
       }
 
       FreePool (Private->ControllerData);
@@ -27,6 +27,7 @@
 #include <Protocol/DevicePath.h>
 #include <Protocol/PciIo.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/DiskInfo.h>
 #include <Protocol/DriverSupportedEfiVersion.h>
 
@@ -62,7 +63,10 @@ extern EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL  gNvmExpressDriverSupportedEfiV
 #define NVME_CSQ_SIZE                             1     // Number of I/O submission queue entries, which is 0-based
 #define NVME_CCQ_SIZE                             1     // Number of I/O completion queue entries, which is 0-based
 
-#define NVME_MAX_IO_QUEUES                        2     // Number of I/O queues supported by the driver
+#define NVME_ASYNC_CSQ_SIZE                       63    // Number of asynchronous I/O submission queue entries, which is 0-based
+#define NVME_ASYNC_CCQ_SIZE                       63    // Number of asynchronous I/O completion queue entries, which is 0-based
+
+#define NVME_MAX_QUEUES                           3     // Number of queues supported by the driver
 
 #define NVME_CONTROLLER_ID                        0
 
@@ -71,6 +75,12 @@ extern EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL  gNvmExpressDriverSupportedEfiV
 //
 #define NVME_GENERIC_TIMEOUT                      EFI_TIMER_PERIOD_SECONDS (5)
 
+//
+// Interval of the timer which submits the queued asynchronous commands and
+// completes the finished ones, in 100ns units.
+//
+#define NVME_HC_ASYNC_TIMER                       EFI_TIMER_PERIOD_MILLISECONDS (1)
+
 //
 // Unique signature for private data structure.
 //
@@ -102,11 +112,11 @@ struct _NVME_CONTROLLER_PRIVATE_DATA {
   //
   // 6 x 4kB aligned buffers will be carved out of this buffer.
   // 1st 4kB boundary is the start of the admin submission queue.
-  // 2nd 4kB boundary is the start of submission queue #1.
-  // 3rd 4kB boundary is the start of the admin completion queue.
-  // 4th 4kB boundary is the start of completion queue #1.
-  // 5th 4kB boundary is the start of the first PRP list page.
-  // 6th 4kB boundary is the start of the second PRP list page.
+  // 2nd 4kB boundary is the start of the admin completion queue.
+  // 3rd 4kB boundary is the start of I/O submission queue #1.
+  // 4th 4kB boundary is the start of I/O completion queue #1.
+  // 5th 4kB boundary is the start of I/O submission queue #2.
+  // 6th 4kB boundary is the start of I/O completion queue #2.
   //
   UINT8                           *Buffer;
   UINT8                           *BufferPciAddr;
@@ -114,19 +124,24 @@ struct _NVME_CONTROLLER_PRIVATE_DATA {
   //
   // Pointers to 4kB aligned submission & completion queues.
   //
-  NVME_SQ                         *SqBuffer[NVME_MAX_IO_QUEUES];
-  NVME_CQ                         *CqBuffer[NVME_MAX_IO_QUEUES];
-  NVME_SQ                         *SqBufferPciAddr[NVME_MAX_IO_QUEUES];
-  NVME_CQ                         *CqBufferPciAddr[NVME_MAX_IO_QUEUES];
+  NVME_SQ                         *SqBuffer[NVME_MAX_QUEUES];
+  NVME_CQ                         *CqBuffer[NVME_MAX_QUEUES];
+  NVME_SQ                         *SqBufferPciAddr[NVME_MAX_QUEUES];
+  NVME_CQ                         *CqBufferPciAddr[NVME_MAX_QUEUES];
+
+  //
+  // Number of entries of the submission & completion queues, which is 0-based.
+  //
+  UINT16                          QueueSize[NVME_MAX_QUEUES];
 
   //
   // Submission and completion queue indices.
   //
-  NVME_SQTDBL                     SqTdbl[NVME_MAX_IO_QUEUES];
-  NVME_CQHDBL                     CqHdbl[NVME_MAX_IO_QUEUES];
+  NVME_SQTDBL                     SqTdbl[NVME_MAX_QUEUES];
+  NVME_CQHDBL                     CqHdbl[NVME_MAX_QUEUES];
 
-  UINT8                           Pt[2];
-  UINT16                          Cid[2];
+  UINT8                           Pt[NVME_MAX_QUEUES];
+  UINT16                          Cid[NVME_MAX_QUEUES];
 
   //
   // Nvme controller capabilities
@@ -134,6 +149,22 @@ struct _NVME_CONTROLLER_PRIVATE_DATA {
   NVME_CAP                        Cap;
 
   VOID                            *Mapping;
+
+  //
+  // For Non-blocking operations.
+  //
+  EFI_EVENT                       TimerEvent;
+  //
+  // The commands sent to the asynchronous I/O queue and not completed yet,
+  // their number, and the number of those which timed out.
+  //
+  LIST_ENTRY                      AsyncPassThruQueue;
+  UINTN                           AsyncPassThruCount;
+  UINTN                           AsyncTimedOutCount;
+  //
+  // The BlockIo2 subtasks waiting for a free entry in the asynchronous I/O queue.
+  //
+  LIST_ENTRY                      UnsubmittedSubtasks;
 };
 
 #define NVME_CONTROLLER_PRIVATE_DATA_FROM_PASS_THRU(a) \
@@ -167,8 +198,14 @@ struct _NVME_DEVICE_PRIVATE_DATA {
 
   EFI_BLOCK_IO_MEDIA                Media;
   EFI_BLOCK_IO_PROTOCOL             BlockIo;
+  EFI_BLOCK_IO2_PROTOCOL            BlockIo2;
   EFI_DISK_INFO_PROTOCOL            DiskInfo;
 
+  //
+  // The BlockIo2 requests of the namespace which are not completed yet.
+  //
+  LIST_ENTRY                        AsyncQueue;
+
   EFI_LBA                           NumBlocks;
 
   CHAR16                            ModelName[80];
@@ -188,6 +225,13 @@ struct _NVME_DEVICE_PRIVATE_DATA {
       NVME_DEVICE_PRIVATE_DATA_SIGNATURE \
       )
 
+#define NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2(a) \
+  CR (a, \
+      NVME_DEVICE_PRIVATE_DATA, \
+      BlockIo2, \
+      NVME_DEVICE_PRIVATE_DATA_SIGNATURE \
+      )
+
 #define NVME_DEVICE_PRIVATE_DATA_FROM_DISK_INFO(a) \
   CR (a, \
       NVME_DEVICE_PRIVATE_DATA, \
@@ -195,6 +239,88 @@ struct _NVME_DEVICE_PRIVATE_DATA {
       NVME_DEVICE_PRIVATE_DATA_SIGNATURE \
       )
 
+//
+// Nvme block I/O 2 request.
+//
+#define NVME_BLKIO2_REQUEST_SIGNATURE      SIGNATURE_32 ('N', 'B', '2', 'R')
+
+typedef struct {
+  UINT32                                   Signature;
+  LIST_ENTRY                               Link;
+
+  EFI_BLOCK_IO2_TOKEN                      *Token;
+  //
+  // The subtasks of the request which are sent to the controller and not
+  // completed yet, and the number of the subtasks which are not sent yet.
+  //
+  LIST_ENTRY                               SubtasksQueue;
+  UINTN                                    UnsubmittedSubtaskNum;
+} NVME_BLKIO2_REQUEST;
+
+#define NVME_BLKIO2_REQUEST_FROM_LINK(a) \
+  CR (a, NVME_BLKIO2_REQUEST, Link, NVME_BLKIO2_REQUEST_SIGNATURE)
+
+//
+// Nvme read or write command of a block I/O 2 request. A request is split in
+// several subtasks when it is larger than the maximum data transfer size.
+//
+#define NVME_BLKIO2_SUBTASK_SIGNATURE      SIGNATURE_32 ('N', 'B', '2', 'S')
+
+typedef struct {
+  UINT32                                   Signature;
+  LIST_ENTRY                               Link;
+
+  UINT32                                   NamespaceId;
+  NVM_EXPRESS_PASS_THRU_COMMAND_PACKET     CommandPacket;
+  NVM_EXPRESS_COMMAND                      Command;
+  NVM_EXPRESS_RESPONSE                     Response;
+  //
+  // The BlockIo2 request this subtask belongs to.
+  //
+  NVME_BLKIO2_REQUEST                      *BlockIo2Request;
+} NVME_BLKIO2_SUBTASK;
+
+#define NVME_BLKIO2_SUBTASK_FROM_LINK(a) \
+  CR (a, NVME_BLKIO2_SUBTASK, Link, NVME_BLKIO2_SUBTASK_SIGNATURE)
+
+//
+// Nvme asynchronous passthru request.
+//
+#define NVME_PASS_THRU_ASYNC_REQ_SIG       SIGNATURE_32 ('N', 'P', 'R', 'Q')
+
+typedef struct {
+  UINT32                                   Signature;
+  LIST_ENTRY                               Link;
+
+  NVM_EXPRESS_PASS_THRU_COMMAND_PACKET     *Packet;
+  UINT16                                   CommandId;
+  VOID                                     *MapPrpList;
+  UINTN                                    PrpListNo;
+  VOID                                     *PrpListHost;
+  VOID                                     *MapData;
+  VOID                                     *MapMeta;
+  EFI_EVENT                                CallerEvent;
+  //
+  // The BlockIo2 subtask of the command, which is completed directly instead
+  // of signaling CallerEvent.
+  //
+  NVME_BLKIO2_SUBTASK                      *Subtask;
+  //
+  // The time left before the command is failed, in 100ns units. 0 means the
+  // command never times out.
+  //
+  UINT64                                   Timeout;
+  //
+  // The command timed out and its caller was completed. The entry and the
+  // buffers of the command stay reserved until the controller completes it or
+  // is reset, as it may still transfer the data and post a completion.
+  //
+  BOOLEAN                                  TimedOut;
+} NVME_PASS_THRU_ASYNC_REQ;
+
+#define NVME_PASS_THRU_ASYNC_REQ_FROM_THIS(a) \
+  CR (a, NVME_PASS_THRU_ASYNC_REQ, Link, NVME_PASS_THRU_ASYNC_REQ_SIG)
+
 /**
   Retrieves a Unicode string that is the user readable name of the driver.
 
@@ -611,4 +737,113 @@ NvmExpressBuildDevicePath (
   IN OUT EFI_DEVICE_PATH_PROTOCOL                    **DevicePath
   );
 
+/**
+  Dump the execution status from a given completion queue entry.
+
+  @param[in]     Cq               A pointer to the NVME_CQ item.
+
+**/
+VOID
+NvmeDumpStatus (
+  IN NVME_CQ             *Cq
+  );
+
+/**
+  Sends an NVM Express Command Packet to an NVM Express controller or namespace.
+
+  This is NvmExpressPassThru() with one more way to send a nonblocking I/O
+  command: if Subtask is not NULL, the command is sent to the asynchronous I/O
+  queue and the subtask is completed by ProcessAsyncTaskList() when the command
+  completes or times out, without any event.
+
+  @param[in]     This                A pointer to the NVM_EXPRESS_PASS_THRU_PROTOCOL instance.
+  @param[in]     NamespaceId         Is a 32 bit Namespace ID to which the Express HCI command packet will be sent.
+  @param[in,out] Packet              A pointer to the NVM Express HCI Command Packet to send to the NVMe namespace specified
+                                     by NamespaceId.
+  @param[in]     Event               If Event is not NULL, then nonblocking I/O is performed, and Event will be signaled
+                                     when the NVM Express Command Packet completes.
+  @param[in]     Subtask             If Subtask is not NULL, then nonblocking I/O is performed, and the subtask is
+                                     completed when the NVM Express Command Packet completes.
+
+  @return The status of NvmExpressPassThru().
+
+**/
+EFI_STATUS
+NvmExpressPassThruInternal (
+  IN     NVM_EXPRESS_PASS_THRU_PROTOCOL              *This,
+  IN     UINT32                                      NamespaceId,
+  IN OUT NVM_EXPRESS_PASS_THRU_COMMAND_PACKET        *Packet,
+  IN     EFI_EVENT                                   Event    OPTIONAL,
+  IN     NVME_BLKIO2_SUBTASK                         *Subtask OPTIONAL
+  );
+
+/**
+  Complete a subtask of a BlockIo2 request, and the request with its last
+  subtask.
+
+  It is called at TPL_NOTIFY, which is the TPL at which the subtask lists are
+  updated.
+
+  @param[in]  Subtask   The subtask to complete.
+  @param[in]  Status    EFI_SUCCESS if the command of the subtask completed, in
+                        which case its completion status is checked, or the
+                        error which failed the subtask.
+
+**/
+VOID
+NvmeCompleteSubtask (
+  IN NVME_BLKIO2_SUBTASK                *Subtask,
+  IN EFI_STATUS                         Status
+  );
+
+/**
+  Call back function when the timer event is signaled.
+
+  It completes the commands of the asynchronous I/O queue which are finished,
+  and fails the ones which timed out, then sends the queued BlockIo2 subtasks
+  while the queue has free entries.
+
+  @param[in]  Event     The Event this notify function registered to.
+  @param[in]  Context   Pointer to the context data registered to the
+                        Event.
+
+**/
+VOID
+EFIAPI
+ProcessAsyncTaskList (
+  IN EFI_EVENT                    Event,
+  IN VOID*                        Context
+  );
+
+/**
+  Wait until all the commands of the asynchronous I/O queue are completed,
+  including the BlockIo2 subtasks which are not sent to the controller yet.
+
+  The queue is processed by the caller, so this function may be called at
+  any TPL up to TPL_CALLBACK. The timer still runs at those TPLs, so the
+  commands which never complete are failed after their timeout. The commands
+  which timed out are not waited for, their callers are completed already.
+
+  @param[in]  Private   The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeWaitAsyncQueueEmpty (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private
+  );
+
+/**
+  Release the commands of the asynchronous I/O queue which timed out.
+
+  The controller must be disabled, so that it does not transfer data for the
+  commands nor post their completions any more.
+
+  @param[in]  Private   The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeReleaseTimedOutCommands (
+  IN NVME_CONTROLLER_PRIVATE_DATA       *Private
+  );
+
 #endif
@@ -55,7 +55,6 @@ ReadSectors (
   CommandPacket.NvmeResponse = &Response;
 
   CommandPacket.NvmeCmd->Cdw0.Opcode = NVME_IO_READ_OPC;
-  CommandPacket.NvmeCmd->Cdw0.Cid    = Controller->Cid[1]++;
   CommandPacket.NvmeCmd->Nsid        = Device->NamespaceId;
   CommandPacket.TransferBuffer       = (VOID *)(UINTN)Buffer;
 
@@ -120,7 +119,6 @@ WriteSectors (
   CommandPacket.NvmeResponse = &Response;
 
   CommandPacket.NvmeCmd->Cdw0.Opcode = NVME_IO_WRITE_OPC;
-  CommandPacket.NvmeCmd->Cdw0.Cid    = Controller->Cid[1]++;
   CommandPacket.NvmeCmd->Nsid  = Device->NamespaceId;
   CommandPacket.TransferBuffer = (VOID *)(UINTN)Buffer;
 
@@ -296,7 +294,6 @@ NvmeFlush (
   CommandPacket.NvmeResponse = &Response;
 
   CommandPacket.NvmeCmd->Cdw0.Opcode = NVME_IO_FLUSH_OPC;
-  CommandPacket.NvmeCmd->Cdw0.Cid    = Controller->Cid[1]++;
   CommandPacket.NvmeCmd->Nsid  = Device->NamespaceId;
   CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
   CommandPacket.QueueId        = NVME_IO_QUEUE;
@@ -312,6 +309,216 @@ NvmeFlush (
   return Status;
 }
 
+/**
+  Complete a subtask of a BlockIo2 request, and the request with its last
+  subtask.
+
+  It is called at TPL_NOTIFY, which is the TPL at which the subtask lists are
+  updated.
+
+  @param[in]  Subtask   The subtask to complete.
+  @param[in]  Status    EFI_SUCCESS if the command of the subtask completed, in
+                        which case its completion status is checked, or the
+                        error which failed the subtask.
+
+**/
+VOID
+NvmeCompleteSubtask (
+  IN NVME_BLKIO2_SUBTASK                *Subtask,
+  IN EFI_STATUS                         Status
+  )
+{
+  NVME_BLKIO2_REQUEST         *Request;
+  NVME_CQ                     *Completion;
+  EFI_BLOCK_IO2_TOKEN         *Token;
+
+  Completion = (NVME_CQ *) &Subtask->Response;
+  Request    = Subtask->BlockIo2Request;
+  Token      = Request->Token;
+
+  if (EFI_ERROR (Status)) {
+    Token->TransactionStatus = EFI_DEVICE_ERROR;
+  } else if ((Completion->Sct != 0) || (Completion->Sc != 0)) {
+    Token->TransactionStatus = EFI_DEVICE_ERROR;
+
+    //
+    // Dump completion entry status for debugging.
+    //
+    DEBUG_CODE_BEGIN();
+      NvmeDumpStatus (Completion);
+    DEBUG_CODE_END();
+  }
+
+  RemoveEntryList (&Subtask->Link);
+  FreePool (Subtask);
+
+  //
+  // The request is completed with its last subtask.
+  //
+  if (IsListEmpty (&Request->SubtasksQueue) && (Request->UnsubmittedSubtaskNum == 0)) {
+    //
+    // Remove the BlockIo2 request from the device asynchronous queue.
+    //
+    RemoveEntryList (&Request->Link);
+    FreePool (Request);
+    gBS->SignalEvent (Token->Event);
+  }
+}
+
+/**
+  Create the subtask of a BlockIo2 request which reads or writes some blocks.
+
+  @param  Device                 The pointer to the NVME_DEVICE_PRIVATE_DATA data structure.
+  @param  Request                The BlockIo2 request the subtask belongs to.
+  @param  Opcode                 NVME_IO_READ_OPC or NVME_IO_WRITE_OPC.
+  @param  Buffer                 The buffer of the data.
+  @param  Lba                    The start block number.
+  @param  Blocks                 Total block number to be transferred.
+
+  @return The subtask, or NULL if there are not enough resources to create it.
+
+**/
+NVME_BLKIO2_SUBTASK *
+NvmeCreateSubtask (
+  IN NVME_DEVICE_PRIVATE_DATA           *Device,
+  IN NVME_BLKIO2_REQUEST                *Request,
+  IN UINT8                              Opcode,
+  IN UINT64                             Buffer,
+  IN UINT64                             Lba,
+  IN UINT32                             Blocks
+  )
+{
+  NVME_BLKIO2_SUBTASK                      *Subtask;
+
+  Subtask = AllocateZeroPool (sizeof (NVME_BLKIO2_SUBTASK));
+  if (Subtask == NULL) {
+    return NULL;
+  }
+
+  Subtask->Signature       = NVME_BLKIO2_SUBTASK_SIGNATURE;
+  Subtask->NamespaceId     = Device->NamespaceId;
+  Subtask->BlockIo2Request = Request;
+
+  Subtask->CommandPacket.NvmeCmd      = &Subtask->Command;
+  Subtask->CommandPacket.NvmeResponse = &Subtask->Response;
+
+  Subtask->Command.Cdw0.Opcode          = Opcode;
+  Subtask->Command.Nsid                 = Device->NamespaceId;
+  Subtask->CommandPacket.TransferBuffer = (VOID *)(UINTN)Buffer;
+
+  Subtask->CommandPacket.TransferLength = Blocks * Device->Media.BlockSize;
+  Subtask->CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
+  Subtask->CommandPacket.QueueId        = NVME_IO_QUEUE;
+
+  Subtask->Command.Cdw10 = (UINT32)Lba;
+  Subtask->Command.Cdw11 = (UINT32)(Lba >> 32);
+  Subtask->Command.Cdw12 = (Blocks - 1) & 0xFFFF;
+
+  Subtask->Command.Flags = CDW10_VALID | CDW11_VALID | CDW12_VALID;
+
+  return Subtask;
+}
+
+/**
+  Nonblocking read or write of some blocks.
+
+  The request is split in subtasks of at most the maximum data transfer size,
+  which are queued in the controller and sent to the asynchronous I/O queue as
+  long as it has free entries, so that many of them are in flight at the same
+  time. The token event is signaled when all the subtasks are completed.
+
+  @param  Device                 The pointer to the NVME_DEVICE_PRIVATE_DATA data structure.
+  @param  Opcode                 NVME_IO_READ_OPC or NVME_IO_WRITE_OPC.
+  @param  Buffer                 The buffer of the data.
+  @param  Lba                    The start block number.
+  @param  Blocks                 Total block number to be transferred.
+  @param  Token                  A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS            The request is queued.
+  @retval EFI_OUT_OF_RESOURCES   The request could not be queued due to a lack of resources.
+
+**/
+EFI_STATUS
+NvmeAsyncIo (
+  IN NVME_DEVICE_PRIVATE_DATA           *Device,
+  IN UINT8                              Opcode,
+  IN VOID                               *Buffer,
+  IN UINT64                             Lba,
+  IN UINTN                              Blocks,
+  IN EFI_BLOCK_IO2_TOKEN                *Token
+  )
+{
+  UINT32                           BlockSize;
+  NVME_CONTROLLER_PRIVATE_DATA     *Controller;
+  UINT32                           MaxTransferBlocks;
+  UINT32                           TransferBlocks;
+  NVME_BLKIO2_REQUEST              *BlkIo2Req;
+  NVME_BLKIO2_SUBTASK              *Subtask;
+  LIST_ENTRY                       SubtaskList;
+  LIST_ENTRY                       *Link;
+  EFI_TPL                          OldTpl;
+
+  Controller = Device->Controller;
+  BlockSize  = Device->Media.BlockSize;
+
+  if (Controller->ControllerData->Mdts != 0) {
+    MaxTransferBlocks = (1 << (Controller->ControllerData->Mdts)) * (1 << (Controller->Cap.Mpsmin + 12)) / BlockSize;
+  } else {
+    MaxTransferBlocks = 1024;
+  }
+
+  BlkIo2Req = AllocateZeroPool (sizeof (NVME_BLKIO2_REQUEST));
+  if (BlkIo2Req == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  BlkIo2Req->Signature = NVME_BLKIO2_REQUEST_SIGNATURE;
+  BlkIo2Req->Token     = Token;
+  InitializeListHead (&BlkIo2Req->SubtasksQueue);
+
+  //
+  // All the subtasks are created before any of them is sent, so that the
+  // request can't be completed by its first subtasks.
+  //
+  InitializeListHead (&SubtaskList);
+  while (Blocks > 0) {
+    TransferBlocks = (UINT32) MIN (Blocks, MaxTransferBlocks);
+    Subtask = NvmeCreateSubtask (Device, BlkIo2Req, Opcode, (UINT64)(UINTN)Buffer, Lba, TransferBlocks);
+    if (Subtask == NULL) {
+      while (!IsListEmpty (&SubtaskList)) {
+        Subtask = NVME_BLKIO2_SUBTASK_FROM_LINK (GetFirstNode (&SubtaskList));
+        RemoveEntryList (&Subtask->Link);
+        FreePool (Subtask);
+      }
+      FreePool (BlkIo2Req);
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    InsertTailList (&SubtaskList, &Subtask->Link);
+    BlkIo2Req->UnsubmittedSubtaskNum++;
+
+    Blocks -= TransferBlocks;
+    Buffer  = (VOID *)(UINTN)((UINT64)(UINTN)Buffer + TransferBlocks * BlockSize);
+    Lba    += TransferBlocks;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  InsertTailList (&Device->AsyncQueue, &BlkIo2Req->Link);
+  while (!IsListEmpty (&SubtaskList)) {
+    Link = GetFirstNode (&SubtaskList);
+    RemoveEntryList (Link);
+    InsertTailList (&Controller->UnsubmittedSubtasks, Link);
+  }
+
+  //
+  // Send the subtasks now rather than at the next tick of the timer.
+  //
+  ProcessAsyncTaskList (NULL, Controller);
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
 
 /**
   Reset the Block Device.
@@ -349,6 +556,11 @@ NvmeBlockIoReset (
 
   Private = Device->Controller;
 
+  //
+  // The queues are created again, so the commands in flight are completed first.
+  //
+  NvmeWaitAsyncQueueEmpty (Private);
+
   Status  = NvmeControllerInit (Private);
 
   gBS->RestoreTPL (OldTpl);
@@ -561,3 +773,336 @@ NvmeBlockIoFlushBlocks (
 
   return Status;
 }
+
+/**
+  Reset the block device hardware.
+
+  @param[in]  This                 Indicates a pointer to the calling context.
+  @param[in]  ExtendedVerification Indicates that the driver may perform a more
+                                   exhausive verfication operation of the
+                                   device during reset.
+
+  @retval EFI_SUCCESS          The device was reset.
+  @retval EFI_DEVICE_ERROR     The device is not functioning properly and could
+                               not be reset.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeBlockIoResetEx (
+  IN  EFI_BLOCK_IO2_PROTOCOL  *This,
+  IN  BOOLEAN                 ExtendedVerification
+  )
+{
+  EFI_STATUS                      Status;
+  NVME_DEVICE_PRIVATE_DATA        *Device;
+  NVME_CONTROLLER_PRIVATE_DATA    *Private;
+  EFI_TPL                         OldTpl;
+
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // For Nvm Express subsystem, reset block device means reset controller.
+  //
+  OldTpl  = gBS->RaiseTPL (TPL_CALLBACK);
+
+  Device  = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2 (This);
+
+  Private = Device->Controller;
+
+  //
+  // The queues are created again, so the commands in flight are completed first.
+  //
+  NvmeWaitAsyncQueueEmpty (Private);
+
+  Status  = NvmeControllerInit (Private);
+
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+/**
+  Read BufferSize bytes from Lba into Buffer.
+
+  This function reads the requested number of blocks from the device. All the
+  blocks are read, or an error is returned.
+  If EFI_DEVICE_ERROR, EFI_NO_MEDIA,_or EFI_MEDIA_CHANGED is returned and
+  non-blocking I/O is being used, the Event associated with this request will
+  not be signaled.
+
+  @param[in]       This       Indicates a pointer to the calling context.
+  @param[in]       MediaId    Id of the media, changes every time the media is
+                              replaced.
+  @param[in]       Lba        The starting Logical Block Address to read from.
+  @param[in, out]  Token      A pointer to the token associated with the transaction.
+  @param[in]       BufferSize Size of Buffer, must be a multiple of device block size.
+  @param[out]      Buffer     A pointer to the destination buffer for the data. The
+                              caller is responsible for either having implicit or
+                              explicit ownership of the buffer.
+
+  @retval EFI_SUCCESS           The read request was queued if Token->Event is
+                                not NULL.The data was read correctly from the
+                                device if the Token->Event is NULL.
+  @retval EFI_DEVICE_ERROR      The device reported an error while performing
+                                the read.
+  @retval EFI_NO_MEDIA          There is no media in the device.
+  @retval EFI_MEDIA_CHANGED     The MediaId is not for the current media.
+  @retval EFI_BAD_BUFFER_SIZE   The BufferSize parameter is not a multiple of the
+                                intrinsic block size of the device.
+  @retval EFI_INVALID_PARAMETER The read request contains LBAs that are not valid,
+                                or the buffer is not on proper alignment.
+  @retval EFI_OUT_OF_RESOURCES  The request could not be completed due to a lack
+                                of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeBlockIoReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+     OUT VOID                  *Buffer
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA          *Device;
+  EFI_STATUS                        Status;
+  EFI_BLOCK_IO_MEDIA                *Media;
+  UINTN                             BlockSize;
+  UINTN                             NumberOfBlocks;
+  UINTN                             IoAlign;
+  EFI_TPL                           OldTpl;
+
+  //
+  // Check parameters.
+  //
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Media = This->Media;
+
+  if (MediaId != Media->MediaId) {
+    return EFI_MEDIA_CHANGED;
+  }
+
+  if (Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (BufferSize == 0) {
+    if ((Token != NULL) && (Token->Event != NULL)) {
+      Token->TransactionStatus = EFI_SUCCESS;
+      gBS->SignalEvent (Token->Event);
+    }
+    return EFI_SUCCESS;
+  }
+
+  BlockSize = Media->BlockSize;
+  if ((BufferSize % BlockSize) != 0) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  NumberOfBlocks  = BufferSize / BlockSize;
+  if ((Lba + NumberOfBlocks - 1) > Media->LastBlock) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  IoAlign = Media->IoAlign;
+  if (IoAlign > 0 && (((UINTN) Buffer & (IoAlign - 1)) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  Device = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2 (This);
+
+  if ((Token != NULL) && (Token->Event != NULL)) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    Status = NvmeAsyncIo (Device, NVME_IO_READ_OPC, Buffer, Lba, NumberOfBlocks, Token);
+  } else {
+    Status = NvmeRead (Device, Buffer, Lba, NumberOfBlocks);
+  }
+
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+/**
+  Write BufferSize bytes from Lba into Buffer.
+
+  This function writes the requested number of blocks to the device. All blocks
+  are written, or an error is returned.If EFI_DEVICE_ERROR, EFI_NO_MEDIA,
+  EFI_WRITE_PROTECTED or EFI_MEDIA_CHANGED is returned and non-blocking I/O is
+  being used, the Event associated with this request will not be signaled.
+
+  @param[in]       This       Indicates a pointer to the calling context.
+  @param[in]       MediaId    The media ID that the write request is for.
+  @param[in]       Lba        The starting logical block address to be written.
+                              The caller is responsible for writing to only
+                              legitimate locations.
+  @param[in, out]  Token      A pointer to the token associated with the
+                              transaction.
+  @param[in]       BufferSize Size of Buffer, must be a multiple of device block
+                              size.
+  @param[in]       Buffer     A pointer to the source buffer for the data.
+
+  @retval EFI_SUCCESS           The write request was queued if Event is not
+                                NULL.
+                                The data was written correctly to the device if
+                                the Event is NULL.
+  @retval EFI_WRITE_PROTECTED   The device can not be written to.
+  @retval EFI_NO_MEDIA          There is no media in the device.
+  @retval EFI_MEDIA_CHNAGED     The MediaId does not matched the current device.
+  @retval EFI_DEVICE_ERROR      The device reported an error while performing
+                                the write.
+  @retval EFI_BAD_BUFFER_SIZE   The Buffer was not a multiple of the block size
+                                of the device.
+  @retval EFI_INVALID_PARAMETER The write request contains LBAs that are not
+                                valid, or the buffer is not on proper
+                                alignment.
+  @retval EFI_OUT_OF_RESOURCES  The request could not be completed due to a
+                                lack of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeBlockIoWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL  *This,
+  IN     UINT32                  MediaId,
+  IN     EFI_LBA                 Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN     *Token,
+  IN     UINTN                   BufferSize,
+  IN     VOID                    *Buffer
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA          *Device;
+  EFI_STATUS                        Status;
+  EFI_BLOCK_IO_MEDIA                *Media;
+  UINTN                             BlockSize;
+  UINTN                             NumberOfBlocks;
+  UINTN                             IoAlign;
+  EFI_TPL                           OldTpl;
+
+  //
+  // Check parameters.
+  //
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Media = This->Media;
+
+  if (MediaId != Media->MediaId) {
+    return EFI_MEDIA_CHANGED;
+  }
+
+  if (Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (BufferSize == 0) {
+    if ((Token != NULL) && (Token->Event != NULL)) {
+      Token->TransactionStatus = EFI_SUCCESS;
+      gBS->SignalEvent (Token->Event);
+    }
+    return EFI_SUCCESS;
+  }
+
+  BlockSize = Media->BlockSize;
+  if ((BufferSize % BlockSize) != 0) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  NumberOfBlocks  = BufferSize / BlockSize;
+  if ((Lba + NumberOfBlocks - 1) > Media->LastBlock) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  IoAlign = Media->IoAlign;
+  if (IoAlign > 0 && (((UINTN) Buffer & (IoAlign - 1)) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  Device = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2 (This);
+
+  if ((Token != NULL) && (Token->Event != NULL)) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    Status = NvmeAsyncIo (Device, NVME_IO_WRITE_OPC, Buffer, Lba, NumberOfBlocks, Token);
+  } else {
+    Status = NvmeWrite (Device, Buffer, Lba, NumberOfBlocks);
+  }
+
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+/**
+  Flush the Block Device.
+
+  If EFI_DEVICE_ERROR, EFI_NO_MEDIA,_EFI_WRITE_PROTECTED or EFI_MEDIA_CHANGED
+  is returned and non-blocking I/O is being used, the Event associated with
+  this request will not be signaled.
+
+  @param[in]      This     Indicates a pointer to the calling context.
+  @param[in,out]  Token    A pointer to the token associated with the
+                           transaction.
+
+  @retval EFI_SUCCESS          The flush request was queued if Event is not
+                               NULL.
+                               All outstanding data was written correctly to
+                               the device if the Event is NULL.
+  @retval EFI_DEVICE_ERROR     The device reported an error while writting back
+                               the data.
+  @retval EFI_WRITE_PROTECTED  The device cannot be written to.
+  @retval EFI_NO_MEDIA         There is no media in the device.
+  @retval EFI_MEDIA_CHANGED    The MediaId is not for the current media.
+  @retval EFI_OUT_OF_RESOURCES The request could not be completed due to a lack
+                               of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeBlockIoFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN      *Token
+  )
+{
+  NVME_DEVICE_PRIVATE_DATA          *Device;
+  EFI_STATUS                        Status;
+  EFI_TPL                           OldTpl;
+
+  //
+  // Check parameters.
+  //
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  Device = NVME_DEVICE_PRIVATE_DATA_FROM_BLOCK_IO2 (This);
+
+  //
+  // The flush only covers the writes which are completed, so the requests in
+  // flight are completed first.
+  //
+  NvmeWaitAsyncQueueEmpty (Device->Controller);
+
+  Status = NvmeFlush (Device);
+
+  gBS->RestoreTPL (OldTpl);
+
+  if (!EFI_ERROR (Status) && (Token != NULL) && (Token->Event != NULL)) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    gBS->SignalEvent (Token->Event);
+  }
+
+  return Status;
+}
@@ -582,7 +582,6 @@ NvmeIdentifyController (
   ZeroMem (&Response, sizeof(NVM_EXPRESS_RESPONSE));
 
   Command.Cdw0.Opcode = NVME_ADMIN_IDENTIFY_OPC;
-  Command.Cdw0.Cid    = Private->Cid[0]++;
   //
   // According to Nvm Express 1.1 spec Figure 38, When not used, the field shall be cleared to 0h.
   // For the Identify command, the Namespace Identifier is only used for the Namespace data structure.
@@ -643,7 +642,6 @@ NvmeIdentifyNamespace (
   CommandPacket.NvmeResponse = &Response;
 
   Command.Cdw0.Opcode = NVME_ADMIN_IDENTIFY_OPC;
-  Command.Cdw0.Cid    = Private->Cid[0]++;
   Command.Nsid        = NamespaceId;
   CommandPacket.TransferBuffer = Buffer;
   CommandPacket.TransferLength = sizeof (NVME_ADMIN_NAMESPACE_DATA);
@@ -667,12 +665,15 @@ NvmeIdentifyNamespace (
 }
 
 /**
-  Create io completion queue.
+  Create io completion queues.
+
+  One queue is created for the blocking I/O commands, and one for the
+  nonblocking I/O commands.
 
   @param  Private          The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
 
-  @return EFI_SUCCESS      Successfully create io completion queue.
-  @return EFI_DEVICE_ERROR Fail to create io completion queue.
+  @return EFI_SUCCESS      Successfully create io completion queues.
+  @return EFI_DEVICE_ERROR Fail to create io completion queues.
 
 **/
 EFI_STATUS
@@ -685,46 +686,56 @@ NvmeCreateIoCompletionQueue (
   NVM_EXPRESS_RESPONSE                     Response;
   EFI_STATUS                               Status;
   NVME_ADMIN_CRIOCQ                        CrIoCq;
-
-  ZeroMem (&CommandPacket, sizeof(NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
-  ZeroMem (&Command, sizeof(NVM_EXPRESS_COMMAND));
-  ZeroMem (&Response, sizeof(NVM_EXPRESS_RESPONSE));
-  ZeroMem (&CrIoCq, sizeof(NVME_ADMIN_CRIOCQ));
-
-  CommandPacket.NvmeCmd      = &Command;
-  CommandPacket.NvmeResponse = &Response;
-
-  Command.Cdw0.Opcode = NVME_ADMIN_CRIOCQ_OPC;
-  Command.Cdw0.Cid    = Private->Cid[0]++;
-  CommandPacket.TransferBuffer = Private->CqBufferPciAddr[1];
-  CommandPacket.TransferLength = EFI_PAGE_SIZE;
-  CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
-  CommandPacket.QueueId        = NVME_ADMIN_QUEUE;
-
-  CrIoCq.Qid   = NVME_IO_QUEUE;
-  CrIoCq.Qsize = NVME_CCQ_SIZE;
-  CrIoCq.Pc    = 1;
-  CopyMem (&CommandPacket.NvmeCmd->Cdw10, &CrIoCq, sizeof (NVME_ADMIN_CRIOCQ));
-  CommandPacket.NvmeCmd->Flags = CDW10_VALID | CDW11_VALID;
-
-  Status = Private->Passthru.PassThru (
-                               &Private->Passthru,
-                               0,
-                               0,
-                               &CommandPacket,
-                               NULL
-                               );
+  UINT16                                   Index;
+
+  Status = EFI_SUCCESS;
+
+  for (Index = NVME_IO_QUEUE; Index < NVME_MAX_QUEUES; Index++) {
+    ZeroMem (&CommandPacket, sizeof(NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
+    ZeroMem (&Command, sizeof(NVM_EXPRESS_COMMAND));
+    ZeroMem (&Response, sizeof(NVM_EXPRESS_RESPONSE));
+    ZeroMem (&CrIoCq, sizeof(NVME_ADMIN_CRIOCQ));
+
+    CommandPacket.NvmeCmd      = &Command;
+    CommandPacket.NvmeResponse = &Response;
+
+    Command.Cdw0.Opcode = NVME_ADMIN_CRIOCQ_OPC;
+    CommandPacket.TransferBuffer = Private->CqBufferPciAddr[Index];
+    CommandPacket.TransferLength = EFI_PAGE_SIZE;
+    CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
+    CommandPacket.QueueId        = NVME_ADMIN_QUEUE;
+
+    CrIoCq.Qid   = Index;
+    CrIoCq.Qsize = Private->QueueSize[Index];
+    CrIoCq.Pc    = 1;
+    CopyMem (&CommandPacket.NvmeCmd->Cdw10, &CrIoCq, sizeof (NVME_ADMIN_CRIOCQ));
+    CommandPacket.NvmeCmd->Flags = CDW10_VALID | CDW11_VALID;
+
+    Status = Private->Passthru.PassThru (
+                                 &Private->Passthru,
+                                 0,
+                                 0,
+                                 &CommandPacket,
+                                 NULL
+                                 );
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
 
   return Status;
 }
 
 /**
-  Create io submission queue.
+  Create io submission queues.
+
+  One queue is created for the blocking I/O commands, and one for the
+  nonblocking I/O commands.
 
   @param  Private          The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
 
-  @return EFI_SUCCESS      Successfully create io submission queue.
-  @return EFI_DEVICE_ERROR Fail to create io submission queue.
+  @return EFI_SUCCESS      Successfully create io submission queues.
+  @return EFI_DEVICE_ERROR Fail to create io submission queues.
 
 **/
 EFI_STATUS
@@ -737,37 +748,44 @@ NvmeCreateIoSubmissionQueue (
   NVM_EXPRESS_RESPONSE                     Response;
   EFI_STATUS                               Status;
   NVME_ADMIN_CRIOSQ                        CrIoSq;
-
-  ZeroMem (&CommandPacket, sizeof(NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
-  ZeroMem (&Command, sizeof(NVM_EXPRESS_COMMAND));
-  ZeroMem (&Response, sizeof(NVM_EXPRESS_RESPONSE));
-  ZeroMem (&CrIoSq, sizeof(NVME_ADMIN_CRIOSQ));
-
-  CommandPacket.NvmeCmd      = &Command;
-  CommandPacket.NvmeResponse = &Response;
-
-  Command.Cdw0.Opcode = NVME_ADMIN_CRIOSQ_OPC;
-  Command.Cdw0.Cid    = Private->Cid[0]++;
-  CommandPacket.TransferBuffer = Private->SqBufferPciAddr[1];
-  CommandPacket.TransferLength = EFI_PAGE_SIZE;
-  CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
-  CommandPacket.QueueId        = NVME_ADMIN_QUEUE;
-
-  CrIoSq.Qid   = NVME_IO_QUEUE;
-  CrIoSq.Qsize = NVME_CSQ_SIZE;
-  CrIoSq.Pc    = 1;
-  CrIoSq.Cqid  = NVME_IO_QUEUE;
-  CrIoSq.Qprio = 0;
-  CopyMem (&CommandPacket.NvmeCmd->Cdw10, &CrIoSq, sizeof (NVME_ADMIN_CRIOSQ));
-  CommandPacket.NvmeCmd->Flags = CDW10_VALID | CDW11_VALID;
-
-  Status = Private->Passthru.PassThru (
-                               &Private->Passthru,
-                               0,
-                               0,
-                               &CommandPacket,
-                               NULL
-                               );
+  UINT16                                   Index;
+
+  Status = EFI_SUCCESS;
+
+  for (Index = NVME_IO_QUEUE; Index < NVME_MAX_QUEUES; Index++) {
+    ZeroMem (&CommandPacket, sizeof(NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
+    ZeroMem (&Command, sizeof(NVM_EXPRESS_COMMAND));
+    ZeroMem (&Response, sizeof(NVM_EXPRESS_RESPONSE));
+    ZeroMem (&CrIoSq, sizeof(NVME_ADMIN_CRIOSQ));
+
+    CommandPacket.NvmeCmd      = &Command;
+    CommandPacket.NvmeResponse = &Response;
+
+    Command.Cdw0.Opcode = NVME_ADMIN_CRIOSQ_OPC;
+    CommandPacket.TransferBuffer = Private->SqBufferPciAddr[Index];
+    CommandPacket.TransferLength = EFI_PAGE_SIZE;
+    CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
+    CommandPacket.QueueId        = NVME_ADMIN_QUEUE;
+
+    CrIoSq.Qid   = Index;
+    CrIoSq.Qsize = Private->QueueSize[Index];
+    CrIoSq.Pc    = 1;
+    CrIoSq.Cqid  = Index;
+    CrIoSq.Qprio = 0;
+    CopyMem (&CommandPacket.NvmeCmd->Cdw10, &CrIoSq, sizeof (NVME_ADMIN_CRIOSQ));
+    CommandPacket.NvmeCmd->Flags = CDW10_VALID | CDW11_VALID;
+
+    Status = Private->Passthru.PassThru (
+                                 &Private->Passthru,
+                                 0,
+                                 0,
+                                 &CommandPacket,
+                                 NULL
+                                 );
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
 
   return Status;
 }
@@ -848,15 +866,38 @@ NvmeControllerInit (
   //
   ASSERT ((Private->Cap.Mpsmin + 12) <= EFI_PAGE_SHIFT);
 
-  Private->Cid[0] = 0;
-  Private->Cid[1] = 0;
-
   Status = NvmeDisableController (Private);
 
   if (EFI_ERROR(Status)) {
     return Status;
   }
 
+  //
+  // The disabled controller does not use the buffers of the asynchronous
+  // commands which timed out any more.
+  //
+  NvmeReleaseTimedOutCommands (Private);
+
+  //
+  // The controller starts with empty queues, so the queue indices and the
+  // phase tags are reset, and the completion queues are cleared of the entries
+  // posted before the controller was disabled.
+  //
+  ZeroMem (Private->Buffer, EFI_PAGES_TO_SIZE (6));
+  ZeroMem (Private->SqTdbl, sizeof (Private->SqTdbl));
+  ZeroMem (Private->CqHdbl, sizeof (Private->CqHdbl));
+  ZeroMem (Private->Pt, sizeof (Private->Pt));
+  ZeroMem (Private->Cid, sizeof (Private->Cid));
+
+  //
+  // The asynchronous I/O queue is the deep one, as many nonblocking commands
+  // may be in flight. It fits in one page, and its size is limited by the
+  // maximum queue size of the controller.
+  //
+  Private->QueueSize[NVME_ADMIN_QUEUE]    = NVME_ASQ_SIZE;
+  Private->QueueSize[NVME_IO_QUEUE]       = NVME_CSQ_SIZE;
+  Private->QueueSize[NVME_ASYNC_IO_QUEUE] = (UINT16) MIN (NVME_ASYNC_CSQ_SIZE, Private->Cap.Mqes);
+
   //
   // set number of entries admin submission & completion queues.
   //
@@ -888,6 +929,10 @@ NvmeControllerInit (
   Private->SqBufferPciAddr[1] = (NVME_SQ *)(UINTN)(Private->BufferPciAddr + 2 * EFI_PAGE_SIZE);
   Private->CqBuffer[1]        = (NVME_CQ *)(UINTN)(Private->Buffer + 3 * EFI_PAGE_SIZE);
   Private->CqBufferPciAddr[1] = (NVME_CQ *)(UINTN)(Private->BufferPciAddr + 3 * EFI_PAGE_SIZE);
+  Private->SqBuffer[2]        = (NVME_SQ *)(UINTN)(Private->Buffer + 4 * EFI_PAGE_SIZE);
+  Private->SqBufferPciAddr[2] = (NVME_SQ *)(UINTN)(Private->BufferPciAddr + 4 * EFI_PAGE_SIZE);
+  Private->CqBuffer[2]        = (NVME_CQ *)(UINTN)(Private->Buffer + 5 * EFI_PAGE_SIZE);
+  Private->CqBufferPciAddr[2] = (NVME_CQ *)(UINTN)(Private->BufferPciAddr + 5 * EFI_PAGE_SIZE);
 
   DEBUG ((EFI_D_INFO, "Private->Buffer = [%016X]\n", (UINT64)(UINTN)Private->Buffer));
   DEBUG ((EFI_D_INFO, "Admin Submission Queue size (Aqa.Asqs) = [%08X]\n", Aqa.Asqs));
@@ -896,6 +941,9 @@ NvmeControllerInit (
   DEBUG ((EFI_D_INFO, "Admin Completion Queue (CqBuffer[0]) = [%016X]\n", Private->CqBuffer[0]));
   DEBUG ((EFI_D_INFO, "I/O   Submission Queue (SqBuffer[1]) = [%016X]\n", Private->SqBuffer[1]));
   DEBUG ((EFI_D_INFO, "I/O   Completion Queue (CqBuffer[1]) = [%016X]\n", Private->CqBuffer[1]));
+  DEBUG ((EFI_D_INFO, "Async I/O Submission Queue (SqBuffer[2]) = [%016X]\n", Private->SqBuffer[2]));
+  DEBUG ((EFI_D_INFO, "Async I/O Completion Queue (CqBuffer[2]) = [%016X]\n", Private->CqBuffer[2]));
+  DEBUG ((EFI_D_INFO, "Async I/O Queue size = [%04X]\n", Private->QueueSize[2]));
 
   //
   // Program admin queue attributes.
@@ -930,7 +978,7 @@ NvmeControllerInit (
   }
 
   //
-  // Create one I/O completion queue.
+  // Create the I/O completion queues.
   //
   Status = NvmeCreateIoCompletionQueue (Private);
   if (EFI_ERROR(Status)) {
@@ -938,7 +986,7 @@ NvmeControllerInit (
   }
 
   //
-  // Create one I/O Submission queue.
+  // Create the I/O Submission queues.
   //
   Status = NvmeCreateIoSubmissionQueue (Private);
   if (EFI_ERROR(Status)) {
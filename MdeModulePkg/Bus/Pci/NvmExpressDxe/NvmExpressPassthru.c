@@ -25,7 +25,7 @@
 
 GLOBAL_REMOVE_IF_UNREFERENCED NVM_EXPRESS_PASS_THRU_MODE gNvmExpressPassThruMode = {
   0,
-  NVM_EXPRESS_PASS_THRU_ATTRIBUTES_PHYSICAL | NVM_EXPRESS_PASS_THRU_ATTRIBUTES_CMD_SET_NVME,
+  NVM_EXPRESS_PASS_THRU_ATTRIBUTES_PHYSICAL | NVM_EXPRESS_PASS_THRU_ATTRIBUTES_NONBLOCKIO | NVM_EXPRESS_PASS_THRU_ATTRIBUTES_CMD_SET_NVME,
   sizeof (UINTN),
   0x10000,
   0,
@@ -219,6 +219,9 @@ NvmeDumpStatus (
   Create PRP lists for data transfer which is larger than 2 memory pages.
   Note here we calcuate the number of required PRP lists and allocate them at one time.
 
+  The last entry of every PRP list but the last one points to the next PRP list,
+  so such a list describes one page less than the number of its entries.
+
   @param[in]     PciIo               A pointer to the EFI_PCI_IO_PROTOCOL instance.
   @param[in]     PhysicalAddr        The physical base address of data buffer.
   @param[in]     Pages               The number of pages to be transfered.
@@ -243,7 +246,6 @@ NvmeCreatePrpList (
   UINT64                      PrpListBase;
   UINTN                       PrpListIndex;
   UINTN                       PrpEntryIndex;
-  UINT64                      Remainder;
   EFI_PHYSICAL_ADDRESS        PrpListPhyAddr;
   UINTN                       Bytes;
   EFI_STATUS                  Status;
@@ -256,10 +258,7 @@ NvmeCreatePrpList (
   //
   // Calculate total PrpList number.
   //
-  *PrpListNo = (UINTN)DivU64x64Remainder ((UINT64)Pages, (UINT64)PrpEntryNo, &Remainder);
-  if (Remainder != 0) {
-    *PrpListNo += 1;
-  }
+  *PrpListNo = (Pages - 2) / (PrpEntryNo - 1) + 1;
 
   Status = PciIo->AllocateBuffer (
                     PciIo,
@@ -293,7 +292,7 @@ NvmeCreatePrpList (
   //
   ZeroMem (*PrpListHost, Bytes);
   for (PrpListIndex = 0; PrpListIndex < *PrpListNo - 1; ++PrpListIndex) {
-    PrpListBase = *(UINT8*)PrpListHost + PrpListIndex * EFI_PAGE_SIZE;
+    PrpListBase = (UINT64)(UINTN)*PrpListHost + PrpListIndex * EFI_PAGE_SIZE;
 
     for (PrpEntryIndex = 0; PrpEntryIndex < PrpEntryNo; ++PrpEntryIndex) {
       if (PrpEntryIndex != PrpEntryNo - 1) {
@@ -302,6 +301,7 @@ NvmeCreatePrpList (
         //
         *((UINT64*)(UINTN)PrpListBase + PrpEntryIndex) = PhysicalAddr;
         PhysicalAddr += EFI_PAGE_SIZE;
+        Pages--;
       } else {
         //
         // Fill last PRP entries with next PRP List pointer.
@@ -313,8 +313,9 @@ NvmeCreatePrpList (
   //
   // Fill last PRP list.
   //
-  PrpListBase = *(UINT64*)PrpListHost + PrpListIndex * EFI_PAGE_SIZE;
-  for (PrpEntryIndex = 0; PrpEntryIndex < ((Remainder != 0) ? Remainder : PrpEntryNo); ++PrpEntryIndex) {
+  ASSERT (Pages <= PrpEntryNo);
+  PrpListBase = (UINT64)(UINTN)*PrpListHost + PrpListIndex * EFI_PAGE_SIZE;
+  for (PrpEntryIndex = 0; PrpEntryIndex < Pages; ++PrpEntryIndex) {
     *((UINT64*)(UINTN)PrpListBase + PrpEntryIndex) = PhysicalAddr;
     PhysicalAddr += EFI_PAGE_SIZE;
   }
@@ -328,46 +329,32 @@ EXIT:
 
 
 /**
-  Sends an NVM Express Command Packet to an NVM Express controller or namespace. This function supports
-  both blocking I/O and nonblocking I/O. The blocking I/O functionality is required, and the nonblocking
-  I/O functionality is optional.
+  Sends an NVM Express Command Packet to an NVM Express controller or namespace.
+
+  This is NvmExpressPassThru() with one more way to send a nonblocking I/O
+  command: if Subtask is not NULL, the command is sent to the asynchronous I/O
+  queue and the subtask is completed by ProcessAsyncTaskList() when the command
+  completes or times out, without any event.
 
   @param[in]     This                A pointer to the NVM_EXPRESS_PASS_THRU_PROTOCOL instance.
   @param[in]     NamespaceId         Is a 32 bit Namespace ID to which the Express HCI command packet will be sent.
-                                     A value of 0 denotes the NVM Express controller, a value of all 0FFh in the namespace
-                                     ID specifies that the command packet should be sent to all valid namespaces.
-  @param[in]     NamespaceUuid       Is a 64 bit Namespace UUID to which the Express HCI command packet will be sent.
-                                     A value of 0 denotes the NVM Express controller, a value of all 0FFh in the namespace
-                                     UUID specifies that the command packet should be sent to all valid namespaces.
   @param[in,out] Packet              A pointer to the NVM Express HCI Command Packet to send to the NVMe namespace specified
                                      by NamespaceId.
-  @param[in]     Event               If nonblocking I/O is not supported then Event is ignored, and blocking I/O is performed.
-                                     If Event is NULL, then blocking I/O is performed. If Event is not NULL and non blocking I/O
-                                     is supported, then nonblocking I/O is performed, and Event will be signaled when the NVM
-                                     Express Command Packet completes.
+  @param[in]     Event               If Event is not NULL, then nonblocking I/O is performed, and Event will be signaled
+                                     when the NVM Express Command Packet completes.
+  @param[in]     Subtask             If Subtask is not NULL, then nonblocking I/O is performed, and the subtask is
+                                     completed when the NVM Express Command Packet completes.
 
-  @retval EFI_SUCCESS                The NVM Express Command Packet was sent by the host. TransferLength bytes were transferred
-                                     to, or from DataBuffer.
-  @retval EFI_BAD_BUFFER_SIZE        The NVM Express Command Packet was not executed. The number of bytes that could be transferred
-                                     is returned in TransferLength.
-  @retval EFI_NOT_READY              The NVM Express Command Packet could not be sent because the controller is not ready. The caller
-                                     may retry again later.
-  @retval EFI_DEVICE_ERROR           A device error occurred while attempting to send the NVM Express Command Packet.
-  @retval EFI_INVALID_PARAMETER      Namespace, or the contents of NVM_EXPRESS_PASS_THRU_COMMAND_PACKET are invalid. The NVM
-                                     Express Command Packet was not sent, so no additional status information is available.
-  @retval EFI_UNSUPPORTED            The command described by the NVM Express Command Packet is not supported by the host adapter.
-                                     The NVM Express Command Packet was not sent, so no additional status information is available.
-  @retval EFI_TIMEOUT                A timeout occurred while waiting for the NVM Express Command Packet to execute.
+  @return The status of NvmExpressPassThru().
 
 **/
 EFI_STATUS
-EFIAPI
-NvmExpressPassThru (
+NvmExpressPassThruInternal (
   IN     NVM_EXPRESS_PASS_THRU_PROTOCOL              *This,
   IN     UINT32                                      NamespaceId,
-  IN     UINT64                                      NamespaceUuid,
   IN OUT NVM_EXPRESS_PASS_THRU_COMMAND_PACKET        *Packet,
-  IN     EFI_EVENT                                   Event OPTIONAL
+  IN     EFI_EVENT                                   Event    OPTIONAL,
+  IN     NVME_BLKIO2_SUBTASK                         *Subtask OPTIONAL
   )
 {
   NVME_CONTROLLER_PRIVATE_DATA  *Private;
@@ -375,7 +362,7 @@ NvmExpressPassThru (
   EFI_PCI_IO_PROTOCOL           *PciIo;
   NVME_SQ                       *Sq;
   NVME_CQ                       *Cq;
-  UINT8                         Qid;
+  UINT16                        QueueId;
   UINT32                        Bytes;
   UINT16                        Offset;
   EFI_EVENT                     TimerEvent;
@@ -389,6 +376,8 @@ NvmExpressPassThru (
   VOID                          *PrpListHost;
   UINTN                         PrpListNo;
   UINT32                        Data;
+  NVME_PASS_THRU_ASYNC_REQ      *AsyncRequest;
+  EFI_TPL                       OldTpl;
 
   //
   // check the data fields in Packet parameter.
@@ -405,38 +394,73 @@ NvmExpressPassThru (
     return EFI_INVALID_PARAMETER;
   }
 
-  Private     = NVME_CONTROLLER_PRIVATE_DATA_FROM_PASS_THRU (This);
-  PciIo       = Private->PciIo;
-  MapData     = NULL;
-  MapMeta     = NULL;
-  MapPrpList  = NULL;
-  PrpListHost = NULL;
-  PrpListNo   = 0;
-  Prp         = NULL;
-  TimerEvent  = NULL;
-  Status      = EFI_SUCCESS;
-
-  Qid = Packet->QueueId;
-  Sq  = Private->SqBuffer[Qid] + Private->SqTdbl[Qid].Sqt;
-  Cq  = Private->CqBuffer[Qid] + Private->CqHdbl[Qid].Cqh;
-
   if (Packet->NvmeCmd->Nsid != NamespaceId) {
     return EFI_INVALID_PARAMETER;
   }
 
+  Private      = NVME_CONTROLLER_PRIVATE_DATA_FROM_PASS_THRU (This);
+  PciIo        = Private->PciIo;
+  MapData      = NULL;
+  MapMeta      = NULL;
+  MapPrpList   = NULL;
+  PrpListHost  = NULL;
+  PrpListNo    = 0;
+  Prp          = NULL;
+  TimerEvent   = NULL;
+  AsyncRequest = NULL;
+  OldTpl       = TPL_APPLICATION;
+  Status       = EFI_SUCCESS;
+
+  //
+  // I/O commands with an event or a subtask are sent to the asynchronous I/O
+  // queue, and completed by ProcessAsyncTaskList(). Admin commands are always
+  // executed in blocking mode.
+  //
+  QueueId = Packet->QueueId;
+  if (((Event != NULL) || (Subtask != NULL)) && (QueueId != NVME_ADMIN_QUEUE)) {
+    QueueId = NVME_ASYNC_IO_QUEUE;
+
+    AsyncRequest = AllocateZeroPool (sizeof (NVME_PASS_THRU_ASYNC_REQ));
+    if (AsyncRequest == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    //
+    // The asynchronous I/O queue is shared with the timer event, so it is only
+    // updated at the TPL of the timer. The number of commands in flight is
+    // limited to the number of free queue entries, so that the completion
+    // queue never overflows.
+    //
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    if (Private->AsyncPassThruCount >= Private->QueueSize[QueueId]) {
+      gBS->RestoreTPL (OldTpl);
+      FreePool (AsyncRequest);
+      return EFI_NOT_READY;
+    }
+  }
+
+  Sq  = Private->SqBuffer[QueueId] + Private->SqTdbl[QueueId].Sqt;
+  Cq  = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
+
   ZeroMem (Sq, sizeof (NVME_SQ));
   Sq->Opc  = Packet->NvmeCmd->Cdw0.Opcode;
   Sq->Fuse = Packet->NvmeCmd->Cdw0.FusedOperation;
-  Sq->Cid  = Packet->NvmeCmd->Cdw0.Cid;
   Sq->Nsid = Packet->NvmeCmd->Nsid;
 
+  //
+  // The command identifier is allocated by the driver, so that it is unique
+  // among the commands in flight in the queue.
+  //
+  Sq->Cid  = Private->Cid[QueueId]++;
+
   //
   // Currently we only support PRP for data transfer, SGL is NOT supported.
   //
   ASSERT (Sq->Psdt == 0);
   if (Sq->Psdt != 0) {
     DEBUG ((EFI_D_ERROR, "NvmExpressPassThru: doesn't support SGL mechanism\n"));
-    return EFI_UNSUPPORTED;
+    Status = EFI_UNSUPPORTED;
+    goto EXIT;
   }
 
   Sq->Prp[0] = (UINT64)(UINTN)Packet->TransferBuffer;
@@ -463,7 +487,8 @@ NvmExpressPassThru (
                       &MapData
                       );
     if (EFI_ERROR (Status) || (Packet->TransferLength != MapLength)) {
-      return EFI_OUT_OF_RESOURCES;
+      Status = EFI_OUT_OF_RESOURCES;
+      goto EXIT;
     }
 
     Sq->Prp[0] = PhyAddr;
@@ -481,12 +506,8 @@ NvmExpressPassThru (
                         &MapMeta
                         );
       if (EFI_ERROR (Status) || (Packet->MetadataLength != MapLength)) {
-        PciIo->Unmap (
-                 PciIo,
-                 MapData
-                 );
-
-        return EFI_OUT_OF_RESOURCES;
+        Status = EFI_OUT_OF_RESOURCES;
+        goto EXIT;
       }
       Sq->Mptr = PhyAddr;
     }
@@ -505,6 +526,7 @@ NvmExpressPassThru (
     PhyAddr = (Sq->Prp[0] + EFI_PAGE_SIZE) & ~(EFI_PAGE_SIZE - 1);
     Prp = NvmeCreatePrpList (PciIo, PhyAddr, EFI_SIZE_TO_PAGES(Offset + Bytes) - 1, &PrpListHost, &PrpListNo, &MapPrpList);
     if (Prp == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
       goto EXIT;
     }
 
@@ -535,17 +557,45 @@ NvmExpressPassThru (
   //
   // Ring the submission queue doorbell.
   //
-  Private->SqTdbl[Qid].Sqt ^= 1;
-  Data = ReadUnaligned32 ((UINT32*)&Private->SqTdbl[Qid]);
+  if (Private->SqTdbl[QueueId].Sqt == Private->QueueSize[QueueId]) {
+    Private->SqTdbl[QueueId].Sqt = 0;
+  } else {
+    Private->SqTdbl[QueueId].Sqt++;
+  }
+  Data = ReadUnaligned32 ((UINT32*)&Private->SqTdbl[QueueId]);
   PciIo->Mem.Write (
                PciIo,
                EfiPciIoWidthUint32,
                NVME_BAR,
-               NVME_SQTDBL_OFFSET(Qid, Private->Cap.Dstrd),
+               NVME_SQTDBL_OFFSET(QueueId, Private->Cap.Dstrd),
                1,
                &Data
                );
 
+  //
+  // For non-blocking requests, the resources are released and the event is
+  // signaled when the completion is found by ProcessAsyncTaskList().
+  //
+  if (AsyncRequest != NULL) {
+    AsyncRequest->Signature   = NVME_PASS_THRU_ASYNC_REQ_SIG;
+    AsyncRequest->Packet      = Packet;
+    AsyncRequest->CommandId   = Sq->Cid;
+    AsyncRequest->MapData     = MapData;
+    AsyncRequest->MapMeta     = MapMeta;
+    AsyncRequest->MapPrpList  = MapPrpList;
+    AsyncRequest->PrpListNo   = PrpListNo;
+    AsyncRequest->PrpListHost = (Prp != NULL) ? PrpListHost : NULL;
+    AsyncRequest->CallerEvent = Event;
+    AsyncRequest->Subtask     = Subtask;
+    AsyncRequest->Timeout     = Packet->CommandTimeout;
+
+    InsertTailList (&Private->AsyncPassThruQueue, &AsyncRequest->Link);
+    Private->AsyncPassThruCount++;
+    gBS->RestoreTPL (OldTpl);
+
+    return EFI_SUCCESS;
+  }
+
   Status = gBS->CreateEvent (
                   EVT_TIMER,
                   TPL_CALLBACK,
@@ -570,15 +620,18 @@ NvmExpressPassThru (
   Status = EFI_TIMEOUT;
   Packet->ControllerStatus = NVM_EXPRESS_STATUS_CONTROLLER_TIMEOUT_COMMAND;
   while (EFI_ERROR (gBS->CheckEvent (TimerEvent))) {
-    if (Cq->Pt != Private->Pt[Qid]) {
+    if (Cq->Pt != Private->Pt[QueueId]) {
       Status = EFI_SUCCESS;
       Packet->ControllerStatus = NVM_EXPRESS_STATUS_CONTROLLER_READY;
       break;
     }
   }
 
-  if ((Private->CqHdbl[Qid].Cqh ^= 1) == 0) {
-    Private->Pt[Qid] ^= 1;
+  if (Private->CqHdbl[QueueId].Cqh == Private->QueueSize[QueueId]) {
+    Private->CqHdbl[QueueId].Cqh = 0;
+    Private->Pt[QueueId] ^= 1;
+  } else {
+    Private->CqHdbl[QueueId].Cqh++;
   }
 
   //
@@ -593,16 +646,24 @@ NvmExpressPassThru (
     NvmeDumpStatus(Cq);
   DEBUG_CODE_END();
 
-  Data = ReadUnaligned32 ((UINT32*)&Private->CqHdbl[Qid]);
+  Data = ReadUnaligned32 ((UINT32*)&Private->CqHdbl[QueueId]);
   PciIo->Mem.Write (
                PciIo,
                EfiPciIoWidthUint32,
                NVME_BAR,
-               NVME_CQHDBL_OFFSET(Qid, Private->Cap.Dstrd),
+               NVME_CQHDBL_OFFSET(QueueId, Private->Cap.Dstrd),
                1,
                &Data
                );
 
+  //
+  // Admin commands given an event are executed in blocking mode, so the event
+  // is signaled once they complete.
+  //
+  if ((Event != NULL) && !EFI_ERROR (Status)) {
+    gBS->SignalEvent (Event);
+  }
+
 EXIT:
   if (MapData != NULL) {
     PciIo->Unmap (
@@ -632,9 +693,60 @@ EXIT:
   if (TimerEvent != NULL) {
     gBS->CloseEvent (TimerEvent);
   }
+
+  if (AsyncRequest != NULL) {
+    gBS->RestoreTPL (OldTpl);
+    FreePool (AsyncRequest);
+  }
   return Status;
 }
 
+/**
+  Sends an NVM Express Command Packet to an NVM Express controller or namespace. This function supports
+  both blocking I/O and nonblocking I/O. The blocking I/O functionality is required, and the nonblocking
+  I/O functionality is optional.
+
+  @param[in]     This                A pointer to the NVM_EXPRESS_PASS_THRU_PROTOCOL instance.
+  @param[in]     NamespaceId         Is a 32 bit Namespace ID to which the Express HCI command packet will be sent.
+                                     A value of 0 denotes the NVM Express controller, a value of all 0FFh in the namespace
+                                     ID specifies that the command packet should be sent to all valid namespaces.
+  @param[in]     NamespaceUuid       Is a 64 bit Namespace UUID to which the Express HCI command packet will be sent.
+                                     A value of 0 denotes the NVM Express controller, a value of all 0FFh in the namespace
+                                     UUID specifies that the command packet should be sent to all valid namespaces.
+  @param[in,out] Packet              A pointer to the NVM Express HCI Command Packet to send to the NVMe namespace specified
+                                     by NamespaceId.
+  @param[in]     Event               If nonblocking I/O is not supported then Event is ignored, and blocking I/O is performed.
+                                     If Event is NULL, then blocking I/O is performed. If Event is not NULL and non blocking I/O
+                                     is supported, then nonblocking I/O is performed, and Event will be signaled when the NVM
+                                     Express Command Packet completes.
+
+  @retval EFI_SUCCESS                The NVM Express Command Packet was sent by the host. TransferLength bytes were transferred
+                                     to, or from DataBuffer.
+  @retval EFI_BAD_BUFFER_SIZE        The NVM Express Command Packet was not executed. The number of bytes that could be transferred
+                                     is returned in TransferLength.
+  @retval EFI_NOT_READY              The NVM Express Command Packet could not be sent because the controller is not ready. The caller
+                                     may retry again later.
+  @retval EFI_DEVICE_ERROR           A device error occurred while attempting to send the NVM Express Command Packet.
+  @retval EFI_INVALID_PARAMETER      Namespace, or the contents of NVM_EXPRESS_PASS_THRU_COMMAND_PACKET are invalid. The NVM
+                                     Express Command Packet was not sent, so no additional status information is available.
+  @retval EFI_UNSUPPORTED            The command described by the NVM Express Command Packet is not supported by the host adapter.
+                                     The NVM Express Command Packet was not sent, so no additional status information is available.
+  @retval EFI_TIMEOUT                A timeout occurred while waiting for the NVM Express Command Packet to execute.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmExpressPassThru (
+  IN     NVM_EXPRESS_PASS_THRU_PROTOCOL              *This,
+  IN     UINT32                                      NamespaceId,
+  IN     UINT64                                      NamespaceUuid,
+  IN OUT NVM_EXPRESS_PASS_THRU_COMMAND_PACKET        *Packet,
+  IN     EFI_EVENT                                   Event OPTIONAL
+  )
+{
+  return NvmExpressPassThruInternal (This, NamespaceId, Packet, Event, NULL);
+}
+
 /**
   Used to retrieve the list of namespaces defined on an NVM Express controller.
 
@@ -55,6 +55,11 @@ typedef struct {
 //
 #define NVME_ADMIN_QUEUE                                 0x00
 #define NVME_IO_QUEUE                                    0x01
+//
+// Queue of the I/O commands sent in non blocking mode, which is selected by
+// the driver when an event is given to PassThru().
+//
+#define NVME_ASYNC_IO_QUEUE                              0x02
 
 //
 // ControllerStatus
@@ -25,6 +25,44 @@ BOOLEAN *mDepexEvaluationStack        = NULL;
 BOOLEAN *mDepexEvaluationStackEnd     = NULL;
 BOOLEAN *mDepexEvaluationStackPointer = NULL;
 
+//
+// DEPEX_GUID_ENTRY - each protocol GUID referenced by the dependency expression
+// of a driver in the Dependent state has one entry in the Depex index. It
+// lists the drivers that reference the protocol.
+//
+#define DEPEX_GUID_ENTRY_SIGNATURE  SIGNATURE_32('d','p','x','g')
+#define DEPEX_GUID_HASH_SIZE        64
+
+typedef struct _DEPEX_GUID_ENTRY DEPEX_GUID_ENTRY;
+struct _DEPEX_GUID_ENTRY {
+  UINTN               Signature;
+  LIST_ENTRY          Link;             // mDepexGuidList
+  DEPEX_GUID_ENTRY    *HashNext;        // mDepexGuidHash
+  EFI_GUID            Guid;
+  UINT64              Key;              // Protocol key when the drivers were last marked
+  LIST_ENTRY          Drivers;          // List of DEPEX_GUID_LINK
+};
+
+//
+// DEPEX_GUID_LINK - links a driver to a protocol GUID its dependency expression
+// references
+//
+#define DEPEX_GUID_LINK_SIGNATURE   SIGNATURE_32('d','p','x','l')
+
+typedef struct {
+  UINTN                   Signature;
+  LIST_ENTRY              GuidLink;     // DEPEX_GUID_ENTRY.Drivers
+  LIST_ENTRY              DriverLink;   // EFI_CORE_DRIVER_ENTRY.DepexGuidLinks
+  DEPEX_GUID_ENTRY        *GuidEntry;
+  EFI_CORE_DRIVER_ENTRY   *DriverEntry;
+} DEPEX_GUID_LINK;
+
+//
+// Depex index, from protocol GUID to the drivers waiting on it
+//
+LIST_ENTRY        mDepexGuidList = INITIALIZE_LIST_HEAD_VARIABLE (mDepexGuidList);
+DEPEX_GUID_ENTRY  *mDepexGuidHash[DEPEX_GUID_HASH_SIZE];
+
 //
 // Worker functions
 //
@@ -440,3 +478,266 @@ Done:
 }
 
 
+
+/**
+  Get the next protocol GUID referenced by the dependency expression of a driver.
+
+  @param  DriverEntry           The driver whose Depex is walked.
+  @param  Iterator              On input, the Depex opcode to start from, or NULL to
+                                start from the first opcode. On output, the opcode
+                                that follows the returned GUID.
+
+  @return The protocol GUID, or NULL if there are no more GUIDs in the Depex.
+
+**/
+EFI_GUID *
+CoreGetNextDepexGuid (
+  IN     EFI_CORE_DRIVER_ENTRY   *DriverEntry,
+  IN OUT UINT8                   **Iterator
+  )
+{
+  UINT8       *Opcode;
+  UINT8       *End;
+  EFI_GUID    *Guid;
+
+  if (DriverEntry->Depex == NULL) {
+    return NULL;
+  }
+
+  Opcode = (*Iterator == NULL) ? (UINT8 *) DriverEntry->Depex : *Iterator;
+  End    = (UINT8 *) DriverEntry->Depex + DriverEntry->DepexSize;
+
+  while (Opcode < End) {
+    switch (*Opcode) {
+    case EFI_DEP_PUSH:
+    case EFI_DEP_REPLACE_TRUE:
+      if ((UINTN) (End - Opcode) < 1 + sizeof (EFI_GUID)) {
+        return NULL;
+      }
+      Guid      = (EFI_GUID *) (Opcode + 1);
+      *Iterator = Opcode + 1 + sizeof (EFI_GUID);
+      return Guid;
+
+    case EFI_DEP_BEFORE:
+    case EFI_DEP_AFTER:
+      Opcode += 1 + sizeof (EFI_GUID);
+      break;
+
+    case EFI_DEP_SOR:
+    case EFI_DEP_AND:
+    case EFI_DEP_OR:
+    case EFI_DEP_NOT:
+    case EFI_DEP_TRUE:
+    case EFI_DEP_FALSE:
+      Opcode++;
+      break;
+
+    default:
+      //
+      // EFI_DEP_END or an unknown opcode ends the expression
+      //
+      return NULL;
+    }
+  }
+
+  return NULL;
+}
+
+
+
+/**
+  Find the entry of a protocol GUID in the Depex index.
+
+  @param  Guid                  The protocol GUID to look for.
+  @param  Create                Create a new entry if not found.
+
+  @return The entry, or NULL if it was not found and could not be created.
+
+**/
+DEPEX_GUID_ENTRY *
+CoreFindDepexGuidEntry (
+  IN EFI_GUID   *Guid,
+  IN BOOLEAN    Create
+  )
+{
+  UINTN             Index;
+  DEPEX_GUID_ENTRY  *GuidEntry;
+
+  Index = (ReadUnaligned32 ((UINT32 *) Guid) ^ ReadUnaligned32 ((UINT32 *) Guid + 3)) & (DEPEX_GUID_HASH_SIZE - 1);
+  for (GuidEntry = mDepexGuidHash[Index]; GuidEntry != NULL; GuidEntry = GuidEntry->HashNext) {
+    if (CompareGuid (&GuidEntry->Guid, Guid)) {
+      return GuidEntry;
+    }
+  }
+
+  if (!Create) {
+    return NULL;
+  }
+
+  GuidEntry = AllocatePool (sizeof (DEPEX_GUID_ENTRY));
+  if (GuidEntry == NULL) {
+    return NULL;
+  }
+
+  GuidEntry->Signature = DEPEX_GUID_ENTRY_SIGNATURE;
+  CopyGuid (&GuidEntry->Guid, Guid);
+  GuidEntry->Key       = CoreGetProtocolKey (&GuidEntry->Guid);
+  InitializeListHead (&GuidEntry->Drivers);
+  InsertTailList (&mDepexGuidList, &GuidEntry->Link);
+  GuidEntry->HashNext   = mDepexGuidHash[Index];
+  mDepexGuidHash[Index] = GuidEntry;
+
+  return GuidEntry;
+}
+
+
+
+/**
+  Add the protocol GUIDs referenced by the dependency expression of a driver to
+  the Depex index, and mark the driver so that its Depex is evaluated.
+
+  @param  DriverEntry           The driver to add.
+
+**/
+VOID
+CoreAddDepexToIndex (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  )
+{
+  UINT8             *Iterator;
+  EFI_GUID          *Guid;
+  DEPEX_GUID_ENTRY  *GuidEntry;
+  DEPEX_GUID_LINK   *GuidLink;
+  LIST_ENTRY        *Link;
+
+  DriverEntry->DepexDirty = TRUE;
+
+  //
+  // A NULL Depex depends on all the Architectural Protocols, so it is evaluated
+  // every time
+  //
+  if (DriverEntry->Depex == NULL || DriverEntry->DepexIndexed) {
+    return;
+  }
+
+  //
+  // Before and After Depex are never evaluated by CoreIsSchedulable ()
+  //
+  if (DriverEntry->Before || DriverEntry->After) {
+    DriverEntry->DepexIndexed = TRUE;
+    return;
+  }
+
+  Iterator = NULL;
+  while ((Guid = CoreGetNextDepexGuid (DriverEntry, &Iterator)) != NULL) {
+    GuidEntry = CoreFindDepexGuidEntry (Guid, TRUE);
+    if (GuidEntry == NULL) {
+      //
+      // Leave the driver out of the index, so its Depex is evaluated every time
+      //
+      CoreRemoveDepexFromIndex (DriverEntry);
+      return;
+    }
+
+    //
+    // Skip protocols that are referenced more than once
+    //
+    for (Link = DriverEntry->DepexGuidLinks.ForwardLink; Link != &DriverEntry->DepexGuidLinks; Link = Link->ForwardLink) {
+      GuidLink = CR (Link, DEPEX_GUID_LINK, DriverLink, DEPEX_GUID_LINK_SIGNATURE);
+      if (GuidLink->GuidEntry == GuidEntry) {
+        break;
+      }
+    }
+    if (Link != &DriverEntry->DepexGuidLinks) {
+      continue;
+    }
+
+    GuidLink = AllocatePool (sizeof (DEPEX_GUID_LINK));
+    if (GuidLink == NULL) {
+      CoreRemoveDepexFromIndex (DriverEntry);
+      return;
+    }
+    GuidLink->Signature   = DEPEX_GUID_LINK_SIGNATURE;
+    GuidLink->GuidEntry   = GuidEntry;
+    GuidLink->DriverEntry = DriverEntry;
+    InsertTailList (&GuidEntry->Drivers, &GuidLink->GuidLink);
+    InsertTailList (&DriverEntry->DepexGuidLinks, &GuidLink->DriverLink);
+  }
+
+  DriverEntry->DepexIndexed = TRUE;
+}
+
+
+
+/**
+  Remove a driver from the Depex index once it left the Dependent state.
+
+  @param  DriverEntry           The driver to remove.
+
+**/
+VOID
+CoreRemoveDepexFromIndex (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  )
+{
+  DEPEX_GUID_LINK   *GuidLink;
+  DEPEX_GUID_ENTRY  *GuidEntry;
+  DEPEX_GUID_ENTRY  **HashLink;
+
+  while (!IsListEmpty (&DriverEntry->DepexGuidLinks)) {
+    GuidLink = CR (DriverEntry->DepexGuidLinks.ForwardLink, DEPEX_GUID_LINK, DriverLink, DEPEX_GUID_LINK_SIGNATURE);
+    GuidEntry = GuidLink->GuidEntry;
+    RemoveEntryList (&GuidLink->DriverLink);
+    RemoveEntryList (&GuidLink->GuidLink);
+    CoreFreePool (GuidLink);
+
+    //
+    // Drop the protocol from the index once no driver waits on it
+    //
+    if (IsListEmpty (&GuidEntry->Drivers)) {
+      HashLink = &mDepexGuidHash[(ReadUnaligned32 ((UINT32 *) &GuidEntry->Guid) ^ ReadUnaligned32 ((UINT32 *) &GuidEntry->Guid + 3)) & (DEPEX_GUID_HASH_SIZE - 1)];
+      while (*HashLink != GuidEntry) {
+        HashLink = &(*HashLink)->HashNext;
+      }
+      *HashLink = GuidEntry->HashNext;
+      RemoveEntryList (&GuidEntry->Link);
+      CoreFreePool (GuidEntry);
+    }
+  }
+
+  DriverEntry->DepexIndexed = FALSE;
+}
+
+
+
+/**
+  Mark the drivers whose dependency expression references a protocol that was
+  installed, reinstalled or uninstalled since the previous call, so that their
+  Depex is evaluated again.
+
+**/
+VOID
+CoreUpdateDepexIndex (
+  VOID
+  )
+{
+  LIST_ENTRY        *Link;
+  LIST_ENTRY        *DriverLink;
+  DEPEX_GUID_ENTRY  *GuidEntry;
+  DEPEX_GUID_LINK   *GuidLink;
+  UINT64            Key;
+
+  for (Link = mDepexGuidList.ForwardLink; Link != &mDepexGuidList; Link = Link->ForwardLink) {
+    GuidEntry = CR (Link, DEPEX_GUID_ENTRY, Link, DEPEX_GUID_ENTRY_SIGNATURE);
+    Key = CoreGetProtocolKey (&GuidEntry->Guid);
+    if (Key == GuidEntry->Key) {
+      continue;
+    }
+
+    GuidEntry->Key = Key;
+    for (DriverLink = GuidEntry->Drivers.ForwardLink; DriverLink != &GuidEntry->Drivers; DriverLink = DriverLink->ForwardLink) {
+      GuidLink = CR (DriverLink, DEPEX_GUID_LINK, GuidLink, DEPEX_GUID_LINK_SIGNATURE);
+      GuidLink->DriverEntry->DepexDirty = TRUE;
+    }
+  }
+}
@@ -280,6 +280,7 @@ CoreGetDepexSectionAndPreProccess (
       DriverEntry->Depex = NULL;
       DriverEntry->Dependent = TRUE;
       DriverEntry->DepexProtocolError = FALSE;
+      CoreAddDepexToIndex (DriverEntry);
     }
   } else {
     //
@@ -288,6 +289,7 @@ CoreGetDepexSectionAndPreProccess (
     //
     CorePreProcessDepex (DriverEntry);
     DriverEntry->DepexProtocolError = FALSE;
+    CoreAddDepexToIndex (DriverEntry);
   }
 
   return Status;
@@ -332,6 +334,7 @@ CoreSchedule (
       CoreAcquireDispatcherLock ();
       DriverEntry->Unrequested  = FALSE;
       DriverEntry->Dependent    = TRUE;
+      DriverEntry->DepexDirty   = TRUE;
       CoreReleaseDispatcherLock ();
 
       DEBUG ((DEBUG_DISPATCH, "Schedule FFS(%g) - EFI_SUCCESS\n", DriverName));
@@ -568,7 +571,14 @@ CoreDispatcher (
     }
 
     //
-    // Search DriverList for items to place on Scheduled Queue
+    // Mark the drivers that wait on a protocol installed or uninstalled since
+    // the previous search
+    //
+    CoreUpdateDepexIndex ();
+
+    //
+    // Search DriverList for items to place on Scheduled Queue. Only the drivers
+    // whose Depex may have changed its result are evaluated again.
     //
     ReadyToRun = FALSE;
     for (Link = mDiscoveredList.ForwardLink; Link != &mDiscoveredList; Link = Link->ForwardLink) {
@@ -582,9 +592,12 @@ CoreDispatcher (
       }
 
       if (DriverEntry->Dependent) {
-        if (CoreIsSchedulable (DriverEntry)) {
-          CoreInsertOnScheduledQueueWhileProcessingBeforeAndAfter (DriverEntry);
-          ReadyToRun = TRUE;
+        if (!DriverEntry->DepexIndexed || DriverEntry->DepexDirty) {
+          DriverEntry->DepexDirty = FALSE;
+          if (CoreIsSchedulable (DriverEntry)) {
+            CoreInsertOnScheduledQueueWhileProcessingBeforeAndAfter (DriverEntry);
+            ReadyToRun = TRUE;
+          }
         }
       } else {
         if (DriverEntry->Unrequested) {
@@ -657,6 +670,8 @@ CoreInsertOnScheduledQueueWhileProcessingBeforeAndAfter (
 
   CoreReleaseDispatcherLock ();
 
+  CoreRemoveDepexFromIndex (InsertedDriverEntry);
+
   //
   // Process After Dependency
   //
@@ -908,6 +923,7 @@ CoreAddToDriverList (
   DriverEntry->FvHandle         = FvHandle;
   DriverEntry->Fv               = Fv;
   DriverEntry->FvFileDevicePath = CoreFvToDevicePath (Fv, FvHandle, DriverName);
+  InitializeListHead (&DriverEntry->DepexGuidLinks);
 
   CoreGetDepexSectionAndPreProccess (DriverEntry);
 
@@ -1365,6 +1381,7 @@ CoreFwVolEventProtocolNotify (
           DriverEntry->Scheduled = TRUE;
           InsertTailList (&mScheduledQueue, &DriverEntry->ScheduledLink);
           CoreReleaseDispatcherLock ();
+          CoreRemoveDepexFromIndex (DriverEntry);
           DEBUG ((DEBUG_DISPATCH, "Evaluate DXE DEPEX for FFS(%g)\n", &DriverEntry->FileName));
           DEBUG ((DEBUG_DISPATCH, "  RESULT = TRUE (Apriori)\n"));
           break;
@@ -1424,3 +1441,53 @@ CoreDisplayDiscoveredNotDispatched (
     }
   }
 }
+
+
+/**
+  Display the dependency graph of the discovered drivers: the state of each
+  driver and, for the drivers still waiting, the protocols their dependency
+  expression references and whether each of them is installed.
+
+**/
+VOID
+CoreDisplayDependencyGraph (
+  VOID
+  )
+{
+  LIST_ENTRY                    *Link;
+  EFI_CORE_DRIVER_ENTRY         *DriverEntry;
+  UINT8                         *Iterator;
+  EFI_GUID                      *Guid;
+  VOID                          *Interface;
+
+  DEBUG ((DEBUG_DISPATCH, "DXE dependency graph:\n"));
+  for (Link = mDiscoveredList.ForwardLink; Link != &mDiscoveredList; Link = Link->ForwardLink) {
+    DriverEntry = CR(Link, EFI_CORE_DRIVER_ENTRY, Link, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
+    DEBUG ((
+      DEBUG_DISPATCH,
+      "  FFS(%g) - %a\n",
+      &DriverEntry->FileName,
+      DriverEntry->Initialized ? "Initialized" :
+      DriverEntry->Scheduled   ? "Scheduled"   :
+      DriverEntry->Dependent   ? "Dependent"   :
+      DriverEntry->Unrequested ? "Unrequested" :
+      DriverEntry->Untrusted   ? "Untrusted"   : "Unknown"
+      ));
+
+    if (DriverEntry->Before) {
+      DEBUG ((DEBUG_DISPATCH, "    BEFORE FFS(%g)\n", &DriverEntry->BeforeAfterGuid));
+    } else if (DriverEntry->After) {
+      DEBUG ((DEBUG_DISPATCH, "    AFTER FFS(%g)\n", &DriverEntry->BeforeAfterGuid));
+    } else if (DriverEntry->Dependent || DriverEntry->Unrequested) {
+      Iterator = NULL;
+      while ((Guid = CoreGetNextDepexGuid (DriverEntry, &Iterator)) != NULL) {
+        DEBUG ((
+          DEBUG_DISPATCH,
+          "    PUSH(%g) = %a\n",
+          Guid,
+          EFI_ERROR (CoreLocateProtocol (Guid, NULL, &Interface)) ? "FALSE" : "TRUE"
+          ));
+      }
+    }
+  }
+}
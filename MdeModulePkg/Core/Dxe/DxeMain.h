@@ -174,6 +174,9 @@ typedef struct {
   EFI_HANDLE                      ImageHandle;
   BOOLEAN                         IsFvImage;
 
+  BOOLEAN                         DepexIndexed;     // Depex GUIDs are in the Depex index
+  BOOLEAN                         DepexDirty;       // A protocol referenced by Depex changed
+  LIST_ENTRY                      DepexGuidLinks;   // List of DEPEX_GUID_LINK
 } EFI_CORE_DRIVER_ENTRY;
 
 //
@@ -506,6 +509,61 @@ CorePreProcessDepex (
   );
 
 
+/**
+  Get the next protocol GUID referenced by the dependency expression of a driver.
+
+  @param  DriverEntry           The driver whose Depex is walked.
+  @param  Iterator              On input, the Depex opcode to start from, or NULL to
+                                start from the first opcode. On output, the opcode
+                                that follows the returned GUID.
+
+  @return The protocol GUID, or NULL if there are no more GUIDs in the Depex.
+
+**/
+EFI_GUID *
+CoreGetNextDepexGuid (
+  IN     EFI_CORE_DRIVER_ENTRY   *DriverEntry,
+  IN OUT UINT8                   **Iterator
+  );
+
+
+/**
+  Add the protocol GUIDs referenced by the dependency expression of a driver to
+  the Depex index, and mark the driver so that its Depex is evaluated.
+
+  @param  DriverEntry           The driver to add.
+
+**/
+VOID
+CoreAddDepexToIndex (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  );
+
+
+/**
+  Remove a driver from the Depex index once it left the Dependent state.
+
+  @param  DriverEntry           The driver to remove.
+
+**/
+VOID
+CoreRemoveDepexFromIndex (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  );
+
+
+/**
+  Mark the drivers whose dependency expression references a protocol that was
+  installed, reinstalled or uninstalled since the previous call, so that their
+  Depex is evaluated again.
+
+**/
+VOID
+CoreUpdateDepexIndex (
+  VOID
+  );
+
+
 
 /**
   Terminates all boot services.
@@ -1124,6 +1182,38 @@ CoreGetHandleDatabaseKey (
   );
 
 
+/**
+  Log the number of protocol database lookups that were served by the hash
+  tables instead of a list walk. The count is recorded as the Identifier of a
+  performance record, so it is reported by Dp.
+
+  @param  Event                  The event that is signaled
+  @param  Context                Not used
+
+**/
+VOID
+EFIAPI
+CoreLogProtocolDatabaseStatistics (
+  IN EFI_EVENT      Event,
+  IN VOID           *Context
+  );
+
+
+/**
+  Get the key of a protocol, which changes each time an interface of the
+  protocol is installed, reinstalled or uninstalled.
+
+  @param  Protocol               The ID of the protocol
+
+  @return The key of the protocol, or 0 if it was never installed
+
+**/
+UINT64
+CoreGetProtocolKey (
+  IN EFI_GUID       *Protocol
+  );
+
+
 /**
   Go connect any handles that were created or modified while a image executed.
 
@@ -2200,6 +2290,18 @@ CoreDisplayDiscoveredNotDispatched (
   );
 
 
+/**
+  Display the dependency graph of the discovered drivers: the state of each
+  driver, its Before or After dependency, and whether each protocol its
+  dependency expression references is installed.
+
+**/
+VOID
+CoreDisplayDependencyGraph (
+  VOID
+  );
+
+
 /**
   Place holder function until all the Boot Services and Runtime Services are
   available.
@@ -2842,6 +2944,17 @@ CoreUpdateProfile (
   IN VOID                   *Buffer
   );
 
+/**
+  Get pool allocator statistics.
+
+  @param  Stats                  Returns the pool statistics.
+
+**/
+VOID
+CoreGetPoolStatistics (
+  OUT MEMORY_PROFILE_POOL_STATS  *Stats
+  );
+
 /**
   Internal function.  Converts a memory range to use new attributes.
 
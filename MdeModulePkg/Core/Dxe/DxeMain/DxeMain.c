@@ -247,6 +247,7 @@ DxeMain (
   EFI_HOB_GUID_TYPE             *GuidHob;
   EFI_VECTOR_HANDOFF_INFO       *VectorInfoList;
   EFI_VECTOR_HANDOFF_INFO       *VectorInfo;
+  EFI_EVENT                     ReadyToBootEvent;
 
   //
   // Setup the default exception handlers
@@ -479,6 +480,13 @@ DxeMain (
     CoreDisplayDiscoveredNotDispatched ();
   DEBUG_CODE_END ();
 
+  //
+  // Display the dependency graph of the discovered drivers if this is a debug build
+  //
+  DEBUG_CODE_BEGIN ();
+    CoreDisplayDependencyGraph ();
+  DEBUG_CODE_END ();
+
   //
   // Assert if the Architectural Protocols are not present.
   //
@@ -494,6 +502,20 @@ DxeMain (
   }
   ASSERT_EFI_ERROR (Status);
 
+  //
+  // Log the protocol database statistics each time the platform is ready to boot
+  //
+  PERF_CODE (
+    CoreCreateEventEx (
+      EVT_NOTIFY_SIGNAL,
+      TPL_CALLBACK,
+      CoreLogProtocolDatabaseStatistics,
+      NULL,
+      &gEfiEventReadyToBootGuid,
+      &ReadyToBootEvent
+      );
+  );
+
   //
   // Report Status code before transfer control to BDS
   //
@@ -27,11 +27,23 @@ extern  UINTN                   gEventPending;
 ///
 /// Timer event information
 ///
-typedef struct {
-  LIST_ENTRY      Link;
-  UINT64          TriggerTime;
-  UINT64          Period;
-} TIMER_EVENT_INFO;
+typedef struct _TIMER_EVENT_INFO TIMER_EVENT_INFO;
+struct _TIMER_EVENT_INFO {
+  ///
+  /// Links in the timer heap. Prev is the parent for the first child of a node,
+  /// and the left sibling for the other children.
+  ///
+  TIMER_EVENT_INFO  *Child;
+  TIMER_EVENT_INFO  *Sibling;
+  TIMER_EVENT_INFO  *Prev;
+  BOOLEAN           Queued;
+  UINT64            TriggerTime;
+  UINT64            Period;
+  ///
+  /// Orders timers with the same TriggerTime by the time they were queued
+  ///
+  UINT64            Sequence;
+};
 
 #define EVENT_SIGNATURE         SIGNATURE_32('e','v','n','t')
 typedef struct {
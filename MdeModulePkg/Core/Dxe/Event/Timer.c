@@ -20,7 +20,13 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 // Internal data
 //
 
-LIST_ENTRY       mEfiTimerList = INITIALIZE_LIST_HEAD_VARIABLE (mEfiTimerList);
+//
+// The timer database is a pairing heap ordered by trigger time, so the next
+// timer to expire is always at the root. Queuing a timer is O(1), and removing
+// one is O(log n) amortized, with no allocation under mEfiTimerLock.
+//
+TIMER_EVENT_INFO *mEfiTimerHeap = NULL;
+UINT64           mEfiTimerSequence = 0;
 EFI_LOCK         mEfiTimerLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL - 1);
 EFI_EVENT        mEfiCheckTimerEvent = NULL;
 
@@ -30,6 +36,111 @@ UINT64           mEfiSystemTime = 0;
 //
 // Timer functions
 //
+/**
+  Merges two timer heaps.
+
+  @param  Heap1                  The root of the first heap, or NULL
+  @param  Heap2                  The root of the second heap, or NULL
+
+  @return The root of the merged heap
+
+**/
+TIMER_EVENT_INFO *
+CoreMergeTimerHeaps (
+  IN TIMER_EVENT_INFO  *Heap1,
+  IN TIMER_EVENT_INFO  *Heap2
+  )
+{
+  TIMER_EVENT_INFO  *Root;
+  TIMER_EVENT_INFO  *Child;
+
+  if (Heap1 == NULL) {
+    return Heap2;
+  }
+  if (Heap2 == NULL) {
+    return Heap1;
+  }
+
+  //
+  // The timer that triggers first becomes the root. Timers with the same
+  // trigger time keep the order they were queued in.
+  //
+  if ((Heap2->TriggerTime < Heap1->TriggerTime) ||
+      ((Heap2->TriggerTime == Heap1->TriggerTime) && (Heap2->Sequence < Heap1->Sequence))) {
+    Root  = Heap2;
+    Child = Heap1;
+  } else {
+    Root  = Heap1;
+    Child = Heap2;
+  }
+
+  Child->Prev    = Root;
+  Child->Sibling = Root->Child;
+  if (Root->Child != NULL) {
+    Root->Child->Prev = Child;
+  }
+  Root->Child   = Child;
+  Root->Sibling = NULL;
+  Root->Prev    = NULL;
+
+  return Root;
+}
+
+/**
+  Merges a list of sibling timer heaps into one heap, merging them in pairs
+  left to right and then the pairs right to left.
+
+  @param  First                  The first heap of the sibling list, or NULL
+
+  @return The root of the merged heap
+
+**/
+TIMER_EVENT_INFO *
+CoreMergeTimerSiblings (
+  IN TIMER_EVENT_INFO  *First
+  )
+{
+  TIMER_EVENT_INFO  *Pairs;
+  TIMER_EVENT_INFO  *Heap;
+  TIMER_EVENT_INFO  *Second;
+  TIMER_EVENT_INFO  *Next;
+
+  //
+  // Merge the siblings in pairs, stacking the results on Pairs
+  //
+  Pairs = NULL;
+  while (First != NULL) {
+    Heap   = First;
+    Second = Heap->Sibling;
+    Next   = (Second != NULL) ? Second->Sibling : NULL;
+
+    Heap->Sibling = NULL;
+    Heap->Prev    = NULL;
+    if (Second != NULL) {
+      Second->Sibling = NULL;
+      Second->Prev    = NULL;
+      Heap = CoreMergeTimerHeaps (Heap, Second);
+    }
+
+    Heap->Sibling = Pairs;
+    Pairs = Heap;
+    First = Next;
+  }
+
+  //
+  // Merge the pairs from the last one back to the first one
+  //
+  Heap = NULL;
+  while (Pairs != NULL) {
+    Next = Pairs->Sibling;
+    Pairs->Sibling = NULL;
+    Heap  = CoreMergeTimerHeaps (Heap, Pairs);
+    Pairs = Next;
+  }
+
+  return Heap;
+}
+
 /**
   Inserts the timer event.
 
@@ -42,29 +153,61 @@ CoreInsertEventTimer (
   IN IEVENT   *Event
   )
 {
-  UINT64          TriggerTime;
-  LIST_ENTRY      *Link;
-  IEVENT          *Event2;
-
   ASSERT_LOCKED (&mEfiTimerLock);
 
   //
-  // Get the timer's trigger time
+  // Insert the timer into the timer database. The sequence number places it
+  // after the timers queued earlier with the same trigger time.
   //
-  TriggerTime = Event->Timer.TriggerTime;
+  Event->Timer.Child    = NULL;
+  Event->Timer.Sibling  = NULL;
+  Event->Timer.Prev     = NULL;
+  Event->Timer.Sequence = mEfiTimerSequence++;
+  Event->Timer.Queued   = TRUE;
 
-  //
-  // Insert the timer into the timer database in assending sorted order
-  //
-  for (Link = mEfiTimerList.ForwardLink; Link != &mEfiTimerList; Link = Link->ForwardLink) {
-    Event2 = CR (Link, IEVENT, Timer.Link, EVENT_SIGNATURE);
+  mEfiTimerHeap = CoreMergeTimerHeaps (mEfiTimerHeap, &Event->Timer);
+}
 
-    if (Event2->Timer.TriggerTime > TriggerTime) {
-      break;
+/**
+  Removes the timer event from the timer database.
+
+  @param  Event                  Points to the internal structure of timer event
+                                 to be removed
+
+**/
+VOID
+CoreRemoveEventTimer (
+  IN IEVENT   *Event
+  )
+{
+  TIMER_EVENT_INFO  *Timer;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+  ASSERT (Event->Timer.Queued);
+
+  Timer = &Event->Timer;
+  if (Timer == mEfiTimerHeap) {
+    mEfiTimerHeap = CoreMergeTimerSiblings (Timer->Child);
+  } else {
+    //
+    // Unlink the timer from its parent or left sibling, and merge its children
+    // back into the timer database
+    //
+    if (Timer->Prev->Child == Timer) {
+      Timer->Prev->Child = Timer->Sibling;
+    } else {
+      Timer->Prev->Sibling = Timer->Sibling;
+    }
+    if (Timer->Sibling != NULL) {
+      Timer->Sibling->Prev = Timer->Prev;
     }
+    mEfiTimerHeap = CoreMergeTimerHeaps (mEfiTimerHeap, CoreMergeTimerSiblings (Timer->Child));
   }
 
-  InsertTailList (Link, &Event->Timer.Link);
+  Timer->Child   = NULL;
+  Timer->Sibling = NULL;
+  Timer->Prev    = NULL;
+  Timer->Queued  = FALSE;
 }
 
 /**
@@ -88,7 +231,7 @@ CoreCurrentSystemTime (
 }
 
 /**
-  Checks the sorted timer list against the current system time.
+  Checks the timer database against the current system time.
   Signals any expired event timer.
 
   @param  CheckEvent             Not used
@@ -111,8 +254,8 @@ CoreCheckTimers (
   CoreAcquireLock (&mEfiTimerLock);
   SystemTime = CoreCurrentSystemTime ();
 
-  while (!IsListEmpty (&mEfiTimerList)) {
-    Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+  while (mEfiTimerHeap != NULL) {
+    Event = CR (mEfiTimerHeap, IEVENT, Timer, EVENT_SIGNATURE);
 
     //
     // If this timer is not expired, then we're done
@@ -125,8 +268,7 @@ CoreCheckTimers (
     // Remove this timer from the timer queue
     //
 
-    RemoveEntryList (&Event->Timer.Link);
-    Event->Timer.Link.ForwardLink = NULL;
+    CoreRemoveEventTimer (Event);
 
     //
     // Signal it
@@ -210,11 +352,11 @@ CoreTimerTick (
   mEfiSystemTime += Duration;
 
   //
-  // If the head of the list is expired, fire the timer event
+  // If the root of the timer heap is expired, fire the timer event
   // to process it
   //
-  if (!IsListEmpty (&mEfiTimerList)) {
-    Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+  if (mEfiTimerHeap != NULL) {
+    Event = CR (mEfiTimerHeap, IEVENT, Timer, EVENT_SIGNATURE);
 
     if (Event->Timer.TriggerTime <= mEfiSystemTime) {
       CoreSignalEvent (mEfiCheckTimerEvent);
@@ -270,9 +412,8 @@ CoreSetTimer (
   //
   // If the timer is queued to the timer database, remove it
   //
-  if (Event->Timer.Link.ForwardLink != NULL) {
-    RemoveEntryList (&Event->Timer.Link);
-    Event->Timer.Link.ForwardLink = NULL;
+  if (Event->Timer.Queued) {
+    CoreRemoveEventTimer (Event);
   }
 
   Event->Timer.TriggerTime = 0;
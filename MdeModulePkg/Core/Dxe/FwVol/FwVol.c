@@ -24,6 +24,14 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 VOID          *gEfiFwVolBlockNotifyReg;
 EFI_EVENT     gEfiFwVolBlockEvent;
 
+//
+// The number of files looked up by name, and the number of FFS file headers
+// that a walk of the file lists would have compared but the file name hash
+// tables did not.
+//
+UINTN         mFvFileNameLookups = 0;
+UINTN         mFvFileHeadersSkipped = 0;
+
 FV_DEVICE mFvDevice = {
   FV2_DEVICE_SIGNATURE,
   NULL,
@@ -48,7 +56,12 @@ FV_DEVICE mFvDevice = {
   0,
   0,
   FALSE,
-  FALSE
+  FALSE,
+  FALSE,
+  { NULL, NULL },
+  0,
+  { NULL },
+  0
 };
 
 
@@ -161,6 +174,57 @@ ReadFvbData (
   return EFI_SUCCESS;
 }
 
+/**
+  Read data at an offset of the FV by FVB protocol Read, using the block map
+  of the FV header to find the block the data starts in.
+
+  @param  FvDevice              The FV from which to read data.
+  @param  FvOffset              Offset from the beginning of the FV at which to
+                                begin reading.
+  @param  DataSize              Size of data to be read.
+  @param  Data                  Pointer to Buffer that the data will be read into.
+
+  @retval EFI_SUCCESS           Successfully read data from the FV.
+  @retval EFI_VOLUME_CORRUPTED  The data is not inside the FV.
+  @retval others
+**/
+EFI_STATUS
+ReadFvData (
+  IN     FV_DEVICE                              *FvDevice,
+  IN     UINTN                                  FvOffset,
+  IN     UINTN                                  DataSize,
+  OUT    UINT8                                  *Data
+  )
+{
+  EFI_FV_BLOCK_MAP_ENTRY      *BlockMap;
+  EFI_LBA                     StartLba;
+  UINTN                       Offset;
+  UINTN                       RangeSize;
+
+  if ((FvOffset > FvDevice->FwVolHeader->FvLength) ||
+      (DataSize > FvDevice->FwVolHeader->FvLength - FvOffset)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  //
+  // Find the block range that the data starts in
+  //
+  StartLba = 0;
+  Offset   = FvOffset;
+  for (BlockMap = FvDevice->FwVolHeader->BlockMap; (BlockMap->NumBlocks != 0) || (BlockMap->Length != 0); BlockMap++) {
+    RangeSize = (UINTN) BlockMap->NumBlocks * BlockMap->Length;
+    if (Offset < RangeSize) {
+      StartLba += Offset / BlockMap->Length;
+      Offset    = Offset % BlockMap->Length;
+      return ReadFvbData (FvDevice->Fvb, &StartLba, &Offset, DataSize, Data);
+    }
+    StartLba += BlockMap->NumBlocks;
+    Offset   -= RangeSize;
+  }
+
+  return EFI_VOLUME_CORRUPTED;
+}
+
 /**
   Given the supplied FW_VOL_BLOCK_PROTOCOL, allocate a buffer for output and
   copy the real length volume header into it.
@@ -288,7 +352,7 @@ FreeFvDeviceResource (
     FfsFileEntry = (FFS_FILE_LIST_ENTRY *) NextEntry;
   }
 
-  if (!FvDevice->IsMemoryMapped) {
+  if (!FvDevice->IsMemoryMapped && !FvDevice->IsLazyCached) {
     //
     // Free the cached FV buffer.
     //
@@ -305,6 +369,410 @@ FreeFvDeviceResource (
 
 
 
+/**
+  Drop a file of a lazily read FV from the file cache. The section stream of
+  the file refers to the cached file, so it is closed too.
+
+  @param  FvDevice              The FV that the file belongs to.
+  @param  FfsFileEntry          The file list entry of the cached file.
+
+**/
+VOID
+FvDropCachedFile (
+  IN OUT FV_DEVICE            *FvDevice,
+  IN OUT FFS_FILE_LIST_ENTRY  *FfsFileEntry
+  )
+{
+  EFI_FFS_FILE_HEADER         *FfsHeader;
+
+  ASSERT (FfsFileEntry->FileCached);
+
+  if (FfsFileEntry->StreamHandle != 0) {
+    CloseSectionStream (FfsFileEntry->StreamHandle, FALSE);
+    FfsFileEntry->StreamHandle = 0;
+  }
+
+  FfsHeader = FfsFileEntry->FfsHeader;
+  FvDevice->FileCacheSize -= IS_FFS_FILE2 (FfsHeader) ? FFS_FILE2_SIZE (FfsHeader) : FFS_FILE_SIZE (FfsHeader);
+  RemoveEntryList (&FfsFileEntry->CacheLink);
+  CoreFreePool (FfsHeader);
+
+  //
+  // Fall back to the copy of the file header.
+  //
+  FfsFileEntry->FfsHeader  = (EFI_FFS_FILE_HEADER *) &FfsFileEntry->HeaderCopy;
+  FfsFileEntry->FileCached = FALSE;
+}
+
+
+
+/**
+  Make sure the whole file of a lazily read FV is cached, reading it from the
+  FVB on first use. The file becomes the most recently used one, and the least
+  recently used files are dropped from the cache when the cache size exceeds
+  PcdFwVolDxeFileCacheSize.
+
+  @param  FvDevice              The FV that the file belongs to.
+  @param  FfsFileEntry          The file list entry of the file.
+
+  @retval EFI_SUCCESS           FfsFileEntry->FfsHeader points to the whole file.
+  @retval EFI_OUT_OF_RESOURCES  No enough buffer could be allocated.
+  @retval EFI_DEVICE_ERROR      The file could not be read or is corrupted.
+
+**/
+EFI_STATUS
+FvCacheFile (
+  IN OUT FV_DEVICE            *FvDevice,
+  IN OUT FFS_FILE_LIST_ENTRY  *FfsFileEntry
+  )
+{
+  EFI_STATUS                  Status;
+  EFI_FFS_FILE_HEADER         *FfsHeader;
+  UINTN                       HeaderSize;
+  UINTN                       WholeFileSize;
+  FFS_FILE_LIST_ENTRY         *CachedEntry;
+
+  ASSERT (FvDevice->IsLazyCached);
+
+  if (FfsFileEntry->FileCached) {
+    //
+    // Move the file to the head of the LRU list.
+    //
+    RemoveEntryList (&FfsFileEntry->CacheLink);
+    InsertHeadList (&FvDevice->FileCacheList, &FfsFileEntry->CacheLink);
+    return EFI_SUCCESS;
+  }
+
+  FfsHeader = FfsFileEntry->FfsHeader;
+  if (IS_FFS_FILE2 (FfsHeader)) {
+    HeaderSize    = sizeof (EFI_FFS_FILE_HEADER2);
+    WholeFileSize = FFS_FILE2_SIZE (FfsHeader);
+  } else {
+    HeaderSize    = sizeof (EFI_FFS_FILE_HEADER);
+    WholeFileSize = FFS_FILE_SIZE (FfsHeader);
+  }
+
+  FfsHeader = AllocatePool (WholeFileSize);
+  if (FfsHeader == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // The file checksum was not verified when the FV was checked, so verify it
+  // now, and make sure the file header has not changed since.
+  //
+  Status = ReadFvData (FvDevice, FfsFileEntry->FileOffset, WholeFileSize, (UINT8 *) FfsHeader);
+  if (EFI_ERROR (Status) ||
+      (CompareMem (FfsHeader, &FfsFileEntry->HeaderCopy, HeaderSize) != 0) ||
+      !IsValidFfsFile (FvDevice->ErasePolarity, FfsHeader)) {
+    DEBUG ((EFI_D_ERROR, "Failed to read FFS file %g from FV - %r\n", &FfsFileEntry->HeaderCopy.Name, Status));
+    CoreFreePool (FfsHeader);
+    return EFI_DEVICE_ERROR;
+  }
+
+  //
+  // Drop the least recently used files until the new file fits in the cache.
+  //
+  while (!IsListEmpty (&FvDevice->FileCacheList) &&
+         (FvDevice->FileCacheSize + WholeFileSize > PcdGet32 (PcdFwVolDxeFileCacheSize))) {
+    CachedEntry = BASE_CR (FvDevice->FileCacheList.BackLink, FFS_FILE_LIST_ENTRY, CacheLink);
+    FvDropCachedFile (FvDevice, CachedEntry);
+  }
+
+  FfsFileEntry->FfsHeader  = FfsHeader;
+  FfsFileEntry->FileCached = TRUE;
+  InsertHeadList (&FvDevice->FileCacheList, &FfsFileEntry->CacheLink);
+  FvDevice->FileCacheSize += WholeFileSize;
+
+  return EFI_SUCCESS;
+}
+
+
+
+/**
+  Check if an FV is consistent by reading only the FFS file headers from the
+  FVB, and make a list of the files. The files are read when they are used.
+
+  @param  FvDevice              A pointer to the FvDevice to be checked.
+  @param  FvbAttributes         The attributes of the FVB.
+
+  @retval EFI_OUT_OF_RESOURCES  No enough buffer could be allocated.
+  @retval EFI_SUCCESS           FV is consistent and the file list is built.
+  @retval EFI_VOLUME_CORRUPTED  File system is corrupted.
+
+**/
+EFI_STATUS
+FvCheckLazily (
+  IN OUT FV_DEVICE              *FvDevice,
+  IN     EFI_FVB_ATTRIBUTES_2   FvbAttributes
+  )
+{
+  EFI_STATUS                            Status;
+  EFI_FIRMWARE_VOLUME_HEADER            *FwVolHeader;
+  EFI_FIRMWARE_VOLUME_EXT_HEADER        FwVolExtHeader;
+  FFS_FILE_LIST_ENTRY                   *FfsFileEntry;
+  EFI_FFS_FILE_HEADER2                  FfsHeader;
+  EFI_FFS_FILE_STATE                    FileState;
+  UINTN                                 FvLength;
+  UINTN                                 FileOffset;
+  UINTN                                 HeaderSize;
+  UINTN                                 WholeFileSize;
+
+  FwVolHeader = FvDevice->FwVolHeader;
+  FvLength    = (UINTN) FwVolHeader->FvLength;
+
+  FvDevice->IsMemoryMapped = FALSE;
+  FvDevice->IsLazyCached   = TRUE;
+  FvDevice->CachedFv       = NULL;
+  FvDevice->EndOfCachedFv  = NULL;
+  FvDevice->FileCacheSize  = 0;
+  InitializeListHead (&FvDevice->FileCacheList);
+  InitializeListHead (&FvDevice->FfsFileListHeader);
+
+  if ((FvbAttributes & EFI_FVB2_ERASE_POLARITY) != 0) {
+    FvDevice->ErasePolarity = 1;
+  } else {
+    FvDevice->ErasePolarity = 0;
+  }
+
+  //
+  // Searching for files starts on an 8 byte aligned boundary after the end of the Extended Header if it exists.
+  //
+  if (FwVolHeader->ExtHeaderOffset != 0) {
+    Status = ReadFvData (FvDevice, FwVolHeader->ExtHeaderOffset, sizeof (FwVolExtHeader), (UINT8 *) &FwVolExtHeader);
+    if (EFI_ERROR (Status)) {
+      goto Done;
+    }
+    FileOffset = ALIGN_VALUE (FwVolHeader->ExtHeaderOffset + FwVolExtHeader.ExtHeaderSize, 8);
+  } else {
+    FileOffset = FwVolHeader->HeaderLength;
+  }
+
+  Status = EFI_SUCCESS;
+  while (FileOffset + sizeof (EFI_FFS_FILE_HEADER) <= FvLength) {
+    Status = ReadFvData (FvDevice, FileOffset, sizeof (EFI_FFS_FILE_HEADER), (UINT8 *) &FfsHeader);
+    if (EFI_ERROR (Status)) {
+      goto Done;
+    }
+
+    if (IsBufferErased (FvDevice->ErasePolarity, &FfsHeader, sizeof (EFI_FFS_FILE_HEADER))) {
+      //
+      // We have found the free space so we are done!
+      //
+      goto Done;
+    }
+
+    HeaderSize = sizeof (EFI_FFS_FILE_HEADER);
+    if (IS_FFS_FILE2 (&FfsHeader)) {
+      HeaderSize = sizeof (EFI_FFS_FILE_HEADER2);
+      Status = ReadFvData (FvDevice, FileOffset + sizeof (EFI_FFS_FILE_HEADER), sizeof (FfsHeader.ExtendedSize), (UINT8 *) &FfsHeader.ExtendedSize);
+      if (EFI_ERROR (Status)) {
+        goto Done;
+      }
+    }
+
+    if (!IsValidFfsHeader (FvDevice->ErasePolarity, (EFI_FFS_FILE_HEADER *) &FfsHeader, &FileState)) {
+      if ((FileState == EFI_FILE_HEADER_INVALID) ||
+          (FileState == EFI_FILE_HEADER_CONSTRUCTION)) {
+        if (IS_FFS_FILE2 (&FfsHeader) && !FvDevice->IsFfs3Fv) {
+          DEBUG ((EFI_D_ERROR, "Found a FFS3 formatted file: %g in a non-FFS3 formatted FV.\n", &FfsHeader.Name));
+        }
+        FileOffset += HeaderSize;
+        continue;
+      } else {
+        //
+        // File system is corrputed
+        //
+        Status = EFI_VOLUME_CORRUPTED;
+        goto Done;
+      }
+    }
+
+    if (IS_FFS_FILE2 (&FfsHeader)) {
+      WholeFileSize = FFS_FILE2_SIZE (&FfsHeader);
+    } else {
+      WholeFileSize = FFS_FILE_SIZE (&FfsHeader);
+    }
+    if ((WholeFileSize < HeaderSize) || (WholeFileSize > FvLength - FileOffset)) {
+      //
+      // File system is corrupted
+      //
+      Status = EFI_VOLUME_CORRUPTED;
+      goto Done;
+    }
+
+    if (IS_FFS_FILE2 (&FfsHeader)) {
+      ASSERT (WholeFileSize > 0x00FFFFFF);
+      if (!FvDevice->IsFfs3Fv) {
+        DEBUG ((EFI_D_ERROR, "Found a FFS3 formatted file: %g in a non-FFS3 formatted FV.\n", &FfsHeader.Name));
+        FileOffset = ALIGN_VALUE (FileOffset + WholeFileSize, 8);
+        continue;
+      }
+    }
+
+    //
+    // check for non-deleted file
+    //
+    if (FileState != EFI_FILE_DELETED) {
+      //
+      // Create a FFS list entry for each non-deleted file, which keeps a copy
+      // of the file header until the file is read.
+      //
+      FfsFileEntry = AllocateZeroPool (sizeof (FFS_FILE_LIST_ENTRY));
+      if (FfsFileEntry == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Done;
+      }
+
+      CopyMem (&FfsFileEntry->HeaderCopy, &FfsHeader, HeaderSize);
+      FfsFileEntry->FfsHeader  = (EFI_FFS_FILE_HEADER *) &FfsFileEntry->HeaderCopy;
+      FfsFileEntry->FileOffset = FileOffset;
+      InsertTailList (&FvDevice->FfsFileListHeader, &FfsFileEntry->Link);
+    }
+
+    //
+    // Adjust offset to the next 8-byte aligned boundry.
+    //
+    FileOffset = ALIGN_VALUE (FileOffset + WholeFileSize, 8);
+  }
+
+Done:
+  if (EFI_ERROR (Status)) {
+    FreeFvDeviceResource (FvDevice);
+  }
+
+  return Status;
+}
+
+
+
+/**
+  Compute the bucket of a file name in the file name hash table of a FV.
+
+  @param  NameGuid              The name of the file.
+
+  @return Index of the bucket
+
+**/
+UINTN
+FvHashFileName (
+  IN CONST EFI_GUID           *NameGuid
+  )
+{
+  UINT32                      Value;
+
+  Value = ReadUnaligned32 ((CONST UINT32 *) NameGuid) ^
+          ReadUnaligned32 ((CONST UINT32 *) NameGuid + 3);
+  return (Value ^ (Value >> 16)) & (FV_FILE_NAME_HASH_SIZE - 1);
+}
+
+
+
+/**
+  Hash the files of a FV by name, so that ReadFile() does not need to walk the
+  file list. Pad files are skipped, as GetNextFile() never returns them.
+
+  @param  FvDevice              The FV whose file list is complete.
+
+**/
+VOID
+FvBuildFileNameHash (
+  IN OUT FV_DEVICE            *FvDevice
+  )
+{
+  LIST_ENTRY                  *Link;
+  FFS_FILE_LIST_ENTRY         *FfsFileEntry;
+  UINTN                       Bucket;
+
+  ZeroMem (FvDevice->FileNameHash, sizeof (FvDevice->FileNameHash));
+  FvDevice->FileCount = 0;
+  for (Link = FvDevice->FfsFileListHeader.ForwardLink; Link != &FvDevice->FfsFileListHeader; Link = Link->ForwardLink) {
+    FfsFileEntry = (FFS_FILE_LIST_ENTRY *) Link;
+    if (FfsFileEntry->FfsHeader->Type != EFI_FV_FILETYPE_FFS_PAD) {
+      FfsFileEntry->FileIndex = ++FvDevice->FileCount;
+    }
+  }
+
+  //
+  // Insert the files in reverse order, so the first file with a name is found
+  // first like in the file list.
+  //
+  for (Link = FvDevice->FfsFileListHeader.BackLink; Link != &FvDevice->FfsFileListHeader; Link = Link->BackLink) {
+    FfsFileEntry = (FFS_FILE_LIST_ENTRY *) Link;
+    if (FfsFileEntry->FfsHeader->Type != EFI_FV_FILETYPE_FFS_PAD) {
+      Bucket = FvHashFileName (&FfsFileEntry->FfsHeader->Name);
+      FfsFileEntry->HashNext = FvDevice->FileNameHash[Bucket];
+      FvDevice->FileNameHash[Bucket] = FfsFileEntry;
+    }
+  }
+}
+
+
+
+/**
+  Find a file of the FV by its name in the file name hash table.
+
+  @param  FvDevice              The FV to search.
+  @param  NameGuid              The name of the file.
+
+  @return The file list entry of the first file with the name, or NULL if
+          there is no such file.
+
+**/
+FFS_FILE_LIST_ENTRY *
+FvFindFileByName (
+  IN FV_DEVICE                *FvDevice,
+  IN CONST EFI_GUID           *NameGuid
+  )
+{
+  FFS_FILE_LIST_ENTRY         *FfsFileEntry;
+  UINTN                       Compared;
+
+  mFvFileNameLookups++;
+  Compared = 0;
+  for (FfsFileEntry = FvDevice->FileNameHash[FvHashFileName (NameGuid)]; FfsFileEntry != NULL; FfsFileEntry = FfsFileEntry->HashNext) {
+    Compared++;
+    if (CompareGuid (&FfsFileEntry->FfsHeader->Name, NameGuid)) {
+      mFvFileHeadersSkipped += FfsFileEntry->FileIndex - Compared;
+      return FfsFileEntry;
+    }
+  }
+
+  mFvFileHeadersSkipped += FvDevice->FileCount - Compared;
+  return NULL;
+}
+
+
+
+/**
+  Log the number of FFS file headers that lookups by name did not compare
+  thanks to the file name hash tables. The count is recorded as the Identifier
+  of a performance record, so it is reported by Dp.
+
+  @param  Event                 The event that is signaled
+  @param  Context               Not used
+
+**/
+VOID
+EFIAPI
+FvLogFileNameStatistics (
+  IN EFI_EVENT                Event,
+  IN VOID                     *Context
+  )
+{
+  UINT32                      Identifier;
+
+  Identifier = (UINT32) MIN (mFvFileNameLookups, MAX_UINT32);
+  PERF_START_EX (NULL, "FvFileNameLookups", "DxeMain", 0, Identifier);
+  PERF_END_EX (NULL, "FvFileNameLookups", "DxeMain", 0, Identifier);
+
+  Identifier = (UINT32) MIN (mFvFileHeadersSkipped, MAX_UINT32);
+  PERF_START_EX (NULL, "FvFileHeadersSkipped", "DxeMain", 0, Identifier);
+  PERF_END_EX (NULL, "FvFileHeadersSkipped", "DxeMain", 0, Identifier);
+}
+
+
+
 /**
   Check if an FV is consistent and allocate cache for it.
 
@@ -353,6 +821,13 @@ FvCheck (
     return Status;
   }
 
+  if (FeaturePcdGet (PcdFwVolDxeLazyFileCache) && ((FvbAttributes & EFI_FVB2_MEMORY_MAPPED) == 0)) {
+    //
+    // Don't copy the whole FV, only read the file headers now.
+    //
+    return FvCheckLazily (FvDevice, FvbAttributes);
+  }
+
   //
   // Size is the size of the FV minus the head. We have already allocated
   // the header to check to make sure the volume is valid
@@ -720,6 +1195,8 @@ NotifyFwVolBlock (
       }
       
       if (!EFI_ERROR (FvCheck (FvDevice))) {
+        FvBuildFileNameHash (FvDevice);
+
         //
         // Install an New FV protocol on the existing handle
         //
@@ -762,6 +1239,8 @@ FwVolDriverInit (
   IN EFI_SYSTEM_TABLE             *SystemTable
   )
 {
+  EFI_EVENT                       ReadyToBootEvent;
+
   gEfiFwVolBlockEvent = EfiCreateProtocolNotifyEvent (
                           &gEfiFirmwareVolumeBlockProtocolGuid,
                           TPL_CALLBACK,
@@ -769,6 +1248,20 @@ FwVolDriverInit (
                           NULL,
                           &gEfiFwVolBlockNotifyReg
                           );
+
+  //
+  // Log the file name lookup statistics each time the platform is ready to boot
+  //
+  PERF_CODE (
+    CoreCreateEventEx (
+      EVT_NOTIFY_SIGNAL,
+      TPL_CALLBACK,
+      FvLogFileNameStatistics,
+      NULL,
+      &gEfiEventReadyToBootGuid,
+      &ReadyToBootEvent
+      );
+  );
   return EFI_SUCCESS;
 }
 
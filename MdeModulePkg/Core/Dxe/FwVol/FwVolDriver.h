@@ -19,14 +19,32 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #define FV2_DEVICE_SIGNATURE SIGNATURE_32 ('_', 'F', 'V', '2')
 
+//
+// The number of buckets of the file name hash table of each FV
+//
+#define FV_FILE_NAME_HASH_SIZE  64
+
 //
 // Used to track all non-deleted files
 //
-typedef struct {
+typedef struct _FFS_FILE_LIST_ENTRY {
   LIST_ENTRY                      Link;
   EFI_FFS_FILE_HEADER             *FfsHeader;
   UINTN                           StreamHandle;
   BOOLEAN                         FileCached;
+  //
+  // Used when the FV is read lazily. FfsHeader points to HeaderCopy until the
+  // file is read, and a cached file is linked on the FV file cache LRU list.
+  //
+  UINTN                           FileOffset;
+  LIST_ENTRY                      CacheLink;
+  EFI_FFS_FILE_HEADER2            HeaderCopy;
+  //
+  // Next file in the same bucket of the FV file name hash table, and the
+  // 1-based position of the file among the files that can be looked up.
+  //
+  struct _FFS_FILE_LIST_ENTRY     *HashNext;
+  UINTN                           FileIndex;
 } FFS_FILE_LIST_ENTRY;
 
 typedef struct {
@@ -47,6 +65,13 @@ typedef struct {
   UINT8                                   ErasePolarity;
   BOOLEAN                                 IsFfs3Fv;
   BOOLEAN                                 IsMemoryMapped;
+
+  BOOLEAN                                 IsLazyCached;
+  LIST_ENTRY                              FileCacheList;
+  UINTN                                   FileCacheSize;
+
+  FFS_FILE_LIST_ENTRY                     *FileNameHash[FV_FILE_NAME_HASH_SIZE];
+  UINTN                                   FileCount;
 } FV_DEVICE;
 
 #define FV_DEVICE_FROM_THIS(a) CR(a, FV_DEVICE, Fv, FV2_DEVICE_SIGNATURE)
@@ -405,4 +430,42 @@ IsValidFfsFile (
   IN EFI_FFS_FILE_HEADER  *FfsHeader
   );
 
+
+/**
+  Make sure the whole file of a lazily read FV is cached, reading it from the
+  FVB on first use. The file becomes the most recently used one, and the least
+  recently used files are dropped from the cache when the cache size exceeds
+  PcdFwVolDxeFileCacheSize.
+
+  @param  FvDevice              The FV that the file belongs to.
+  @param  FfsFileEntry          The file list entry of the file.
+
+  @retval EFI_SUCCESS           FfsFileEntry->FfsHeader points to the whole file.
+  @retval EFI_OUT_OF_RESOURCES  No enough buffer could be allocated.
+  @retval EFI_DEVICE_ERROR      The file could not be read or is corrupted.
+
+**/
+EFI_STATUS
+FvCacheFile (
+  IN OUT FV_DEVICE            *FvDevice,
+  IN OUT FFS_FILE_LIST_ENTRY  *FfsFileEntry
+  );
+
+
+/**
+  Find a file of the FV by its name in the file name hash table.
+
+  @param  FvDevice              The FV to search.
+  @param  NameGuid              The name of the file.
+
+  @return The file list entry of the first file with the name, or NULL if
+          there is no such file.
+
+**/
+FFS_FILE_LIST_ENTRY *
+FvFindFileByName (
+  IN FV_DEVICE                *FvDevice,
+  IN CONST EFI_GUID           *NameGuid
+  );
+
 #endif
@@ -281,6 +281,7 @@ FvReadFile (
   EFI_FFS_FILE_HEADER               *FfsHeader;
   UINTN                             InputBufferSize;
   UINTN                             WholeFileSize;
+  FFS_FILE_LIST_ENTRY               *FfsFileEntry;
 
   if (NameGuid == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -290,24 +291,32 @@ FvReadFile (
 
 
   //
-  // Keep looking until we find the matching NameGuid.
-  // The Key is really a FfsFileEntry
+  // Find the matching NameGuid in the file name hash table.
   //
   FvDevice->LastKey = 0;
-  do {
-    LocalFoundType = 0;
-    Status = FvGetNextFile (
-              This,
-              &FvDevice->LastKey,
-              &LocalFoundType,
-              &SearchNameGuid,
-              &LocalAttributes,
-              &FileSize
-              );
-    if (EFI_ERROR (Status)) {
-      return EFI_NOT_FOUND;
-    }
-  } while (!CompareGuid (&SearchNameGuid, NameGuid));
+  FfsFileEntry = FvFindFileByName (FvDevice, NameGuid);
+  if (FfsFileEntry == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  //
+  // Let FvGetNextFile() return the information of the file by starting the
+  // search from the link before it. The Key is really a FfsFileEntry
+  //
+  FvDevice->LastKey = (FFS_FILE_LIST_ENTRY *) FfsFileEntry->Link.BackLink;
+  LocalFoundType = 0;
+  Status = FvGetNextFile (
+            This,
+            &FvDevice->LastKey,
+            &LocalFoundType,
+            &SearchNameGuid,
+            &LocalAttributes,
+            &FileSize
+            );
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+  ASSERT (FvDevice->LastKey == FfsFileEntry);
 
   //
   // Get a pointer to the header
@@ -357,6 +366,17 @@ FvReadFile (
     return EFI_SUCCESS;
   }
 
+  if (FvDevice->IsLazyCached) {
+    //
+    // Only the file header of a lazily read FV is cached, so read the file now.
+    //
+    Status = FvCacheFile (FvDevice, FvDevice->LastKey);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    FfsHeader = FvDevice->LastKey->FfsHeader;
+  }
+
   //
   // Skip over file header
   //
@@ -467,11 +487,6 @@ FvReadFileSection (
   if (EFI_ERROR (Status)) {
     return Status;
   }
-  if (IS_FFS_FILE2 (FfsEntry->FfsHeader)) {
-    FileBuffer = ((UINT8 *) FfsEntry->FfsHeader) + sizeof (EFI_FFS_FILE_HEADER2);
-  } else {
-    FileBuffer = ((UINT8 *) FfsEntry->FfsHeader) + sizeof (EFI_FFS_FILE_HEADER);
-  }
   //
   // Check to see that the file actually HAS sections before we go any further.
   //
@@ -480,6 +495,23 @@ FvReadFileSection (
     goto Done;
   }
 
+  if (FvDevice->IsLazyCached) {
+    //
+    // Read the file of a lazily read FV, or keep it cached as the most
+    // recently used one. The section stream is closed when it is dropped.
+    //
+    Status = FvCacheFile (FvDevice, FfsEntry);
+    if (EFI_ERROR (Status)) {
+      goto Done;
+    }
+  }
+
+  if (IS_FFS_FILE2 (FfsEntry->FfsHeader)) {
+    FileBuffer = ((UINT8 *) FfsEntry->FfsHeader) + sizeof (EFI_FFS_FILE_HEADER2);
+  } else {
+    FileBuffer = ((UINT8 *) FfsEntry->FfsHeader) + sizeof (EFI_FFS_FILE_HEADER);
+  }
+
   //
   // Use FfsEntry to cache Section Extraction Protocol Information
   //
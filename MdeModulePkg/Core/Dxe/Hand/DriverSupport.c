@@ -15,6 +15,27 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "DxeMain.h"
 #include "Handle.h"
 
+//
+// One entry of the default Driver Binding Protocol order, with the versions the
+// order was sorted by.
+//
+typedef struct {
+  EFI_DRIVER_BINDING_PROTOCOL          *DriverBinding;
+  UINT32                               Version;
+  EFI_DRIVER_FAMILY_OVERRIDE_PROTOCOL  *DriverFamilyOverride;
+  UINT32                               DriverFamilyOverrideVersion;
+} DEFAULT_DRIVER_BINDING_ORDER_ENTRY;
+
+//
+// The Driver Binding Protocol order used for controllers without any context,
+// platform or bus specific driver override, and the keys of the Driver Binding
+// and Driver Family Override Protocols when it was computed.
+//
+DEFAULT_DRIVER_BINDING_ORDER_ENTRY  *mDefaultDriverBindingOrder     = NULL;
+UINTN                        mDefaultDriverBindingOrderCount       = 0;
+UINT64                       mDefaultDriverBindingKey              = 0;
+UINT64                       mDefaultDriverFamilyOverrideKey       = 0;
+
 
 //
 // Driver Support Functions
@@ -74,7 +95,12 @@ CoreConnectController (
   //
   // Make sure ControllerHandle is valid
   //
+  CoreAcquireProtocolLock ();
+
   Status = CoreValidateHandle (ControllerHandle);
+
+  CoreReleaseProtocolLock ();
+
   if (EFI_ERROR (Status)) {
     return Status;
   }
@@ -274,7 +300,12 @@ AddSortedDriverBindingProtocol (
   //
   // Make sure the DriverBindingHandle is valid
   //
+  CoreAcquireProtocolLock ();
+
   Status = CoreValidateHandle (DriverBindingHandle);
+
+  CoreReleaseProtocolLock ();
+
   if (EFI_ERROR (Status)) {
     return;
   }
@@ -408,6 +439,10 @@ CoreConnectSingleController (
   UINTN                                      SortIndex;
   BOOLEAN                                    OneStarted;
   BOOLEAN                                    DriverFound;
+  BOOLEAN                                    DefaultOrder;
+  UINT64                                     DriverBindingKey;
+  UINT64                                     DriverFamilyOverrideKey;
+  DEFAULT_DRIVER_BINDING_ORDER_ENTRY         *NewDefaultOrder;
 
   //
   // Initialize local variables
@@ -442,6 +477,62 @@ CoreConnectSingleController (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  //
+  // Without any context, platform or bus specific driver override, the order of the
+  // Driver Binding Protocols only depends on the Driver Binding and Driver Family
+  // Override Protocols in the handle database. Reuse the order computed by a previous
+  // call if neither of them changed since, instead of sorting again for every
+  // controller.
+  //
+  DriverBindingKey        = CoreGetProtocolKey (&gEfiDriverBindingProtocolGuid);
+  DriverFamilyOverrideKey = CoreGetProtocolKey (&gEfiDriverFamilyOverrideProtocolGuid);
+  DefaultOrder            = FALSE;
+  if (ContextDriverImageHandles == NULL) {
+    Status = CoreLocateProtocol (
+               &gEfiPlatformDriverOverrideProtocolGuid,
+               NULL,
+               (VOID **) &PlatformDriverOverride
+               );
+    if (EFI_ERROR (Status) || (PlatformDriverOverride == NULL)) {
+      Status = CoreHandleProtocol (
+                 ControllerHandle,
+                 &gEfiBusSpecificDriverOverrideProtocolGuid,
+                 (VOID **) &BusSpecificDriverOverride
+                 );
+      DefaultOrder = (BOOLEAN) (EFI_ERROR (Status) || (BusSpecificDriverOverride == NULL));
+    }
+    PlatformDriverOverride = NULL;
+  }
+
+  if (DefaultOrder &&
+      (mDefaultDriverBindingOrder != NULL) &&
+      (mDefaultDriverBindingKey == DriverBindingKey) &&
+      (mDefaultDriverFamilyOverrideKey == DriverFamilyOverrideKey)) {
+    //
+    // The protocol keys only change when an interface is installed, reinstalled
+    // or uninstalled. The order also depends on the Version field of each Driver
+    // Binding Protocol and on the version returned by each Driver Family Override
+    // Protocol, which may change in place, so check them again too.
+    //
+    ASSERT (mDefaultDriverBindingOrderCount <= DriverBindingHandleCount);
+    for (Index = 0; Index < mDefaultDriverBindingOrderCount; Index++) {
+      if (mDefaultDriverBindingOrder[Index].DriverBinding->Version != mDefaultDriverBindingOrder[Index].Version) {
+        break;
+      }
+      DriverFamilyOverride = mDefaultDriverBindingOrder[Index].DriverFamilyOverride;
+      if ((DriverFamilyOverride != NULL) &&
+          (DriverFamilyOverride->GetVersion (DriverFamilyOverride) != mDefaultDriverBindingOrder[Index].DriverFamilyOverrideVersion)) {
+        break;
+      }
+      SortedDriverBindingProtocols[Index] = mDefaultDriverBindingOrder[Index].DriverBinding;
+    }
+    if (Index == mDefaultDriverBindingOrderCount) {
+      NumberOfSortedDriverBindingProtocols = mDefaultDriverBindingOrderCount;
+      CoreFreePool (DriverBindingHandleBuffer);
+      goto StartDrivers;
+    }
+  }
+
   //
   // Add Driver Binding Protocols from Context Driver Image Handles first
   //
@@ -611,6 +702,39 @@ CoreConnectSingleController (
     }
   }
 
+  //
+  // Remember the default order for the next controllers
+  //
+  if (DefaultOrder && (NumberOfSortedDriverBindingProtocols <= DriverBindingHandleCount)) {
+    NewDefaultOrder = AllocatePool (sizeof (DEFAULT_DRIVER_BINDING_ORDER_ENTRY) * NumberOfSortedDriverBindingProtocols);
+    if (NewDefaultOrder != NULL) {
+      for (Index = 0; Index < NumberOfSortedDriverBindingProtocols; Index++) {
+        DriverBinding = SortedDriverBindingProtocols[Index];
+        NewDefaultOrder[Index].DriverBinding               = DriverBinding;
+        NewDefaultOrder[Index].Version                     = DriverBinding->Version;
+        NewDefaultOrder[Index].DriverFamilyOverride        = NULL;
+        NewDefaultOrder[Index].DriverFamilyOverrideVersion = 0;
+        Status = CoreHandleProtocol (
+                   DriverBinding->DriverBindingHandle,
+                   &gEfiDriverFamilyOverrideProtocolGuid,
+                   (VOID **) &DriverFamilyOverride
+                   );
+        if (!EFI_ERROR (Status) && (DriverFamilyOverride != NULL)) {
+          NewDefaultOrder[Index].DriverFamilyOverride        = DriverFamilyOverride;
+          NewDefaultOrder[Index].DriverFamilyOverrideVersion = DriverFamilyOverride->GetVersion (DriverFamilyOverride);
+        }
+      }
+      if (mDefaultDriverBindingOrder != NULL) {
+        CoreFreePool (mDefaultDriverBindingOrder);
+      }
+      mDefaultDriverBindingOrder      = NewDefaultOrder;
+      mDefaultDriverBindingOrderCount = NumberOfSortedDriverBindingProtocols;
+      mDefaultDriverBindingKey        = DriverBindingKey;
+      mDefaultDriverFamilyOverrideKey = DriverFamilyOverrideKey;
+    }
+  }
+
+StartDrivers:
   //
   // Loop until no more drivers can be started on ControllerHandle
   //
@@ -749,11 +873,14 @@ CoreDisconnectController (
   PROTOCOL_INTERFACE                  *Prot;
   EFI_DRIVER_BINDING_PROTOCOL         *DriverBinding;
 
+  CoreAcquireProtocolLock ();
+
   //
   // Make sure ControllerHandle is valid
   //
   Status = CoreValidateHandle (ControllerHandle);
   if (EFI_ERROR (Status)) {
+    CoreReleaseProtocolLock ();
     return Status;
   }
 
@@ -763,10 +890,13 @@ CoreDisconnectController (
   if (ChildHandle != NULL) {
     Status = CoreValidateHandle (ChildHandle);
     if (EFI_ERROR (Status)) {
+      CoreReleaseProtocolLock ();
       return Status;
     }
   }
 
+  CoreReleaseProtocolLock ();
+
   Handle = ControllerHandle;
 
   //
@@ -27,6 +27,17 @@ LIST_ENTRY      gHandleList           = INITIALIZE_LIST_HEAD_VARIABLE (gHandleLi
 EFI_LOCK        gProtocolDatabaseLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_NOTIFY);
 UINT64          gHandleDatabaseKey    = 0;
 
+//
+// mProtocolEntryHash     - Protocol entries of mProtocolDatabase hashed by protocol GUID
+// mHandleHash            - Handles of gHandleList hashed by handle value
+// mProtocolInterfaceHash - Protocol interfaces hashed by handle and protocol entry
+// mProtocolLookupsSaved  - Number of lookups that found their entry in the hash tables instead of a list walk
+//
+PROTOCOL_ENTRY      *mProtocolEntryHash[PROTOCOL_ENTRY_HASH_SIZE];
+IHANDLE             *mHandleHash[HANDLE_HASH_SIZE];
+PROTOCOL_INTERFACE  *mProtocolInterfaceHash[PROTOCOL_INTERFACE_HASH_SIZE];
+UINT64              mProtocolLookupsSaved = 0;
+
 
 
 /**
@@ -57,8 +68,222 @@ CoreReleaseProtocolLock (
 
 
 
+/**
+  Compute the bucket of a pointer in a hash table.
+
+  @param  Pointer                The pointer to hash
+  @param  HashSize               The number of buckets in the hash table
+
+  @return Index of the bucket
+
+**/
+UINTN
+CoreHashPointer (
+  IN CONST VOID     *Pointer,
+  IN UINTN          HashSize
+  )
+{
+  UINTN               Value;
+
+  //
+  // Pool allocations are 8-byte aligned, so the low bits carry no information
+  //
+  Value = (UINTN) Pointer >> 3;
+  return (Value ^ (Value >> 9)) & (HashSize - 1);
+}
+
+
+
+/**
+  Compute the bucket of a protocol GUID in the protocol entry hash table.
+
+  @param  Protocol               The protocol GUID to hash
+
+  @return Index of the bucket
+
+**/
+UINTN
+CoreHashProtocolGuid (
+  IN CONST EFI_GUID *Protocol
+  )
+{
+  UINT32              Value;
+
+  Value = ReadUnaligned32 ((CONST UINT32 *) Protocol) ^
+          ReadUnaligned32 ((CONST UINT32 *) Protocol + 1) ^
+          ReadUnaligned32 ((CONST UINT32 *) Protocol + 2) ^
+          ReadUnaligned32 ((CONST UINT32 *) Protocol + 3);
+  return (Value ^ (Value >> 16)) & (PROTOCOL_ENTRY_HASH_SIZE - 1);
+}
+
+
+
+/**
+  Compute the bucket of a handle and protocol entry pair in the protocol
+  interface hash table.
+
+  @param  Handle                 The handle the protocol interface is on
+  @param  ProtEntry              The protocol entry of the protocol interface
+
+  @return Index of the bucket
+
+**/
+UINTN
+CoreHashProtocolInterface (
+  IN IHANDLE        *Handle,
+  IN PROTOCOL_ENTRY *ProtEntry
+  )
+{
+  return CoreHashPointer (Handle, PROTOCOL_INTERFACE_HASH_SIZE) ^
+         CoreHashPointer (ProtEntry, PROTOCOL_INTERFACE_HASH_SIZE);
+}
+
+
+
+/**
+  Find the protocol interface for a protocol entry on a handle in the
+  protocol interface hash table.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Handle                 The handle to search the protocol on
+  @param  ProtEntry              The protocol entry of the protocol
+
+  @return Protocol instance (NULL: Not found)
+
+**/
+PROTOCOL_INTERFACE *
+CoreLookupProtocolInterface (
+  IN IHANDLE        *Handle,
+  IN PROTOCOL_ENTRY *ProtEntry
+  )
+{
+  PROTOCOL_INTERFACE  *Prot;
+
+  ASSERT_LOCKED(&gProtocolDatabaseLock);
+
+  Prot = mProtocolInterfaceHash[CoreHashProtocolInterface (Handle, ProtEntry)];
+  while (Prot != NULL) {
+    if (Prot->Handle == Handle && Prot->Protocol == ProtEntry) {
+      break;
+    }
+    Prot = Prot->HashNext;
+  }
+
+  if (Prot != NULL) {
+    mProtocolLookupsSaved++;
+  }
+  return Prot;
+}
+
+
+
+/**
+  Add a protocol interface to the protocol interface hash table.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Prot                   The protocol interface to add
+
+**/
+VOID
+CoreInsertProtocolInterfaceHash (
+  IN PROTOCOL_INTERFACE   *Prot
+  )
+{
+  UINTN               Index;
+
+  ASSERT_LOCKED(&gProtocolDatabaseLock);
+
+  Index = CoreHashProtocolInterface (Prot->Handle, Prot->Protocol);
+  Prot->HashNext = mProtocolInterfaceHash[Index];
+  mProtocolInterfaceHash[Index] = Prot;
+}
+
+
+
+/**
+  Remove a protocol interface from the protocol interface hash table.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Prot                   The protocol interface to remove
+
+**/
+VOID
+CoreRemoveProtocolInterfaceHash (
+  IN PROTOCOL_INTERFACE   *Prot
+  )
+{
+  PROTOCOL_INTERFACE  **Link;
+
+  ASSERT_LOCKED(&gProtocolDatabaseLock);
+
+  Link = &mProtocolInterfaceHash[CoreHashProtocolInterface (Prot->Handle, Prot->Protocol)];
+  while (*Link != NULL) {
+    if (*Link == Prot) {
+      *Link = Prot->HashNext;
+      break;
+    }
+    Link = &(*Link)->HashNext;
+  }
+  Prot->HashNext = NULL;
+}
+
+
+
+/**
+  Add a handle to the handle hash table.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Handle                 The handle to add
+
+**/
+VOID
+CoreInsertHandleHash (
+  IN IHANDLE        *Handle
+  )
+{
+  UINTN               Index;
+
+  ASSERT_LOCKED(&gProtocolDatabaseLock);
+
+  Index = CoreHashPointer (Handle, HANDLE_HASH_SIZE);
+  Handle->HashNext = mHandleHash[Index];
+  mHandleHash[Index] = Handle;
+}
+
+
+
+/**
+  Remove a handle from the handle hash table.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Handle                 The handle to remove
+
+**/
+VOID
+CoreRemoveHandleHash (
+  IN IHANDLE        *Handle
+  )
+{
+  IHANDLE             **Link;
+
+  ASSERT_LOCKED(&gProtocolDatabaseLock);
+
+  Link = &mHandleHash[CoreHashPointer (Handle, HANDLE_HASH_SIZE)];
+  while (*Link != NULL) {
+    if (*Link == Handle) {
+      *Link = Handle->HashNext;
+      break;
+    }
+    Link = &(*Link)->HashNext;
+  }
+  Handle->HashNext = NULL;
+}
+
+
+
 /**
   Check whether a handle is a valid EFI_HANDLE
+  The gProtocolDatabaseLock must be owned
 
   @param  UserHandle             The handle to check
 
@@ -73,13 +298,28 @@ CoreValidateHandle (
 {
   IHANDLE             *Handle;
 
-  Handle = (IHANDLE *)UserHandle;
-  if (Handle == NULL) {
+  if (UserHandle == NULL) {
     return EFI_INVALID_PARAMETER;
   }
-  if (Handle->Signature != EFI_HANDLE_SIGNATURE) {
+
+  ASSERT_LOCKED(&gProtocolDatabaseLock);
+
+  //
+  // Look the handle up in the handle hash table rather than dereferencing it,
+  // so that stale or bogus handle values are rejected safely.
+  //
+  for (Handle = mHandleHash[CoreHashPointer (UserHandle, HANDLE_HASH_SIZE)];
+       Handle != NULL;
+       Handle = Handle->HashNext) {
+    if (Handle == (IHANDLE *) UserHandle) {
+      break;
+    }
+  }
+
+  if (Handle == NULL) {
     return EFI_INVALID_PARAMETER;
   }
+  ASSERT_IS_HANDLE (Handle);
   return EFI_SUCCESS;
 }
 
@@ -101,22 +341,20 @@ CoreFindProtocolEntry (
   IN BOOLEAN    Create
   )
 {
-  LIST_ENTRY          *Link;
+  UINTN               Index;
   PROTOCOL_ENTRY      *Item;
   PROTOCOL_ENTRY      *ProtEntry;
 
   ASSERT_LOCKED(&gProtocolDatabaseLock);
 
   //
-  // Search the database for the matching GUID
+  // Search the hash bucket of the GUID for the matching entry
   //
 
   ProtEntry = NULL;
-  for (Link = mProtocolDatabase.ForwardLink;
-       Link != &mProtocolDatabase;
-       Link = Link->ForwardLink) {
-
-    Item = CR(Link, PROTOCOL_ENTRY, AllEntries, PROTOCOL_ENTRY_SIGNATURE);
+  Index = CoreHashProtocolGuid (Protocol);
+  for (Item = mProtocolEntryHash[Index]; Item != NULL; Item = Item->HashNext) {
+    ASSERT (Item->Signature == PROTOCOL_ENTRY_SIGNATURE);
     if (CompareGuid (&Item->ProtocolID, Protocol)) {
 
       //
@@ -124,6 +362,7 @@ CoreFindProtocolEntry (
       //
 
       ProtEntry = Item;
+      mProtocolLookupsSaved++;
       break;
     }
   }
@@ -140,6 +379,7 @@ CoreFindProtocolEntry (
       // Initialize new protocol entry structure
       //
       ProtEntry->Signature = PROTOCOL_ENTRY_SIGNATURE;
+      ProtEntry->Key = 0;
       CopyGuid ((VOID *)&ProtEntry->ProtocolID, Protocol);
       InitializeListHead (&ProtEntry->Protocols);
       InitializeListHead (&ProtEntry->Notify);
@@ -148,6 +388,8 @@ CoreFindProtocolEntry (
       // Add it to protocol database
       //
       InsertTailList (&mProtocolDatabase, &ProtEntry->AllEntries);
+      ProtEntry->HashNext = mProtocolEntryHash[Index];
+      mProtocolEntryHash[Index] = ProtEntry;
     }
   }
 
@@ -156,6 +398,33 @@ CoreFindProtocolEntry (
 
 
 
+/**
+  Get the key of a protocol, which changes each time an interface of the
+  protocol is installed, reinstalled or uninstalled.
+
+  @param  Protocol               The ID of the protocol
+
+  @return The key of the protocol, or 0 if it was never installed
+
+**/
+UINT64
+CoreGetProtocolKey (
+  IN EFI_GUID       *Protocol
+  )
+{
+  PROTOCOL_ENTRY      *ProtEntry;
+  UINT64              Key;
+
+  CoreAcquireProtocolLock ();
+  ProtEntry = CoreFindProtocolEntry (Protocol, FALSE);
+  Key = (ProtEntry != NULL) ? ProtEntry->Key : 0;
+  CoreReleaseProtocolLock ();
+
+  return Key;
+}
+
+
+
 /**
   Finds the protocol instance for the requested handle and protocol.
   Note: This function doesn't do parameters checking, it's caller's responsibility
@@ -177,7 +446,6 @@ CoreFindProtocolInterface (
 {
   PROTOCOL_INTERFACE  *Prot;
   PROTOCOL_ENTRY      *ProtEntry;
-  LIST_ENTRY          *Link;
 
   ASSERT_LOCKED(&gProtocolDatabaseLock);
   Prot = NULL;
@@ -190,18 +458,11 @@ CoreFindProtocolInterface (
   if (ProtEntry != NULL) {
 
     //
-    // Look at each protocol interface for any matches
+    // A handle holds at most one interface of each protocol, so the
+    // protocol interface hash table gives the only candidate
     //
-    for (Link = Handle->Protocols.ForwardLink; Link != &Handle->Protocols; Link=Link->ForwardLink) {
-
-      //
-      // If this protocol interface matches, remove it
-      //
-      Prot = CR(Link, PROTOCOL_INTERFACE, Link, PROTOCOL_INTERFACE_SIGNATURE);
-      if (Prot->Interface == Interface && Prot->Protocol == ProtEntry) {
-        break;
-      }
-
+    Prot = CoreLookupProtocolInterface (Handle, ProtEntry);
+    if (Prot != NULL && Prot->Interface != Interface) {
       Prot = NULL;
     }
   }
@@ -428,6 +689,7 @@ CoreInstallProtocolInterfaceNotify (
     // in the system
     //
     InsertTailList (&gHandleList, &Handle->AllHandles);
+    CoreInsertHandleHash (Handle);
   }
 
   Status = CoreValidateHandle (Handle);
@@ -465,6 +727,8 @@ CoreInstallProtocolInterfaceNotify (
   // protocol entry
   //
   InsertTailList (&ProtEntry->Protocols, &Prot->ByProtocol);
+  CoreInsertProtocolInterfaceHash (Prot);
+  ProtEntry->Key++;
 
   //
   // Notify the notification list for this protocol
@@ -726,19 +990,19 @@ CoreUninstallProtocolInterface (
     return EFI_INVALID_PARAMETER;
   }
 
+  //
+  // Lock the protocol database
+  //
+  CoreAcquireProtocolLock ();
+
   //
   // Check that UserHandle is a valid handle
   //
   Status = CoreValidateHandle (UserHandle);
   if (EFI_ERROR (Status)) {
-    return Status;
+    goto Done;
   }
 
-  //
-  // Lock the protocol database
-  //
-  CoreAcquireProtocolLock ();
-
   //
   // Check that Protocol exists on UserHandle, and Interface matches the interface in the database
   //
@@ -780,6 +1044,7 @@ CoreUninstallProtocolInterface (
     // Remove the protocol interface from the handle
     //
     RemoveEntryList (&Prot->Link);
+    CoreRemoveProtocolInterfaceHash (Prot);
 
     //
     // Free the memory
@@ -795,6 +1060,7 @@ CoreUninstallProtocolInterface (
   if (IsListEmpty (&Handle->Protocols)) {
     Handle->Signature = 0;
     RemoveEntryList (&Handle->AllHandles);
+    CoreRemoveHandleHash (Handle);
     CoreFreePool (Handle);
   }
 
@@ -878,6 +1144,7 @@ CoreUninstallMultipleProtocolInterfaces (
 
 /**
   Locate a certain GUID protocol interface in a Handle's protocols.
+  The gProtocolDatabaseLock must be owned
 
   @param  UserHandle             The handle to obtain the protocol interface on
   @param  Protocol               The GUID of the protocol
@@ -893,9 +1160,7 @@ CoreGetProtocolInterface (
 {
   EFI_STATUS          Status;
   PROTOCOL_ENTRY      *ProtEntry;
-  PROTOCOL_INTERFACE  *Prot;
   IHANDLE             *Handle;
-  LIST_ENTRY          *Link;
 
   Status = CoreValidateHandle (UserHandle);
   if (EFI_ERROR (Status)) {
@@ -905,16 +1170,13 @@ CoreGetProtocolInterface (
   Handle = (IHANDLE *)UserHandle;
 
   //
-  // Look at each protocol interface for a match
+  // Look up the protocol entry, then the interface of that protocol on the handle
   //
-  for (Link = Handle->Protocols.ForwardLink; Link != &Handle->Protocols; Link = Link->ForwardLink) {
-    Prot = CR(Link, PROTOCOL_INTERFACE, Link, PROTOCOL_INTERFACE_SIGNATURE);
-    ProtEntry = Prot->Protocol;
-    if (CompareGuid (&ProtEntry->ProtocolID, Protocol)) {
-      return Prot;
-    }
+  ProtEntry = CoreFindProtocolEntry (Protocol, FALSE);
+  if (ProtEntry == NULL) {
+    return NULL;
   }
-  return NULL;
+  return CoreLookupProtocolInterface (Handle, ProtEntry);
 }
 
 
@@ -1012,12 +1274,17 @@ CoreOpenProtocol (
     }
   }
 
+  //
+  // Lock the protocol database
+  //
+  CoreAcquireProtocolLock ();
+
   //
   // Check for invalid UserHandle
   //
   Status = CoreValidateHandle (UserHandle);
   if (EFI_ERROR (Status)) {
-    return Status;
+    goto Done;
   }
 
   //
@@ -1027,31 +1294,32 @@ CoreOpenProtocol (
   case EFI_OPEN_PROTOCOL_BY_CHILD_CONTROLLER :
     Status = CoreValidateHandle (ImageHandle);
     if (EFI_ERROR (Status)) {
-      return Status;
+      goto Done;
     }
     Status = CoreValidateHandle (ControllerHandle);
     if (EFI_ERROR (Status)) {
-      return Status;
+      goto Done;
     }
     if (UserHandle == ControllerHandle) {
-      return EFI_INVALID_PARAMETER;
+      Status = EFI_INVALID_PARAMETER;
+      goto Done;
     }
     break;
   case EFI_OPEN_PROTOCOL_BY_DRIVER :
   case EFI_OPEN_PROTOCOL_BY_DRIVER | EFI_OPEN_PROTOCOL_EXCLUSIVE :
     Status = CoreValidateHandle (ImageHandle);
     if (EFI_ERROR (Status)) {
-      return Status;
+      goto Done;
     }
     Status = CoreValidateHandle (ControllerHandle);
     if (EFI_ERROR (Status)) {
-      return Status;
+      goto Done;
     }
     break;
   case EFI_OPEN_PROTOCOL_EXCLUSIVE :
     Status = CoreValidateHandle (ImageHandle);
     if (EFI_ERROR (Status)) {
-      return Status;
+      goto Done;
     }
     break;
   case EFI_OPEN_PROTOCOL_BY_HANDLE_PROTOCOL :
@@ -1059,14 +1327,10 @@ CoreOpenProtocol (
   case EFI_OPEN_PROTOCOL_TEST_PROTOCOL :
     break;
   default:
-    return EFI_INVALID_PARAMETER;
+    Status = EFI_INVALID_PARAMETER;
+    goto Done;
   }
 
-  //
-  // Lock the protocol database
-  //
-  CoreAcquireProtocolLock ();
-
   //
   // Look at each protocol interface for a match
   //
@@ -1223,32 +1487,33 @@ CoreCloseProtocol (
   LIST_ENTRY          *Link;
   OPEN_PROTOCOL_DATA  *OpenData;
 
+  //
+  // Lock the protocol database
+  //
+  CoreAcquireProtocolLock ();
+
   //
   // Check for invalid parameters
   //
   Status = CoreValidateHandle (UserHandle);
   if (EFI_ERROR (Status)) {
-    return Status;
+    goto Done;
   }
   Status = CoreValidateHandle (AgentHandle);
   if (EFI_ERROR (Status)) {
-    return Status;
+    goto Done;
   }
   if (ControllerHandle != NULL) {
     Status = CoreValidateHandle (ControllerHandle);
     if (EFI_ERROR (Status)) {
-      return Status;
+      goto Done;
     }
   }
   if (Protocol == NULL) {
-    return EFI_INVALID_PARAMETER;
+    Status = EFI_INVALID_PARAMETER;
+    goto Done;
   }
 
-  //
-  // Lock the protocol database
-  //
-  CoreAcquireProtocolLock ();
-
   //
   // Look at each protocol interface for a match
   //
@@ -1420,13 +1685,6 @@ CoreProtocolsPerHandle (
   UINTN                               ProtocolCount;
   EFI_GUID                            **Buffer;
 
-  Status = CoreValidateHandle (UserHandle);
-  if (EFI_ERROR (Status)) {
-    return Status;
-  }
-
-  Handle = (IHANDLE *)UserHandle;
-
   if (ProtocolBuffer == NULL) {
     return EFI_INVALID_PARAMETER;
   }
@@ -1441,6 +1699,13 @@ CoreProtocolsPerHandle (
 
   CoreAcquireProtocolLock ();
 
+  Status = CoreValidateHandle (UserHandle);
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
+  Handle = (IHANDLE *)UserHandle;
+
   for (Link = Handle->Protocols.ForwardLink; Link != &Handle->Protocols; Link = Link->ForwardLink) {
     ProtocolCount++;
   }
@@ -1477,6 +1742,34 @@ Done:
 
 
 
+/**
+  Log the number of protocol database lookups that were served by the hash
+  tables instead of a list walk. The count is recorded as the Identifier of a
+  performance record, so it is reported by Dp.
+
+  @param  Event                  The event that is signaled
+  @param  Context                Not used
+
+**/
+VOID
+EFIAPI
+CoreLogProtocolDatabaseStatistics (
+  IN EFI_EVENT      Event,
+  IN VOID           *Context
+  )
+{
+  UINT32              Identifier;
+
+  CoreAcquireProtocolLock ();
+  Identifier = (UINT32) MIN (mProtocolLookupsSaved, MAX_UINT32);
+  CoreReleaseProtocolLock ();
+
+  PERF_START_EX (NULL, "ProtocolDbLookupsSaved", "DxeMain", 0, Identifier);
+  PERF_END_EX (NULL, "ProtocolDbLookupsSaved", "DxeMain", 0, Identifier);
+}
+
+
+
 /**
   return handle database key.
 
@@ -18,10 +18,18 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #define EFI_HANDLE_SIGNATURE            SIGNATURE_32('h','n','d','l')
 
+///
+/// Number of buckets in the protocol database hash tables. Must be powers of 2.
+///
+#define PROTOCOL_ENTRY_HASH_SIZE        64
+#define HANDLE_HASH_SIZE                256
+#define PROTOCOL_INTERFACE_HASH_SIZE    512
+
 ///
 /// IHANDLE - contains a list of protocol handles
 ///
-typedef struct {
+typedef struct _IHANDLE IHANDLE;
+struct _IHANDLE {
   UINTN               Signature;
   /// All handles list of IHANDLE
   LIST_ENTRY          AllHandles;
@@ -30,7 +38,9 @@ typedef struct {
   UINTN               LocateRequest;
   /// The Handle Database Key value when this handle was last created or modified
   UINT64              Key;
-} IHANDLE;
+  /// Next handle in the same bucket of the handle hash table
+  IHANDLE             *HashNext;
+};
 
 #define ASSERT_IS_HANDLE(a)  ASSERT((a)->Signature == EFI_HANDLE_SIGNATURE)
 
@@ -41,7 +51,8 @@ typedef struct {
 /// database.  Each handler that supports this protocol is listed, along
 /// with a list of registered notifies.
 ///
-typedef struct {
+typedef struct _PROTOCOL_ENTRY PROTOCOL_ENTRY;
+struct _PROTOCOL_ENTRY {
   UINTN               Signature;
   /// Link Entry inserted to mProtocolDatabase
   LIST_ENTRY          AllEntries;  
@@ -51,7 +62,11 @@ typedef struct {
   LIST_ENTRY          Protocols;     
   /// Registerd notification handlers
   LIST_ENTRY          Notify;                 
-} PROTOCOL_ENTRY;
+  /// Incremented each time an interface of this protocol is installed, reinstalled or uninstalled
+  UINT64              Key;
+  /// Next protocol entry in the same bucket of the protocol entry hash table
+  PROTOCOL_ENTRY      *HashNext;
+};
 
 
 #define PROTOCOL_INTERFACE_SIGNATURE  SIGNATURE_32('p','i','f','c')
@@ -60,7 +75,8 @@ typedef struct {
 /// PROTOCOL_INTERFACE - each protocol installed on a handle is tracked
 /// with a protocol interface structure
 ///
-typedef struct {
+typedef struct _PROTOCOL_INTERFACE PROTOCOL_INTERFACE;
+struct _PROTOCOL_INTERFACE {
   UINTN                       Signature;
   /// Link on IHANDLE.Protocols
   LIST_ENTRY                  Link;   
@@ -75,8 +91,9 @@ typedef struct {
   /// OPEN_PROTOCOL_DATA list
   LIST_ENTRY                  OpenList;       
   UINTN                       OpenListCount;
-
-} PROTOCOL_INTERFACE;
+  /// Next protocol interface in the same bucket of the protocol interface hash table
+  PROTOCOL_INTERFACE          *HashNext;
+};
 
 #define OPEN_PROTOCOL_DATA_SIGNATURE  SIGNATURE_32('p','o','d','l')
 
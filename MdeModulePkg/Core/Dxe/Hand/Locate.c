@@ -180,7 +180,9 @@ CoreLocateHandle (
       break;
     }
     //
-    // Look up the protocol entry and set the head pointer
+    // Look up the protocol entry in the protocol entry hash table and set the
+    // head pointer. The walk that follows only visits the interfaces of this
+    // protocol, so it costs as much as the handles it returns.
     //
     Position.ProtEntry = CoreFindProtocolEntry (Protocol, FALSE);
     if (Position.ProtEntry == NULL) {
@@ -84,6 +84,7 @@ CoreRemoveInterfaceFromProtocol (
     // Remove the protocol interface entry
     //
     RemoveEntryList (&Prot->ByProtocol);
+    ProtEntry->Key++;
   }
 
   return Prot;
@@ -193,11 +194,6 @@ CoreReinstallProtocolInterface (
   PROTOCOL_INTERFACE        *Prot;
   PROTOCOL_ENTRY            *ProtEntry;
 
-  Status = CoreValidateHandle (UserHandle);
-  if (EFI_ERROR (Status)) {
-    return Status;
-  }
-
   if (Protocol == NULL) {
     return EFI_INVALID_PARAMETER;
   }
@@ -209,6 +205,11 @@ CoreReinstallProtocolInterface (
   //
   CoreAcquireProtocolLock ();
 
+  Status = CoreValidateHandle (UserHandle);
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
   //
   // Check that Protocol exists on UserHandle, and Interface matches the interface in the database
   //
@@ -32,6 +32,19 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #endif
 
 
+//
+// MEMORY_MAP_NODE - node of a balanced tree that indexes MEMORY_MAP entries
+// by start address. MaxSize is the size of the largest range in the subtree.
+//
+typedef struct _MEMORY_MAP_NODE MEMORY_MAP_NODE;
+struct _MEMORY_MAP_NODE {
+  MEMORY_MAP_NODE *Parent;
+  MEMORY_MAP_NODE *Left;
+  MEMORY_MAP_NODE *Right;
+  UINT64          MaxSize;
+  UINTN           Height;
+};
+
 //
 // MEMORY_MAP_ENTRY
 //
@@ -48,8 +61,20 @@ typedef struct {
 
   UINT64          VirtualStart;
   UINT64          Attribute;
+
+  MEMORY_MAP_NODE AddressNode;
+  MEMORY_MAP_NODE FreeNode;
 } MEMORY_MAP;
 
+//
+// MEMORY_MAP_INDEX - balanced tree of MEMORY_MAP entries. NodeOffset is the
+// offset of the MEMORY_MAP_NODE used by this index inside MEMORY_MAP.
+//
+typedef struct {
+  MEMORY_MAP_NODE *Root;
+  UINTN           NodeOffset;
+} MEMORY_MAP_INDEX;
+
 //
 // Internal prototypes
 //
@@ -145,6 +170,134 @@ CoreReleaseMemoryLock (
   );
 
 
+/**
+  Insert a memory map entry into an index.
+
+  @param  Index                  The index to insert into.
+  @param  Entry                  The entry to insert. Its range must not overlap
+                                 the range of any entry already in the index.
+
+**/
+VOID
+MemoryMapIndexInsert (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP        *Entry
+  );
+
+
+/**
+  Remove a memory map entry from an index.
+
+  @param  Index                  The index to remove from.
+  @param  Entry                  The entry to remove.
+
+**/
+VOID
+MemoryMapIndexRemove (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP        *Entry
+  );
+
+
+/**
+  Update an index after the range of one of its entries was clipped in place.
+
+  @param  Index                  The index that holds Entry.
+  @param  Entry                  The entry whose Start or End changed.
+
+**/
+VOID
+MemoryMapIndexUpdate (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP        *Entry
+  );
+
+
+/**
+  Find the entry of an index whose range covers an address.
+
+  @param  Index                  The index to search.
+  @param  Address                The address to look for.
+
+  @return The entry that covers Address, or NULL.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexFindCovering (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN UINT64            Address
+  );
+
+
+/**
+  Find the entry with the lowest start address above an address.
+
+  @param  Index                  The index to search.
+  @param  Address                The address the entry must start above.
+
+  @return The entry, or NULL if no entry starts above Address.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexFindAbove (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN UINT64            Address
+  );
+
+
+/**
+  Get the entry that follows an entry in address order.
+
+  @param  Index                  The index that holds Entry.
+  @param  Entry                  The current entry.
+
+  @return The next entry, or NULL if Entry is the last one.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexNext (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP        *Entry
+  );
+
+
+/**
+  Find the entry with the highest start address below an address whose range
+  is at least a given size.
+
+  @param  Index                  The index to search.
+  @param  Address                The address the entry must start below.
+  @param  MinSize                The minimum size of the range in bytes.
+
+  @return The entry, or NULL if there is no such entry.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexFindLastFit (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN UINT64            Address,
+  IN UINT64            MinSize
+  );
+
+
+/**
+  Get the entry that precedes an entry in address order and whose range is at
+  least a given size.
+
+  @param  Index                  The index that holds Entry.
+  @param  Entry                  The current entry.
+  @param  MinSize                The minimum size of the range in bytes.
+
+  @return The entry, or NULL if there is no such entry.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexPrevFit (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP        *Entry,
+  IN UINT64            MinSize
+  );
+
 //
 // Internal Global data
 //
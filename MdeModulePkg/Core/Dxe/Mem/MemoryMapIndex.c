@@ -0,0 +1,561 @@
+/** @file
+  Balanced tree index of the memory map entries.
+
+  The entries of gMemoryMap never overlap, so they are kept in an AVL tree
+  ordered by start address. Every node also records the size of the largest
+  range in its subtree, which lets the page allocator skip whole subtrees of
+  free ranges that are too small for a request. The nodes are embedded in the
+  MEMORY_MAP entries so that no memory is allocated while gMemoryLock is held.
+
+Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "DxeMain.h"
+#include "Imem.h"
+
+#define NODE_TO_ENTRY(Index, Node)   ((MEMORY_MAP *) ((UINTN) (Node) - (Index)->NodeOffset))
+#define ENTRY_TO_NODE(Index, Entry)  ((MEMORY_MAP_NODE *) ((UINTN) (Entry) + (Index)->NodeOffset))
+
+/**
+  Get the size in bytes of the range of the entry linked by a node.
+
+  @param  Index                  The index that holds Node.
+  @param  Node                   The node.
+
+  @return The size of the range.
+
+**/
+UINT64
+NodeRangeSize (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP_NODE   *Node
+  )
+{
+  MEMORY_MAP  *Entry;
+
+  Entry = NODE_TO_ENTRY (Index, Node);
+  return Entry->End - Entry->Start + 1;
+}
+
+/**
+  Get the height of a subtree.
+
+  @param  Node                   The root of the subtree, or NULL.
+
+  @return The height of the subtree.
+
+**/
+UINTN
+NodeHeight (
+  IN MEMORY_MAP_NODE   *Node
+  )
+{
+  return (Node == NULL) ? 0 : Node->Height;
+}
+
+/**
+  Get the size of the largest range in a subtree.
+
+  @param  Node                   The root of the subtree, or NULL.
+
+  @return The size of the largest range.
+
+**/
+UINT64
+NodeMaxSize (
+  IN MEMORY_MAP_NODE   *Node
+  )
+{
+  return (Node == NULL) ? 0 : Node->MaxSize;
+}
+
+/**
+  Recompute the height and largest range size of a node from its children.
+
+  @param  Index                  The index that holds Node.
+  @param  Node                   The node.
+
+**/
+VOID
+RefreshNode (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP_NODE   *Node
+  )
+{
+  Node->Height  = 1 + MAX (NodeHeight (Node->Left), NodeHeight (Node->Right));
+  Node->MaxSize = MAX (NodeRangeSize (Index, Node), MAX (NodeMaxSize (Node->Left), NodeMaxSize (Node->Right)));
+}
+
+/**
+  Replace the link from a parent to one of its children.
+
+  @param  Index                  The index that holds the nodes.
+  @param  Parent                 The parent, or NULL if OldChild is the root.
+  @param  OldChild               The current child.
+  @param  NewChild               The new child, or NULL.
+
+**/
+VOID
+ReplaceChild (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP_NODE   *Parent,
+  IN MEMORY_MAP_NODE   *OldChild,
+  IN MEMORY_MAP_NODE   *NewChild
+  )
+{
+  if (Parent == NULL) {
+    Index->Root = NewChild;
+  } else if (Parent->Left == OldChild) {
+    Parent->Left = NewChild;
+  } else {
+    Parent->Right = NewChild;
+  }
+}
+
+/**
+  Rotate a subtree to the left.
+
+  @param  Index                  The index that holds Node.
+  @param  Node                   The root of the subtree.
+
+  @return The new root of the subtree.
+
+**/
+MEMORY_MAP_NODE *
+RotateLeft (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP_NODE   *Node
+  )
+{
+  MEMORY_MAP_NODE  *Pivot;
+
+  Pivot = Node->Right;
+  Node->Right = Pivot->Left;
+  if (Pivot->Left != NULL) {
+    Pivot->Left->Parent = Node;
+  }
+  Pivot->Parent = Node->Parent;
+  ReplaceChild (Index, Node->Parent, Node, Pivot);
+  Pivot->Left  = Node;
+  Node->Parent = Pivot;
+
+  RefreshNode (Index, Node);
+  RefreshNode (Index, Pivot);
+  return Pivot;
+}
+
+/**
+  Rotate a subtree to the right.
+
+  @param  Index                  The index that holds Node.
+  @param  Node                   The root of the subtree.
+
+  @return The new root of the subtree.
+
+**/
+MEMORY_MAP_NODE *
+RotateRight (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP_NODE   *Node
+  )
+{
+  MEMORY_MAP_NODE  *Pivot;
+
+  Pivot = Node->Left;
+  Node->Left = Pivot->Right;
+  if (Pivot->Right != NULL) {
+    Pivot->Right->Parent = Node;
+  }
+  Pivot->Parent = Node->Parent;
+  ReplaceChild (Index, Node->Parent, Node, Pivot);
+  Pivot->Right = Node;
+  Node->Parent = Pivot;
+
+  RefreshNode (Index, Node);
+  RefreshNode (Index, Pivot);
+  return Pivot;
+}
+
+/**
+  Refresh and rebalance every node from a node up to the root.
+
+  @param  Index                  The index that holds Node.
+  @param  Node                   The lowest node that changed, or NULL.
+
+**/
+VOID
+RebalanceToRoot (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP_NODE   *Node
+  )
+{
+  INTN  Balance;
+
+  while (Node != NULL) {
+    RefreshNode (Index, Node);
+    Balance = (INTN) NodeHeight (Node->Left) - (INTN) NodeHeight (Node->Right);
+    if (Balance > 1) {
+      if (NodeHeight (Node->Left->Left) < NodeHeight (Node->Left->Right)) {
+        RotateLeft (Index, Node->Left);
+      }
+      Node = RotateRight (Index, Node);
+    } else if (Balance < -1) {
+      if (NodeHeight (Node->Right->Right) < NodeHeight (Node->Right->Left)) {
+        RotateRight (Index, Node->Right);
+      }
+      Node = RotateLeft (Index, Node);
+    }
+    Node = Node->Parent;
+  }
+}
+
+/**
+  Insert a memory map entry into an index.
+
+  @param  Index                  The index to insert into.
+  @param  Entry                  The entry to insert. Its range must not overlap
+                                 the range of any entry already in the index.
+
+**/
+VOID
+MemoryMapIndexInsert (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP        *Entry
+  )
+{
+  MEMORY_MAP_NODE  *Node;
+  MEMORY_MAP_NODE  *Parent;
+  MEMORY_MAP_NODE  **Link;
+
+  Node = ENTRY_TO_NODE (Index, Entry);
+
+  Parent = NULL;
+  Link   = &Index->Root;
+  while (*Link != NULL) {
+    Parent = *Link;
+    if (Entry->Start < NODE_TO_ENTRY (Index, Parent)->Start) {
+      Link = &Parent->Left;
+    } else {
+      Link = &Parent->Right;
+    }
+  }
+
+  Node->Parent = Parent;
+  Node->Left   = NULL;
+  Node->Right  = NULL;
+  *Link        = Node;
+  RebalanceToRoot (Index, Node);
+}
+
+/**
+  Remove a memory map entry from an index.
+
+  @param  Index                  The index to remove from.
+  @param  Entry                  The entry to remove.
+
+**/
+VOID
+MemoryMapIndexRemove (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP        *Entry
+  )
+{
+  MEMORY_MAP_NODE  *Node;
+  MEMORY_MAP_NODE  *Child;
+  MEMORY_MAP_NODE  *Successor;
+  MEMORY_MAP_NODE  *Changed;
+
+  Node = ENTRY_TO_NODE (Index, Entry);
+  ASSERT (Node->Height != 0);
+
+  if (Node->Left != NULL && Node->Right != NULL) {
+    //
+    // Put the in-order successor, which has no left child, in place of Node
+    //
+    Successor = Node->Right;
+    while (Successor->Left != NULL) {
+      Successor = Successor->Left;
+    }
+
+    if (Successor->Parent == Node) {
+      Changed = Successor;
+    } else {
+      Changed = Successor->Parent;
+      ReplaceChild (Index, Successor->Parent, Successor, Successor->Right);
+      if (Successor->Right != NULL) {
+        Successor->Right->Parent = Successor->Parent;
+      }
+      Successor->Right    = Node->Right;
+      Node->Right->Parent = Successor;
+    }
+
+    Successor->Left    = Node->Left;
+    Node->Left->Parent = Successor;
+    Successor->Parent  = Node->Parent;
+    ReplaceChild (Index, Node->Parent, Node, Successor);
+  } else {
+    Child = (Node->Left != NULL) ? Node->Left : Node->Right;
+    if (Child != NULL) {
+      Child->Parent = Node->Parent;
+    }
+    ReplaceChild (Index, Node->Parent, Node, Child);
+    Changed = Node->Parent;
+  }
+
+  RebalanceToRoot (Index, Changed);
+  Node->Height = 0;
+}
+
+/**
+  Update an index after the range of one of its entries was clipped in place.
+
+  @param  Index                  The index that holds Entry.
+  @param  Entry                  The entry whose Start or End changed.
+
+**/
+VOID
+MemoryMapIndexUpdate (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP        *Entry
+  )
+{
+  //
+  // Clipping a range never moves it past its neighbors, so only the
+  // largest range sizes on the path to the root need to be recomputed.
+  //
+  RebalanceToRoot (Index, ENTRY_TO_NODE (Index, Entry));
+}
+
+/**
+  Find the entry of an index whose range covers an address.
+
+  @param  Index                  The index to search.
+  @param  Address                The address to look for.
+
+  @return The entry that covers Address, or NULL.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexFindCovering (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN UINT64            Address
+  )
+{
+  MEMORY_MAP_NODE  *Node;
+  MEMORY_MAP       *Entry;
+  MEMORY_MAP       *Best;
+
+  Best = NULL;
+  Node = Index->Root;
+  while (Node != NULL) {
+    Entry = NODE_TO_ENTRY (Index, Node);
+    if (Entry->Start <= Address) {
+      Best = Entry;
+      Node = Node->Right;
+    } else {
+      Node = Node->Left;
+    }
+  }
+
+  if (Best != NULL && Best->End >= Address) {
+    return Best;
+  }
+  return NULL;
+}
+
+/**
+  Find the entry with the lowest start address above an address.
+
+  @param  Index                  The index to search.
+  @param  Address                The address the entry must start above.
+
+  @return The entry, or NULL if no entry starts above Address.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexFindAbove (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN UINT64            Address
+  )
+{
+  MEMORY_MAP_NODE  *Node;
+  MEMORY_MAP       *Entry;
+  MEMORY_MAP       *Best;
+
+  Best = NULL;
+  Node = Index->Root;
+  while (Node != NULL) {
+    Entry = NODE_TO_ENTRY (Index, Node);
+    if (Entry->Start > Address) {
+      Best = Entry;
+      Node = Node->Left;
+    } else {
+      Node = Node->Right;
+    }
+  }
+
+  return Best;
+}
+
+/**
+  Get the entry that follows an entry in address order.
+
+  @param  Index                  The index that holds Entry.
+  @param  Entry                  The current entry.
+
+  @return The next entry, or NULL if Entry is the last one.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexNext (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP        *Entry
+  )
+{
+  MEMORY_MAP_NODE  *Node;
+
+  Node = ENTRY_TO_NODE (Index, Entry);
+  if (Node->Right != NULL) {
+    Node = Node->Right;
+    while (Node->Left != NULL) {
+      Node = Node->Left;
+    }
+    return NODE_TO_ENTRY (Index, Node);
+  }
+
+  while (Node->Parent != NULL && Node == Node->Parent->Right) {
+    Node = Node->Parent;
+  }
+  if (Node->Parent == NULL) {
+    return NULL;
+  }
+  return NODE_TO_ENTRY (Index, Node->Parent);
+}
+
+/**
+  Find the right-most node of a subtree whose range is at least a given size.
+  The subtree must hold such a node.
+
+  @param  Index                  The index that holds Node.
+  @param  Node                   The root of the subtree.
+  @param  MinSize                The minimum size of the range in bytes.
+
+  @return The node.
+
+**/
+MEMORY_MAP_NODE *
+LastFitInSubtree (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP_NODE   *Node,
+  IN UINT64            MinSize
+  )
+{
+  ASSERT (NodeMaxSize (Node) >= MinSize);
+
+  while (TRUE) {
+    if (NodeMaxSize (Node->Right) >= MinSize) {
+      Node = Node->Right;
+    } else if (NodeRangeSize (Index, Node) >= MinSize) {
+      return Node;
+    } else {
+      Node = Node->Left;
+    }
+  }
+}
+
+/**
+  Get the entry that precedes an entry in address order and whose range is at
+  least a given size.
+
+  @param  Index                  The index that holds Entry.
+  @param  Entry                  The current entry.
+  @param  MinSize                The minimum size of the range in bytes.
+
+  @return The entry, or NULL if there is no such entry.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexPrevFit (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN MEMORY_MAP        *Entry,
+  IN UINT64            MinSize
+  )
+{
+  MEMORY_MAP_NODE  *Node;
+  MEMORY_MAP_NODE  *Parent;
+
+  Node = ENTRY_TO_NODE (Index, Entry);
+  if (NodeMaxSize (Node->Left) >= MinSize) {
+    return NODE_TO_ENTRY (Index, LastFitInSubtree (Index, Node->Left, MinSize));
+  }
+
+  //
+  // Walk up. Every ancestor reached from its right subtree, and then its
+  // left subtree, precede Node in address order.
+  //
+  for (; Node->Parent != NULL; Node = Node->Parent) {
+    Parent = Node->Parent;
+    if (Node != Parent->Right) {
+      continue;
+    }
+    if (NodeRangeSize (Index, Parent) >= MinSize) {
+      return NODE_TO_ENTRY (Index, Parent);
+    }
+    if (NodeMaxSize (Parent->Left) >= MinSize) {
+      return NODE_TO_ENTRY (Index, LastFitInSubtree (Index, Parent->Left, MinSize));
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Find the entry with the highest start address below an address whose range
+  is at least a given size.
+
+  @param  Index                  The index to search.
+  @param  Address                The address the entry must start below.
+  @param  MinSize                The minimum size of the range in bytes.
+
+  @return The entry, or NULL if there is no such entry.
+
+**/
+MEMORY_MAP *
+MemoryMapIndexFindLastFit (
+  IN MEMORY_MAP_INDEX  *Index,
+  IN UINT64            Address,
+  IN UINT64            MinSize
+  )
+{
+  MEMORY_MAP_NODE  *Node;
+  MEMORY_MAP       *Entry;
+  MEMORY_MAP       *Best;
+
+  //
+  // Find the last entry that starts below Address
+  //
+  Best = NULL;
+  Node = Index->Root;
+  while (Node != NULL) {
+    Entry = NODE_TO_ENTRY (Index, Node);
+    if (Entry->Start < Address) {
+      Best = Entry;
+      Node = Node->Right;
+    } else {
+      Node = Node->Left;
+    }
+  }
+
+  if (Best == NULL || Best->End - Best->Start + 1 >= MinSize) {
+    return Best;
+  }
+  return MemoryMapIndexPrevFit (Index, Best, MinSize);
+}
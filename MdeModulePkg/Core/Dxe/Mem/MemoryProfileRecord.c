@@ -1191,6 +1191,10 @@ MemoryProfileGetDataSize (
     TotalSize += sizeof (MEMORY_PROFILE_ALLOC_INFO) * (UINTN) DriverInfoData->DriverInfo.AllocRecordCount;
   }
 
+  if (IS_UEFI_MEMORY_PROFILE_ENABLED) {
+    TotalSize += sizeof (MEMORY_PROFILE_POOL_STATS);
+  }
+
   return TotalSize;
 }
 
@@ -1254,6 +1258,10 @@ MemoryProfileCopyData (
 
     DriverInfo = (MEMORY_PROFILE_DRIVER_INFO *) ((UINTN) (DriverInfo + 1) + sizeof (MEMORY_PROFILE_ALLOC_INFO) * (UINTN) DriverInfo->AllocRecordCount);
   }
+
+  if (IS_UEFI_MEMORY_PROFILE_ENABLED) {
+    CoreGetPoolStatistics ((MEMORY_PROFILE_POOL_STATS *) DriverInfo);
+  }
 }
 
 /**
@@ -51,6 +51,14 @@ UINTN         mFreeMapStack = 0;
 ///
 LIST_ENTRY   mFreeMemoryMapEntryList = INITIALIZE_LIST_HEAD_VARIABLE (mFreeMemoryMapEntryList);
 BOOLEAN      mMemoryTypeInformationInitialized = FALSE;
+///
+/// Index of all entries in gMemoryMap, ordered by address
+///
+MEMORY_MAP_INDEX  mMemoryMapAddressIndex = { NULL, OFFSET_OF (MEMORY_MAP, AddressNode) };
+///
+/// Index of the EfiConventionalMemory entries in gMemoryMap, ordered by address
+///
+MEMORY_MAP_INDEX  mMemoryMapFreeIndex = { NULL, OFFSET_OF (MEMORY_MAP, FreeNode) };
 
 EFI_MEMORY_TYPE_STATISTICS mMemoryTypeStatistics[EfiMaxMemoryType + 1] = {
   { 0, MAX_ADDRESS, 0, 0, EfiMaxMemoryType, TRUE,  FALSE },  // EfiReservedMemoryType
@@ -126,6 +134,59 @@ CoreReleaseMemoryLock (
 
 
 
+/**
+  Internal function.  Adds a descriptor entry that was just linked into
+  gMemoryMap to the memory map indexes.
+
+  @param  Entry                  The entry to index
+
+**/
+VOID
+IndexMemoryMapEntry (
+  IN MEMORY_MAP          *Entry
+  )
+{
+  MemoryMapIndexInsert (&mMemoryMapAddressIndex, Entry);
+  if (Entry->Type == EfiConventionalMemory) {
+    MemoryMapIndexInsert (&mMemoryMapFreeIndex, Entry);
+  }
+}
+
+/**
+  Internal function.  Removes a descriptor entry from the memory map indexes.
+
+  @param  Entry                  The entry to remove from the indexes
+
+**/
+VOID
+UnindexMemoryMapEntry (
+  IN MEMORY_MAP          *Entry
+  )
+{
+  MemoryMapIndexRemove (&mMemoryMapAddressIndex, Entry);
+  if (Entry->Type == EfiConventionalMemory) {
+    MemoryMapIndexRemove (&mMemoryMapFreeIndex, Entry);
+  }
+}
+
+/**
+  Internal function.  Updates the memory map indexes after the range of a
+  descriptor entry was clipped.
+
+  @param  Entry                  The entry that was clipped
+
+**/
+VOID
+ReindexMemoryMapEntry (
+  IN MEMORY_MAP          *Entry
+  )
+{
+  MemoryMapIndexUpdate (&mMemoryMapAddressIndex, Entry);
+  if (Entry->Type == EfiConventionalMemory) {
+    MemoryMapIndexUpdate (&mMemoryMapFreeIndex, Entry);
+  }
+}
+
 /**
   Internal function.  Removes a descriptor entry.
 
@@ -137,6 +198,7 @@ RemoveMemoryMapEntry (
   IN OUT MEMORY_MAP      *Entry
   )
 {
+  UnindexMemoryMapEntry (Entry);
   RemoveEntryList (&Entry->Link);
   Entry->Link.ForwardLink = NULL;
 
@@ -168,7 +230,6 @@ CoreAddRange (
   IN UINT64                   Attribute
   )
 {
-  LIST_ENTRY        *Link;
   MEMORY_MAP        *Entry;
 
   ASSERT ((Start & EFI_PAGE_MASK) == 0);
@@ -212,32 +273,26 @@ CoreAddRange (
   //
 
   // Two memory descriptors can only be merged if they have the same Type
-  // and the same Attribute
+  // and the same Attribute. Descriptors never overlap, so the only candidates
+  // are the descriptors that cover the bytes just below and just above the range.
   //
 
-  Link = gMemoryMap.ForwardLink;
-  while (Link != &gMemoryMap) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    Link  = Link->ForwardLink;
-
-    if (Entry->Type != Type) {
-      continue;
-    }
-
-    if (Entry->Attribute != Attribute) {
-      continue;
-    }
-
-    if (Entry->End + 1 == Start) {
+  if (Start != 0) {
+    Entry = MemoryMapIndexFindCovering (&mMemoryMapAddressIndex, Start - 1);
+    if (Entry != NULL && Entry->End + 1 == Start &&
+        Entry->Type == Type && Entry->Attribute == Attribute) {
 
       Start = Entry->Start;
       RemoveMemoryMapEntry (Entry);
+    }
+  }
 
-    } else if (Entry->Start == End + 1) {
+  Entry = MemoryMapIndexFindCovering (&mMemoryMapAddressIndex, End + 1);
+  if (Entry != NULL && Entry->Start == End + 1 &&
+      Entry->Type == Type && Entry->Attribute == Attribute) {
 
-      End = Entry->End;
-      RemoveMemoryMapEntry (Entry);
-    }
+    End = Entry->End;
+    RemoveMemoryMapEntry (Entry);
   }
 
   //
@@ -252,6 +307,7 @@ CoreAddRange (
   mMapStack[mMapDepth].VirtualStart  = 0;
   mMapStack[mMapDepth].Attribute     = Attribute;
   InsertTailList (&gMemoryMap, &mMapStack[mMapDepth].Link);
+  IndexMemoryMapEntry (&mMapStack[mMapDepth]);
 
   mMapDepth += 1;
   ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -354,6 +410,7 @@ CoreFreeMemoryMapStack (
       //
       // Move this entry to general memory
       //
+      UnindexMemoryMapEntry (&mMapStack[mMapDepth]);
       RemoveEntryList (&mMapStack[mMapDepth].Link);
       mMapStack[mMapDepth].Link.ForwardLink = NULL;
 
@@ -361,16 +418,18 @@ CoreFreeMemoryMapStack (
       Entry->FromPages = TRUE;
 
       //
-      // Find insertion location
+      // Find insertion location. Entries from pages are always kept in
+      // gMemoryMap in address order, so the new entry goes in front of the
+      // first entry from pages that starts above it.
       //
-      for (Link2 = gMemoryMap.ForwardLink; Link2 != &gMemoryMap; Link2 = Link2->ForwardLink) {
-        Entry2 = CR (Link2, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-        if (Entry2->FromPages && Entry2->Start > Entry->Start) {
-          break;
-        }
+      Entry2 = MemoryMapIndexFindAbove (&mMemoryMapAddressIndex, Entry->Start);
+      while (Entry2 != NULL && !Entry2->FromPages) {
+        Entry2 = MemoryMapIndexNext (&mMemoryMapAddressIndex, Entry2);
       }
+      Link2 = (Entry2 != NULL) ? &Entry2->Link : &gMemoryMap;
 
       InsertTailList (Link2, &Entry->Link);
+      IndexMemoryMapEntry (Entry);
 
     } else {
       //
@@ -706,7 +765,6 @@ CoreConvertPagesEx (
   UINT64          RangeEnd;
   UINT64          Attribute;
   EFI_MEMORY_TYPE MemType;
-  LIST_ENTRY      *Link;
   MEMORY_MAP      *Entry;
 
   Entry = NULL;
@@ -732,15 +790,9 @@ CoreConvertPagesEx (
     //
     // Find the entry that the covers the range
     //
-    for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-      Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+    Entry = MemoryMapIndexFindCovering (&mMemoryMapAddressIndex, Start);
 
-      if (Entry->Start <= Start && Entry->End > Start) {
-        break;
-      }
-    }
-
-    if (Link == &gMemoryMap) {
+    if (Entry == NULL) {
       DEBUG ((DEBUG_ERROR | DEBUG_PAGE, "ConvertPages: failed to find range %lx - %lx\n", Start, End));
       return EFI_NOT_FOUND;
     }
@@ -806,6 +858,7 @@ CoreConvertPagesEx (
       // Clip start
       //
       Entry->Start = RangeEnd + 1;
+      ReindexMemoryMapEntry (Entry);
 
     } else if (Entry->End == RangeEnd) {
 
@@ -813,6 +866,7 @@ CoreConvertPagesEx (
       // Clip end
       //
       Entry->End = Start - 1;
+      ReindexMemoryMapEntry (Entry);
 
     } else {
 
@@ -836,9 +890,11 @@ CoreConvertPagesEx (
 
       Entry->End = Start - 1;
       ASSERT (Entry->Start < Entry->End);
+      ReindexMemoryMapEntry (Entry);
 
       Entry = &mMapStack[mMapDepth];
       InsertTailList (&gMemoryMap, &Entry->Link);
+      IndexMemoryMapEntry (Entry);
 
       mMapDepth += 1;
       ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -984,7 +1040,6 @@ CoreFindFreePagesI (
   UINT64          DescStart;
   UINT64          DescEnd;
   UINT64          DescNumberOfBytes;
-  LIST_ENTRY      *Link;
   MEMORY_MAP      *Entry;
 
   if ((MaxAddress < EFI_PAGE_MASK) ||(NumberOfPages == 0)) {
@@ -1016,24 +1071,26 @@ CoreFindFreePagesI (
   NumberOfBytes = LShiftU64 (NumberOfPages, EFI_PAGE_SHIFT);
   Target = 0;
 
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+  //
+  // Walk the free entries that are large enough from the highest one that
+  // starts below MaxAddress downwards. The usable end of a descriptor grows
+  // with its address, so the first descriptor that satisfies the request is
+  // the best match.
+  //
+  for (Entry = MemoryMapIndexFindLastFit (&mMemoryMapFreeIndex, MaxAddress, NumberOfBytes);
+       Entry != NULL;
+       Entry = MemoryMapIndexPrevFit (&mMemoryMapFreeIndex, Entry, NumberOfBytes)) {
 
-    //
-    // If it's not a free entry, don't bother with it
-    //
-    if (Entry->Type != EfiConventionalMemory) {
-      continue;
-    }
+    ASSERT (Entry->Type == EfiConventionalMemory);
 
     DescStart = Entry->Start;
     DescEnd = Entry->End;
 
     //
-    // If desc is past max allowed address or below min allowed address, skip it
+    // If desc is below min allowed address, so are all the remaining ones
     //
-    if ((DescStart >= MaxAddress) || (DescEnd < MinAddress)) {
-      continue;
+    if (DescEnd < MinAddress) {
+      break;
     }
 
     //
@@ -1060,11 +1117,10 @@ CoreFindFreePagesI (
       }
 
       //
-      // If this is the best match so far remember it
+      // This is the best match
       //
-      if (DescEnd > Target) {
-        Target = DescEnd;
-      }
+      Target = DescEnd;
+      break;
     }
   }
 
@@ -1322,7 +1378,6 @@ CoreInternalFreePages (
   )
 {
   EFI_STATUS      Status;
-  LIST_ENTRY      *Link;
   MEMORY_MAP      *Entry;
   UINTN           Alignment;
 
@@ -1334,14 +1389,8 @@ CoreInternalFreePages (
   //
   // Find the entry that the covers the range
   //
-  Entry = NULL;
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR(Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    if (Entry->Start <= Memory && Entry->End > Memory) {
-        break;
-    }
-  }
-  if (Link == &gMemoryMap) {
+  Entry = MemoryMapIndexFindCovering (&mMemoryMapAddressIndex, Memory);
+  if (Entry == NULL) {
     Status = EFI_NOT_FOUND;
     goto Done;
   }
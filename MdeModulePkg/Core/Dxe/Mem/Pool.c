@@ -57,6 +57,65 @@ typedef struct {
 
 #define MAX_POOL_SIZE     (MAX_ADDRESS - POOL_OVERHEAD)
 
+//
+// Slab allocator (PcdDxePoolSlabAllocator).
+//
+// A slab is one DEFAULT_PAGE_ALLOCATION sized page that starts with a
+// POOL_SLAB header and is carved into equal slots of one size class. Each
+// slot still carries a POOL_HEAD and POOL_TAIL, so the checks done on free
+// are the same as for list based pool; the slab header is found by masking
+// the buffer address down to the page boundary. A set bit in FreeMap marks
+// a free slot. FreeMap has a bit for every slot of the smallest class, so no
+// class leaves part of its slab unused.
+//
+#define POOL_SLAB_DATA_OFFSET   64
+#define POOL_SLAB_MIN_SIZE      64
+#define POOL_SLAB_MAX_SLOTS     ((DEFAULT_PAGE_ALLOCATION - POOL_SLAB_DATA_OFFSET) / POOL_SLAB_MIN_SIZE)
+#define POOL_SLAB_FREE_MAP_SIZE ((POOL_SLAB_MAX_SLOTS + 63) / 64)
+
+#define POOL_SLAB_SIGNATURE   SIGNATURE_32('p','s','l','b')
+typedef struct {
+  UINT32          Signature;
+  UINT16          Class;
+  UINT16          FreeCount;
+  EFI_MEMORY_TYPE Type;
+  UINT64          FreeMap[POOL_SLAB_FREE_MAP_SIZE];
+  LIST_ENTRY      Link;
+} POOL_SLAB;
+
+#define POOL_SLAB_CLASS_COUNT   9
+#define POOL_SLAB_MAX_SIZE      1024
+
+#define POOL_SLAB_CLASS_GRANULARITY_SHIFT  5
+
+GLOBAL_REMOVE_IF_UNREFERENCED CONST UINT16 mPoolSlabClassSize[POOL_SLAB_CLASS_COUNT] = {
+  POOL_SLAB_MIN_SIZE, 96, 128, 192, 256, 384, 512, 768, 1024
+};
+
+//
+// Maps (Size - 1) >> POOL_SLAB_CLASS_GRANULARITY_SHIFT to the smallest class that fits Size.
+//
+GLOBAL_REMOVE_IF_UNREFERENCED UINT8 mPoolSlabClassIndex[POOL_SLAB_MAX_SIZE >> POOL_SLAB_CLASS_GRANULARITY_SHIFT];
+
+//
+// Per-TPL magazines cache a few free EfiBootServicesData slots of each class.
+// Code running at one TPL is never preempted by other code running at the same
+// TPL, so a magazine that is only used at its own TPL needs no lock. When a
+// magazine is full, its older half is returned to the slabs under the memory
+// lock so that cached slots do not keep slab pages pinned.
+//
+#define POOL_MAGAZINE_SIZE       8
+#define POOL_MAGAZINE_TPL_COUNT  3
+
+typedef struct {
+  UINTN           Count;
+  UINT64          HitCount;
+  UINT64          FreeCount;
+  POOL_HEAD       *Slot[POOL_MAGAZINE_SIZE];
+} POOL_MAGAZINE;
+
+GLOBAL_REMOVE_IF_UNREFERENCED POOL_MAGAZINE mPoolMagazine[POOL_MAGAZINE_TPL_COUNT][POOL_SLAB_CLASS_COUNT];
+
 //
 // Globals
 //
@@ -67,6 +126,7 @@ typedef struct {
     UINTN            Used;
     EFI_MEMORY_TYPE  MemoryType;
     LIST_ENTRY       FreeList[MAX_POOL_LIST];
+    LIST_ENTRY       SlabList[POOL_SLAB_CLASS_COUNT];
     LIST_ENTRY       Link;
 } POOL;
 
@@ -80,6 +140,18 @@ POOL            mPoolHead[EfiMaxMemoryType];
 //
 LIST_ENTRY      mPoolHeadList = INITIALIZE_LIST_HEAD_VARIABLE (mPoolHeadList);
 
+//
+// Pool statistics reported through the memory profile.
+//
+MEMORY_PROFILE_POOL_STATS  mPoolStats = {
+  {
+    MEMORY_PROFILE_POOL_STATS_SIGNATURE,
+    sizeof (MEMORY_PROFILE_POOL_STATS),
+    MEMORY_PROFILE_POOL_STATS_REVISION
+  },
+  MEMORY_PROFILE_POOL_MODE_LIST
+};
+
 
 /**
   Called to initialize the pool.
@@ -92,6 +164,7 @@ CoreInitializePool (
 {
   UINTN  Type;
   UINTN  Index;
+  UINTN  Class;
 
   for (Type=0; Type < EfiMaxMemoryType; Type++) {
     mPoolHead[Type].Signature  = 0;
@@ -100,6 +173,21 @@ CoreInitializePool (
     for (Index=0; Index < MAX_POOL_LIST; Index++) {
       InitializeListHead (&mPoolHead[Type].FreeList[Index]);
     }
+    for (Index=0; Index < POOL_SLAB_CLASS_COUNT; Index++) {
+      InitializeListHead (&mPoolHead[Type].SlabList[Index]);
+    }
+  }
+
+  if (FeaturePcdGet (PcdDxePoolSlabAllocator)) {
+    ASSERT (sizeof (POOL_SLAB) <= POOL_SLAB_DATA_OFFSET);
+    mPoolStats.PoolMode = MEMORY_PROFILE_POOL_MODE_SLAB;
+    Class = 0;
+    for (Index = 0; Index < (POOL_SLAB_MAX_SIZE >> POOL_SLAB_CLASS_GRANULARITY_SHIFT); Index++) {
+      while (mPoolSlabClassSize[Class] < ((Index + 1) << POOL_SLAB_CLASS_GRANULARITY_SHIFT)) {
+        Class++;
+      }
+      mPoolSlabClassIndex[Index] = (UINT8) Class;
+    }
   }
 }
 
@@ -149,6 +237,9 @@ LookupPoolHead (
     for (Index=0; Index < MAX_POOL_LIST; Index++) {
       InitializeListHead (&Pool->FreeList[Index]);
     }
+    for (Index=0; Index < POOL_SLAB_CLASS_COUNT; Index++) {
+      InitializeListHead (&Pool->SlabList[Index]);
+    }
 
     InsertHeadList (&mPoolHeadList, &Pool->Link);
 
@@ -159,6 +250,386 @@ LookupPoolHead (
 }
 
 
+/**
+  Return the magazine row to use at the current TPL.
+
+  @return Pointer to the magazines of all classes for the current TPL, or NULL
+          if magazines are not used at the current TPL.
+
+**/
+POOL_MAGAZINE *
+GetPoolMagazine (
+  VOID
+  )
+{
+  switch (gEfiCurrentTpl) {
+  case TPL_APPLICATION:
+    return mPoolMagazine[0];
+  case TPL_CALLBACK:
+    return mPoolMagazine[1];
+  case TPL_NOTIFY:
+    return mPoolMagazine[2];
+  default:
+    return NULL;
+  }
+}
+
+
+/**
+  Get the slab header of a pool buffer, if the buffer was allocated from a slab.
+
+  @param  Head                   Pool head of the buffer.
+
+  @return Pointer to the slab header, or NULL if Head is not in a slab.
+
+**/
+POOL_SLAB *
+PoolHeadToSlab (
+  IN POOL_HEAD  *Head
+  )
+{
+  POOL_SLAB   *Slab;
+
+  if (!FeaturePcdGet (PcdDxePoolSlabAllocator)) {
+    return NULL;
+  }
+
+  //
+  // A page that holds list based pool always starts with a POOL_HEAD or a
+  // POOL_FREE, so the slab signature cannot appear at a pool page boundary
+  // unless the page is a slab.
+  //
+  Slab = (POOL_SLAB *) ((UINTN) Head & ~((UINTN) DEFAULT_PAGE_ALLOCATION - 1));
+  if (Slab->Signature != POOL_SLAB_SIGNATURE) {
+    return NULL;
+  }
+  return Slab;
+}
+
+
+/**
+  Get the number of slots in a slab of the given class.
+
+  @param  Class                  Slab size class.
+
+  @return Number of slots.
+
+**/
+UINTN
+GetPoolSlabSlotCount (
+  IN UINTN  Class
+  )
+{
+  return MIN (POOL_SLAB_MAX_SLOTS, (DEFAULT_PAGE_ALLOCATION - POOL_SLAB_DATA_OFFSET) / mPoolSlabClassSize[Class]);
+}
+
+
+/**
+  Internal function to allocate a slot from the slabs of one size class.
+  Caller must have the memory lock held
+
+  @param  Pool                   Pool head of the memory type.
+  @param  Class                  Slab size class.
+
+  @return The pool head of the allocated slot, or NULL
+
+**/
+POOL_HEAD *
+CoreAllocatePoolSlab (
+  IN POOL   *Pool,
+  IN UINTN  Class
+  )
+{
+  POOL_SLAB   *Slab;
+  UINTN       SlotCount;
+  UINTN       Slot;
+  UINTN       Index;
+
+  ASSERT_LOCKED (&gMemoryLock);
+
+  if (IsListEmpty (&Pool->SlabList[Class])) {
+    //
+    // Get another page and turn it into a slab
+    //
+    Slab = CoreAllocatePoolPages (Pool->MemoryType, EFI_SIZE_TO_PAGES (DEFAULT_PAGE_ALLOCATION), DEFAULT_PAGE_ALLOCATION);
+    if (Slab == NULL) {
+      return NULL;
+    }
+    mPoolStats.MissCount++;
+    mPoolStats.CurrentSlabPages++;
+    if (mPoolStats.CurrentSlabPages > mPoolStats.PeakSlabPages) {
+      mPoolStats.PeakSlabPages = mPoolStats.CurrentSlabPages;
+    }
+
+    SlotCount       = GetPoolSlabSlotCount (Class);
+    Slab->Signature = POOL_SLAB_SIGNATURE;
+    Slab->Class     = (UINT16) Class;
+    Slab->FreeCount = (UINT16) SlotCount;
+    Slab->Type      = Pool->MemoryType;
+    for (Index = 0; Index < POOL_SLAB_FREE_MAP_SIZE; Index++) {
+      if (SlotCount >= (Index + 1) * 64) {
+        Slab->FreeMap[Index] = MAX_UINT64;
+      } else if (SlotCount > Index * 64) {
+        Slab->FreeMap[Index] = LShiftU64 (1, SlotCount - Index * 64) - 1;
+      } else {
+        Slab->FreeMap[Index] = 0;
+      }
+    }
+    InsertHeadList (&Pool->SlabList[Class], &Slab->Link);
+  } else {
+    Slab = BASE_CR (Pool->SlabList[Class].ForwardLink, POOL_SLAB, Link);
+    mPoolStats.HitCount++;
+  }
+
+  ASSERT (Slab->Signature == POOL_SLAB_SIGNATURE);
+  ASSERT (Slab->FreeCount != 0);
+
+  //
+  // Take the lowest free slot
+  //
+  for (Index = 0; Slab->FreeMap[Index] == 0; Index++) {
+    ASSERT (Index + 1 < POOL_SLAB_FREE_MAP_SIZE);
+  }
+  Slot = (UINTN) LowBitSet64 (Slab->FreeMap[Index]);
+  Slab->FreeMap[Index] &= ~LShiftU64 (1, Slot);
+  Slot += Index * 64;
+  Slab->FreeCount--;
+  if (Slab->FreeCount == 0) {
+    //
+    // Full slabs are not kept on the class list
+    //
+    RemoveEntryList (&Slab->Link);
+  }
+
+  return (POOL_HEAD *) ((UINTN) Slab + POOL_SLAB_DATA_OFFSET + Slot * mPoolSlabClassSize[Class]);
+}
+
+
+/**
+  Internal function to return a slot to its slab.
+  Caller must have the memory lock held
+
+  @param  Pool                   Pool head of the memory type.
+  @param  Slab                   Slab that owns the slot.
+  @param  Head                   Pool head of the slot.
+
+**/
+VOID
+CoreFreePoolSlab (
+  IN POOL       *Pool,
+  IN POOL_SLAB  *Slab,
+  IN POOL_HEAD  *Head
+  )
+{
+  UINTN       Class;
+  UINTN       Slot;
+
+  ASSERT_LOCKED (&gMemoryLock);
+
+  Class = Slab->Class;
+  Slot  = ((UINTN) Head - (UINTN) Slab - POOL_SLAB_DATA_OFFSET) / mPoolSlabClassSize[Class];
+  ASSERT ((Slab->FreeMap[Slot / 64] & LShiftU64 (1, Slot % 64)) == 0);
+
+  Head->Signature = POOL_FREE_SIGNATURE;
+  Slab->FreeMap[Slot / 64] |= LShiftU64 (1, Slot % 64);
+  Slab->FreeCount++;
+  if (Slab->FreeCount == 1) {
+    InsertHeadList (&Pool->SlabList[Class], &Slab->Link);
+  }
+
+  if (Slab->FreeCount < GetPoolSlabSlotCount (Class)) {
+    return;
+  }
+
+  //
+  // Keep the last empty slab of a class so that alloc/free pairs do not keep
+  // going back to the page allocator, except for OS memory types whose pool
+  // head is released once it is no longer used.
+  //
+  if ((INT32)Pool->MemoryType >= 0 &&
+      Pool->SlabList[Class].ForwardLink == &Slab->Link &&
+      Pool->SlabList[Class].BackLink == &Slab->Link) {
+    return;
+  }
+
+  RemoveEntryList (&Slab->Link);
+  Slab->Signature = 0;
+  mPoolStats.CurrentSlabPages--;
+  CoreFreePoolPages ((EFI_PHYSICAL_ADDRESS) (UINTN) Slab, EFI_SIZE_TO_PAGES (DEFAULT_PAGE_ALLOCATION));
+}
+
+
+/**
+  Try to allocate a slot from the magazine of the current TPL without taking
+  the memory lock.
+
+  @param  PoolType               Type of pool to allocate
+  @param  Size                   The amount of pool to allocate
+
+  @return The allocated buffer, or NULL if the magazine cannot serve the request.
+
+**/
+VOID *
+CoreAllocatePoolMagazine (
+  IN EFI_MEMORY_TYPE  PoolType,
+  IN UINTN            Size
+  )
+{
+  POOL_MAGAZINE   *Magazine;
+  POOL_HEAD       *Head;
+
+  if (PoolType != EfiBootServicesData) {
+    return NULL;
+  }
+
+  Size = ALIGN_VARIABLE (Size) + POOL_OVERHEAD;
+  if (Size > POOL_SLAB_MAX_SIZE) {
+    return NULL;
+  }
+
+  Magazine = GetPoolMagazine ();
+  if (Magazine == NULL) {
+    return NULL;
+  }
+  Magazine = &Magazine[mPoolSlabClassIndex[(Size - 1) >> POOL_SLAB_CLASS_GRANULARITY_SHIFT]];
+  if (Magazine->Count == 0) {
+    return NULL;
+  }
+
+  Magazine->Count--;
+  Magazine->HitCount++;
+  Head = Magazine->Slot[Magazine->Count];
+  ASSERT (Head->Signature == POOL_FREE_SIGNATURE);
+  Head->Signature = POOL_HEAD_SIGNATURE;
+  DEBUG_CLEAR_MEMORY (Head->Data, Head->Size - POOL_OVERHEAD);
+  return Head->Data;
+}
+
+
+/**
+  Return the oldest slots of a magazine to their slabs.
+
+  The magazine must belong to the current TPL, which is not above TPL_NOTIFY,
+  so the memory lock can be taken here.
+
+  @param  Magazine               The magazine to drain.
+  @param  Count                  The number of slots to return.
+
+**/
+VOID
+CoreDrainPoolMagazine (
+  IN POOL_MAGAZINE  *Magazine,
+  IN UINTN          Count
+  )
+{
+  POOL        *Pool;
+  POOL_HEAD   *Head;
+  UINTN       Index;
+
+  ASSERT (Count <= Magazine->Count);
+
+  CoreAcquireMemoryLock ();
+  Pool = LookupPoolHead (EfiBootServicesData);
+  ASSERT (Pool != NULL);
+  for (Index = 0; Index < Count; Index++) {
+    Head = Magazine->Slot[Index];
+    ASSERT (Head->Signature == POOL_FREE_SIGNATURE);
+    //
+    // The slot was never taken off Pool->Used when it entered the magazine.
+    //
+    Pool->Used -= Head->Size;
+    CoreFreePoolSlab (Pool, PoolHeadToSlab (Head), Head);
+  }
+  CoreReleaseMemoryLock ();
+
+  Magazine->Count -= Count;
+  CopyMem (&Magazine->Slot[0], &Magazine->Slot[Count], Magazine->Count * sizeof (POOL_HEAD *));
+}
+
+
+/**
+  Try to free a buffer into the magazine of the current TPL without taking
+  the memory lock.
+
+  @param  Buffer                 The allocated pool entry to free
+
+  @retval TRUE                   The buffer was put into a magazine.
+  @retval FALSE                  The buffer must be freed by CoreFreePoolI().
+
+**/
+BOOLEAN
+CoreFreePoolMagazine (
+  IN VOID       *Buffer
+  )
+{
+  POOL_MAGAZINE   *Magazine;
+  POOL_HEAD       *Head;
+  POOL_TAIL       *Tail;
+  POOL_SLAB       *Slab;
+
+  Head = BASE_CR (Buffer, POOL_HEAD, Data);
+  if (Head->Signature != POOL_HEAD_SIGNATURE || Head->Type != EfiBootServicesData) {
+    return FALSE;
+  }
+
+  Slab = PoolHeadToSlab (Head);
+  if (Slab == NULL || Head->Size != mPoolSlabClassSize[Slab->Class]) {
+    return FALSE;
+  }
+
+  Tail = HEAD_TO_TAIL (Head);
+  if (Tail->Signature != POOL_TAIL_SIGNATURE || Tail->Size != Head->Size) {
+    return FALSE;
+  }
+
+  Magazine = GetPoolMagazine ();
+  if (Magazine == NULL) {
+    return FALSE;
+  }
+  Magazine = &Magazine[Slab->Class];
+  if (Magazine->Count == POOL_MAGAZINE_SIZE) {
+    CoreDrainPoolMagazine (Magazine, POOL_MAGAZINE_SIZE / 2);
+  }
+
+  //
+  // Slots in a magazine stay allocated from the slab's point of view, but are
+  // marked free so that a second free of the same buffer is rejected.
+  //
+  DEBUG_CLEAR_MEMORY (Head->Data, Head->Size - POOL_OVERHEAD);
+  Head->Signature = POOL_FREE_SIGNATURE;
+  Magazine->Slot[Magazine->Count] = Head;
+  Magazine->Count++;
+  Magazine->FreeCount++;
+  return TRUE;
+}
+
+
+/**
+  Get pool allocator statistics.
+
+  @param  Stats                  Returns the pool statistics.
+
+**/
+VOID
+CoreGetPoolStatistics (
+  OUT MEMORY_PROFILE_POOL_STATS  *Stats
+  )
+{
+  UINTN  TplIndex;
+  UINTN  Class;
+
+  CopyMem (Stats, &mPoolStats, sizeof (MEMORY_PROFILE_POOL_STATS));
+  for (TplIndex = 0; TplIndex < POOL_MAGAZINE_TPL_COUNT; TplIndex++) {
+    for (Class = 0; Class < POOL_SLAB_CLASS_COUNT; Class++) {
+      Stats->MagazineHitCount += mPoolMagazine[TplIndex][Class].HitCount;
+      Stats->FreeCount        += mPoolMagazine[TplIndex][Class].FreeCount;
+    }
+  }
+  Stats->AllocateCount += Stats->MagazineHitCount;
+  Stats->HitCount      += Stats->MagazineHitCount;
+}
+
+
 
 /**
   Allocate pool of a particular type.
@@ -205,6 +676,13 @@ CoreInternalAllocatePool (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  if (FeaturePcdGet (PcdDxePoolSlabAllocator)) {
+    *Buffer = CoreAllocatePoolMagazine (PoolType, Size);
+    if (*Buffer != NULL) {
+      return EFI_SUCCESS;
+    }
+  }
+
   //
   // Acquire the memory lock and make the allocation
   //
@@ -274,6 +752,7 @@ CoreAllocatePoolI (
   UINTN       FSize;
   UINTN       Offset;
   UINTN       NoPages;
+  UINTN       Class;
 
   ASSERT_LOCKED (&gMemoryLock);
 
@@ -295,6 +774,18 @@ CoreAllocatePoolI (
     return NULL;
   }
   Head = NULL;
+  mPoolStats.AllocateCount++;
+
+  //
+  // Small allocations are served from a slab of the smallest size class
+  // that fits; the slot size becomes the size recorded in the pool head.
+  //
+  if (FeaturePcdGet (PcdDxePoolSlabAllocator) && Size <= POOL_SLAB_MAX_SIZE) {
+    Class = mPoolSlabClassIndex[(Size - 1) >> POOL_SLAB_CLASS_GRANULARITY_SHIFT];
+    Size  = mPoolSlabClassSize[Class];
+    Head  = CoreAllocatePoolSlab (Pool, Class);
+    goto Done;
+  }
 
   //
   // If allocation is over max size, just allocate pages for the request
@@ -304,6 +795,7 @@ CoreAllocatePoolI (
     NoPages = EFI_SIZE_TO_PAGES(Size) + EFI_SIZE_TO_PAGES (DEFAULT_PAGE_ALLOCATION) - 1;
     NoPages &= ~(UINTN)(EFI_SIZE_TO_PAGES (DEFAULT_PAGE_ALLOCATION) - 1);
     Head = CoreAllocatePoolPages (PoolType, NoPages, DEFAULT_PAGE_ALLOCATION);
+    mPoolStats.MissCount++;
     goto Done;
   }
 
@@ -316,6 +808,7 @@ CoreAllocatePoolI (
     // Get another page
     //
     NewPage = CoreAllocatePoolPages(PoolType, EFI_SIZE_TO_PAGES (DEFAULT_PAGE_ALLOCATION), DEFAULT_PAGE_ALLOCATION);
+    mPoolStats.MissCount++;
     if (NewPage == NULL) {
       goto Done;
     }
@@ -341,6 +834,8 @@ CoreAllocatePoolI (
 
     ASSERT (Offset == DEFAULT_PAGE_ALLOCATION);
     Index = SIZE_TO_LIST(Size);
+  } else {
+    mPoolStats.HitCount++;
   }
 
   //
@@ -411,6 +906,10 @@ CoreInternalFreePool (
     return EFI_INVALID_PARAMETER;
   }
 
+  if (FeaturePcdGet (PcdDxePoolSlabAllocator) && CoreFreePoolMagazine (Buffer)) {
+    return EFI_SUCCESS;
+  }
+
   CoreAcquireMemoryLock ();
   Status = CoreFreePoolI (Buffer);
   CoreReleaseMemoryLock ();
@@ -467,6 +966,7 @@ CoreFreePoolI (
   UINTN       FSize;
   UINTN       Offset;
   BOOLEAN     AllFree;
+  POOL_SLAB   *Slab;
 
   ASSERT(Buffer != NULL);
   //
@@ -506,20 +1006,27 @@ CoreFreePoolI (
     return EFI_INVALID_PARAMETER;
   }
   Pool->Used -= Size;
+  mPoolStats.FreeCount++;
   DEBUG ((DEBUG_POOL, "FreePool: %p (len %lx) %,ld\n", Head->Data, (UINT64)(Head->Size - POOL_OVERHEAD), (UINT64) Pool->Used));
 
   //
   // Determine the pool list
   //
   Index = SIZE_TO_LIST(Size);
+  Slab  = PoolHeadToSlab (Head);
   DEBUG_CLEAR_MEMORY (Head, Size);
 
-  //
-  // If it's not on the list, it must be pool pages
-  //
-  if (Index >= MAX_POOL_LIST) {
+  if (Slab != NULL) {
+
+    //
+    // Return the slot to its slab
+    //
+    CoreFreePoolSlab (Pool, Slab, Head);
+
+  } else if (Index >= MAX_POOL_LIST) {
 
     //
+    // If it's not on the list, it must be pool pages.
     // Return the memory pages back to free memory
     //
     NoPages = EFI_SIZE_TO_PAGES(Size) + EFI_SIZE_TO_PAGES (DEFAULT_PAGE_ALLOCATION) - 1;
@@ -27,6 +27,11 @@
   3) A support protocol is not found, and the data is not available to be read
      without it.  This results in EFI_PROTOCOL_ERROR.
 
+  The streams produced by decompressing a compression section or extracting a
+  GUIDed section without authentication are kept in a bounded cache shared by
+  all streams, keyed by the contents of the encapsulating section, so that
+  reopening a stream does not decompress the same section again.
+
 Copyright (c) 2006 - 2014, Intel Corporation. All rights reserved.<BR>
 This program and the accompanying materials
 are licensed and made available under the terms and conditions of the BSD License
@@ -98,6 +103,28 @@ typedef struct {
   VOID                        *Registration;
 } RPN_EVENT_CONTEXT;
 
+#define CORE_SECTION_CACHE_SIGNATURE  SIGNATURE_32('S','X','C','E')
+#define SECTION_CACHE_ENTRY_FROM_LINK(Node) \
+  CR (Node, CORE_SECTION_CACHE_ENTRY, Link, CORE_SECTION_CACHE_SIGNATURE)
+
+//
+// A decompressed section stream in the section cache. The copy of the
+// encapsulating section and the section stream follow the entry.
+//
+typedef struct {
+  UINT32                      Signature;
+  LIST_ENTRY                  Link;
+  UINTN                       SectionSize;
+  UINTN                       StreamSize;
+  //
+  // Authentication status returned by the GUIDed section extraction protocol
+  //
+  UINT32                      AuthenticationStatus;
+} CORE_SECTION_CACHE_ENTRY;
+
+#define SECTION_CACHE_ENTRY_SECTION(Entry)  ((VOID *) ((Entry) + 1))
+#define SECTION_CACHE_ENTRY_STREAM(Entry)   ((VOID *) ((UINT8 *) ((Entry) + 1) + (Entry)->SectionSize))
+
 
 /**
   The ExtractSection() function processes the input section and
@@ -203,6 +230,46 @@ EFI_GUIDED_SECTION_EXTRACTION_PROTOCOL mCustomGuidedSectionExtractionProtocol =
   CustomGuidedSectionExtract
 };
 
+//
+// Section cache, most recently used entry first, and its statistics
+//
+LIST_ENTRY mSectionCache = INITIALIZE_LIST_HEAD_VARIABLE (mSectionCache);
+UINTN      mSectionCacheSize       = 0;
+UINTN      mSectionCacheHits       = 0;
+UINTN      mSectionCacheMisses     = 0;
+UINT64     mSectionCacheBytesSaved = 0;
+
+
+/**
+  Log the section cache statistics. The counts are recorded as the Identifier
+  of performance records, so they are reported by Dp.
+
+  @param  Event                  The event that is signaled
+  @param  Context                Not used
+
+**/
+VOID
+EFIAPI
+LogSectionCacheStatistics (
+  IN EFI_EVENT      Event,
+  IN VOID           *Context
+  )
+{
+  UINT32            Identifier;
+
+  Identifier = (UINT32) MIN (mSectionCacheHits, MAX_UINT32);
+  PERF_START_EX (NULL, "SectionCacheHits", "DxeMain", 0, Identifier);
+  PERF_END_EX (NULL, "SectionCacheHits", "DxeMain", 0, Identifier);
+
+  Identifier = (UINT32) MIN (mSectionCacheMisses, MAX_UINT32);
+  PERF_START_EX (NULL, "SectionCacheMisses", "DxeMain", 0, Identifier);
+  PERF_END_EX (NULL, "SectionCacheMisses", "DxeMain", 0, Identifier);
+
+  Identifier = (UINT32) MIN (mSectionCacheBytesSaved, MAX_UINT32);
+  PERF_START_EX (NULL, "SectionCacheBytesSaved", "DxeMain", 0, Identifier);
+  PERF_END_EX (NULL, "SectionCacheBytesSaved", "DxeMain", 0, Identifier);
+}
+
 
 /**
   Entry point of the section extraction code. Initializes an instance of the
@@ -225,6 +292,7 @@ InitializeSectionExtraction (
   EFI_STATUS                         Status;
   EFI_GUID                           *ExtractHandlerGuidTable;
   UINTN                              ExtractHandlerNumber;
+  EFI_EVENT                          ReadyToBootEvent;
 
   //
   // Get custom extract guided section method guid list
@@ -245,6 +313,20 @@ InitializeSectionExtraction (
     ASSERT_EFI_ERROR (Status);
   }
 
+  //
+  // Log the section cache statistics each time the platform is ready to boot
+  //
+  PERF_CODE (
+    CoreCreateEventEx (
+      EVT_NOTIFY_SIGNAL,
+      TPL_CALLBACK,
+      LogSectionCacheStatistics,
+      NULL,
+      &gEfiEventReadyToBootGuid,
+      &ReadyToBootEvent
+      );
+  );
+
   return Status;
 }
 
@@ -448,6 +530,99 @@ OpenSectionStream (
 
 
 
+/**
+  Worker function.  Search the section cache for the stream produced by an
+  encapsulating section. A found entry becomes the most recently used one.
+
+  @param  Section                The encapsulating section.
+  @param  SectionSize            The size of the encapsulating section.
+
+  @return The cache entry whose section has the same contents, or NULL if there
+          is none.
+
+**/
+CORE_SECTION_CACHE_ENTRY *
+FindCachedSection (
+  IN VOID                     *Section,
+  IN UINTN                    SectionSize
+  )
+{
+  LIST_ENTRY                  *Link;
+  CORE_SECTION_CACHE_ENTRY    *Entry;
+
+  if (PcdGet32 (PcdDxeSectionCacheSize) == 0) {
+    return NULL;
+  }
+
+  for (Link = GetFirstNode (&mSectionCache); !IsNull (&mSectionCache, Link); Link = GetNextNode (&mSectionCache, Link)) {
+    Entry = SECTION_CACHE_ENTRY_FROM_LINK (Link);
+    if ((Entry->SectionSize == SectionSize) &&
+        (CompareMem (SECTION_CACHE_ENTRY_SECTION (Entry), Section, SectionSize) == 0)) {
+      RemoveEntryList (&Entry->Link);
+      InsertHeadList (&mSectionCache, &Entry->Link);
+      mSectionCacheHits++;
+      mSectionCacheBytesSaved += Entry->StreamSize;
+      return Entry;
+    }
+  }
+
+  mSectionCacheMisses++;
+  return NULL;
+}
+
+
+/**
+  Worker function.  Add the stream produced by an encapsulating section to the
+  section cache, dropping the least recently used entries to make room for it.
+  Streams that do not fit in the cache on their own are not cached.
+
+  @param  Section                The encapsulating section.
+  @param  SectionSize            The size of the encapsulating section.
+  @param  Stream                 The section stream produced by the section.
+  @param  StreamSize             The size of the section stream.
+  @param  AuthenticationStatus   The authentication status of the extraction.
+
+**/
+VOID
+CacheSection (
+  IN VOID                     *Section,
+  IN UINTN                    SectionSize,
+  IN VOID                     *Stream,
+  IN UINTN                    StreamSize,
+  IN UINT32                   AuthenticationStatus
+  )
+{
+  CORE_SECTION_CACHE_ENTRY    *Entry;
+  UINTN                       EntrySize;
+
+  EntrySize = SectionSize + StreamSize;
+  if ((StreamSize == 0) || (EntrySize > PcdGet32 (PcdDxeSectionCacheSize))) {
+    return;
+  }
+
+  while (mSectionCacheSize + EntrySize > PcdGet32 (PcdDxeSectionCacheSize)) {
+    Entry = SECTION_CACHE_ENTRY_FROM_LINK (GetPreviousNode (&mSectionCache, &mSectionCache));
+    RemoveEntryList (&Entry->Link);
+    mSectionCacheSize -= Entry->SectionSize + Entry->StreamSize;
+    CoreFreePool (Entry);
+  }
+
+  Entry = AllocatePool (sizeof (CORE_SECTION_CACHE_ENTRY) + EntrySize);
+  if (Entry == NULL) {
+    return;
+  }
+
+  Entry->Signature            = CORE_SECTION_CACHE_SIGNATURE;
+  Entry->SectionSize          = SectionSize;
+  Entry->StreamSize           = StreamSize;
+  Entry->AuthenticationStatus = AuthenticationStatus;
+  CopyMem (SECTION_CACHE_ENTRY_SECTION (Entry), Section, SectionSize);
+  CopyMem (SECTION_CACHE_ENTRY_STREAM (Entry), Stream, StreamSize);
+  InsertHeadList (&mSectionCache, &Entry->Link);
+  mSectionCacheSize += EntrySize;
+}
+
+
 /**
   Worker function.  Determine if the input stream:child matches the input type.
 
@@ -691,6 +866,7 @@ CreateChildNode (
   UINT32                                       UncompressedLength;
   UINT8                                        CompressionType;
   UINT16                                       GuidedSectionAttributes;
+  CORE_SECTION_CACHE_ENTRY                     *CacheEntry;
 
   CORE_SECTION_CHILD_NODE                      *Node;
 
@@ -766,51 +942,57 @@ CreateChildNode (
           //
           // Only support the EFI_SATNDARD_COMPRESSION algorithm.
           //
+          CacheEntry = FindCachedSection (SectionHeader, Node->Size);
+          if ((CacheEntry != NULL) && (CacheEntry->StreamSize == NewStreamBufferSize)) {
+            CopyMem (NewStreamBuffer, SECTION_CACHE_ENTRY_STREAM (CacheEntry), NewStreamBufferSize);
+          } else {
+            //
+            // Decompress the stream
+            //
+            Status = CoreLocateProtocol (&gEfiDecompressProtocolGuid, NULL, (VOID **)&Decompress);
+            ASSERT_EFI_ERROR (Status);
+            ASSERT (Decompress != NULL);
+
+            Status = Decompress->GetInfo (
+                                   Decompress,
+                                   CompressionSource,
+                                   CompressionSourceSize,
+                                   (UINT32 *)&NewStreamBufferSize,
+                                   &ScratchSize
+                                   );
+            if (EFI_ERROR (Status) || (NewStreamBufferSize != UncompressedLength)) {
+              CoreFreePool (Node);
+              CoreFreePool (NewStreamBuffer);
+              if (!EFI_ERROR (Status)) {
+                Status = EFI_BAD_BUFFER_SIZE;
+              }
+              return Status;
+            }
 
-          //
-          // Decompress the stream
-          //
-          Status = CoreLocateProtocol (&gEfiDecompressProtocolGuid, NULL, (VOID **)&Decompress);
-          ASSERT_EFI_ERROR (Status);
-          ASSERT (Decompress != NULL);
-
-          Status = Decompress->GetInfo (
-                                 Decompress,
-                                 CompressionSource,
-                                 CompressionSourceSize,
-                                 (UINT32 *)&NewStreamBufferSize,
-                                 &ScratchSize
-                                 );
-          if (EFI_ERROR (Status) || (NewStreamBufferSize != UncompressedLength)) {
-            CoreFreePool (Node);
-            CoreFreePool (NewStreamBuffer);
-            if (!EFI_ERROR (Status)) {
-              Status = EFI_BAD_BUFFER_SIZE;
+            ScratchBuffer = AllocatePool (ScratchSize);
+            if (ScratchBuffer == NULL) {
+              CoreFreePool (Node);
+              CoreFreePool (NewStreamBuffer);
+              return EFI_OUT_OF_RESOURCES;
             }
-            return Status;
-          }
 
-          ScratchBuffer = AllocatePool (ScratchSize);
-          if (ScratchBuffer == NULL) {
-            CoreFreePool (Node);
-            CoreFreePool (NewStreamBuffer);
-            return EFI_OUT_OF_RESOURCES;
-          }
+            Status = Decompress->Decompress (
+                                   Decompress,
+                                   CompressionSource,
+                                   CompressionSourceSize,
+                                   NewStreamBuffer,
+                                   (UINT32)NewStreamBufferSize,
+                                   ScratchBuffer,
+                                   ScratchSize
+                                   );
+            CoreFreePool (ScratchBuffer);
+            if (EFI_ERROR (Status)) {
+              CoreFreePool (Node);
+              CoreFreePool (NewStreamBuffer);
+              return Status;
+            }
 
-          Status = Decompress->Decompress (
-                                 Decompress,
-                                 CompressionSource,
-                                 CompressionSourceSize,
-                                 NewStreamBuffer,
-                                 (UINT32)NewStreamBufferSize,
-                                 ScratchBuffer,
-                                 ScratchSize
-                                 );
-          CoreFreePool (ScratchBuffer);
-          if (EFI_ERROR (Status)) {
-            CoreFreePool (Node);
-            CoreFreePool (NewStreamBuffer);
-            return Status;
+            CacheSection (SectionHeader, Node->Size, NewStreamBuffer, NewStreamBufferSize, 0);
           }
         }
       } else {
@@ -843,19 +1025,43 @@ CreateChildNode (
       }
       if (VerifyGuidedSectionGuid (Node->EncapsulationGuid, &GuidedExtraction)) {
         //
-        // NewStreamBuffer is always allocated by ExtractSection... No caller
-        // allocation here.
+        // Sections whose extraction reports an authentication status are
+        // always extracted again, as the result may depend on the platform
+        // security policy at the time.
         //
-        Status = GuidedExtraction->ExtractSection (
-                                     GuidedExtraction,
-                                     GuidedHeader,
-                                     &NewStreamBuffer,
-                                     &NewStreamBufferSize,
-                                     &AuthenticationStatus
-                                     );
-        if (EFI_ERROR (Status)) {
-          CoreFreePool (*ChildNode);
-          return EFI_PROTOCOL_ERROR;
+        CacheEntry = NULL;
+        if ((GuidedSectionAttributes & EFI_GUIDED_SECTION_AUTH_STATUS_VALID) == 0) {
+          CacheEntry = FindCachedSection (SectionHeader, Node->Size);
+        }
+
+        if (CacheEntry != NULL) {
+          NewStreamBufferSize  = CacheEntry->StreamSize;
+          AuthenticationStatus = CacheEntry->AuthenticationStatus;
+          NewStreamBuffer      = AllocateCopyPool (NewStreamBufferSize, SECTION_CACHE_ENTRY_STREAM (CacheEntry));
+          if (NewStreamBuffer == NULL) {
+            CoreFreePool (*ChildNode);
+            return EFI_OUT_OF_RESOURCES;
+          }
+        } else {
+          //
+          // NewStreamBuffer is always allocated by ExtractSection... No caller
+          // allocation here.
+          //
+          Status = GuidedExtraction->ExtractSection (
+                                       GuidedExtraction,
+                                       GuidedHeader,
+                                       &NewStreamBuffer,
+                                       &NewStreamBufferSize,
+                                       &AuthenticationStatus
+                                       );
+          if (EFI_ERROR (Status)) {
+            CoreFreePool (*ChildNode);
+            return EFI_PROTOCOL_ERROR;
+          }
+
+          if ((GuidedSectionAttributes & EFI_GUIDED_SECTION_AUTH_STATUS_VALID) == 0) {
+            CacheSection (SectionHeader, Node->Size, NewStreamBuffer, NewStreamBufferSize, AuthenticationStatus);
+          }
         }
 
         //
@@ -52,6 +52,11 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define STACK_SIZE      0x20000
 #define BSP_STORE_SIZE  0x4000
 
+//
+// Size of the windows in which a GUIDed section is decoded incrementally
+//
+#define GUIDED_SECTION_STREAM_WINDOW_SIZE  SIZE_64KB
+
 
 //
 // This PPI is installed to indicate the end of the PEI usage of memory
@@ -128,6 +133,37 @@ UpdateStackHob (
   IN UINT64                      Length
   );
 
+/**
+  Decode a GUIDed section incrementally and place the decoded section stream so
+  that a firmware volume it holds is aligned as its header requires.
+
+  The first window of the section stream is decoded to a small local buffer. If
+  it starts with a firmware volume image section, the alignment of the firmware
+  volume is taken from its header, the output buffer is allocated with that
+  alignment and the rest of the section stream is decoded in place. The PEI
+  Core then does not need to copy the firmware volume to an aligned buffer.
+
+  @param InputSection           A pointer to the input GUIDed section.
+  @param OutputBufferSize       The size, in bytes, of the decoded section stream.
+  @param ScratchBuffer          The scratch buffer of the decode operation.
+  @param OutputBuffer           Returns the decoded section stream.
+  @param AuthenticationStatus   Returns the authentication status of the decode operation.
+
+  @retval EFI_SUCCESS           The section stream was decoded.
+  @retval EFI_UNSUPPORTED       The GUIDed section can not be decoded incrementally.
+  @retval EFI_OUT_OF_RESOURCES  The output buffer could not be allocated.
+  @retval Others                The section stream could not be decoded.
+
+**/
+EFI_STATUS
+StreamGuidedSectionExtract (
+  IN CONST  VOID                                  *InputSection,
+  IN        UINT32                                OutputBufferSize,
+  IN        VOID                                  *ScratchBuffer,
+  OUT       VOID                                  **OutputBuffer,
+  OUT       UINT32                                *AuthenticationStatus
+  );
+
 /**
   The ExtractSection() function processes the input section and
   returns a pointer to the section contents. If the section being
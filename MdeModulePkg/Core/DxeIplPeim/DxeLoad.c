@@ -419,6 +419,119 @@ DxeIplFindDxeCore (
 
 
 
+/**
+  Decode a GUIDed section incrementally and place the decoded section stream so
+  that a firmware volume it holds is aligned as its header requires.
+
+  The first window of the section stream is decoded to a small local buffer. If
+  it starts with a firmware volume image section, the alignment of the firmware
+  volume is taken from its header, the output buffer is allocated with that
+  alignment and the rest of the section stream is decoded in place, one window
+  of GUIDED_SECTION_STREAM_WINDOW_SIZE bytes at a time. The PEI Core then does
+  not need to copy the firmware volume to an aligned buffer.
+
+  @param InputSection           A pointer to the input GUIDed section.
+  @param OutputBufferSize       The size, in bytes, of the decoded section stream.
+  @param ScratchBuffer          The scratch buffer of the decode operation.
+  @param OutputBuffer           Returns the decoded section stream.
+  @param AuthenticationStatus   Returns the authentication status of the decode operation.
+
+  @retval EFI_SUCCESS           The section stream was decoded.
+  @retval EFI_UNSUPPORTED       The GUIDed section can not be decoded incrementally.
+  @retval EFI_OUT_OF_RESOURCES  The output buffer could not be allocated.
+  @retval Others                The section stream could not be decoded.
+
+**/
+EFI_STATUS
+StreamGuidedSectionExtract (
+  IN CONST  VOID                                  *InputSection,
+  IN        UINT32                                OutputBufferSize,
+  IN        VOID                                  *ScratchBuffer,
+  OUT       VOID                                  **OutputBuffer,
+  OUT       UINT32                                *AuthenticationStatus
+  )
+{
+  EFI_STATUS                  Status;
+  UINT8                       Window[sizeof (EFI_COMMON_SECTION_HEADER2) + sizeof (EFI_FIRMWARE_VOLUME_HEADER)];
+  UINT32                      WindowSize;
+  UINT32                      HeaderSize;
+  UINT32                      FvAlignment;
+  EFI_FIRMWARE_VOLUME_HEADER  *FvHeader;
+  UINT8                       *Pages;
+  UINTN                       PageCount;
+  UINT8                       *Buffer;
+  UINT32                      DecodedSize;
+  UINT32                      WindowEnd;
+
+  Status = ExtractGuidedSectionStreamInit (InputSection, ScratchBuffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Decode the section header and the firmware volume header, if any
+  //
+  WindowSize = MIN (OutputBufferSize, (UINT32) sizeof (Window));
+  Status = ExtractGuidedSectionStreamFeed (InputSection, Window, &WindowSize, ScratchBuffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // By default, the section data is page aligned as it is for other GUIDed sections
+  //
+  HeaderSize  = sizeof (EFI_COMMON_SECTION_HEADER);
+  FvAlignment = EFI_PAGE_SIZE;
+  if (WindowSize >= sizeof (EFI_COMMON_SECTION_HEADER) &&
+      ((EFI_COMMON_SECTION_HEADER *) Window)->Type == EFI_SECTION_FIRMWARE_VOLUME_IMAGE) {
+    if (IS_SECTION2 (Window)) {
+      HeaderSize = sizeof (EFI_COMMON_SECTION_HEADER2);
+    }
+    FvHeader = (EFI_FIRMWARE_VOLUME_HEADER *) (Window + HeaderSize);
+    if (WindowSize >= HeaderSize + OFFSET_OF (EFI_FIRMWARE_VOLUME_HEADER, HeaderLength) &&
+        FvHeader->Signature == EFI_FVH_SIGNATURE &&
+        (FvHeader->Attributes & EFI_FVB2_WEAK_ALIGNMENT) == 0) {
+      FvAlignment = MAX (EFI_PAGE_SIZE, (UINT32) 1 << ((FvHeader->Attributes & EFI_FVB2_ALIGNMENT) >> 16));
+    }
+  }
+
+  PageCount = EFI_SIZE_TO_PAGES ((UINTN) OutputBufferSize + FvAlignment);
+  Pages     = AllocateAlignedPages (PageCount, FvAlignment);
+  if (Pages == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  DEBUG ((DEBUG_INFO, "Customized Guided section Memory Size required is 0x%x and address is 0x%p, alignment 0x%x\n", OutputBufferSize, Pages, FvAlignment));
+
+  //
+  // Decode the rest of the section stream after the first window, one window
+  // at a time
+  //
+  Buffer      = Pages + FvAlignment - HeaderSize;
+  CopyMem (Buffer, Window, WindowSize);
+  DecodedSize = WindowSize;
+  while (DecodedSize < OutputBufferSize) {
+    WindowEnd   = DecodedSize + MIN (OutputBufferSize - DecodedSize, GUIDED_SECTION_STREAM_WINDOW_SIZE);
+    DecodedSize = WindowEnd;
+    Status = ExtractGuidedSectionStreamFeed (InputSection, Buffer, &DecodedSize, ScratchBuffer);
+    if (!EFI_ERROR (Status) && (DecodedSize != WindowEnd)) {
+      Status = EFI_VOLUME_CORRUPTED;
+    }
+    if (EFI_ERROR (Status)) {
+      FreeAlignedPages (Pages, PageCount);
+      return Status;
+    }
+  }
+
+  Status = ExtractGuidedSectionStreamFinish (InputSection, ScratchBuffer, AuthenticationStatus);
+  if (EFI_ERROR (Status)) {
+    FreeAlignedPages (Pages, PageCount);
+    return Status;
+  }
+
+  *OutputBuffer = Buffer;
+  return EFI_SUCCESS;
+}
+
 /**
   The ExtractSection() function processes the input section and
   returns a pointer to the section contents. If the section being
@@ -520,6 +633,26 @@ CustomGuidedSectionExtract (
   }
 
   if (((SectionAttribute & EFI_GUIDED_SECTION_PROCESSING_REQUIRED) != 0) && OutputBufferSize > 0) {  
+    //
+    // Decode the section incrementally if its handler supports it, so that the
+    // firmware volume it holds is decoded straight to an aligned buffer.
+    //
+    Status = StreamGuidedSectionExtract (
+               InputSection,
+               OutputBufferSize,
+               ScratchBuffer,
+               OutputBuffer,
+               AuthenticationStatus
+               );
+    if (!EFI_ERROR (Status)) {
+      *OutputSize = (UINTN) OutputBufferSize;
+      return EFI_SUCCESS;
+    }
+    if (Status != EFI_UNSUPPORTED) {
+      DEBUG ((DEBUG_ERROR, "Extract guided section Failed - %r\n", Status));
+      return Status;
+    }
+
     //
     // Allocate output buffer
     //
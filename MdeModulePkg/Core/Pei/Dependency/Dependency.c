@@ -251,3 +251,69 @@ PeimDispatchReadiness (
     }
   }
 }
+
+/**
+
+  Check whether any PPI that a dependency expression pushes was installed or
+  reinstalled after the PPI database reached a given sequence number. If not,
+  the dependency expression still evaluates to the same result.
+
+  @param PrivateData            PeiCore's private data structure.
+  @param DependencyExpression   Pointer to a dependency expression.
+  @param Sequence               The PPI database sequence number to compare with.
+
+  @retval TRUE      if one of the PPIs changed, or the expression could not be parsed.
+  @retval FALSE     if none of the PPIs changed.
+
+**/
+BOOLEAN
+DepexPpiInstalledSince (
+  IN PEI_CORE_INSTANCE  *PrivateData,
+  IN VOID               *DependencyExpression,
+  IN UINT32             Sequence
+  )
+{
+  DEPENDENCY_EXPRESSION_OPERAND  *Iterator;
+  EFI_GUID                       PpiGuid;
+
+  if (PrivateData->PpiData.PpiSequence == Sequence) {
+    //
+    // No PPI was installed at all
+    //
+    return FALSE;
+  }
+
+  Iterator = DependencyExpression;
+
+  while (TRUE) {
+    switch (*(Iterator++)) {
+      case (EFI_DEP_PUSH):
+        //
+        // Copy the Guid into a locale variable so that there are no
+        // possibilities of alignment faults.
+        //
+        CopyMem (&PpiGuid, Iterator, sizeof (EFI_GUID));
+        if (IsPpiInstalledSince (PrivateData, &PpiGuid, Sequence)) {
+          return TRUE;
+        }
+        Iterator = Iterator + sizeof (EFI_GUID);
+        break;
+
+      case (EFI_DEP_AND):
+      case (EFI_DEP_OR):
+      case (EFI_DEP_NOT):
+      case (EFI_DEP_TRUE):
+      case (EFI_DEP_FALSE):
+        break;
+
+      case (EFI_DEP_END):
+        return FALSE;
+
+      default:
+        //
+        // Let PeimDispatchReadiness () report the invalid opcode
+        //
+        return TRUE;
+    }
+  }
+}
@@ -71,6 +71,7 @@ DiscoverPeimsAndOrderWithApriori (
   //
   if (Private->Fv[Private->CurrentPeimFvCount].ScanFv) {
     CopyMem (Private->CurrentFvFileHandles, Private->Fv[Private->CurrentPeimFvCount].FvFileHandles, sizeof (EFI_PEI_FILE_HANDLE) * PcdGet32 (PcdPeiCoreMaxPeimPerFv));
+    Private->AprioriCount = Private->Fv[Private->CurrentPeimFvCount].AprioriCount;
     return;
   }
 
@@ -185,6 +186,7 @@ DiscoverPeimsAndOrderWithApriori (
   // Instead, we can retrieve the file handles within this Fv from cachable data.
   //
   Private->Fv[Private->CurrentPeimFvCount].ScanFv = TRUE;
+  Private->Fv[Private->CurrentPeimFvCount].AprioriCount = Private->AprioriCount;
   CopyMem (Private->Fv[Private->CurrentPeimFvCount].FvFileHandles, Private->CurrentFvFileHandles, sizeof (EFI_PEI_FILE_HANDLE) * PcdGet32 (PcdPeiCoreMaxPeimPerFv));
 
 }
@@ -756,6 +758,7 @@ PeiDispatcher (
     if (!Private->PeimDispatcherReenter) {
       Private->PeimNeedingDispatch      = FALSE;
       Private->PeimDispatchOnThisPass   = FALSE;
+      Private->DispatchPassCount++;
     } else {
       Private->PeimDispatcherReenter    = FALSE;
     }
@@ -1164,6 +1167,20 @@ PeiDispatcher (
     //
   } while (Private->PeimNeedingDispatch && Private->PeimDispatchOnThisPass);
 
+  //
+  // Record the number of dispatcher passes, dependency expression evaluations,
+  // file name lookups and the FFS file headers those lookups skipped as the
+  // Identifier of performance records, so they are reported with the other PEI
+  // measurements.
+  //
+  PERF_START_EX (NULL, "DisPass", "PeiCore", 0, Private->DispatchPassCount);
+  PERF_END_EX (NULL, "DisPass", "PeiCore", 0, Private->DispatchPassCount);
+  PERF_START_EX (NULL, "DisDepx", "PeiCore", 0, Private->DepexEvaluationCount);
+  PERF_END_EX (NULL, "DisDepx", "PeiCore", 0, Private->DepexEvaluationCount);
+  PERF_START_EX (NULL, "FfsName", "PeiCore", 0, Private->FileNameLookupCount);
+  PERF_END_EX (NULL, "FfsName", "PeiCore", 0, Private->FileNameLookupCount);
+  PERF_START_EX (NULL, "FfsSkip", "PeiCore", 0, Private->FileHeadersSkipped);
+  PERF_END_EX (NULL, "FfsSkip", "PeiCore", 0, Private->FileHeadersSkipped);
 }
 
 /**
@@ -1217,15 +1234,29 @@ DepexSatisfied (
   )
 {
   EFI_STATUS           Status;
-  VOID                 *DepexData;
-  EFI_FV_FILE_INFO     FileInfo;
+  PEI_CORE_PEIM_DEPEX  *PeimDepex;
 
-  Status = PeiServicesFfsGetFileInfo (FileHandle, &FileInfo);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_DISPATCH, "Evaluate PEI DEPEX for FFS(Unknown)\n"));
-  } else {
-    DEBUG ((DEBUG_DISPATCH, "Evaluate PEI DEPEX for FFS(%g)\n", &FileInfo.FileName));
+  PeimDepex = &Private->Fv[Private->CurrentPeimFvCount].PeimDepex[PeimCount];
+
+  //
+  // If the DEPEX evaluated to FALSE on a previous pass and none of the PPIs it
+  // pushes has been installed since, it still evaluates to FALSE.
+  //
+  if (PeimDepex->Waiting && !DepexPpiInstalledSince (Private, PeimDepex->Depex, PeimDepex->Sequence)) {
+    PeimDepex->Sequence = Private->PpiData.PpiSequence;
+    return FALSE;
   }
+
+  DEBUG_CODE_BEGIN ();
+    EFI_FV_FILE_INFO     FileInfo;
+
+    Status = PeiServicesFfsGetFileInfo (FileHandle, &FileInfo);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_DISPATCH, "Evaluate PEI DEPEX for FFS(Unknown)\n"));
+    } else {
+      DEBUG ((DEBUG_DISPATCH, "Evaluate PEI DEPEX for FFS(%g)\n", &FileInfo.FileName));
+    }
+  DEBUG_CODE_END ();
   
   if (PeimCount < Private->AprioriCount) {
     //
@@ -1235,16 +1266,23 @@ DepexSatisfied (
     return TRUE;
   }
 
-  //
-  // Depex section not in the encapsulated section.
-  //
-  Status = PeiServicesFfsFindSectionData (
-              EFI_SECTION_PEI_DEPEX,
-              FileHandle,
-              (VOID **)&DepexData
-              );
+  if (!PeimDepex->DepexFound) {
+    //
+    // Depex section not in the encapsulated section. It is looked up once and
+    // kept in the per-FV PEIM table for the following passes.
+    //
+    Status = PeiServicesFfsFindSectionData (
+                EFI_SECTION_PEI_DEPEX,
+                FileHandle,
+                &PeimDepex->Depex
+                );
+    if (EFI_ERROR (Status)) {
+      PeimDepex->Depex = NULL;
+    }
+    PeimDepex->DepexFound = TRUE;
+  }
 
-  if (EFI_ERROR (Status)) {
+  if (PeimDepex->Depex == NULL) {
     //
     // If there is no DEPEX, assume the module can be executed
     //
@@ -1255,7 +1293,15 @@ DepexSatisfied (
   //
   // Evaluate a given DEPEX
   //
-  return PeimDispatchReadiness (&Private->Ps, DepexData);
+  Private->DepexEvaluationCount++;
+  if (PeimDispatchReadiness (&Private->Ps, PeimDepex->Depex)) {
+    PeimDepex->Waiting = FALSE;
+    return TRUE;
+  }
+
+  PeimDepex->Waiting  = TRUE;
+  PeimDepex->Sequence = Private->PpiData.PpiSequence;
+  return FALSE;
 }
 
 /**
@@ -420,6 +420,143 @@ FindFileEx (
   return EFI_NOT_FOUND;  
 }
 
+/**
+  Compute the bucket of a file name in a file name index.
+
+  @param FileName        File name
+
+  @return Index of the bucket
+**/
+UINTN
+HashFileName (
+  IN CONST EFI_GUID                  *FileName
+  )
+{
+  UINT32                                Value;
+
+  Value = ReadUnaligned32 ((CONST UINT32 *) FileName) ^
+          ReadUnaligned32 ((CONST UINT32 *) FileName + 3);
+  return (Value ^ (Value >> 16)) & (PEI_CORE_FILE_NAME_HASH_SIZE - 1);
+}
+
+/**
+  Build the file name index of a FV from the files that FindFileEx() finds
+  when it searches for all file types.
+
+  @param FvHandle        Pointer to the FV header of the volume to index
+
+  @return The file name index, or NULL if it could not be allocated.
+**/
+PEI_CORE_FILE_NAME_INDEX *
+BuildFileNameIndex (
+  IN CONST EFI_PEI_FV_HANDLE         FvHandle
+  )
+{
+  PEI_CORE_FILE_NAME_INDEX              *FileNameIndex;
+  EFI_PEI_FILE_HANDLE                   FileHandle;
+  EFI_FFS_FILE_HEADER                   *FfsFileHeader;
+  UINT32                                FileCount;
+  UINT32                                Index;
+  UINTN                                 Bucket;
+
+  FileCount  = 0;
+  FileHandle = NULL;
+  while (!EFI_ERROR (FindFileEx (FvHandle, NULL, EFI_FV_FILETYPE_ALL, &FileHandle, NULL))) {
+    FileCount++;
+  }
+
+  FileNameIndex = AllocateZeroPool (sizeof (PEI_CORE_FILE_NAME_INDEX) + FileCount * sizeof (PEI_CORE_FILE_NAME_ENTRY));
+  if (FileNameIndex == NULL) {
+    return NULL;
+  }
+
+  FileHandle = NULL;
+  for (Index = 0; Index < FileCount; Index++) {
+    if (EFI_ERROR (FindFileEx (FvHandle, NULL, EFI_FV_FILETYPE_ALL, &FileHandle, NULL))) {
+      break;
+    }
+    FileNameIndex->Entry[Index].FileOffset = (UINT32) ((UINT8 *) FileHandle - (UINT8 *) FvHandle);
+  }
+  FileNameIndex->FileCount = Index;
+
+  //
+  // Insert the files in reverse order, so the first file with a name is found
+  // first like in a search of the FV.
+  //
+  for (Index = FileNameIndex->FileCount; Index > 0; Index--) {
+    FfsFileHeader = (EFI_FFS_FILE_HEADER *) ((UINT8 *) FvHandle + FileNameIndex->Entry[Index - 1].FileOffset);
+    Bucket = HashFileName (&FfsFileHeader->Name);
+    FileNameIndex->Entry[Index - 1].Next = FileNameIndex->Bucket[Bucket];
+    FileNameIndex->Bucket[Bucket] = Index;
+  }
+
+  return FileNameIndex;
+}
+
+/**
+  Find a file within a FV by its name, using the file name index of the FV.
+  The index is built the first time a file is looked up by name in the FV.
+  If the FV is not known to PeiCore or the index can not be built, the FV is
+  searched by FindFileEx().
+
+  @param FvHandle        Pointer to the FV header of the volume to search
+  @param FileName        File name
+  @param FileHandle      Upon exit, points to the found file's handle
+                         or NULL if it could not be found.
+
+  @retval EFI_NOT_FOUND  No file with the name was found
+  @retval EFI_SUCCESS    Success to search given file
+
+**/
+EFI_STATUS
+FindFileByName (
+  IN  CONST EFI_PEI_FV_HANDLE        FvHandle,
+  IN  CONST EFI_GUID                 *FileName,
+  OUT       EFI_PEI_FILE_HANDLE      *FileHandle
+  )
+{
+  PEI_CORE_INSTANCE                     *PrivateData;
+  PEI_CORE_FV_HANDLE                    *CoreFvHandle;
+  PEI_CORE_FILE_NAME_INDEX              *FileNameIndex;
+  EFI_FFS_FILE_HEADER                   *FfsFileHeader;
+  UINT32                                Index;
+  UINT32                                Compared;
+
+  CoreFvHandle = FvHandleToCoreHandle (FvHandle);
+  if (CoreFvHandle == NULL) {
+    return FindFileEx (FvHandle, FileName, 0, FileHandle, NULL);
+  }
+
+  if (CoreFvHandle->FileNameIndex == NULL) {
+    CoreFvHandle->FileNameIndex = BuildFileNameIndex (FvHandle);
+    if (CoreFvHandle->FileNameIndex == NULL) {
+      return FindFileEx (FvHandle, FileName, 0, FileHandle, NULL);
+    }
+  }
+  FileNameIndex = CoreFvHandle->FileNameIndex;
+
+  PrivateData = PEI_CORE_INSTANCE_FROM_PS_THIS (GetPeiServicesTablePointer ());
+  PrivateData->FileNameLookupCount++;
+
+  Compared = 0;
+  for (Index = FileNameIndex->Bucket[HashFileName (FileName)]; Index != 0; Index = FileNameIndex->Entry[Index - 1].Next) {
+    Compared++;
+    FfsFileHeader = (EFI_FFS_FILE_HEADER *) ((UINT8 *) FvHandle + FileNameIndex->Entry[Index - 1].FileOffset);
+    if (CompareGuid (&FfsFileHeader->Name, FileName)) {
+      //
+      // A search of the FV would have parsed all the files up to this one.
+      //
+      PrivateData->FileHeadersSkipped += Index - Compared;
+      *FileHandle = FfsFileHeader;
+      return EFI_SUCCESS;
+    }
+  }
+
+  PrivateData->FileHeadersSkipped += FileNameIndex->FileCount - Compared;
+  *FileHandle = NULL;
+  return EFI_NOT_FOUND;
+}
+
 /**
   Initialize PeiCore Fv List.
 
@@ -1539,7 +1676,7 @@ PeiFfsFvPpiFindFileByName (
   }
   
   if (*FvHandle != NULL) {
-    Status = FindFileEx (*FvHandle, FileName, 0, FileHandle, NULL);
+    Status = FindFileByName (*FvHandle, FileName, FileHandle);
     if (Status == EFI_NOT_FOUND) {
       *FileHandle = NULL;
     }
@@ -1555,7 +1692,7 @@ PeiFfsFvPpiFindFileByName (
       // Only search the FV which is associated with a EFI_PEI_FIRMWARE_VOLUME_PPI instance.
       //
       if (PrivateData->Fv[Index].FvPpi != NULL) {
-        Status = FindFileEx (PrivateData->Fv[Index].FvHandle, FileName, 0, FileHandle, NULL);
+        Status = FindFileByName (PrivateData->Fv[Index].FvHandle, FileName, FileHandle);
         if (!EFI_ERROR (Status)) {
           *FvHandle = PrivateData->Fv[Index].FvHandle;
           break;
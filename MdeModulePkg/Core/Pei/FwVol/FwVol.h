@@ -308,6 +308,28 @@ FindFileEx (
   IN OUT    EFI_PEI_FV_HANDLE        *AprioriFile  OPTIONAL
   );
 
+/**
+  Find a file within a FV by its name, using the file name index of the FV.
+  The index is built the first time a file is looked up by name in the FV.
+  If the FV is not known to PeiCore or the index can not be built, the FV is
+  searched by FindFileEx().
+
+  @param FvHandle        Pointer to the FV header of the volume to search
+  @param FileName        File name
+  @param FileHandle      Upon exit, points to the found file's handle
+                         or NULL if it could not be found.
+
+  @retval EFI_NOT_FOUND  No file with the name was found
+  @retval EFI_SUCCESS    Success to search given file
+
+**/
+EFI_STATUS
+FindFileByName (
+  IN  CONST EFI_PEI_FV_HANDLE        FvHandle,
+  IN  CONST EFI_GUID                 *FileName,
+  OUT       EFI_PEI_FILE_HANDLE      *FileHandle
+  );
+
 /**
   Report the information for a new discoveried FV in unknown format.
   
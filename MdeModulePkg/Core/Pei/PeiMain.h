@@ -63,6 +63,21 @@ typedef union {
   VOID                        *Raw;
 } PEI_PPI_LIST_POINTERS;
 
+///
+/// Entry of the PPI index. The index keeps the installed PPIs sorted by GUID and
+/// then by install order, so that a PPI can be located with a binary search.
+///
+typedef struct {
+  ///
+  /// index of the PPI descriptor in PpiListPtrs.
+  ///
+  INTN                    PpiListIndex;
+  ///
+  /// value of PpiSequence when the PPI was installed or reinstalled.
+  ///
+  UINT32                  Sequence;
+} PEI_PPI_INDEX_ENTRY;
+
 ///
 /// PPI database structure which contains two link: PpiList and NotifyList. PpiList
 /// is in head of PpiListPtrs array and notify is in end of PpiListPtrs.
@@ -92,6 +107,15 @@ typedef struct {
   /// Ppi database has the PcdPeiCoreMaxPpiSupported number of entries.
   ///
   PEI_PPI_LIST_POINTERS   *PpiListPtrs;
+  ///
+  /// Ppi index has the PcdPeiCoreMaxPpiSupported number of entries, and PpiListEnd of
+  /// them are in use.
+  ///
+  PEI_PPI_INDEX_ENTRY     *PpiIndex;
+  ///
+  /// sequence number, incremented each time a PPI is installed or reinstalled.
+  ///
+  UINT32                  PpiSequence;
 } PEI_PPI_DATABASE;
 
 
@@ -105,6 +129,43 @@ typedef struct {
 #define PEIM_STATE_REGISITER_FOR_SHADOW   0x02
 #define PEIM_STATE_DONE                   0x03
 
+//
+// PEI_CORE_FV_HANDE.PeimDepex
+// The dependency expression of a PEIM, cached the first time it is evaluated.
+//
+typedef struct {
+  //
+  // Pointer to the Depex section data, or NULL if the PEIM has no Depex.
+  //
+  VOID                                *Depex;
+  //
+  // PpiData.PpiSequence when the Depex was last evaluated to FALSE.
+  //
+  UINT32                              Sequence;
+  BOOLEAN                             DepexFound;
+  BOOLEAN                             Waiting;
+} PEI_CORE_PEIM_DEPEX;
+
+//
+// PEI_CORE_FV_HANDE.FileNameIndex
+// The files of a FV hashed by name, built the first time a file is looked up by
+// name in the FV. Files are identified by their offset in the FV and linked by
+// their 1-based index in Entry, so the index needs no fixup when the FV or the
+// heap moves.
+//
+#define PEI_CORE_FILE_NAME_HASH_SIZE      32
+
+typedef struct {
+  UINT32                              FileOffset;
+  UINT32                              Next;
+} PEI_CORE_FILE_NAME_ENTRY;
+
+typedef struct {
+  UINT32                              FileCount;
+  UINT32                              Bucket[PEI_CORE_FILE_NAME_HASH_SIZE];
+  PEI_CORE_FILE_NAME_ENTRY            Entry[1];
+} PEI_CORE_FILE_NAME_INDEX;
+
 typedef struct {
   EFI_FIRMWARE_VOLUME_HEADER          *FvHeader;
   EFI_PEI_FIRMWARE_VOLUME_PPI         *FvPpi;
@@ -117,6 +178,18 @@ typedef struct {
   // Ponter to the buffer with the PcdPeiCoreMaxPeimPerFv number of Entries.
   //
   EFI_PEI_FILE_HANDLE                 *FvFileHandles;
+  //
+  // Ponter to the buffer with the PcdPeiCoreMaxPeimPerFv number of Entries.
+  //
+  PEI_CORE_PEIM_DEPEX                 *PeimDepex;
+  //
+  // The count of PEIMs at the head of FvFileHandles that are in the Apriori file.
+  //
+  UINTN                               AprioriCount;
+  //
+  // Pointer to the file name index, or NULL if it has not been built.
+  //
+  PEI_CORE_FILE_NAME_INDEX            *FileNameIndex;
   BOOLEAN                             ScanFv;
   UINT32                              AuthenticationStatus;
 } PEI_CORE_FV_HANDLE;
@@ -264,6 +337,20 @@ struct _PEI_CORE_INSTANCE {
   // Those Memory Range will be migrated into phisical memory. 
   //
   HOLE_MEMORY_DATA                  HoleData[HOLE_MAX_NUMBER];
+
+  //
+  // The number of passes the PEIM dispatcher made over the FVs, and the number
+  // of dependency expressions it evaluated.
+  //
+  UINT32                            DispatchPassCount;
+  UINT32                            DepexEvaluationCount;
+
+  //
+  // The number of files looked up by name, and the number of FFS file headers
+  // that a walk of the FVs would have parsed but the file name indexes did not.
+  //
+  UINT32                            FileNameLookupCount;
+  UINT32                            FileHeadersSkipped;
 };
 
 ///
@@ -351,6 +438,27 @@ PeimDispatchReadiness (
   IN VOID               *DependencyExpression
   );
 
+/**
+
+  Check whether any PPI that a dependency expression pushes was installed or
+  reinstalled after the PPI database reached a given sequence number. If not,
+  the dependency expression still evaluates to the same result.
+
+  @param PrivateData            PeiCore's private data structure.
+  @param DependencyExpression   Pointer to a dependency expression.
+  @param Sequence               The PPI database sequence number to compare with.
+
+  @retval TRUE      if one of the PPIs changed, or the expression could not be parsed.
+  @retval FALSE     if none of the PPIs changed.
+
+**/
+BOOLEAN
+DepexPpiInstalledSince (
+  IN PEI_CORE_INSTANCE  *PrivateData,
+  IN VOID               *DependencyExpression,
+  IN UINT32             Sequence
+  );
+
 /**
   Conduct PEIM dispatch.
 
@@ -502,6 +610,26 @@ PeiLocatePpi (
   IN OUT VOID                    **Ppi
   );
 
+/**
+
+  Check whether an instance of a given PPI was installed or reinstalled after
+  the PPI database reached a given sequence number.
+
+  @param PrivateData     PeiCore's private data structure.
+  @param Guid            Pointer to GUID of the PPI.
+  @param Sequence        The PPI database sequence number to compare with.
+
+  @retval TRUE           The PPI was installed or reinstalled after Sequence.
+  @retval FALSE          The PPI did not change after Sequence.
+
+**/
+BOOLEAN
+IsPpiInstalledSince (
+  IN PEI_CORE_INSTANCE  *PrivateData,
+  IN CONST EFI_GUID     *Guid,
+  IN UINT32             Sequence
+  );
+
 /**
 
   Install a notification for a given PPI.
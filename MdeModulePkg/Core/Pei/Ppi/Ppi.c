@@ -14,6 +14,167 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #include "PeiMain.h"
 
+/**
+
+  Compare the GUIDs of two PPIs in the order of the PPI index.
+
+  @param Guid1           Pointer to the first GUID.
+  @param Guid2           Pointer to the second GUID.
+
+  @retval 0              The GUIDs are equal.
+  @retval <0             Guid1 sorts before Guid2.
+  @retval >0             Guid1 sorts after Guid2.
+
+**/
+INTN
+ComparePpiGuid (
+  IN CONST EFI_GUID  *Guid1,
+  IN CONST EFI_GUID  *Guid2
+  )
+{
+  UINTN   Index;
+
+  //
+  // Don't use CompareGuid function here for performance reasons.
+  // Instead we compare the GUID as UINT32 at a time and branch
+  // on the first failed comparison.
+  //
+  for (Index = 0; Index < 4; Index++) {
+    if (((UINT32 *)Guid1)[Index] != ((UINT32 *)Guid2)[Index]) {
+      return (((UINT32 *)Guid1)[Index] < ((UINT32 *)Guid2)[Index]) ? -1 : 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+
+  Get the GUID of the PPI that an entry of the PPI index refers to.
+
+  @param PrivateData     Pointer to the PEI Core data.
+  @param Position        Position of the entry in the PPI index.
+
+  @return Pointer to the GUID of the PPI.
+
+**/
+EFI_GUID *
+GetPpiIndexGuid (
+  IN PEI_CORE_INSTANCE  *PrivateData,
+  IN INTN               Position
+  )
+{
+  return PrivateData->PpiData.PpiListPtrs[PrivateData->PpiData.PpiIndex[Position].PpiListIndex].Ppi->Guid;
+}
+
+/**
+
+  Binary search the PPI index for the first instance of a PPI.
+
+  @param PrivateData     Pointer to the PEI Core data.
+  @param Guid            Pointer to GUID of the PPI.
+  @param Count           The number of entries in the PPI index.
+
+  @return The position of the first entry whose GUID does not sort before Guid,
+          or Count if there is none.
+
+**/
+INTN
+FindPpiIndexPosition (
+  IN PEI_CORE_INSTANCE  *PrivateData,
+  IN CONST EFI_GUID     *Guid,
+  IN INTN               Count
+  )
+{
+  INTN    Low;
+  INTN    High;
+  INTN    Middle;
+
+  Low  = 0;
+  High = Count;
+  while (Low < High) {
+    Middle = Low + (High - Low) / 2;
+    if (ComparePpiGuid (GetPpiIndexGuid (PrivateData, Middle), Guid) < 0) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
+    }
+  }
+
+  return Low;
+}
+
+/**
+
+  Add a PPI that was just stored in PpiListPtrs to the PPI index. PpiListEnd
+  must already include the PPI.
+
+  @param PrivateData     Pointer to the PEI Core data.
+  @param PpiListIndex    Index of the PPI descriptor in PpiListPtrs.
+
+**/
+VOID
+InsertPpiIndex (
+  IN PEI_CORE_INSTANCE  *PrivateData,
+  IN INTN               PpiListIndex
+  )
+{
+  PEI_PPI_INDEX_ENTRY   *PpiIndex;
+  EFI_GUID              *Guid;
+  INTN                  Count;
+  INTN                  Position;
+
+  PpiIndex = PrivateData->PpiData.PpiIndex;
+  Guid     = PrivateData->PpiData.PpiListPtrs[PpiListIndex].Ppi->Guid;
+  Count    = PrivateData->PpiData.PpiListEnd - 1;
+
+  //
+  // Keep the instances of the same PPI in install order, so that the Instance
+  // parameter of LocatePpi () finds the same PPI as a walk of PpiListPtrs.
+  //
+  Position = FindPpiIndexPosition (PrivateData, Guid, Count);
+  while ((Position < Count) &&
+         (PpiIndex[Position].PpiListIndex < PpiListIndex) &&
+         (ComparePpiGuid (GetPpiIndexGuid (PrivateData, Position), Guid) == 0)) {
+    Position++;
+  }
+
+  CopyMem (&PpiIndex[Position + 1], &PpiIndex[Position], (Count - Position) * sizeof (PEI_PPI_INDEX_ENTRY));
+  PpiIndex[Position].PpiListIndex = PpiListIndex;
+  PpiIndex[Position].Sequence     = ++PrivateData->PpiData.PpiSequence;
+}
+
+/**
+
+  Remove a PPI from the PPI index. PpiListEnd must still include the PPI.
+
+  @param PrivateData     Pointer to the PEI Core data.
+  @param PpiListIndex    Index of the PPI descriptor in PpiListPtrs.
+
+**/
+VOID
+RemovePpiIndex (
+  IN PEI_CORE_INSTANCE  *PrivateData,
+  IN INTN               PpiListIndex
+  )
+{
+  PEI_PPI_INDEX_ENTRY   *PpiIndex;
+  INTN                  Count;
+  INTN                  Position;
+
+  PpiIndex = PrivateData->PpiData.PpiIndex;
+  Count    = PrivateData->PpiData.PpiListEnd;
+
+  for (Position = 0; Position < Count; Position++) {
+    if (PpiIndex[Position].PpiListIndex == PpiListIndex) {
+      CopyMem (&PpiIndex[Position], &PpiIndex[Position + 1], (Count - Position - 1) * sizeof (PEI_PPI_INDEX_ENTRY));
+      return;
+    }
+  }
+
+  ASSERT (FALSE);
+}
+
 /**
 
   Initialize PPI services.
@@ -220,7 +381,10 @@ PeiInstallPpi (
     // Try to indicate which item failed.
     //
     if ((PpiList->Flags & EFI_PEI_PPI_DESCRIPTOR_PPI) == 0) {
-      PrivateData->PpiData.PpiListEnd = LastCallbackInstall;
+      while (PrivateData->PpiData.PpiListEnd > LastCallbackInstall) {
+        RemovePpiIndex (PrivateData, PrivateData->PpiData.PpiListEnd - 1);
+        PrivateData->PpiData.PpiListEnd--;
+      }
       DEBUG((EFI_D_ERROR, "ERROR -> InstallPpi: %g %p\n", PpiList->Guid, PpiList->Ppi));
       return  EFI_INVALID_PARAMETER;
     }
@@ -228,6 +392,7 @@ PeiInstallPpi (
     DEBUG((EFI_D_INFO, "Install PPI: %g\n", PpiList->Guid));
     PrivateData->PpiData.PpiListPtrs[Index].Ppi = (EFI_PEI_PPI_DESCRIPTOR*) PpiList;
     PrivateData->PpiData.PpiListEnd++;
+    InsertPpiIndex (PrivateData, Index);
 
     //
     // Continue until the end of the PPI List.
@@ -313,7 +478,9 @@ PeiReInstallPpi (
   //
   DEBUG((EFI_D_INFO, "Reinstall PPI: %g\n", NewPpi->Guid));
   ASSERT (Index < (INTN)(PcdGet32 (PcdPeiCoreMaxPpiSupported)));
+  RemovePpiIndex (PrivateData, Index);
   PrivateData->PpiData.PpiListPtrs[Index].Ppi = (EFI_PEI_PPI_DESCRIPTOR *) NewPpi;
+  InsertPpiIndex (PrivateData, Index);
 
   //
   // Dispatch any callback level notifies for the newly installed PPI.
@@ -358,47 +525,72 @@ PeiLocatePpi (
   )
 {
   PEI_CORE_INSTANCE   *PrivateData;
-  INTN                Index;
-  EFI_GUID            *CheckGuid;
+  INTN                Position;
   EFI_PEI_PPI_DESCRIPTOR  *TempPtr;
 
 
   PrivateData = PEI_CORE_INSTANCE_FROM_PS_THIS(PeiServices);
 
   //
-  // Search the data base for the matching instance of the GUIDed PPI.
+  // Binary search the PPI index for the first instance of the GUIDed PPI. The
+  // instances of a PPI are next to each other in install order.
   //
-  for (Index = 0; Index < PrivateData->PpiData.PpiListEnd; Index++) {
-    TempPtr = PrivateData->PpiData.PpiListPtrs[Index].Ppi;
-    CheckGuid = TempPtr->Guid;
+  Position = FindPpiIndexPosition (PrivateData, Guid, PrivateData->PpiData.PpiListEnd);
+  if (Instance >= (UINTN) (PrivateData->PpiData.PpiListEnd - Position)) {
+    return EFI_NOT_FOUND;
+  }
+  Position += Instance;
 
-    //
-    // Don't use CompareGuid function here for performance reasons.
-    // Instead we compare the GUID as INT32 at a time and branch
-    // on the first failed comparison.
-    //
-    if ((((INT32 *)Guid)[0] == ((INT32 *)CheckGuid)[0]) &&
-        (((INT32 *)Guid)[1] == ((INT32 *)CheckGuid)[1]) &&
-        (((INT32 *)Guid)[2] == ((INT32 *)CheckGuid)[2]) &&
-        (((INT32 *)Guid)[3] == ((INT32 *)CheckGuid)[3])) {
-      if (Instance == 0) {
-
-        if (PpiDescriptor != NULL) {
-          *PpiDescriptor = TempPtr;
-        }
+  TempPtr = PrivateData->PpiData.PpiListPtrs[PrivateData->PpiData.PpiIndex[Position].PpiListIndex].Ppi;
+  if (ComparePpiGuid (TempPtr->Guid, Guid) != 0) {
+    return EFI_NOT_FOUND;
+  }
 
-        if (Ppi != NULL) {
-          *Ppi = TempPtr->Ppi;
-        }
+  if (PpiDescriptor != NULL) {
+    *PpiDescriptor = TempPtr;
+  }
 
+  if (Ppi != NULL) {
+    *Ppi = TempPtr->Ppi;
+  }
 
-        return EFI_SUCCESS;
-      }
-      Instance--;
+  return EFI_SUCCESS;
+}
+
+/**
+
+  Check whether an instance of a given PPI was installed or reinstalled after
+  the PPI database reached a given sequence number.
+
+  @param PrivateData     PeiCore's private data structure.
+  @param Guid            Pointer to GUID of the PPI.
+  @param Sequence        The PPI database sequence number to compare with.
+
+  @retval TRUE           The PPI was installed or reinstalled after Sequence.
+  @retval FALSE          The PPI did not change after Sequence.
+
+**/
+BOOLEAN
+IsPpiInstalledSince (
+  IN PEI_CORE_INSTANCE  *PrivateData,
+  IN CONST EFI_GUID     *Guid,
+  IN UINT32             Sequence
+  )
+{
+  INTN                Position;
+
+  for (Position = FindPpiIndexPosition (PrivateData, Guid, PrivateData->PpiData.PpiListEnd);
+       Position < PrivateData->PpiData.PpiListEnd;
+       Position++) {
+    if (ComparePpiGuid (GetPpiIndexGuid (PrivateData, Position), Guid) != 0) {
+      break;
+    }
+    if (PrivateData->PpiData.PpiIndex[Position].Sequence > Sequence) {
+      return TRUE;
     }
   }
 
-  return EFI_NOT_FOUND;
+  return FALSE;
 }
 
 /**
@@ -110,6 +110,28 @@ typedef struct {
   //MEMORY_PROFILE_DESCRIPTOR     MemoryDescriptor[MemoryRangeCount];
 } MEMORY_PROFILE_MEMORY_RANGE;
 
+#define MEMORY_PROFILE_POOL_STATS_SIGNATURE SIGNATURE_32 ('M','P','P','S')
+#define MEMORY_PROFILE_POOL_STATS_REVISION 0x0001
+
+//
+// Pool allocator mode reported in MEMORY_PROFILE_POOL_STATS.
+//
+#define MEMORY_PROFILE_POOL_MODE_LIST   0
+#define MEMORY_PROFILE_POOL_MODE_SLAB   1
+
+typedef struct {
+  MEMORY_PROFILE_COMMON_HEADER  Header;
+  UINT32                        PoolMode;
+  UINT8                         Reserved[4];
+  UINT64                        AllocateCount;
+  UINT64                        FreeCount;
+  UINT64                        HitCount;          // Served from memory already owned by the pool.
+  UINT64                        MissCount;         // Had to get pages from the page allocator.
+  UINT64                        MagazineHitCount;  // Subset of HitCount served by a per-TPL magazine.
+  UINT64                        CurrentSlabPages;
+  UINT64                        PeakSlabPages;
+} MEMORY_PROFILE_POOL_STATS;
+
 //
 // UEFI memory profile layout:
 // +--------------------------------+
@@ -127,6 +149,8 @@ typedef struct {
 // +--------------------------------+
 // | ALLOC_INFO(n, mn)              |
 // +--------------------------------+
+// | POOL_STATS                     |
+// +--------------------------------+
 //
 
 typedef struct _EDKII_MEMORY_PROFILE_PROTOCOL EDKII_MEMORY_PROFILE_PROTOCOL;
@@ -191,6 +191,11 @@ DiskIoDriverBindingStart (
     goto ErrorExit;
   }
 
+  //
+  // The block cache is optional, the reads go to the device when it can't be created.
+  //
+  DiskIoCacheCreate (Instance);
+
   //
   // Install protocol interfaces for the Disk IO device.
   //
@@ -219,6 +224,7 @@ ErrorExit:
     }
 
     if (Instance != NULL) {
+      DiskIoCacheDestroy (Instance);
       FreePool (Instance);
     }
 
@@ -322,6 +328,7 @@ DiskIoDriverBindingStop (
       EfiReleaseLock (&Instance->TaskQueueLock);
     } while (!AllTaskDone);
 
+    DiskIoCacheDestroy (Instance);
     FreeAlignedPages (
       Instance->SharedWorkingBuffer,
       EFI_SIZE_TO_PAGES (PcdGet32 (PcdDiskIoDataBufferBlockNum) * Instance->BlockIo->Media->BlockSize)
@@ -747,6 +754,11 @@ DiskIo2Cancel (
     }
   }
 
+  //
+  // The data of the aborted writes on the device is not known.
+  //
+  DiskIoCacheInvalidate (Instance);
+
   EfiReleaseLock (&Instance->TaskQueueLock);
 
   return EFI_SUCCESS;
@@ -847,6 +859,14 @@ DiskIo2ReadWriteDisk (
     //
     while (!DiskIo2RemoveCompletedTask (Instance));
 
+    if (!Write && (Instance->Cache != NULL)) {
+      Status = DiskIoCacheRead (Instance, MediaId, Offset, BufferSize, Buffer);
+      if (Status != EFI_UNSUPPORTED) {
+        return Status;
+      }
+      Status = EFI_SUCCESS;
+    }
+
     SubtasksPtr = &Subtasks;
   } else {
     DiskIo2RemoveCompletedTask (Instance);
@@ -956,7 +976,17 @@ DiskIo2ReadWriteDisk (
       break;
     }
   }
-  
+
+  //
+  // Write through the block cache. The cached lines are dropped when the data
+  // on the device is not known yet, or not known at all after a failure.
+  // DiskIoCacheWrite() raises the TPL to TPL_CALLBACK itself, so it is called
+  // before the TPL is raised to TPL_NOTIFY.
+  //
+  if (Write) {
+    DiskIoCacheWrite (Instance, Offset, BufferSize, (Blocking && !EFI_ERROR (Status)) ? Buffer : NULL);
+  }
+
   gBS->RaiseTPL (TPL_NOTIFY);
 
   //
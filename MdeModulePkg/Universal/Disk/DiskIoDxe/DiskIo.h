@@ -29,6 +29,54 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
+#include <Library/PcdLib.h>
+
+//
+// Size of the cache lines, rounded down to a multiple of the block size.
+// The cache line is one block when the block is larger.
+//
+#define DISK_IO_CACHE_LINE_SIZE   SIZE_4KB
+#define DISK_IO_CACHE_INVALID     MAX_UINT64
+
+typedef struct {
+  UINT64                          Line;     /// < number of the cached line, DISK_IO_CACHE_INVALID if unused
+  UINT64                          LastUse;  /// < value of UseCount when the line was last used
+  UINT8                           *Data;
+} DISK_IO_CACHE_LINE;
+
+typedef struct {
+  //
+  // Geometry of the media the lines were cached for.
+  //
+  UINT32                          MediaId;
+  UINT32                          BlockSize;
+  UINTN                           LineSize;
+  UINTN                           LineCount;
+  UINTN                           StagingLineCount;
+
+  DISK_IO_CACHE_LINE              *Lines;
+  UINTN                           MaxLineCount;
+  UINT8                           *Data;
+  UINTN                           DataSize;
+  UINT8                           *StagingBuffer; /// < buffer the lines are read in with one device read
+  UINTN                           StagingSize;
+
+  //
+  // Sequential read detection: the read-ahead window in lines grows while
+  // every read starts where the previous one ended.
+  //
+  UINT64                          NextOffset;
+  UINTN                           ReadAhead;
+  UINT64                          UseCount;
+
+  //
+  // Statistics
+  //
+  UINT64                          Hits;
+  UINT64                          Misses;
+  UINT64                          DeviceReads;
+  UINT64                          DeviceReadsSaved;
+} DISK_IO_CACHE;
 
 #define DISK_IO_PRIVATE_DATA_SIGNATURE  SIGNATURE_32 ('d', 's', 'k', 'I')
 typedef struct {
@@ -40,6 +88,7 @@ typedef struct {
   EFI_BLOCK_IO2_PROTOCOL          *BlockIo2;
 
   UINT8                           *SharedWorkingBuffer;
+  DISK_IO_CACHE                   *Cache;   /// < NULL when the reads are not cached
 
   EFI_LOCK                        TaskQueueLock;
   LIST_ENTRY                      TaskQueue;
@@ -340,6 +389,83 @@ DiskIo2FlushDiskEx (
   IN OUT EFI_DISK_IO2_TOKEN       *Token
   );
 
+//
+// Block cache
+//
+/**
+  Create the block cache of a Disk I/O instance.
+
+  The cache is only created if PcdDiskIoCacheSize is not 0, and only for whole
+  disks: the partitions read and write through the Disk I/O of their disk, so
+  one cache stays coherent for all of them.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheCreate (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  );
+
+/**
+  Log the statistics of the block cache of a Disk I/O instance and free it.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheDestroy (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  );
+
+/**
+  Drop all the lines of the block cache of a Disk I/O instance.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheInvalidate (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  );
+
+/**
+  Read from the block cache of a Disk I/O instance, filling the missing lines
+  and the read-ahead lines from the device.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param MediaId     ID of the medium to be read.
+  @param Offset      The starting byte offset on the logical block I/O device to read from.
+  @param BufferSize  The size in bytes of Buffer.
+  @param Buffer      A pointer to the destination buffer for the data.
+
+  @retval EFI_SUCCESS      The data was read from the cache or from the device.
+  @retval EFI_UNSUPPORTED  The read is not cached and must be done directly on the device.
+  @retval others           The device reported an error while filling the cache.
+**/
+EFI_STATUS
+DiskIoCacheRead (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT32                   MediaId,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize,
+  OUT UINT8                   *Buffer
+  );
+
+/**
+  Update the cached lines a write overlaps.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param Offset      The starting byte offset on the logical block I/O device written to.
+  @param BufferSize  The size in bytes of Buffer.
+  @param Buffer      The data written to the device, or NULL to drop the lines
+                     when the data on the device is not known.
+**/
+VOID
+DiskIoCacheWrite (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize,
+  IN UINT8                    *Buffer OPTIONAL
+  );
+
 //
 // EFI Component Name Functions
 //
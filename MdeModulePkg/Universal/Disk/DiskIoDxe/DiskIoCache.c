@@ -0,0 +1,431 @@
+/** @file
+  Block cache of the DiskIo driver.
+
+  Small blocking reads are served from a cache of the most recently read lines
+  of blocks. A missing line is read from the device together with the lines
+  following it when the reads are sequential, so that file systems reading
+  small unaligned pieces of a file don't go to the device for every piece.
+  The cache is write-through: the writes go to the device as before, and the
+  cached lines they overlap are updated.
+
+Copyright (c) 2015, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "DiskIo.h"
+
+/**
+  Create the block cache of a Disk I/O instance.
+
+  The cache is only created if PcdDiskIoCacheSize is not 0, and only for whole
+  disks: the partitions read and write through the Disk I/O of their disk, so
+  one cache stays coherent for all of them.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheCreate (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  )
+{
+  DISK_IO_CACHE               *Cache;
+  EFI_BLOCK_IO_MEDIA          *Media;
+
+  Media = Instance->BlockIo->Media;
+  if ((PcdGet32 (PcdDiskIoCacheSize) == 0) || Media->LogicalPartition) {
+    return;
+  }
+
+  Cache = AllocateZeroPool (sizeof (DISK_IO_CACHE));
+  if (Cache == NULL) {
+    return;
+  }
+
+  //
+  // The lines are never smaller than half of DISK_IO_CACHE_LINE_SIZE, whatever the block size is.
+  //
+  Cache->DataSize     = EFI_PAGES_TO_SIZE (EFI_SIZE_TO_PAGES (PcdGet32 (PcdDiskIoCacheSize)));
+  Cache->MaxLineCount = Cache->DataSize / (DISK_IO_CACHE_LINE_SIZE / 2);
+  Cache->StagingSize  = EFI_PAGES_TO_SIZE (EFI_SIZE_TO_PAGES (MAX (PcdGet32 (PcdDiskIoCacheReadAheadSize), DISK_IO_CACHE_LINE_SIZE)));
+  Cache->Lines        = AllocatePool (Cache->MaxLineCount * sizeof (DISK_IO_CACHE_LINE));
+  Cache->Data         = AllocatePages (EFI_SIZE_TO_PAGES (Cache->DataSize));
+  Cache->StagingBuffer = AllocateAlignedPages (EFI_SIZE_TO_PAGES (Cache->StagingSize), Media->IoAlign);
+  if ((Cache->Lines == NULL) || (Cache->Data == NULL) || (Cache->StagingBuffer == NULL)) {
+    DEBUG ((EFI_D_WARN, "DiskIo: Not enough memory for the block cache, reads are not cached.\n"));
+    Instance->Cache = Cache;
+    DiskIoCacheDestroy (Instance);
+    return;
+  }
+
+  Instance->Cache = Cache;
+  DiskIoCacheInvalidate (Instance);
+}
+
+/**
+  Log the statistics of the block cache of a Disk I/O instance and free it.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheDestroy (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  )
+{
+  DISK_IO_CACHE               *Cache;
+
+  Cache = Instance->Cache;
+  if (Cache == NULL) {
+    return;
+  }
+
+  DEBUG ((
+    EFI_D_INFO,
+    "DiskIo: Block cache %ld hits, %ld misses, %ld device reads, %ld device reads saved\n",
+    Cache->Hits,
+    Cache->Misses,
+    Cache->DeviceReads,
+    Cache->DeviceReadsSaved
+    ));
+
+  if (Cache->StagingBuffer != NULL) {
+    FreeAlignedPages (Cache->StagingBuffer, EFI_SIZE_TO_PAGES (Cache->StagingSize));
+  }
+  if (Cache->Data != NULL) {
+    FreePages (Cache->Data, EFI_SIZE_TO_PAGES (Cache->DataSize));
+  }
+  if (Cache->Lines != NULL) {
+    FreePool (Cache->Lines);
+  }
+  FreePool (Cache);
+  Instance->Cache = NULL;
+}
+
+/**
+  Drop all the lines of the block cache of a Disk I/O instance.
+
+  The geometry of the lines is computed again from the current media, so the
+  cache is ready for the media after a media change.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheInvalidate (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  )
+{
+  DISK_IO_CACHE               *Cache;
+  EFI_BLOCK_IO_MEDIA          *Media;
+  UINTN                       Index;
+
+  Cache = Instance->Cache;
+  if (Cache == NULL) {
+    return;
+  }
+
+  Media            = Instance->BlockIo->Media;
+  Cache->MediaId   = Media->MediaId;
+  Cache->BlockSize = Media->BlockSize;
+  if (Media->BlockSize == 0) {
+    Cache->LineSize = 0;
+  } else if (Media->BlockSize >= DISK_IO_CACHE_LINE_SIZE) {
+    Cache->LineSize = Media->BlockSize;
+  } else {
+    Cache->LineSize = (DISK_IO_CACHE_LINE_SIZE / Media->BlockSize) * Media->BlockSize;
+  }
+
+  //
+  // The lines read at once must not evict each other, so at most half of the
+  // lines are read at once.
+  //
+  if (Cache->LineSize == 0) {
+    Cache->LineCount        = 0;
+    Cache->StagingLineCount = 0;
+  } else {
+    Cache->LineCount        = MIN (Cache->DataSize / Cache->LineSize, Cache->MaxLineCount);
+    Cache->StagingLineCount = MIN (Cache->StagingSize / Cache->LineSize, Cache->LineCount / 2);
+  }
+
+  for (Index = 0; Index < Cache->LineCount; Index++) {
+    Cache->Lines[Index].Line    = DISK_IO_CACHE_INVALID;
+    Cache->Lines[Index].LastUse = 0;
+    Cache->Lines[Index].Data    = Cache->Data + Index * Cache->LineSize;
+  }
+
+  Cache->NextOffset = DISK_IO_CACHE_INVALID;
+  Cache->ReadAhead  = 0;
+}
+
+/**
+  Find a line in the block cache.
+
+  @param Cache       Pointer to the DISK_IO_CACHE.
+  @param Line        Number of the line.
+
+  @return The cached line, or NULL if the line is not cached.
+**/
+DISK_IO_CACHE_LINE *
+DiskIoCacheLookup (
+  IN DISK_IO_CACHE            *Cache,
+  IN UINT64                   Line
+  )
+{
+  UINTN                       Index;
+
+  for (Index = 0; Index < Cache->LineCount; Index++) {
+    if (Cache->Lines[Index].Line == Line) {
+      return &Cache->Lines[Index];
+    }
+  }
+  return NULL;
+}
+
+/**
+  Get a line of the block cache to cache a new line in.
+
+  @param Cache       Pointer to the DISK_IO_CACHE.
+
+  @return An unused line, or else the least recently used line.
+**/
+DISK_IO_CACHE_LINE *
+DiskIoCacheEvict (
+  IN DISK_IO_CACHE            *Cache
+  )
+{
+  UINTN                       Index;
+  DISK_IO_CACHE_LINE          *Victim;
+
+  Victim = &Cache->Lines[0];
+  for (Index = 0; Index < Cache->LineCount; Index++) {
+    if (Cache->Lines[Index].Line == DISK_IO_CACHE_INVALID) {
+      return &Cache->Lines[Index];
+    }
+    if (Cache->Lines[Index].LastUse < Victim->LastUse) {
+      Victim = &Cache->Lines[Index];
+    }
+  }
+  return Victim;
+}
+
+/**
+  Read from the block cache of a Disk I/O instance, filling the missing lines
+  and the read-ahead lines from the device.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param MediaId     ID of the medium to be read.
+  @param Offset      The starting byte offset on the logical block I/O device to read from.
+  @param BufferSize  The size in bytes of Buffer.
+  @param Buffer      A pointer to the destination buffer for the data.
+
+  @retval EFI_SUCCESS      The data was read from the cache or from the device.
+  @retval EFI_UNSUPPORTED  The read is not cached and must be done directly on the device.
+  @retval others           The device reported an error while filling the cache.
+**/
+EFI_STATUS
+DiskIoCacheRead (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT32                   MediaId,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize,
+  OUT UINT8                   *Buffer
+  )
+{
+  EFI_STATUS                  Status;
+  DISK_IO_CACHE               *Cache;
+  EFI_BLOCK_IO_PROTOCOL       *BlockIo;
+  EFI_BLOCK_IO_MEDIA          *Media;
+  DISK_IO_CACHE_LINE          *CacheLine;
+  EFI_TPL                     OldTpl;
+  UINT64                      MediaSize;
+  UINT64                      End;
+  UINT64                      Line;
+  UINT64                      LastLine;
+  UINT64                      LastMediaLine;
+  UINT64                      LineOffset;
+  UINT64                      Start;
+  UINT64                      Stop;
+  UINTN                       Count;
+  UINTN                       Length;
+  UINTN                       Index;
+  BOOLEAN                     DeviceRead;
+
+  Cache   = Instance->Cache;
+  BlockIo = Instance->BlockIo;
+  Media   = BlockIo->Media;
+  if (Cache == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  if ((Media->MediaId != Cache->MediaId) || (Media->BlockSize != Cache->BlockSize)) {
+    DiskIoCacheInvalidate (Instance);
+  }
+
+  //
+  // Let the device report the errors of the reads it doesn't accept, and read
+  // the large buffers directly.
+  //
+  MediaSize = MultU64x32 (Media->LastBlock + 1, Media->BlockSize);
+  if (!Media->MediaPresent || (Cache->StagingLineCount == 0) ||
+      (BufferSize == 0) || (BufferSize > Cache->StagingSize) ||
+      (Offset > MediaSize) || (BufferSize > MediaSize - Offset)) {
+    gBS->RestoreTPL (OldTpl);
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Double the read-ahead window while the reads are sequential.
+  //
+  if (Offset == Cache->NextOffset) {
+    Cache->ReadAhead = (Cache->ReadAhead == 0) ? 1 : MIN (Cache->ReadAhead * 2, Cache->StagingLineCount);
+  } else {
+    Cache->ReadAhead = 0;
+  }
+  End               = Offset + BufferSize;
+  Cache->NextOffset = End;
+
+  LastLine      = DivU64x32 (End - 1, (UINT32) Cache->LineSize);
+  LastMediaLine = DivU64x32 (MediaSize - 1, (UINT32) Cache->LineSize);
+  DeviceRead    = FALSE;
+  Status        = EFI_SUCCESS;
+
+  for (Line = DivU64x32 (Offset, (UINT32) Cache->LineSize); Line <= LastLine; ) {
+    LineOffset = MultU64x32 (Line, (UINT32) Cache->LineSize);
+    Start      = MAX (Offset, LineOffset);
+
+    CacheLine = DiskIoCacheLookup (Cache, Line);
+    if (CacheLine != NULL) {
+      Cache->Hits++;
+      CacheLine->LastUse = ++Cache->UseCount;
+      Stop = MIN (End, LineOffset + Cache->LineSize);
+      CopyMem (Buffer + (UINTN) (Start - Offset), CacheLine->Data + (UINTN) (Start - LineOffset), (UINTN) (Stop - Start));
+      Line++;
+      continue;
+    }
+
+    //
+    // Read the missing line with the following missing lines of the request
+    // and of the read-ahead window at once.
+    //
+    Cache->Misses++;
+    for (Count = 1; Count < Cache->StagingLineCount; Count++) {
+      if ((Line + Count > LastLine + Cache->ReadAhead) || (Line + Count > LastMediaLine) ||
+          (DiskIoCacheLookup (Cache, Line + Count) != NULL)) {
+        break;
+      }
+    }
+    Length = (UINTN) MIN (Count * Cache->LineSize, MediaSize - LineOffset);
+
+    Status = BlockIo->ReadBlocks (
+                        BlockIo,
+                        MediaId,
+                        DivU64x32 (LineOffset, Media->BlockSize),
+                        Length,
+                        Cache->StagingBuffer
+                        );
+    if (EFI_ERROR (Status)) {
+      if ((Status == EFI_MEDIA_CHANGED) || (Status == EFI_NO_MEDIA)) {
+        DiskIoCacheInvalidate (Instance);
+      }
+      break;
+    }
+    Cache->DeviceReads++;
+    DeviceRead = TRUE;
+
+    for (Index = 0; Index < Count; Index++) {
+      CacheLine          = DiskIoCacheEvict (Cache);
+      CacheLine->Line    = Line + Index;
+      CacheLine->LastUse = ++Cache->UseCount;
+      CopyMem (
+        CacheLine->Data,
+        Cache->StagingBuffer + Index * Cache->LineSize,
+        MIN (Cache->LineSize, Length - Index * Cache->LineSize)
+        );
+    }
+
+    Stop = MIN (End, LineOffset + Length);
+    CopyMem (Buffer + (UINTN) (Start - Offset), Cache->StagingBuffer + (UINTN) (Start - LineOffset), (UINTN) (Stop - Start));
+    Line += Count;
+  }
+
+  if (!EFI_ERROR (Status) && !DeviceRead) {
+    Cache->DeviceReadsSaved++;
+  }
+
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+/**
+  Update the cached lines a write overlaps.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param Offset      The starting byte offset on the logical block I/O device written to.
+  @param BufferSize  The size in bytes of Buffer.
+  @param Buffer      The data written to the device, or NULL to drop the lines
+                     when the data on the device is not known.
+**/
+VOID
+DiskIoCacheWrite (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize,
+  IN UINT8                    *Buffer OPTIONAL
+  )
+{
+  DISK_IO_CACHE               *Cache;
+  EFI_BLOCK_IO_MEDIA          *Media;
+  DISK_IO_CACHE_LINE          *CacheLine;
+  EFI_TPL                     OldTpl;
+  UINT64                      End;
+  UINT64                      LineOffset;
+  UINT64                      Start;
+  UINT64                      Stop;
+  UINTN                       Index;
+
+  Cache = Instance->Cache;
+  if (Cache == NULL) {
+    return;
+  }
+
+  //
+  // Keep a DiskIoCacheRead() from a callback from seeing half-updated lines.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  Media = Instance->BlockIo->Media;
+  if ((Media->MediaId != Cache->MediaId) || (Media->BlockSize != Cache->BlockSize)) {
+    DiskIoCacheInvalidate (Instance);
+    gBS->RestoreTPL (OldTpl);
+    return;
+  }
+
+  End = Offset + BufferSize;
+  for (Index = 0; Index < Cache->LineCount; Index++) {
+    CacheLine = &Cache->Lines[Index];
+    if (CacheLine->Line == DISK_IO_CACHE_INVALID) {
+      continue;
+    }
+    LineOffset = MultU64x32 (CacheLine->Line, (UINT32) Cache->LineSize);
+    if ((LineOffset >= End) || (LineOffset + Cache->LineSize <= Offset)) {
+      continue;
+    }
+
+    if (Buffer == NULL) {
+      CacheLine->Line = DISK_IO_CACHE_INVALID;
+    } else {
+      Start = MAX (Offset, LineOffset);
+      Stop  = MIN (End, LineOffset + Cache->LineSize);
+      CopyMem (CacheLine->Data + (UINTN) (Start - LineOffset), Buffer + (UINTN) (Start - Offset), (UINTN) (Stop - Start));
+    }
+  }
+
+  gBS->RestoreTPL (OldTpl);
+}
@@ -579,6 +579,9 @@ FvSimpleFileSystemClose (
 
   if (File != Instance->Root) {
     RemoveEntryList (&File->Link);
+    if (File->FileBuffer != NULL) {
+      FreePool (File->FileBuffer);
+    }
     FreePool (File);
   }
   return EFI_SUCCESS;
@@ -653,23 +656,40 @@ FvSimpleFileSystemRead (
       return EFI_SUCCESS;
     }
   } else {
-    FileSize = (UINTN)File->FvFileInfo->FileInfo.FileSize;
-
-    FileBuffer = AllocateZeroPool (FileSize);
-    if (FileBuffer == NULL) {
+    if (File->Position > File->FvFileInfo->FileInfo.FileSize) {
       return EFI_DEVICE_ERROR;
     }
 
-    Status = FvFsReadFile (File->Instance->FvProtocol, File->FvFileInfo, &FileSize, &FileBuffer);
-    if (EFI_ERROR (Status)) {
-      return EFI_DEVICE_ERROR;
+    //
+    // Read and decode the file from the FV only on the first read, and keep
+    // it until the file is closed. Reading a file in small pieces would
+    // otherwise read the whole file again for every piece.
+    //
+    if (File->FileBuffer == NULL) {
+      FileSize = (UINTN)File->FvFileInfo->FileInfo.FileSize;
+
+      FileBuffer = AllocateZeroPool (FileSize);
+      if (FileBuffer == NULL) {
+        return EFI_DEVICE_ERROR;
+      }
+
+      Status = FvFsReadFile (File->Instance->FvProtocol, File->FvFileInfo, &FileSize, &FileBuffer);
+      if (EFI_ERROR (Status)) {
+        FreePool (FileBuffer);
+        return EFI_DEVICE_ERROR;
+      }
+      File->FileBuffer = FileBuffer;
     }
 
-    if (*BufferSize + File->Position > FileSize) {
+    //
+    // The buffer holds FileInfo.FileSize bytes, even if the section found was larger.
+    //
+    FileSize = (UINTN)File->FvFileInfo->FileInfo.FileSize;
+    if (*BufferSize > FileSize - File->Position) {
       *BufferSize = (UINTN)(FileSize - File->Position);
     }
 
-    CopyMem (Buffer, (UINT8*)FileBuffer + File->Position, *BufferSize);
+    CopyMem (Buffer, (UINT8*)File->FileBuffer + File->Position, *BufferSize);
     File->Position += *BufferSize;
 
     return EFI_SUCCESS;
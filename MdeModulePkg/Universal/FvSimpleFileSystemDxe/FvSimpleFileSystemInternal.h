@@ -70,6 +70,7 @@ struct _FV_FILESYSTEM_FILE {
   EFI_FILE_PROTOCOL                FileProtocol;
   FV_FILESYSTEM_FILE_INFO          *FvFileInfo;
   UINT64                           Position;
+  VOID                             *FileBuffer;   // Contents of the file, read on the first Read()
 };
 
 //
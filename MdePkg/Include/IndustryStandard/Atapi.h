@@ -517,6 +517,7 @@ typedef union {
 #define ATA_CMD_READ_LONG               0x22   ///< defined from ATA-1, obsoleted from ATA-5
 #define ATA_CMD_READ_LONG_WITH_RETRY    0x23   ///< defined from ATA-1, obsoleted from ATA-5
 #define ATA_CMD_READ_SECTORS_EXT        0x24   ///< defined from ATA-6
+#define ATA_CMD_READ_LOG_EXT            0x2f   ///< defined from ATA-6
 
 //
 // Class 2: PIO Data-Out Commands
@@ -575,6 +576,8 @@ typedef union {
 #define ATA_CMD_WRITE_DMA             0xca   ///< defined from ATA-1
 #define ATA_CMD_WRITE_DMA_WITH_RETRY  0xcb   ///< defined from ATA-1, obsoleted from ATA-
 #define ATA_CMD_WRITE_DMA_EXT         0x35   ///< defined from ATA-6
+#define ATA_CMD_READ_FPDMA_QUEUED     0x60   ///< defined from ATA/ATAPI-7 with Serial ATA
+#define ATA_CMD_WRITE_FPDMA_QUEUED    0x61   ///< defined from ATA/ATAPI-7 with Serial ATA
         
 ///
 /// Default content of device control register, disable INT,
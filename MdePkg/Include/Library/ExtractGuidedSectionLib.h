@@ -4,7 +4,8 @@
   This library provides functions to process GUIDed sections of FFS files.  Handlers may 
   be registered to decode GUIDed sections of FFS files.  Services are provided to determine 
   the set of supported section GUIDs, collection information about a specific GUIDed section, 
-  and decode a specific GUIDed section. 
+  and decode a specific GUIDed section. Optional handlers may also be registered to decode
+  a GUIDed section incrementally, one window of the decoded data at a time.
   
   A library instance that produces this library class may be used to produce a 
   EFI_PEI_GUIDED_SECTION_EXTRACTION_PPI or a EFI_GUIDED_SECTION_EXTRACTION_PROTOCOL 
@@ -107,6 +108,108 @@ RETURN_STATUS
   OUT       UINT32  *AuthenticationStatus
   );
 
+/**
+  Starts to decode a GUIDed section incrementally.
+
+  Initializes the state of the incremental decode of the GUIDed section specified by
+  InputSection in ScratchBuffer. The decoded data is then produced in windows by
+  EXTRACT_GUIDED_SECTION_STREAM_FEED_HANDLER, and the decode operation is completed by
+  EXTRACT_GUIDED_SECTION_STREAM_FINISH_HANDLER.
+
+  If InputSection is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+
+  @param[in]  InputSection  A pointer to a GUIDed section of an FFS formatted file.
+  @param[in]  ScratchBuffer A caller allocated buffer of the size returned by
+                            EXTRACT_GUIDED_SECTION_GET_INFO_HANDLER, which holds the
+                            state of the decode operation until it is finished.
+
+  @retval  RETURN_SUCCESS            The decode operation was started.
+  @retval  RETURN_UNSUPPORTED        The section specified by InputSection does not match the GUID this handler supports.
+  @retval  RETURN_INVALID_PARAMETER  The section specified by InputSection can not be decoded.
+
+**/
+typedef
+RETURN_STATUS
+(EFIAPI *EXTRACT_GUIDED_SECTION_STREAM_INIT_HANDLER)(
+  IN CONST  VOID    *InputSection,
+  IN        VOID    *ScratchBuffer
+  );
+
+/**
+  Decodes the next window of a GUIDed section.
+
+  Decodes the data of the GUIDed section specified by InputSection from the end of
+  the previous window up to the offset specified by OutputSize, and places it at the
+  same offset in OutputBuffer. The data decoded by the previous windows must be
+  present in OutputBuffer, because it may be referenced by the data being decoded.
+  The caller may move that data to another OutputBuffer between two windows.
+
+  If InputSection is NULL, then ASSERT().
+  If OutputBuffer is NULL, then ASSERT().
+  If OutputSize is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+
+  @param[in]      InputSection  A pointer to a GUIDed section of an FFS formatted file.
+  @param[in, out] OutputBuffer  A pointer to the buffer that holds the decoded data.
+  @param[in, out] OutputSize    On input, the offset in OutputBuffer at which this window ends.
+                                It is truncated to the size of the decoded data. On output,
+                                the size, in bytes, of the data decoded so far.
+  @param[in]      ScratchBuffer The scratch buffer given to EXTRACT_GUIDED_SECTION_STREAM_INIT_HANDLER.
+
+  @retval  RETURN_SUCCESS            The window was decoded.
+  @retval  RETURN_INVALID_PARAMETER  The section specified by InputSection can not be decoded.
+
+**/
+typedef
+RETURN_STATUS
+(EFIAPI *EXTRACT_GUIDED_SECTION_STREAM_FEED_HANDLER)(
+  IN CONST  VOID    *InputSection,
+  IN OUT    VOID    *OutputBuffer,
+  IN OUT    UINT32  *OutputSize,
+  IN        VOID    *ScratchBuffer
+  );
+
+/**
+  Finishes the incremental decode of a GUIDed section.
+
+  Checks that all the data of the GUIDed section specified by InputSection was decoded,
+  and returns the authentication status of the decode operation in AuthenticationStatus.
+
+  If InputSection is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+  If AuthenticationStatus is NULL, then ASSERT().
+
+  @param[in]  InputSection  A pointer to a GUIDed section of an FFS formatted file.
+  @param[in]  ScratchBuffer The scratch buffer given to EXTRACT_GUIDED_SECTION_STREAM_INIT_HANDLER.
+  @param[out] AuthenticationStatus
+                            A pointer to the authentication status of the decoded output buffer.
+                            See the definition of authentication status in the EFI_PEI_GUIDED_SECTION_EXTRACTION_PPI
+                            section of the PI Specification. EFI_AUTH_STATUS_PLATFORM_OVERRIDE must
+                            never be set by this handler.
+
+  @retval  RETURN_SUCCESS            The section specified by InputSection was completely decoded.
+  @retval  RETURN_INVALID_PARAMETER  The section specified by InputSection can not be decoded,
+                                     or not all of it was decoded.
+
+**/
+typedef
+RETURN_STATUS
+(EFIAPI *EXTRACT_GUIDED_SECTION_STREAM_FINISH_HANDLER)(
+  IN CONST  VOID    *InputSection,
+  IN        VOID    *ScratchBuffer,
+  OUT       UINT32  *AuthenticationStatus
+  );
+
+///
+/// The handlers that decode a GUIDed section incrementally.
+///
+typedef struct {
+  EXTRACT_GUIDED_SECTION_STREAM_INIT_HANDLER    InitHandler;
+  EXTRACT_GUIDED_SECTION_STREAM_FEED_HANDLER    FeedHandler;
+  EXTRACT_GUIDED_SECTION_STREAM_FINISH_HANDLER  FinishHandler;
+} EXTRACT_GUIDED_SECTION_STREAM_HANDLERS;
+
 /**
   Registers handlers of type EXTRACT_GUIDED_SECTION_GET_INFO_HANDLER and EXTRACT_GUIDED_SECTION_DECODE_HANDLER
   for a specific GUID section type.
@@ -281,4 +384,135 @@ ExtractGuidedSectionGetHandlers (
   OUT        EXTRACT_GUIDED_SECTION_DECODE_HANDLER    *DecodeHandler    OPTIONAL
   );
 
+/**
+  Registers the handlers that decode a specific GUID section type incrementally.
+
+  Registers the handlers specified by InitHandler, FeedHandler and FinishHandler with the GUID
+  specified by SectionGuid. The handlers of type EXTRACT_GUIDED_SECTION_GET_INFO_HANDLER and
+  EXTRACT_GUIDED_SECTION_DECODE_HANDLER must have been registered for SectionGuid with
+  ExtractGuidedSectionRegisterHandlers() first. If the incremental handlers have already been
+  registered for SectionGuid, then they are updated.
+
+  If SectionGuid is NULL, then ASSERT().
+  If InitHandler is NULL, then ASSERT().
+  If FeedHandler is NULL, then ASSERT().
+  If FinishHandler is NULL, then ASSERT().
+
+  @param[in]  SectionGuid    A pointer to the GUID associated with the the handlers
+                             of the GUIDed section type being registered.
+  @param[in]  InitHandler    The pointer to a function that starts to decode a GUIDed section.
+  @param[in]  FeedHandler    The pointer to a function that decodes the next window of a GUIDed section.
+  @param[in]  FinishHandler  The pointer to a function that finishes to decode a GUIDed section.
+
+  @retval  RETURN_SUCCESS     The handlers were registered.
+  @retval  RETURN_NOT_FOUND   No handlers have been registered with the specified GUID
+                              through ExtractGuidedSectionRegisterHandlers().
+
+**/
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionRegisterStreamHandlers (
+  IN CONST  GUID                                          *SectionGuid,
+  IN        EXTRACT_GUIDED_SECTION_STREAM_INIT_HANDLER    InitHandler,
+  IN        EXTRACT_GUIDED_SECTION_STREAM_FEED_HANDLER    FeedHandler,
+  IN        EXTRACT_GUIDED_SECTION_STREAM_FINISH_HANDLER  FinishHandler
+  );
+
+/**
+  Retrieves the GUID from a GUIDed section and uses that GUID to select the associated handler of type
+  EXTRACT_GUIDED_SECTION_STREAM_INIT_HANDLER that was registered with ExtractGuidedSectionRegisterStreamHandlers().
+  The selected handler is used to start to decode the GUIDed section incrementally.
+
+  The size of ScratchBuffer is returned by ExtractGuidedSectionGetInfo(). The decoded data is produced
+  by ExtractGuidedSectionStreamFeed(), and the decode operation is completed by ExtractGuidedSectionStreamFinish().
+
+  If InputSection is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+
+  @param[in]  InputSection   A pointer to a GUIDed section of an FFS formatted file.
+  @param[in]  ScratchBuffer  A caller allocated buffer that holds the state of the decode operation until it is finished.
+
+  @retval  RETURN_SUCCESS      The decode operation was started.
+  @retval  RETURN_UNSUPPORTED  The GUID from the section specified by InputSection does not match any of
+                               the GUIDs registered with ExtractGuidedSectionRegisterStreamHandlers().
+  @retval  Others              The return status from the handler associated with the GUID retrieved from
+                               the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionStreamInit (
+  IN  CONST VOID    *InputSection,
+  IN        VOID    *ScratchBuffer
+  );
+
+/**
+  Retrieves the GUID from a GUIDed section and uses that GUID to select the associated handler of type
+  EXTRACT_GUIDED_SECTION_STREAM_FEED_HANDLER that was registered with ExtractGuidedSectionRegisterStreamHandlers().
+  The selected handler is used to decode the next window of the GUIDed section.
+
+  The data of the window ends at the offset specified by OutputSize in OutputBuffer. The data decoded by
+  the previous windows must be present in OutputBuffer, but it may have been moved to another buffer
+  between two windows.
+
+  If InputSection is NULL, then ASSERT().
+  If OutputBuffer is NULL, then ASSERT().
+  If OutputSize is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+
+  @param[in]      InputSection   A pointer to a GUIDed section of an FFS formatted file.
+  @param[in, out] OutputBuffer   A pointer to the buffer that holds the decoded data.
+  @param[in, out] OutputSize     On input, the offset in OutputBuffer at which this window ends. On output,
+                                 the size, in bytes, of the data decoded so far.
+  @param[in]      ScratchBuffer  The scratch buffer given to ExtractGuidedSectionStreamInit().
+
+  @retval  RETURN_SUCCESS      The window was decoded.
+  @retval  RETURN_UNSUPPORTED  The GUID from the section specified by InputSection does not match any of
+                               the GUIDs registered with ExtractGuidedSectionRegisterStreamHandlers().
+  @retval  Others              The return status from the handler associated with the GUID retrieved from
+                               the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionStreamFeed (
+  IN  CONST VOID    *InputSection,
+  IN OUT    VOID    *OutputBuffer,
+  IN OUT    UINT32  *OutputSize,
+  IN        VOID    *ScratchBuffer
+  );
+
+/**
+  Retrieves the GUID from a GUIDed section and uses that GUID to select the associated handler of type
+  EXTRACT_GUIDED_SECTION_STREAM_FINISH_HANDLER that was registered with ExtractGuidedSectionRegisterStreamHandlers().
+  The selected handler is used to complete the incremental decode of the GUIDed section.
+
+  This function is responsible for computing the EFI_AUTH_STATUS_PLATFORM_OVERRIDE bit of in AuthenticationStatus.
+
+  If InputSection is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+  If AuthenticationStatus is NULL, then ASSERT().
+
+  @param[in]  InputSection   A pointer to a GUIDed section of an FFS formatted file.
+  @param[in]  ScratchBuffer  The scratch buffer given to ExtractGuidedSectionStreamInit().
+  @param[out] AuthenticationStatus
+                             A pointer to the authentication status of the decoded output buffer. See the definition
+                             of authentication status in the EFI_PEI_GUIDED_SECTION_EXTRACTION_PPI section of the PI
+                             Specification.
+
+  @retval  RETURN_SUCCESS      The section specified by InputSection was completely decoded.
+  @retval  RETURN_UNSUPPORTED  The GUID from the section specified by InputSection does not match any of
+                               the GUIDs registered with ExtractGuidedSectionRegisterStreamHandlers().
+  @retval  Others              The return status from the handler associated with the GUID retrieved from
+                               the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionStreamFinish (
+  IN  CONST VOID    *InputSection,
+  IN        VOID    *ScratchBuffer,
+  OUT       UINT32  *AuthenticationStatus
+  );
+
 #endif
@@ -27,6 +27,7 @@ typedef struct {
   GUID                                    *ExtractHandlerGuidTable;
   EXTRACT_GUIDED_SECTION_DECODE_HANDLER   *ExtractDecodeHandlerTable;
   EXTRACT_GUIDED_SECTION_GET_INFO_HANDLER *ExtractGetInfoHandlerTable;
+  EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  *ExtractStreamHandlerTable;
 } EXTRACT_GUIDED_SECTION_HANDLER_INFO;
 
 /**
@@ -92,6 +93,11 @@ GetExtractGuidedSectionHandlerInfo (
                                               PcdGet32 (PcdMaximumGuidedExtractHandler) * 
                                               sizeof (EXTRACT_GUIDED_SECTION_DECODE_HANDLER)
                                              );
+  HandlerInfo->ExtractStreamHandlerTable  = (EXTRACT_GUIDED_SECTION_STREAM_HANDLERS *) (
+                                              (UINT8 *)HandlerInfo->ExtractGetInfoHandlerTable + 
+                                              PcdGet32 (PcdMaximumGuidedExtractHandler) * 
+                                              sizeof (EXTRACT_GUIDED_SECTION_GET_INFO_HANDLER)
+                                             );
   *InfoPointer = HandlerInfo;
   return RETURN_SUCCESS;
 }
@@ -216,6 +222,7 @@ ExtractGuidedSectionRegisterHandlers (
   //
   CopyGuid (HandlerInfo->ExtractHandlerGuidTable + HandlerInfo->NumberOfExtractHandler, SectionGuid);
   HandlerInfo->ExtractDecodeHandlerTable [HandlerInfo->NumberOfExtractHandler] = DecodeHandler;
+  ZeroMem (&HandlerInfo->ExtractStreamHandlerTable [HandlerInfo->NumberOfExtractHandler], sizeof (EXTRACT_GUIDED_SECTION_STREAM_HANDLERS));
   HandlerInfo->ExtractGetInfoHandlerTable [HandlerInfo->NumberOfExtractHandler++] = GetInfoHandler;
 
   return RETURN_SUCCESS;
@@ -482,3 +489,270 @@ ExtractGuidedSectionGetHandlers (
   }
   return RETURN_NOT_FOUND;
 }
+
+/**
+  Registers the handlers that decode a specific GUID section type incrementally.
+
+  Registers the handlers specified by InitHandler, FeedHandler and FinishHandler with the GUID
+  specified by SectionGuid. The handlers of type EXTRACT_GUIDED_SECTION_GET_INFO_HANDLER and
+  EXTRACT_GUIDED_SECTION_DECODE_HANDLER must have been registered for SectionGuid with
+  ExtractGuidedSectionRegisterHandlers() first. If the incremental handlers have already been
+  registered for SectionGuid, then they are updated.
+
+  If SectionGuid is NULL, then ASSERT().
+  If InitHandler is NULL, then ASSERT().
+  If FeedHandler is NULL, then ASSERT().
+  If FinishHandler is NULL, then ASSERT().
+
+  @param[in]  SectionGuid    A pointer to the GUID associated with the the handlers
+                             of the GUIDed section type being registered.
+  @param[in]  InitHandler    The pointer to a function that starts to decode a GUIDed section.
+  @param[in]  FeedHandler    The pointer to a function that decodes the next window of a GUIDed section.
+  @param[in]  FinishHandler  The pointer to a function that finishes to decode a GUIDed section.
+
+  @retval  RETURN_SUCCESS     The handlers were registered.
+  @retval  RETURN_NOT_FOUND   No handlers have been registered with the specified GUID
+                              through ExtractGuidedSectionRegisterHandlers().
+
+**/
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionRegisterStreamHandlers (
+  IN CONST  GUID                                          *SectionGuid,
+  IN        EXTRACT_GUIDED_SECTION_STREAM_INIT_HANDLER    InitHandler,
+  IN        EXTRACT_GUIDED_SECTION_STREAM_FEED_HANDLER    FeedHandler,
+  IN        EXTRACT_GUIDED_SECTION_STREAM_FINISH_HANDLER  FinishHandler
+  )
+{
+  RETURN_STATUS                            Status;
+  UINT32                                   Index;
+  EXTRACT_GUIDED_SECTION_HANDLER_INFO      *HandlerInfo;
+
+  //
+  // Check input parameter
+  //
+  ASSERT (SectionGuid != NULL);
+  ASSERT (InitHandler != NULL);
+  ASSERT (FeedHandler != NULL);
+  ASSERT (FinishHandler != NULL);
+
+  //
+  // Get the registered handler information
+  //
+  Status = GetExtractGuidedSectionHandlerInfo (&HandlerInfo);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Search the match registered handler for the input guided section.
+  //
+  ASSERT (HandlerInfo != NULL);
+  for (Index = 0; Index < HandlerInfo->NumberOfExtractHandler; Index ++) {
+    if (CompareGuid (HandlerInfo->ExtractHandlerGuidTable + Index, SectionGuid)) {
+      HandlerInfo->ExtractStreamHandlerTable[Index].InitHandler   = InitHandler;
+      HandlerInfo->ExtractStreamHandlerTable[Index].FeedHandler   = FeedHandler;
+      HandlerInfo->ExtractStreamHandlerTable[Index].FinishHandler = FinishHandler;
+      return RETURN_SUCCESS;
+    }
+  }
+  return RETURN_NOT_FOUND;
+}
+
+/**
+  Retrieves the handlers that decode a GUIDed section incrementally, which were registered
+  with ExtractGuidedSectionRegisterStreamHandlers() for the GUID of the section.
+
+  @param[in]  InputSection    A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] StreamHandlers  A pointer to the handlers registered for the GUID of InputSection.
+
+  @retval  RETURN_SUCCESS      The handlers were retrieved.
+  @retval  RETURN_UNSUPPORTED  No incremental handlers have been registered for the GUID of InputSection.
+  @retval  Others              The registered handler information can not be retrieved.
+
+**/
+RETURN_STATUS
+GetExtractGuidedSectionStreamHandlers (
+  IN  CONST VOID                              *InputSection,
+  OUT EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  **StreamHandlers
+  )
+{
+  RETURN_STATUS                            Status;
+  UINT32                                   Index;
+  EXTRACT_GUIDED_SECTION_HANDLER_INFO      *HandlerInfo;
+  EFI_GUID                                 *SectionDefinitionGuid;
+
+  ASSERT (InputSection != NULL);
+
+  //
+  // Get all registered handler information.
+  //
+  Status = GetExtractGuidedSectionHandlerInfo (&HandlerInfo);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  if (IS_SECTION2 (InputSection)) {
+    SectionDefinitionGuid = &(((EFI_GUID_DEFINED_SECTION2 *) InputSection)->SectionDefinitionGuid);
+  } else {
+    SectionDefinitionGuid = &(((EFI_GUID_DEFINED_SECTION *) InputSection)->SectionDefinitionGuid);
+  }
+
+  //
+  // Search the match registered handler for the input guided section.
+  //
+  ASSERT (HandlerInfo != NULL);
+  for (Index = 0; Index < HandlerInfo->NumberOfExtractHandler; Index ++) {
+    if (CompareGuid (HandlerInfo->ExtractHandlerGuidTable + Index, SectionDefinitionGuid)) {
+      if (HandlerInfo->ExtractStreamHandlerTable[Index].InitHandler == NULL) {
+        break;
+      }
+      *StreamHandlers = &HandlerInfo->ExtractStreamHandlerTable[Index];
+      return RETURN_SUCCESS;
+    }
+  }
+
+  //
+  // Not found, the input guided section can not be decoded incrementally.
+  //
+  return RETURN_UNSUPPORTED;
+}
+
+/**
+  Retrieves the GUID from a GUIDed section and uses that GUID to select the associated handler of type
+  EXTRACT_GUIDED_SECTION_STREAM_INIT_HANDLER that was registered with ExtractGuidedSectionRegisterStreamHandlers().
+  The selected handler is used to start to decode the GUIDed section incrementally.
+
+  The size of ScratchBuffer is returned by ExtractGuidedSectionGetInfo(). The decoded data is produced
+  by ExtractGuidedSectionStreamFeed(), and the decode operation is completed by ExtractGuidedSectionStreamFinish().
+
+  If InputSection is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+
+  @param[in]  InputSection   A pointer to a GUIDed section of an FFS formatted file.
+  @param[in]  ScratchBuffer  A caller allocated buffer that holds the state of the decode operation until it is finished.
+
+  @retval  RETURN_SUCCESS      The decode operation was started.
+  @retval  RETURN_UNSUPPORTED  The GUID from the section specified by InputSection does not match any of
+                               the GUIDs registered with ExtractGuidedSectionRegisterStreamHandlers().
+  @retval  Others              The return status from the handler associated with the GUID retrieved from
+                               the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionStreamInit (
+  IN  CONST VOID    *InputSection,
+  IN        VOID    *ScratchBuffer
+  )
+{
+  RETURN_STATUS                           Status;
+  EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  *StreamHandlers;
+
+  ASSERT (ScratchBuffer != NULL);
+
+  Status = GetExtractGuidedSectionStreamHandlers (InputSection, &StreamHandlers);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  return StreamHandlers->InitHandler (InputSection, ScratchBuffer);
+}
+
+/**
+  Retrieves the GUID from a GUIDed section and uses that GUID to select the associated handler of type
+  EXTRACT_GUIDED_SECTION_STREAM_FEED_HANDLER that was registered with ExtractGuidedSectionRegisterStreamHandlers().
+  The selected handler is used to decode the next window of the GUIDed section.
+
+  The data of the window ends at the offset specified by OutputSize in OutputBuffer. The data decoded by
+  the previous windows must be present in OutputBuffer, but it may have been moved to another buffer
+  between two windows.
+
+  If InputSection is NULL, then ASSERT().
+  If OutputBuffer is NULL, then ASSERT().
+  If OutputSize is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+
+  @param[in]      InputSection   A pointer to a GUIDed section of an FFS formatted file.
+  @param[in, out] OutputBuffer   A pointer to the buffer that holds the decoded data.
+  @param[in, out] OutputSize     On input, the offset in OutputBuffer at which this window ends. On output,
+                                 the size, in bytes, of the data decoded so far.
+  @param[in]      ScratchBuffer  The scratch buffer given to ExtractGuidedSectionStreamInit().
+
+  @retval  RETURN_SUCCESS      The window was decoded.
+  @retval  RETURN_UNSUPPORTED  The GUID from the section specified by InputSection does not match any of
+                               the GUIDs registered with ExtractGuidedSectionRegisterStreamHandlers().
+  @retval  Others              The return status from the handler associated with the GUID retrieved from
+                               the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionStreamFeed (
+  IN  CONST VOID    *InputSection,
+  IN OUT    VOID    *OutputBuffer,
+  IN OUT    UINT32  *OutputSize,
+  IN        VOID    *ScratchBuffer
+  )
+{
+  RETURN_STATUS                           Status;
+  EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  *StreamHandlers;
+
+  ASSERT (OutputBuffer != NULL);
+  ASSERT (OutputSize != NULL);
+  ASSERT (ScratchBuffer != NULL);
+
+  Status = GetExtractGuidedSectionStreamHandlers (InputSection, &StreamHandlers);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  return StreamHandlers->FeedHandler (InputSection, OutputBuffer, OutputSize, ScratchBuffer);
+}
+
+/**
+  Retrieves the GUID from a GUIDed section and uses that GUID to select the associated handler of type
+  EXTRACT_GUIDED_SECTION_STREAM_FINISH_HANDLER that was registered with ExtractGuidedSectionRegisterStreamHandlers().
+  The selected handler is used to complete the incremental decode of the GUIDed section.
+
+  This function is responsible for computing the EFI_AUTH_STATUS_PLATFORM_OVERRIDE bit of in AuthenticationStatus.
+
+  If InputSection is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+  If AuthenticationStatus is NULL, then ASSERT().
+
+  @param[in]  InputSection   A pointer to a GUIDed section of an FFS formatted file.
+  @param[in]  ScratchBuffer  The scratch buffer given to ExtractGuidedSectionStreamInit().
+  @param[out] AuthenticationStatus
+                             A pointer to the authentication status of the decoded output buffer. See the definition
+                             of authentication status in the EFI_PEI_GUIDED_SECTION_EXTRACTION_PPI section of the PI
+                             Specification.
+
+  @retval  RETURN_SUCCESS      The section specified by InputSection was completely decoded.
+  @retval  RETURN_UNSUPPORTED  The GUID from the section specified by InputSection does not match any of
+                               the GUIDs registered with ExtractGuidedSectionRegisterStreamHandlers().
+  @retval  Others              The return status from the handler associated with the GUID retrieved from
+                               the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionStreamFinish (
+  IN  CONST VOID    *InputSection,
+  IN        VOID    *ScratchBuffer,
+  OUT       UINT32  *AuthenticationStatus
+  )
+{
+  RETURN_STATUS                           Status;
+  EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  *StreamHandlers;
+
+  ASSERT (ScratchBuffer != NULL);
+  ASSERT (AuthenticationStatus != NULL);
+
+  Status = GetExtractGuidedSectionStreamHandlers (InputSection, &StreamHandlers);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  return StreamHandlers->FinishHandler (InputSection, ScratchBuffer, AuthenticationStatus);
+}
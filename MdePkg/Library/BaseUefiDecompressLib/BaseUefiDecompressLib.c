@@ -26,6 +26,8 @@
   Read NumOfBit of bits from source into mBitBuf.
 
   Shift mBitBuf NumOfBits left. Read in NumOfBits of bits from source.
+  mSubBitBuf is refilled with whole bytes up to its full width, so that on 64-bit
+  processors it is only refilled every few codes.
 
   @param  Sd        The global scratch data.
   @param  NumOfBits The number of bits to shift and read.
@@ -37,45 +39,37 @@ FillBuf (
   IN  UINT16        NumOfBits
   )
 {
-  //
-  // Left shift NumOfBits of bits in advance
-  //
-  Sd->mBitBuf = (UINT32) (Sd->mBitBuf << NumOfBits);
-
-  //
-  // Copy data needed in bytes into mSbuBitBuf
-  //
-  while (NumOfBits > Sd->mBitCount) {
-
-    Sd->mBitBuf |= (UINT32) (Sd->mSubBitBuf << (NumOfBits = (UINT16) (NumOfBits - Sd->mBitCount)));
-
-    if (Sd->mCompSize > 0) {
-      //
-      // Get 1 byte into SubBitBuf
-      //
-      Sd->mCompSize--;
-      Sd->mSubBitBuf  = Sd->mSrcBase[Sd->mInBuf++];
-      Sd->mBitCount   = 8;
+  UINT16  Bits;
 
-    } else {
+  while (NumOfBits > 0) {
+    if (Sd->mBitCount < 16) {
       //
-      // No more bits from the source, just pad zero bit.
+      // Copy data needed in bytes into mSubBitBuf
       //
-      Sd->mSubBitBuf  = 0;
-      Sd->mBitCount   = 8;
-
+      while (Sd->mBitCount <= SUBBITBUFSIZ - 8) {
+        if (Sd->mCompSize > 0) {
+          //
+          // Get 1 byte into SubBitBuf
+          //
+          Sd->mCompSize--;
+          Sd->mSubBitBuf |= (UINTN) Sd->mSrcBase[Sd->mInBuf++] << (SUBBITBUFSIZ - 8 - Sd->mBitCount);
+        }
+        //
+        // No more bits from the source, just pad zero bit.
+        //
+        Sd->mBitCount = (UINT16) (Sd->mBitCount + 8);
+      }
     }
-  }
 
-  //
-  // Caculate additional bit count read to update mBitCount
-  //
-  Sd->mBitCount = (UINT16) (Sd->mBitCount - NumOfBits);
-  
-  //
-  // Copy NumOfBits of bits from mSubBitBuf into mBitBuf
-  //
-  Sd->mBitBuf |= Sd->mSubBitBuf >> Sd->mBitCount;
+    //
+    // Move at most 16 bits from mSubBitBuf into mBitBuf
+    //
+    Bits           = MIN (NumOfBits, 16);
+    Sd->mBitBuf    = (Sd->mBitBuf << Bits) | (UINT32) (Sd->mSubBitBuf >> (SUBBITBUFSIZ - Bits));
+    Sd->mSubBitBuf = Sd->mSubBitBuf << Bits;
+    Sd->mBitCount  = (UINT16) (Sd->mBitCount - Bits);
+    NumOfBits      = (UINT16) (NumOfBits - Bits);
+  }
 }
 
 /**
@@ -257,54 +251,6 @@ MakeTable (
   return 0;
 }
 
-/**
-  Decodes a position value.
-
-  Get a position value according to Position Huffman Table.
-
-  @param  Sd The global scratch data.
-
-  @return The position value decoded.
-
-**/
-UINT32
-DecodeP (
-  IN  SCRATCH_DATA  *Sd
-  )
-{
-  UINT16  Val;
-  UINT32  Mask;
-  UINT32  Pos;
-
-  Val = Sd->mPTTable[Sd->mBitBuf >> (BITBUFSIZ - 8)];
-
-  if (Val >= MAXNP) {
-    Mask = 1U << (BITBUFSIZ - 1 - 8);
-
-    do {
-
-      if ((Sd->mBitBuf & Mask) != 0) {
-        Val = Sd->mRight[Val];
-      } else {
-        Val = Sd->mLeft[Val];
-      }
-
-      Mask >>= 1;
-    } while (Val >= MAXNP);
-  }
-  //
-  // Advance what we have read
-  //
-  FillBuf (Sd, Sd->mPTLen[Val]);
-
-  Pos = Val;
-  if (Val > 1) {
-    Pos = (UINT32) ((1U << (Val - 1)) + GetBits (Sd, (UINT16) (Val - 1)));
-  }
-
-  return Pos;
-}
-
 /**
   Reads code lengths for the Extra Set or the Position Set.
 
@@ -481,87 +427,88 @@ ReadCLen (
 }
 
 /**
-  Decode a character/length value.
+  Reads a block header.
 
-  Read one value from mBitBuf, Get one code from mBitBuf. If it is at block boundary, generates
-  Huffman code mapping table for Extra Set, Code&Len Set and
-  Position Set.
+  Read in the Block Size, then the code length arrays of the Extra Set,
+  the Char&Len Set and the Position Set, and generate their Huffman code
+  mapping tables.
 
   @param  Sd The global scratch data.
 
-  @return The value decoded.
+  @retval  0 OK.
+  @retval  BAD_TABLE A table is corrupted.
 
 **/
 UINT16
-DecodeC (
+ReadBlockHeader (
   SCRATCH_DATA  *Sd
   )
 {
-  UINT16  Index2;
-  UINT32  Mask;
-
-  if (Sd->mBlockSize == 0) {
-    //
-    // Starting a new block
-    // Read BlockSize from block header
-    // 
-    Sd->mBlockSize    = (UINT16) GetBits (Sd, 16);
-
-    //
-    // Read in the Extra Set Code Length Arrary,
-    // Generate the Huffman code mapping table for Extra Set.
-    //
-    Sd->mBadTableFlag = ReadPTLen (Sd, NT, TBIT, 3);
-    if (Sd->mBadTableFlag != 0) {
-      return 0;
-    }
-
-    //
-    // Read in and decode the Char&Len Set Code Length Arrary,
-    // Generate the Huffman code mapping table for Char&Len Set.
-    //
-    ReadCLen (Sd);
+  //
+  // Read BlockSize from block header
+  // 
+  Sd->mBlockSize = (UINT16) GetBits (Sd, 16);
 
-    //
-    // Read in the Position Set Code Length Arrary, 
-    // Generate the Huffman code mapping table for the Position Set.
-    //
-    Sd->mBadTableFlag = ReadPTLen (Sd, MAXNP, Sd->mPBit, (UINT16) (-1));
-    if (Sd->mBadTableFlag != 0) {
-      return 0;
-    }
+  //
+  // Read in the Extra Set Code Length Arrary,
+  // Generate the Huffman code mapping table for Extra Set.
+  //
+  Sd->mBadTableFlag = ReadPTLen (Sd, NT, TBIT, 3);
+  if (Sd->mBadTableFlag != 0) {
+    return Sd->mBadTableFlag;
   }
 
   //
-  // Get one code according to Code&Set Huffman Table
+  // Read in and decode the Char&Len Set Code Length Arrary,
+  // Generate the Huffman code mapping table for Char&Len Set.
   //
-  Sd->mBlockSize--;
-  Index2 = Sd->mCTable[Sd->mBitBuf >> (BITBUFSIZ - 12)];
-
-  if (Index2 >= NC) {
-    Mask = 1U << (BITBUFSIZ - 1 - 12);
-
-    do {
-      if ((Sd->mBitBuf & Mask) != 0) {
-        Index2 = Sd->mRight[Index2];
-      } else {
-        Index2 = Sd->mLeft[Index2];
-      }
+  ReadCLen (Sd);
 
-      Mask >>= 1;
-    } while (Index2 >= NC);
-  }
   //
-  // Advance what we have read
+  // Read in the Position Set Code Length Arrary, 
+  // Generate the Huffman code mapping table for the Position Set.
   //
-  FillBuf (Sd, Sd->mCLen[Index2]);
+  Sd->mBadTableFlag = ReadPTLen (Sd, MAXNP, Sd->mPBit, (UINT16) (-1));
+  if (Sd->mBadTableFlag != 0) {
+    return Sd->mBadTableFlag;
+  }
 
-  return Index2;
+  return 0;
 }
 
+//
+// Decode() keeps the bit buffer in local variables. DECODE_FILL_BITS() tops up
+// SubBitBuf like FillBuf() does, and DECODE_SKIP_BITS() is FillBuf() for at most
+// 16 bits once DECODE_FILL_BITS() is done.
+//
+#define DECODE_FILL_BITS() \
+  do { \
+    if (BitCount < 16) { \
+      while (BitCount <= SUBBITBUFSIZ - 8) { \
+        if (CompSize > 0) { \
+          CompSize--; \
+          SubBitBuf |= (UINTN) Src[InBuf++] << (SUBBITBUFSIZ - 8 - BitCount); \
+        } \
+        BitCount += 8; \
+      } \
+    } \
+  } while (FALSE)
+
+#define DECODE_SKIP_BITS(NumOfBits) \
+  do { \
+    BitBuf    = (BitBuf << (NumOfBits)) | (UINT32) ((SubBitBuf >> 1) >> (SUBBITBUFSIZ - 1 - (NumOfBits))); \
+    SubBitBuf = SubBitBuf << (NumOfBits); \
+    BitCount  = BitCount - (NumOfBits); \
+  } while (FALSE)
+
 /**
   Decode the source data and put the resulting data into the destination buffer.
 
+  The bit buffer and the position in the source and destination buffers are
+  kept in local variables while the codes of a block are decoded, so that they
+  can stay in registers. They are copied to the scratch data to read a block
+  header.
+
   @param  Sd The global scratch data.
 
 **/
@@ -570,68 +517,171 @@ Decode (
   SCRATCH_DATA  *Sd
   )
 {
-  UINT16  BytesRemain;
-  UINT32  DataIdx;
-  UINT16  CharC;
+  CONST UINT8  *Src;
+  UINT8        *Dst;
+  UINT32       InBuf;
+  UINT32       CompSize;
+  UINT32       OutBuf;
+  UINT32       OrigSize;
+  UINT32       BitBuf;
+  UINTN        SubBitBuf;
+  UINTN        BitCount;
+  UINT16       BlockSize;
+  UINT16       BytesRemain;
+  UINT16       Bits;
+  UINT16       CharC;
+  UINT16       Val;
+  UINT32       Mask;
+  UINT32       Pos;
+  UINT32       DataIdx;
+
+  Src       = Sd->mSrcBase;
+  Dst       = Sd->mDstBase;
+  OrigSize  = Sd->mOrigSize;
+  OutBuf    = Sd->mOutBuf;
+  BlockSize = Sd->mBlockSize;
+
+  BitBuf    = Sd->mBitBuf;
+  SubBitBuf = Sd->mSubBitBuf;
+  BitCount  = Sd->mBitCount;
+  InBuf     = Sd->mInBuf;
+  CompSize  = Sd->mCompSize;
 
-  BytesRemain = (UINT16) (-1);
+  for (;;) {
+    if (BlockSize == 0) {
+      //
+      // Starting a new block
+      //
+      Sd->mBitBuf    = BitBuf;
+      Sd->mSubBitBuf = SubBitBuf;
+      Sd->mBitCount  = (UINT16) BitCount;
+      Sd->mInBuf     = InBuf;
+      Sd->mCompSize  = CompSize;
 
-  DataIdx     = 0;
+      if (ReadBlockHeader (Sd) != 0) {
+        goto Done;
+      }
 
-  for (;;) {
+      BlockSize = Sd->mBlockSize;
+      BitBuf    = Sd->mBitBuf;
+      SubBitBuf = Sd->mSubBitBuf;
+      BitCount  = Sd->mBitCount;
+      InBuf     = Sd->mInBuf;
+      CompSize  = Sd->mCompSize;
+    }
+
+    //
+    // Get one code according to Code&Set Huffman Table
     //
-    // Get one code from mBitBuf
-    // 
-    CharC = DecodeC (Sd);
-    if (Sd->mBadTableFlag != 0) {
-      goto Done;
+    BlockSize--;
+    DECODE_FILL_BITS ();
+    CharC = Sd->mCTable[BitBuf >> (BITBUFSIZ - 12)];
+
+    if (CharC >= NC) {
+      Mask = 1U << (BITBUFSIZ - 1 - 12);
+
+      do {
+        if ((BitBuf & Mask) != 0) {
+          CharC = Sd->mRight[CharC];
+        } else {
+          CharC = Sd->mLeft[CharC];
+        }
+
+        Mask >>= 1;
+      } while (CharC >= NC);
     }
 
+    //
+    // Advance what we have read
+    //
+    DECODE_SKIP_BITS (Sd->mCLen[CharC]);
+
     if (CharC < 256) {
       //
       // Process an Original character
       //
-      if (Sd->mOutBuf >= Sd->mOrigSize) {
+      if (OutBuf >= OrigSize) {
         goto Done;
-      } else {
-        //
-        // Write orignal character into mDstBase
-        //
-        Sd->mDstBase[Sd->mOutBuf++] = (UINT8) CharC;
       }
 
-    } else {
-      //
-      // Process a Pointer
       //
-      CharC       = (UINT16) (CharC - (BIT8 - THRESHOLD));
- 
-      //
-      // Get string length
+      // Write orignal character into mDstBase
       //
-      BytesRemain = CharC;
+      Dst[OutBuf++] = (UINT8) CharC;
+      continue;
+    }
 
-      //
-      // Locate string position
-      //
-      DataIdx     = Sd->mOutBuf - DecodeP (Sd) - 1;
+    //
+    // Process a Pointer, get string length
+    //
+    BytesRemain = (UINT16) (CharC - (BIT8 - THRESHOLD));
 
-      //
-      // Write BytesRemain of bytes into mDstBase
-      //
-      BytesRemain--;
-      while ((INT16) (BytesRemain) >= 0) {
-        Sd->mDstBase[Sd->mOutBuf++] = Sd->mDstBase[DataIdx++];
-        if (Sd->mOutBuf >= Sd->mOrigSize) {
-          goto Done;
+    //
+    // Decode a position value according to Position Huffman Table
+    //
+    DECODE_FILL_BITS ();
+    Val = Sd->mPTTable[BitBuf >> (BITBUFSIZ - 8)];
+
+    if (Val >= MAXNP) {
+      Mask = 1U << (BITBUFSIZ - 1 - 8);
+
+      do {
+        if ((BitBuf & Mask) != 0) {
+          Val = Sd->mRight[Val];
+        } else {
+          Val = Sd->mLeft[Val];
         }
 
-        BytesRemain--;
+        Mask >>= 1;
+      } while (Val >= MAXNP);
+    }
+
+    //
+    // The code lengths and the extra bits of the Position Set are only longer
+    // than 16 bits in corrupted data.
+    //
+    Bits = Sd->mPTLen[Val];
+    while (Bits > 16) {
+      DECODE_SKIP_BITS (16);
+      DECODE_FILL_BITS ();
+      Bits = (UINT16) (Bits - 16);
+    }
+    DECODE_SKIP_BITS (Bits);
+
+    Pos = Val;
+    if (Val > 1) {
+      Bits = (UINT16) (Val - 1);
+      Pos  = (1U << Bits) + (BitBuf >> (BITBUFSIZ - Bits));
+      DECODE_FILL_BITS ();
+      while (Bits > 16) {
+        DECODE_SKIP_BITS (16);
+        DECODE_FILL_BITS ();
+        Bits = (UINT16) (Bits - 16);
       }
+      DECODE_SKIP_BITS (Bits);
     }
+
+    //
+    // Locate string position
+    //
+    DataIdx = OutBuf - Pos - 1;
+
+    //
+    // Write BytesRemain of bytes into mDstBase
+    //
+    do {
+      Dst[OutBuf++] = Dst[DataIdx++];
+      if (OutBuf >= OrigSize) {
+        goto Done;
+      }
+
+      BytesRemain--;
+    } while (BytesRemain != 0);
   }
 
 Done:
+  Sd->mOutBuf    = OutBuf;
+  Sd->mBlockSize = BlockSize;
   return ;
 }
 
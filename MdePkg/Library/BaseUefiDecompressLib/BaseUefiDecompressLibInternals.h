@@ -39,15 +39,20 @@
 #define NPT MAXNP
 #endif
 
+//
+// The width of mSubBitBuf, which holds the bits that follow mBitBuf
+//
+#define SUBBITBUFSIZ  (sizeof (UINTN) * 8)
+
 typedef struct {
   UINT8   *mSrcBase;  // The starting address of compressed data
   UINT8   *mDstBase;  // The starting address of decompressed data
   UINT32  mOutBuf;
   UINT32  mInBuf;
 
-  UINT16  mBitCount;
+  UINT16  mBitCount;   // The number of bits left in mSubBitBuf
   UINT32  mBitBuf;
-  UINT32  mSubBitBuf;
+  UINTN   mSubBitBuf;  // The bits that follow mBitBuf, left aligned
   UINT16  mBlockSize;
   UINT32  mCompSize;
   UINT32  mOrigSize;
@@ -128,21 +133,6 @@ MakeTable (
   OUT UINT16        *Table
   );
 
-/**
-  Decodes a position value.
-
-  Get a position value according to Position Huffman Table.
-
-  @param  Sd The global scratch data.
-
-  @return The position value decoded.
-
-**/
-UINT32
-DecodeP (
-  IN  SCRATCH_DATA  *Sd
-  );
-
 /**
   Reads code lengths for the Extra Set or the Position Set.
 
@@ -181,19 +171,20 @@ ReadCLen (
   );
 
 /**
-  Decode a character/length value.
+  Reads a block header.
 
-  Read one value from mBitBuf, Get one code from mBitBuf. If it is at block boundary, generates
-  Huffman code mapping table for Extra Set, Code&Len Set and
-  Position Set.
+  Read in the Block Size, then the code length arrays of the Extra Set,
+  the Char&Len Set and the Position Set, and generate their Huffman code
+  mapping tables.
 
   @param  Sd The global scratch data.
 
-  @return The value decoded.
+  @retval  0 OK.
+  @retval  BAD_TABLE A table is corrupted.
 
 **/
 UINT16
-DecodeC (
+ReadBlockHeader (
   SCRATCH_DATA  *Sd
   );
 
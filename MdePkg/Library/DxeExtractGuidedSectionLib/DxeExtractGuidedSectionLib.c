@@ -28,6 +28,7 @@ UINT32               mMaxNumberOfExtractHandler = 0;
 GUID                 *mExtractHandlerGuidTable = NULL;
 EXTRACT_GUIDED_SECTION_DECODE_HANDLER   *mExtractDecodeHandlerTable = NULL;
 EXTRACT_GUIDED_SECTION_GET_INFO_HANDLER *mExtractGetInfoHandlerTable = NULL;
+EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  *mExtractStreamHandlerTable = NULL;
 
 /**
   Reallocates more global memory to store the registered guid and Handler list.
@@ -78,6 +79,19 @@ ReallocateExtractHandlerTable (
   if (mExtractGetInfoHandlerTable == NULL) {
     goto Done;
   }
+
+  //
+  // Reallocate memory for the incremental decode handler Table
+  //
+  mExtractStreamHandlerTable = ReallocatePool (
+                               mMaxNumberOfExtractHandler * sizeof (EXTRACT_GUIDED_SECTION_STREAM_HANDLERS), 
+                               (mMaxNumberOfExtractHandler + EXTRACT_HANDLER_TABLE_SIZE) * sizeof (EXTRACT_GUIDED_SECTION_STREAM_HANDLERS), 
+                               mExtractStreamHandlerTable
+                             );
+
+  if (mExtractStreamHandlerTable == NULL) {
+    goto Done;
+  }
   
   //
   // Increase max handler number
@@ -95,6 +109,9 @@ Done:
   if (mExtractGetInfoHandlerTable != NULL) {
     FreePool (mExtractGetInfoHandlerTable);
   }
+  if (mExtractStreamHandlerTable != NULL) {
+    FreePool (mExtractStreamHandlerTable);
+  }
   
   return RETURN_OUT_OF_RESOURCES;
 }
@@ -213,6 +230,7 @@ ExtractGuidedSectionRegisterHandlers (
   //
   CopyGuid (&mExtractHandlerGuidTable [mNumberOfExtractHandler], SectionGuid);
   mExtractDecodeHandlerTable [mNumberOfExtractHandler] = DecodeHandler;
+  ZeroMem (&mExtractStreamHandlerTable [mNumberOfExtractHandler], sizeof (EXTRACT_GUIDED_SECTION_STREAM_HANDLERS));
   mExtractGetInfoHandlerTable [mNumberOfExtractHandler++] = GetInfoHandler;
 
   //
@@ -452,3 +470,247 @@ ExtractGuidedSectionGetHandlers (
   }
   return RETURN_NOT_FOUND;
 }
+
+/**
+  Registers the handlers that decode a specific GUID section type incrementally.
+
+  Registers the handlers specified by InitHandler, FeedHandler and FinishHandler with the GUID
+  specified by SectionGuid. The handlers of type EXTRACT_GUIDED_SECTION_GET_INFO_HANDLER and
+  EXTRACT_GUIDED_SECTION_DECODE_HANDLER must have been registered for SectionGuid with
+  ExtractGuidedSectionRegisterHandlers() first. If the incremental handlers have already been
+  registered for SectionGuid, then they are updated.
+
+  If SectionGuid is NULL, then ASSERT().
+  If InitHandler is NULL, then ASSERT().
+  If FeedHandler is NULL, then ASSERT().
+  If FinishHandler is NULL, then ASSERT().
+
+  @param[in]  SectionGuid    A pointer to the GUID associated with the the handlers
+                             of the GUIDed section type being registered.
+  @param[in]  InitHandler    The pointer to a function that starts to decode a GUIDed section.
+  @param[in]  FeedHandler    The pointer to a function that decodes the next window of a GUIDed section.
+  @param[in]  FinishHandler  The pointer to a function that finishes to decode a GUIDed section.
+
+  @retval  RETURN_SUCCESS     The handlers were registered.
+  @retval  RETURN_NOT_FOUND   No handlers have been registered with the specified GUID
+                              through ExtractGuidedSectionRegisterHandlers().
+
+**/
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionRegisterStreamHandlers (
+  IN CONST  GUID                                          *SectionGuid,
+  IN        EXTRACT_GUIDED_SECTION_STREAM_INIT_HANDLER    InitHandler,
+  IN        EXTRACT_GUIDED_SECTION_STREAM_FEED_HANDLER    FeedHandler,
+  IN        EXTRACT_GUIDED_SECTION_STREAM_FINISH_HANDLER  FinishHandler
+  )
+{
+  UINT32 Index;
+
+  //
+  // Check input paramter.
+  //
+  ASSERT (SectionGuid != NULL);
+  ASSERT (InitHandler != NULL);
+  ASSERT (FeedHandler != NULL);
+  ASSERT (FinishHandler != NULL);
+
+  //
+  // Search the match registered handler for the input guided section.
+  //
+  for (Index = 0; Index < mNumberOfExtractHandler; Index ++) {
+    if (CompareGuid (&mExtractHandlerGuidTable[Index], SectionGuid)) {
+      mExtractStreamHandlerTable[Index].InitHandler   = InitHandler;
+      mExtractStreamHandlerTable[Index].FeedHandler   = FeedHandler;
+      mExtractStreamHandlerTable[Index].FinishHandler = FinishHandler;
+      return RETURN_SUCCESS;
+    }
+  }
+  return RETURN_NOT_FOUND;
+}
+
+/**
+  Retrieves the handlers that decode a GUIDed section incrementally, which were registered
+  with ExtractGuidedSectionRegisterStreamHandlers() for the GUID of the section.
+
+  @param[in]  InputSection    A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] StreamHandlers  A pointer to the handlers registered for the GUID of InputSection.
+
+  @retval  RETURN_SUCCESS      The handlers were retrieved.
+  @retval  RETURN_UNSUPPORTED  No incremental handlers have been registered for the GUID of InputSection.
+
+**/
+RETURN_STATUS
+DxeGetExtractGuidedSectionStreamHandlers (
+  IN  CONST VOID                              *InputSection,
+  OUT EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  **StreamHandlers
+  )
+{
+  UINT32     Index;
+  EFI_GUID   *SectionDefinitionGuid;
+
+  ASSERT (InputSection != NULL);
+
+  if (IS_SECTION2 (InputSection)) {
+    SectionDefinitionGuid = &(((EFI_GUID_DEFINED_SECTION2 *) InputSection)->SectionDefinitionGuid);
+  } else {
+    SectionDefinitionGuid = &(((EFI_GUID_DEFINED_SECTION *) InputSection)->SectionDefinitionGuid);
+  }
+
+  //
+  // Search the match registered handler for the input guided section.
+  //
+  for (Index = 0; Index < mNumberOfExtractHandler; Index ++) {
+    if (CompareGuid (&mExtractHandlerGuidTable[Index], SectionDefinitionGuid)) {
+      if (mExtractStreamHandlerTable[Index].InitHandler == NULL) {
+        break;
+      }
+      *StreamHandlers = &mExtractStreamHandlerTable[Index];
+      return RETURN_SUCCESS;
+    }
+  }
+
+  //
+  // Not found, the input guided section can not be decoded incrementally.
+  //
+  return RETURN_UNSUPPORTED;
+}
+
+/**
+  Retrieves the GUID from a GUIDed section and uses that GUID to select the associated handler of type
+  EXTRACT_GUIDED_SECTION_STREAM_INIT_HANDLER that was registered with ExtractGuidedSectionRegisterStreamHandlers().
+  The selected handler is used to start to decode the GUIDed section incrementally.
+
+  The size of ScratchBuffer is returned by ExtractGuidedSectionGetInfo(). The decoded data is produced
+  by ExtractGuidedSectionStreamFeed(), and the decode operation is completed by ExtractGuidedSectionStreamFinish().
+
+  If InputSection is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+
+  @param[in]  InputSection   A pointer to a GUIDed section of an FFS formatted file.
+  @param[in]  ScratchBuffer  A caller allocated buffer that holds the state of the decode operation until it is finished.
+
+  @retval  RETURN_SUCCESS      The decode operation was started.
+  @retval  RETURN_UNSUPPORTED  The GUID from the section specified by InputSection does not match any of
+                               the GUIDs registered with ExtractGuidedSectionRegisterStreamHandlers().
+  @retval  Others              The return status from the handler associated with the GUID retrieved from
+                               the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionStreamInit (
+  IN  CONST VOID    *InputSection,
+  IN        VOID    *ScratchBuffer
+  )
+{
+  RETURN_STATUS                           Status;
+  EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  *StreamHandlers;
+
+  ASSERT (ScratchBuffer != NULL);
+
+  Status = DxeGetExtractGuidedSectionStreamHandlers (InputSection, &StreamHandlers);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  return StreamHandlers->InitHandler (InputSection, ScratchBuffer);
+}
+
+/**
+  Retrieves the GUID from a GUIDed section and uses that GUID to select the associated handler of type
+  EXTRACT_GUIDED_SECTION_STREAM_FEED_HANDLER that was registered with ExtractGuidedSectionRegisterStreamHandlers().
+  The selected handler is used to decode the next window of the GUIDed section.
+
+  The data of the window ends at the offset specified by OutputSize in OutputBuffer. The data decoded by
+  the previous windows must be present in OutputBuffer, but it may have been moved to another buffer
+  between two windows.
+
+  If InputSection is NULL, then ASSERT().
+  If OutputBuffer is NULL, then ASSERT().
+  If OutputSize is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+
+  @param[in]      InputSection   A pointer to a GUIDed section of an FFS formatted file.
+  @param[in, out] OutputBuffer   A pointer to the buffer that holds the decoded data.
+  @param[in, out] OutputSize     On input, the offset in OutputBuffer at which this window ends. On output,
+                                 the size, in bytes, of the data decoded so far.
+  @param[in]      ScratchBuffer  The scratch buffer given to ExtractGuidedSectionStreamInit().
+
+  @retval  RETURN_SUCCESS      The window was decoded.
+  @retval  RETURN_UNSUPPORTED  The GUID from the section specified by InputSection does not match any of
+                               the GUIDs registered with ExtractGuidedSectionRegisterStreamHandlers().
+  @retval  Others              The return status from the handler associated with the GUID retrieved from
+                               the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionStreamFeed (
+  IN  CONST VOID    *InputSection,
+  IN OUT    VOID    *OutputBuffer,
+  IN OUT    UINT32  *OutputSize,
+  IN        VOID    *ScratchBuffer
+  )
+{
+  RETURN_STATUS                           Status;
+  EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  *StreamHandlers;
+
+  ASSERT (OutputBuffer != NULL);
+  ASSERT (OutputSize != NULL);
+  ASSERT (ScratchBuffer != NULL);
+
+  Status = DxeGetExtractGuidedSectionStreamHandlers (InputSection, &StreamHandlers);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  return StreamHandlers->FeedHandler (InputSection, OutputBuffer, OutputSize, ScratchBuffer);
+}
+
+/**
+  Retrieves the GUID from a GUIDed section and uses that GUID to select the associated handler of type
+  EXTRACT_GUIDED_SECTION_STREAM_FINISH_HANDLER that was registered with ExtractGuidedSectionRegisterStreamHandlers().
+  The selected handler is used to complete the incremental decode of the GUIDed section.
+
+  This function is responsible for computing the EFI_AUTH_STATUS_PLATFORM_OVERRIDE bit of in AuthenticationStatus.
+
+  If InputSection is NULL, then ASSERT().
+  If ScratchBuffer is NULL, then ASSERT().
+  If AuthenticationStatus is NULL, then ASSERT().
+
+  @param[in]  InputSection   A pointer to a GUIDed section of an FFS formatted file.
+  @param[in]  ScratchBuffer  The scratch buffer given to ExtractGuidedSectionStreamInit().
+  @param[out] AuthenticationStatus
+                             A pointer to the authentication status of the decoded output buffer. See the definition
+                             of authentication status in the EFI_PEI_GUIDED_SECTION_EXTRACTION_PPI section of the PI
+                             Specification.
+
+  @retval  RETURN_SUCCESS      The section specified by InputSection was completely decoded.
+  @retval  RETURN_UNSUPPORTED  The GUID from the section specified by InputSection does not match any of
+                               the GUIDs registered with ExtractGuidedSectionRegisterStreamHandlers().
+  @retval  Others              The return status from the handler associated with the GUID retrieved from
+                               the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+ExtractGuidedSectionStreamFinish (
+  IN  CONST VOID    *InputSection,
+  IN        VOID    *ScratchBuffer,
+  OUT       UINT32  *AuthenticationStatus
+  )
+{
+  RETURN_STATUS                           Status;
+  EXTRACT_GUIDED_SECTION_STREAM_HANDLERS  *StreamHandlers;
+
+  ASSERT (ScratchBuffer != NULL);
+  ASSERT (AuthenticationStatus != NULL);
+
+  Status = DxeGetExtractGuidedSectionStreamHandlers (InputSection, &StreamHandlers);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  return StreamHandlers->FinishHandler (InputSection, ScratchBuffer, AuthenticationStatus);
+}
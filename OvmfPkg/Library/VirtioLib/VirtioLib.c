@@ -184,13 +184,13 @@ VirtioPrepare (
   This function implements the following section from virtio-0.9.5:
   - 2.4.1.1 Placing Buffers into the Descriptor Table
 
-  Free space is taken as granted, since the individual drivers support only
-  synchronous requests and host side status is processed in lock-step with
-  request submission. It is the calling driver's responsibility to verify the
-  ring size in advance.
+  Free space is taken as granted. Drivers with synchronous requests process
+  the host side status in lock-step with request submission, drivers with
+  several requests in flight reserve the descriptors of each request. It is
+  the calling driver's responsibility to verify the ring size in advance.
 
-  The caller is responsible for initializing *Indices with VirtioPrepare()
-  first.
+  The caller is responsible for initializing *Indices with VirtioPrepare() or
+  VirtioPrepareChain() first.
 
   @param[in,out] Ring        The virtio ring to append the buffer to, as a
                              descriptor.
@@ -203,9 +203,10 @@ VirtioPrepare (
   @param[in] Flags           A bitmask of VRING_DESC_F_* flags. The caller
                              computes this mask dependent on further buffers to
                              append and transfer direction.
-                             VRING_DESC_F_INDIRECT is unsupported. The
-                             VRING_DESC.Next field is always set, but the host
-                             only interprets it dependent on VRING_DESC_F_NEXT.
+                             VRING_DESC_F_INDIRECT is unsupported, see
+                             VirtioAppendIndirectDesc(). The VRING_DESC.Next
+                             field is always set, but the host only interprets
+                             it dependent on VRING_DESC_F_NEXT.
 
   @param[in,out] Indices     Indices->HeadDescIdx is not accessed.
                              On input, Indices->NextDescIdx identifies the next
@@ -317,3 +318,209 @@ VirtioFlush (
   MemoryFence();
   return EFI_SUCCESS;
 }
+
+
+/**
+
+  Turn off interrupt notifications from the host, and prepare for appending
+  a descriptor chain that starts at a given entry of the descriptor table.
+
+  Unlike VirtioPrepare(), this function allows several descriptor chains to be
+  in flight at the same time. The calling driver reserves the descriptors of
+  every chain, and submits the chains with VirtioAddAvail() and VirtioKick().
+
+  The calling driver must be in VSTAT_DRIVER_OK state.
+
+  @param[in,out] Ring       The virtio ring we intend to append descriptors to.
+
+  @param[in] HeadDescIdx    The index of the head descriptor of the chain in
+                            the descriptor table.
+
+  @param[out] Indices       The DESC_INDICES structure to initialize.
+
+**/
+VOID
+EFIAPI
+VirtioPrepareChain (
+  IN OUT VRING        *Ring,
+  IN     UINT16       HeadDescIdx,
+  OUT    DESC_INDICES *Indices
+  )
+{
+  //
+  // We're going to poll the answer, the host should not send an interrupt.
+  //
+  *Ring->Avail.Flags = (UINT16) VRING_AVAIL_F_NO_INTERRUPT;
+
+  Indices->HeadDescIdx = HeadDescIdx;
+  Indices->NextDescIdx = Indices->HeadDescIdx;
+}
+
+
+/**
+
+  Append a descriptor that refers to an indirect table of descriptors.
+
+  This function implements the following section from virtio-0.9.5:
+  - 2.4.1.1 Placing Buffers into the Descriptor Table, Indirect Descriptors
+
+  The whole request is described by the indirect table, so it takes a single
+  descriptor of the ring, whatever the number of its buffers. The entries of
+  the table are chained with VRING_DESC_F_NEXT and VRING_DESC.Next like a chain
+  of the ring, starting at entry #0. The host must have accepted the
+  VIRTIO_F_RING_INDIRECT_DESC feature.
+
+  The table is read by the host until the descriptor chain is processed, so
+  the caller must keep it unchanged until then.
+
+  @param[in,out] Ring        The virtio ring to append the descriptor to.
+
+  @param[in] IndirectTable   The indirect table of descriptors.
+
+  @param[in] NumDesc         The number of descriptors in IndirectTable.
+
+  @param[in,out] Indices     Indices->HeadDescIdx is not accessed.
+                             On input, Indices->NextDescIdx identifies the
+                             descriptor of the ring to refer to the table. On
+                             output, Indices->NextDescIdx is incremented by
+                             one, modulo 2^16.
+
+**/
+VOID
+EFIAPI
+VirtioAppendIndirectDesc (
+  IN OUT VRING               *Ring,
+  IN     volatile VRING_DESC *IndirectTable,
+  IN     UINT16              NumDesc,
+  IN OUT DESC_INDICES        *Indices
+  )
+{
+  VirtioAppendDesc (Ring, (UINTN) IndirectTable,
+    (UINT32) (NumDesc * sizeof *IndirectTable), VRING_DESC_F_INDIRECT,
+    Indices);
+}
+
+
+/**
+
+  Make the descriptor chain just built available to the host, without
+  notifying it.
+
+  Several descriptor chains can be made available before the host is notified
+  once with VirtioKick().
+
+  @param[in,out] Ring     The virtio ring with descriptors to submit.
+
+  @param[in] Indices      Indices->NextDescIdx is not accessed.
+                          Indices->HeadDescIdx identifies the head descriptor
+                          of the descriptor chain.
+
+**/
+VOID
+EFIAPI
+VirtioAddAvail (
+  IN OUT VRING        *Ring,
+  IN     DESC_INDICES *Indices
+  )
+{
+  UINT16 NextAvailIdx;
+
+  //
+  // virtio-0.9.5, 2.4.1.2 Updating the Available Ring
+  //
+  NextAvailIdx = *Ring->Avail.Idx;
+  Ring->Avail.Ring[NextAvailIdx++ % Ring->QueueSize] =
+    Indices->HeadDescIdx % Ring->QueueSize;
+
+  //
+  // virtio-0.9.5, 2.4.1.3 Updating the Index Field
+  //
+  MemoryFence();
+  *Ring->Avail.Idx = NextAvailIdx;
+}
+
+
+/**
+
+  Notify the host about the descriptor chains made available with
+  VirtioAddAvail(), without waiting for them to be processed.
+
+  @param[in] VirtIo       The target virtio device to notify.
+
+  @param[in] VirtQueueId  Identifies the queue for the target device.
+
+
+  @return                 Status code returned by VirtIo->SetQueueNotify().
+
+**/
+EFI_STATUS
+EFIAPI
+VirtioKick (
+  IN VIRTIO_DEVICE_PROTOCOL *VirtIo,
+  IN UINT16                 VirtQueueId
+  )
+{
+  //
+  // virtio-0.9.5, 2.4.1.4 Notifying the Device -- gratuitous notifications are
+  // OK.
+  //
+  MemoryFence();
+  return VirtIo->SetQueueNotify (VirtIo, VirtQueueId);
+}
+
+
+/**
+
+  Get the next descriptor chain processed by the host, if any.
+
+  This function implements the following section from virtio-0.9.5:
+  - 2.4.2 Receiving Used Buffers From the Device
+
+  The host may complete the descriptor chains in any order.
+
+  @param[in,out] Ring         The virtio ring the descriptor chains were
+                              submitted to.
+
+  @param[in,out] LastUsedIdx  The value of the used ring index up to which the
+                              used elements have been processed by the caller.
+                              It is incremented by one, modulo 2^16, if a
+                              descriptor chain is returned. It must be set to
+                              zero when the ring is set up.
+
+  @param[out] HeadDescIdx     The head descriptor of the descriptor chain
+                              processed by the host.
+
+  @param[out] Len             The number of bytes written by the host into the
+                              buffers of the descriptor chain.
+
+
+  @retval TRUE   A descriptor chain processed by the host is returned.
+
+  @retval FALSE  The host has not processed any other descriptor chain.
+
+**/
+BOOLEAN
+EFIAPI
+VirtioGetUsed (
+  IN OUT VRING  *Ring,
+  IN OUT UINT16 *LastUsedIdx,
+  OUT    UINT16 *HeadDescIdx,
+  OUT    UINT32 *Len
+  )
+{
+  volatile VRING_USED_ELEM *UsedElem;
+
+  MemoryFence();
+  if (*Ring->Used.Idx == *LastUsedIdx) {
+    return FALSE;
+  }
+
+  //
+  // The used element must not be read before the index that publishes it.
+  //
+  MemoryFence();
+  UsedElem     = &Ring->Used.UsedElem[(*LastUsedIdx)++ % Ring->QueueSize];
+  *HeadDescIdx = (UINT16) UsedElem->Id;
+  *Len         = UsedElem->Len;
+  return TRUE;
+}
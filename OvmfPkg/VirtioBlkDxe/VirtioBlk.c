@@ -1,14 +1,16 @@
 /** @file
 
-  This driver produces Block I/O Protocol instances for virtio-blk devices.
+  This driver produces Block I/O and Block I/O 2 Protocol instances for
+  virtio-blk devices.
 
   The implementation is basic:
 
   - No attach/detach (ie. removable media).
 
-  - Although the non-blocking interfaces of EFI_BLOCK_IO2_PROTOCOL could be a
-    good match for multiple in-flight virtio-blk requests, we stick to
-    synchronous requests and EFI_BLOCK_IO_PROTOCOL for now.
+  - The non-blocking requests of EFI_BLOCK_IO2_PROTOCOL are in flight in the
+    virtio ring together, up to VBLK_MAX_INFLIGHT of them, with one descriptor
+    each if the host supports indirect descriptors. They are completed by a
+    poll timer, as interrupts are not used.
 
   Copyright (C) 2012, Red Hat, Inc.
   Copyright (c) 2012 - 2014, Intel Corporation. All rights reserved.<BR>
@@ -183,15 +185,300 @@ VerifyReadWriteRequest (
 
 /**
 
-  Format a read / write / flush request as three consecutive virtio
-  descriptors, push them to the host, and poll for the response.
+  Format a read / write / flush request in a free slot of the virtio ring, and
+  make it available to the host.
 
-  This is the main workhorse function. Two use cases are supported, read/write
-  and flush. The function may only be called after the request parameters have
-  been verified by
+  The request header and the host status live in the slot, so that they stay
+  valid until the host processes the request. If VIRTIO_F_RING_INDIRECT_DESC
+  has been negotiated, the request is described by the indirect table of the
+  slot and takes a single descriptor of the ring, at the index of the slot.
+  Otherwise it takes up to three consecutive descriptors of the ring, starting
+  at three times the index of the slot. Either way the descriptors of the slots
+  never overlap, so the requests of all the slots can be in flight at the same
+  time.
+
+  The host is not notified, see VirtioBlkProcessRing().
+
+  @param[in out] Dev   The virtio-blk device the request is targeted at.
+
+  @param[in] SlotIdx   The index of the free slot to use.
+
+  @param[in] Req       The request, whose parameters have been verified like
+                       for SynchronousRequest().
+
+**/
+
+STATIC
+VOID
+SubmitRequest (
+  IN OUT VBLK_DEV  *Dev,
+  IN     UINT16    SlotIdx,
+  IN     VBLK_REQ  *Req
+  )
+{
+  UINT32       BlockSize;
+  VBLK_SLOT    *Slot;
+  DESC_INDICES Indices;
+  UINT16       NumDesc;
+
+  BlockSize = Dev->BlockIoMedia.BlockSize;
+  Slot      = &Dev->Slots[SlotIdx];
+
+  //
+  // ensured by VirtioBlkInit()
+  //
+  ASSERT (BlockSize > 0);
+  ASSERT (BlockSize % 512 == 0);
+
+  //
+  // ensured by contract above, plus VerifyReadWriteRequest()
+  //
+  ASSERT (Req->BufferSize % BlockSize == 0);
+
+  //
+  // From virtio-0.9.5, 2.3.2 Descriptor Table:
+  // "no descriptor chain may be more than 2^32 bytes long in total".
+  //
+  // The predicate is ensured by the call contract above (for flush), or
+  // VerifyReadWriteRequest() (for read/write). It also implies that
+  // converting BufferSize to UINT32 will not truncate it.
+  //
+  ASSERT (Req->BufferSize <= SIZE_1GB);
+
+  ASSERT (Slot->Req == NULL);
+  Slot->Req = Req;
+
+  //
+  // Prepare virtio-blk request header, setting zero size for flush.
+  // IO Priority is homogeneously 0.
+  //
+  Slot->Request.Type   = Req->RequestIsWrite ?
+                         (Req->BufferSize == 0 ? VIRTIO_BLK_T_FLUSH :
+                                                 VIRTIO_BLK_T_OUT) :
+                         VIRTIO_BLK_T_IN;
+  Slot->Request.IoPrio = 0;
+  Slot->Request.Sector = MultU64x32(Req->Lba, BlockSize / 512);
+
+  //
+  // preset a host status for ourselves that we do not accept as success
+  //
+  Slot->HostStatus = VIRTIO_BLK_S_IOERR;
+
+  if (Dev->IndirectDesc) {
+    //
+    // virtio-blk header in first desc, data buffer for read/write in second
+    // desc, host status in last (second or third) desc.
+    //
+    NumDesc = 0;
+    Slot->IndirectTable[NumDesc].Addr  = (UINTN) &Slot->Request;
+    Slot->IndirectTable[NumDesc].Len   = sizeof Slot->Request;
+    Slot->IndirectTable[NumDesc].Flags = VRING_DESC_F_NEXT;
+    Slot->IndirectTable[NumDesc].Next  = NumDesc + 1;
+    NumDesc++;
+
+    if (Req->BufferSize > 0) {
+      //
+      // VRING_DESC_F_WRITE is interpreted from the host's point of view.
+      //
+      Slot->IndirectTable[NumDesc].Addr  = (UINTN) Req->Buffer;
+      Slot->IndirectTable[NumDesc].Len   = (UINT32) Req->BufferSize;
+      Slot->IndirectTable[NumDesc].Flags = VRING_DESC_F_NEXT |
+                                           (Req->RequestIsWrite ?
+                                              0 : VRING_DESC_F_WRITE);
+      Slot->IndirectTable[NumDesc].Next  = NumDesc + 1;
+      NumDesc++;
+    }
+
+    Slot->IndirectTable[NumDesc].Addr  = (UINTN) &Slot->HostStatus;
+    Slot->IndirectTable[NumDesc].Len   = sizeof Slot->HostStatus;
+    Slot->IndirectTable[NumDesc].Flags = VRING_DESC_F_WRITE;
+    Slot->IndirectTable[NumDesc].Next  = 0;
+    NumDesc++;
+
+    VirtioPrepareChain (&Dev->Ring, SlotIdx, &Indices);
+    VirtioAppendIndirectDesc (&Dev->Ring, Slot->IndirectTable, NumDesc,
+      &Indices);
+  } else {
+    VirtioPrepareChain (&Dev->Ring, (UINT16) (SlotIdx * 3), &Indices);
+
+    //
+    // virtio-blk header in first desc
+    //
+    VirtioAppendDesc (&Dev->Ring, (UINTN) &Slot->Request,
+      sizeof Slot->Request, VRING_DESC_F_NEXT, &Indices);
+
+    //
+    // data buffer for read/write in second desc
+    //
+    if (Req->BufferSize > 0) {
+      //
+      // VRING_DESC_F_WRITE is interpreted from the host's point of view.
+      //
+      VirtioAppendDesc (&Dev->Ring, (UINTN) Req->Buffer,
+        (UINT32) Req->BufferSize,
+        VRING_DESC_F_NEXT | (Req->RequestIsWrite ? 0 : VRING_DESC_F_WRITE),
+        &Indices);
+    }
+
+    //
+    // host status in last (second or third) desc
+    //
+    VirtioAppendDesc (&Dev->Ring, (UINTN) &Slot->HostStatus,
+      sizeof Slot->HostStatus, VRING_DESC_F_WRITE, &Indices);
+  }
+
+  VirtioAddAvail (&Dev->Ring, &Indices);
+}
+
+
+/**
+
+  Complete the requests processed by the host, then submit the pending
+  requests to the free slots of the virtio ring.
+
+  The blocking requests are marked done, the Token->Event of the non-blocking
+  requests is signaled. The host is notified once for all the requests
+  submitted.
+
+  The caller must be at TPL_NOTIFY, the TPL of the poll timer, as the slots and
+  the pending queue are shared with it.
+
+  @param[in out] Dev  The virtio-blk device.
+
+**/
+
+STATIC
+VOID
+VirtioBlkProcessRing (
+  IN OUT VBLK_DEV *Dev
+  )
+{
+  UINT16     HeadDescIdx;
+  UINT32     Len;
+  VBLK_SLOT  *Slot;
+  VBLK_REQ   *Req;
+  EFI_STATUS Status;
+  UINT16     SlotIdx;
+  BOOLEAN    Kick;
+
+  //
+  // virtio-0.9.5, 2.4.2 Receiving Used Buffers From the Device
+  //
+  while (VirtioGetUsed (&Dev->Ring, &Dev->LastUsedIdx, &HeadDescIdx, &Len)) {
+    Slot = &Dev->Slots[Dev->IndirectDesc ? HeadDescIdx : HeadDescIdx / 3];
+    Req  = Slot->Req;
+    ASSERT (Req != NULL);
+
+    Slot->Req = NULL;
+    Dev->InFlight--;
+
+    Status = (Slot->HostStatus == VIRTIO_BLK_S_OK) ? EFI_SUCCESS :
+                                                     EFI_DEVICE_ERROR;
+    if (Req->Token == NULL) {
+      Req->Status = Status;
+      Req->Done   = TRUE;
+    } else {
+      Req->Token->TransactionStatus = Status;
+      gBS->SignalEvent (Req->Token->Event);
+      FreePool (Req);
+    }
+  }
+
+  Kick    = FALSE;
+  SlotIdx = 0;
+  while (!IsListEmpty (&Dev->PendingQueue) && Dev->InFlight < Dev->NumSlots) {
+    while (Dev->Slots[SlotIdx].Req != NULL) {
+      SlotIdx++;
+    }
+
+    Req = VBLK_REQ_FROM_LINK (GetFirstNode (&Dev->PendingQueue));
+    RemoveEntryList (&Req->Link);
+
+    SubmitRequest (Dev, SlotIdx, Req);
+    Dev->InFlight++;
+    Kick = TRUE;
+  }
+
+  //
+  // virtio-blk's only virtqueue is #0, called "requestq" (see Appendix D).
+  //
+  if (Kick) {
+    Status = VirtioKick (Dev->VirtIo, 0);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((EFI_D_ERROR, "%a: failed to notify the host - %r\n",
+        __FUNCTION__, Status));
+    }
+  }
+}
+
+
+/**
+
+  Notify function of the poll timer, which completes the requests in flight.
+
+  @param[in] Event    The poll timer event.
+
+  @param[in] Context  The virtio-blk device.
+
+**/
+
+STATIC
+VOID
+EFIAPI
+VirtioBlkPollTimer (
+  IN EFI_EVENT Event,
+  IN VOID      *Context
+  )
+{
+  VirtioBlkProcessRing ((VBLK_DEV *) Context);
+}
+
+
+/**
+
+  Wait until all the requests of a device, in flight or pending, are
+  completed.
+
+  @param[in out] Dev  The virtio-blk device.
+
+**/
+
+STATIC
+VOID
+VirtioBlkWaitIdle (
+  IN OUT VBLK_DEV *Dev
+  )
+{
+  EFI_TPL OldTpl;
+  BOOLEAN Idle;
+
+  for (;;) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    VirtioBlkProcessRing (Dev);
+    Idle = (BOOLEAN) (Dev->InFlight == 0 && IsListEmpty (&Dev->PendingQueue));
+    gBS->RestoreTPL (OldTpl);
+
+    if (Idle) {
+      break;
+    }
+    gBS->Stall (10);
+  }
+}
+
+
+/**
+
+  Send a read / write / flush request to the host, and poll for the response.
+
+  This is the main workhorse function of the blocking interfaces. Two use
+  cases are supported, read/write and flush. The function may only be called
+  after the request parameters have been verified by
   - specific checks in ReadBlocks() / WriteBlocks() / FlushBlocks(), and
   - VerifyReadWriteRequest() (for read/write only).
 
+  The request goes through the same slots as the non-blocking requests, so it
+  may be in flight together with them.
+
   Parameters handled commonly:
 
     @param[in] Dev             The virtio-blk device the request is targeted
@@ -229,8 +516,7 @@ VerifyReadWriteRequest (
 
   @retval EFI_SUCCESS          Transfer complete.
 
-  @retval EFI_DEVICE_ERROR     Failed to notify host side via VirtIo write, or
-                               unable to parse host response, or host response
+  @retval EFI_DEVICE_ERROR     Unable to parse host response, or host response
                                is not VIRTIO_BLK_S_OK.
 
 **/
@@ -246,90 +532,116 @@ SynchronousRequest (
   IN              BOOLEAN  RequestIsWrite
   )
 {
-  UINT32                  BlockSize;
-  volatile VIRTIO_BLK_REQ Request;
-  volatile UINT8          HostStatus;
-  DESC_INDICES            Indices;
-
-  BlockSize = Dev->BlockIoMedia.BlockSize;
+  VBLK_REQ Req;
+  EFI_TPL  OldTpl;
+  BOOLEAN  Done;
+  UINTN    PollPeriodUsecs;
+
+  Req.Signature      = VBLK_REQ_SIG;
+  Req.Lba            = Lba;
+  Req.BufferSize     = BufferSize;
+  Req.Buffer         = (VOID *) Buffer;
+  Req.RequestIsWrite = RequestIsWrite;
+  Req.Token          = NULL;
+  Req.Done           = FALSE;
+  Req.Status         = EFI_DEVICE_ERROR;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  InsertTailList (&Dev->PendingQueue, &Req.Link);
+  VirtioBlkProcessRing (Dev);
+  gBS->RestoreTPL (OldTpl);
 
   //
-  // ensured by VirtioBlkInit()
+  // Keep slowing down until we reach a poll period of slightly above 1 ms.
   //
-  ASSERT (BlockSize > 0);
-  ASSERT (BlockSize % 512 == 0);
+  PollPeriodUsecs = 1;
+  for (;;) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    VirtioBlkProcessRing (Dev);
+    Done = Req.Done;
+    gBS->RestoreTPL (OldTpl);
+
+    if (Done) {
+      break;
+    }
 
-  //
-  // ensured by contract above, plus VerifyReadWriteRequest()
-  //
-  ASSERT (BufferSize % BlockSize == 0);
+    gBS->Stall (PollPeriodUsecs); // calls AcpiTimerLib::MicroSecondDelay
 
-  //
-  // Prepare virtio-blk request header, setting zero size for flush.
-  // IO Priority is homogeneously 0.
-  //
-  Request.Type   = RequestIsWrite ?
-                   (BufferSize == 0 ? VIRTIO_BLK_T_FLUSH : VIRTIO_BLK_T_OUT) :
-                   VIRTIO_BLK_T_IN;
-  Request.IoPrio = 0;
-  Request.Sector = MultU64x32(Lba, BlockSize / 512);
+    if (PollPeriodUsecs < 1024) {
+      PollPeriodUsecs *= 2;
+    }
+  }
 
-  VirtioPrepare (&Dev->Ring, &Indices);
+  return Req.Status;
+}
 
-  //
-  // preset a host status for ourselves that we do not accept as success
-  //
-  HostStatus = VIRTIO_BLK_S_IOERR;
 
-  //
-  // ensured by VirtioBlkInit() -- this predicate, in combination with the
-  // lock-step progress, ensures we don't have to track free descriptors.
-  //
-  ASSERT (Dev->Ring.QueueSize >= 3);
+/**
 
-  //
-  // virtio-blk header in first desc
-  //
-  VirtioAppendDesc (&Dev->Ring, (UINTN) &Request, sizeof Request,
-    VRING_DESC_F_NEXT, &Indices);
+  Queue a non-blocking read / write request, and return at once.
 
-  //
-  // data buffer for read/write in second desc
-  //
-  if (BufferSize > 0) {
-    //
-    // From virtio-0.9.5, 2.3.2 Descriptor Table:
-    // "no descriptor chain may be more than 2^32 bytes long in total".
-    //
-    // The predicate is ensured by the call contract above (for flush), or
-    // VerifyReadWriteRequest() (for read/write). It also implies that
-    // converting BufferSize to UINT32 will not truncate it.
-    //
-    ASSERT (BufferSize <= SIZE_1GB);
+  The request is sent to the host as soon as a slot of the virtio ring is free.
+  Token->Event is signaled when the host has processed it, with the result in
+  Token->TransactionStatus. The request parameters must have been verified by
+  VerifyReadWriteRequest().
 
-    //
-    // VRING_DESC_F_WRITE is interpreted from the host's point of view.
-    //
-    VirtioAppendDesc (&Dev->Ring, (UINTN) Buffer, (UINT32) BufferSize,
-      VRING_DESC_F_NEXT | (RequestIsWrite ? 0 : VRING_DESC_F_WRITE),
-      &Indices);
+  @param[in] Dev             The virtio-blk device the request is targeted at.
+
+  @param[in] Lba             Logical Block Address: number of logical blocks to
+                             skip from the beginning of the device.
+
+  @param[in] BufferSize      Size of buffer to transfer, in bytes.
+
+  @param[in out] Buffer      The guest side area to read data from the device
+                             into, or write data to the device from.
+
+  @param[in] RequestIsWrite  TRUE iff data transfer goes from guest to device.
+
+  @param[in out] Token       The token of the request. Token->Event must not be
+                             NULL.
+
+
+  @retval EFI_SUCCESS           The request is queued.
+
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+
+**/
+
+STATIC
+EFI_STATUS
+AsynchronousRequest (
+  IN     VBLK_DEV            *Dev,
+  IN     EFI_LBA             Lba,
+  IN     UINTN               BufferSize,
+  IN OUT VOID                *Buffer,
+  IN     BOOLEAN             RequestIsWrite,
+  IN OUT EFI_BLOCK_IO2_TOKEN *Token
+  )
+{
+  VBLK_REQ *Req;
+  EFI_TPL  OldTpl;
+
+  Req = AllocateZeroPool (sizeof *Req);
+  if (Req == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  //
-  // host status in last (second or third) desc
-  //
-  VirtioAppendDesc (&Dev->Ring, (UINTN) &HostStatus, sizeof HostStatus,
-    VRING_DESC_F_WRITE, &Indices);
+  Req->Signature      = VBLK_REQ_SIG;
+  Req->Lba            = Lba;
+  Req->BufferSize     = BufferSize;
+  Req->Buffer         = Buffer;
+  Req->RequestIsWrite = RequestIsWrite;
+  Req->Token          = Token;
 
   //
-  // virtio-blk's only virtqueue is #0, called "requestq" (see Appendix D).
+  // Send the request now rather than at the next tick of the poll timer.
   //
-  if (VirtioFlush (Dev->VirtIo, 0, &Dev->Ring, &Indices) == EFI_SUCCESS &&
-      HostStatus == VIRTIO_BLK_S_OK) {
-    return EFI_SUCCESS;
-  }
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  InsertTailList (&Dev->PendingQueue, &Req->Link);
+  VirtioBlkProcessRing (Dev);
+  gBS->RestoreTPL (OldTpl);
 
-  return EFI_DEVICE_ERROR;
+  return EFI_SUCCESS;
 }
 
 
@@ -459,6 +771,8 @@ VirtioBlkWriteBlocks (
   according to EFI_BLOCK_IO_MEDIA characteristics set in VirtioBlkInit().
   Should they do nonetheless, we do nothing, successfully.
 
+  The non-blocking requests in flight are completed first.
+
 **/
 
 EFI_STATUS
@@ -470,6 +784,12 @@ VirtioBlkFlushBlocks (
   VBLK_DEV *Dev;
 
   Dev = VIRTIO_BLK_FROM_BLOCK_IO (This);
+
+  //
+  // The flush only covers the writes the host has completed.
+  //
+  VirtioBlkWaitIdle (Dev);
+
   return Dev->BlockIoMedia.WriteCaching ?
            SynchronousRequest (
              Dev,
@@ -482,6 +802,204 @@ VirtioBlkFlushBlocks (
 }
 
 
+
+//
+// UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol
+// Driver Writer's Guide for UEFI 2.3.1 v1.01,
+//   24.2 Block I/O Protocol Implementations
+//
+EFI_STATUS
+EFIAPI
+VirtioBlkResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL *This,
+  IN BOOLEAN                ExtendedVerification
+  )
+{
+  //
+  // Complete the requests in flight, after that the device is in the same
+  // state as after initialization.
+  //
+  VirtioBlkWaitIdle (VIRTIO_BLK_FROM_BLOCK_IO2 (This));
+  return EFI_SUCCESS;
+}
+
+
+/**
+
+  ReadBlocksEx() operation for virtio-blk.
+
+  See
+  - UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol,
+    EFI_BLOCK_IO2_PROTOCOL.ReadBlocksEx().
+  - Driver Writer's Guide for UEFI 2.3.1 v1.01, 24.2.2. ReadBlocks() and
+    ReadBlocksEx() Implementation.
+
+  If Token is NULL or Token->Event is NULL, the request is blocking, like
+  ReadBlocks(). Otherwise the request is queued, and Token->Event is signaled
+  when it completes, with the result in Token->TransactionStatus.
+
+**/
+
+EFI_STATUS
+EFIAPI
+VirtioBlkReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  OUT    VOID                   *Buffer
+  )
+{
+  VBLK_DEV   *Dev;
+  EFI_STATUS Status;
+
+  if (BufferSize == 0) {
+    if (Token != NULL && Token->Event != NULL) {
+      Token->TransactionStatus = EFI_SUCCESS;
+      gBS->SignalEvent (Token->Event);
+    }
+    return EFI_SUCCESS;
+  }
+
+  Dev = VIRTIO_BLK_FROM_BLOCK_IO2 (This);
+  Status = VerifyReadWriteRequest (
+             &Dev->BlockIoMedia,
+             Lba,
+             BufferSize,
+             FALSE               // RequestIsWrite
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Token == NULL || Token->Event == NULL) {
+    return SynchronousRequest (
+             Dev,
+             Lba,
+             BufferSize,
+             Buffer,
+             FALSE       // RequestIsWrite
+             );
+  }
+
+  return AsynchronousRequest (
+           Dev,
+           Lba,
+           BufferSize,
+           Buffer,
+           FALSE,      // RequestIsWrite
+           Token
+           );
+}
+
+
+/**
+
+  WriteBlocksEx() operation for virtio-blk.
+
+  See
+  - UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol,
+    EFI_BLOCK_IO2_PROTOCOL.WriteBlocksEx().
+  - Driver Writer's Guide for UEFI 2.3.1 v1.01, 24.2.3 WriteBlocks() and
+    WriteBlockEx() Implementation.
+
+  If Token is NULL or Token->Event is NULL, the request is blocking, like
+  WriteBlocks(). Otherwise the request is queued, and Token->Event is signaled
+  when it completes, with the result in Token->TransactionStatus.
+
+**/
+
+EFI_STATUS
+EFIAPI
+VirtioBlkWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN     VOID                   *Buffer
+  )
+{
+  VBLK_DEV   *Dev;
+  EFI_STATUS Status;
+
+  if (BufferSize == 0) {
+    if (Token != NULL && Token->Event != NULL) {
+      Token->TransactionStatus = EFI_SUCCESS;
+      gBS->SignalEvent (Token->Event);
+    }
+    return EFI_SUCCESS;
+  }
+
+  Dev = VIRTIO_BLK_FROM_BLOCK_IO2 (This);
+  Status = VerifyReadWriteRequest (
+             &Dev->BlockIoMedia,
+             Lba,
+             BufferSize,
+             TRUE                // RequestIsWrite
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Token == NULL || Token->Event == NULL) {
+    return SynchronousRequest (
+             Dev,
+             Lba,
+             BufferSize,
+             Buffer,
+             TRUE        // RequestIsWrite
+             );
+  }
+
+  return AsynchronousRequest (
+           Dev,
+           Lba,
+           BufferSize,
+           Buffer,
+           TRUE,       // RequestIsWrite
+           Token
+           );
+}
+
+
+/**
+
+  FlushBlocksEx() operation for virtio-blk.
+
+  See
+  - UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol,
+    EFI_BLOCK_IO2_PROTOCOL.FlushBlocksEx().
+  - Driver Writer's Guide for UEFI 2.3.1 v1.01, 24.2.4 FlushBlocks() and
+    FlushBlocksEx() Implementation.
+
+  The requests in flight are completed first, then the flush is blocking, and
+  Token->Event is signaled when it is done.
+
+**/
+
+EFI_STATUS
+EFIAPI
+VirtioBlkFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token
+  )
+{
+  VBLK_DEV   *Dev;
+  EFI_STATUS Status;
+
+  Dev = VIRTIO_BLK_FROM_BLOCK_IO2 (This);
+  Status = VirtioBlkFlushBlocks (&Dev->BlockIo);
+  if (Token == NULL || Token->Event == NULL) {
+    return Status;
+  }
+
+  Token->TransactionStatus = Status;
+  gBS->SignalEvent (Token->Event);
+  return EFI_SUCCESS;
+}
+
 /**
 
   Device probe function for this driver.
@@ -702,7 +1220,7 @@ VirtioBlkInit (
   if (EFI_ERROR (Status)) {
     goto Failed;
   }
-  if (QueueSize < 3) { // SynchronousRequest() uses at most three descriptors
+  if (QueueSize < 3) { // SubmitRequest() uses at most three descriptors
     Status = EFI_UNSUPPORTED;
     goto Failed;
   }
@@ -712,18 +1230,51 @@ VirtioBlkInit (
     goto Failed;
   }
 
+  //
+  // Every request in flight takes a slot. Without indirect descriptors, a slot
+  // takes three descriptors of the ring.
+  //
+  Dev->IndirectDesc = (BOOLEAN) ((Features & VIRTIO_F_RING_INDIRECT_DESC) != 0);
+  Dev->NumSlots     = (UINT16) MIN (
+                                 Dev->IndirectDesc ? QueueSize : QueueSize / 3,
+                                 VBLK_MAX_INFLIGHT
+                                 );
+  Dev->Slots = AllocateZeroPool (Dev->NumSlots * sizeof *Dev->Slots);
+  if (Dev->Slots == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto ReleaseQueue;
+  }
+  Dev->LastUsedIdx = 0;
+  Dev->InFlight    = 0;
+  InitializeListHead (&Dev->PendingQueue);
+
+  //
+  // The host is not allowed to interrupt us, the requests in flight are
+  // completed by the poll timer.
+  //
+  Status = gBS->CreateEvent (EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_NOTIFY,
+                  &VirtioBlkPollTimer, Dev, &Dev->PollTimer);
+  if (EFI_ERROR (Status)) {
+    goto FreeSlots;
+  }
+
+  Status = gBS->SetTimer (Dev->PollTimer, TimerPeriodic, VBLK_POLL_PERIOD);
+  if (EFI_ERROR (Status)) {
+    goto CloseTimer;
+  }
+
   //
   // Additional steps for MMIO: align the queue appropriately, and set the
   // size. If anything fails from here on, we must release the ring resources.
   //
   Status = Dev->VirtIo->SetQueueNum (Dev->VirtIo, QueueSize);
   if (EFI_ERROR (Status)) {
-    goto ReleaseQueue;
+    goto CloseTimer;
   }
 
   Status = Dev->VirtIo->SetQueueAlign (Dev->VirtIo, EFI_PAGE_SIZE);
   if (EFI_ERROR (Status)) {
-    goto ReleaseQueue;
+    goto CloseTimer;
   }
 
   //
@@ -732,19 +1283,20 @@ VirtioBlkInit (
   Status = Dev->VirtIo->SetQueueAddress (Dev->VirtIo,
       (UINT32) ((UINTN) Dev->Ring.Base >> EFI_PAGE_SHIFT));
   if (EFI_ERROR (Status)) {
-    goto ReleaseQueue;
+    goto CloseTimer;
   }
 
 
   //
   // step 5 -- Report understood features. There are no virtio-blk specific
-  // features to negotiate in virtio-0.9.5, plus we do not want any of the
-  // device-independent (known or unknown) VIRTIO_F_* capabilities (see
-  // Appendix B).
+  // features to negotiate in virtio-0.9.5. Of the device-independent VIRTIO_F_*
+  // capabilities (see Appendix B), we only want indirect descriptors, if the
+  // host offers them.
   //
-  Status = Dev->VirtIo->SetGuestFeatures (Dev->VirtIo, 0);
+  Status = Dev->VirtIo->SetGuestFeatures (Dev->VirtIo,
+                          Features & VIRTIO_F_RING_INDIRECT_DESC);
   if (EFI_ERROR (Status)) {
-    goto ReleaseQueue;
+    goto CloseTimer;
   }
 
   //
@@ -753,7 +1305,7 @@ VirtioBlkInit (
   NextDevStat |= VSTAT_DRIVER_OK;
   Status = Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, NextDevStat);
   if (EFI_ERROR (Status)) {
-    goto ReleaseQueue;
+    goto CloseTimer;
   }
 
   //
@@ -766,6 +1318,11 @@ VirtioBlkInit (
   Dev->BlockIo.ReadBlocks            = &VirtioBlkReadBlocks;
   Dev->BlockIo.WriteBlocks           = &VirtioBlkWriteBlocks;
   Dev->BlockIo.FlushBlocks           = &VirtioBlkFlushBlocks;
+  Dev->BlockIo2.Media                = &Dev->BlockIoMedia;
+  Dev->BlockIo2.Reset                = &VirtioBlkResetEx;
+  Dev->BlockIo2.ReadBlocksEx         = &VirtioBlkReadBlocksEx;
+  Dev->BlockIo2.WriteBlocksEx        = &VirtioBlkWriteBlocksEx;
+  Dev->BlockIo2.FlushBlocksEx        = &VirtioBlkFlushBlocksEx;
   Dev->BlockIoMedia.MediaId          = 0;
   Dev->BlockIoMedia.RemovableMedia   = FALSE;
   Dev->BlockIoMedia.MediaPresent     = TRUE;
@@ -780,6 +1337,8 @@ VirtioBlkInit (
   DEBUG ((DEBUG_INFO, "%a: LbaSize=0x%x[B] NumBlocks=0x%Lx[Lba]\n",
     __FUNCTION__, Dev->BlockIoMedia.BlockSize,
     Dev->BlockIoMedia.LastBlock + 1));
+  DEBUG ((DEBUG_INFO, "%a: IndirectDesc=%d MaxInFlight=%d\n",
+    __FUNCTION__, Dev->IndirectDesc, Dev->NumSlots));
 
   if (Features & VIRTIO_BLK_F_TOPOLOGY) {
     Dev->BlockIo.Revision = EFI_BLOCK_IO_PROTOCOL_REVISION3;
@@ -796,6 +1355,12 @@ VirtioBlkInit (
   }
   return EFI_SUCCESS;
 
+CloseTimer:
+  gBS->CloseEvent (Dev->PollTimer);
+
+FreeSlots:
+  FreePool (Dev->Slots);
+
 ReleaseQueue:
   VirtioRingUninit (&Dev->Ring);
 
@@ -827,6 +1392,12 @@ VirtioBlkUninit (
   IN OUT VBLK_DEV *Dev
   )
 {
+  //
+  // Complete the requests in flight, then stop polling.
+  //
+  VirtioBlkWaitIdle (Dev);
+  gBS->CloseEvent (Dev->PollTimer);
+
   //
   // Reset the virtual device -- see virtio-0.9.5, 2.2.2.1 Device Status. When
   // VIRTIO_CFG_WRITE() returns, the host will have learned to stay away from
@@ -835,8 +1406,10 @@ VirtioBlkUninit (
   Dev->VirtIo->SetDeviceStatus (Dev->VirtIo, 0);
 
   VirtioRingUninit (&Dev->Ring);
+  FreePool (Dev->Slots);
 
   SetMem (&Dev->BlockIo,      sizeof Dev->BlockIo,      0x00);
+  SetMem (&Dev->BlockIo2,     sizeof Dev->BlockIo2,     0x00);
   SetMem (&Dev->BlockIoMedia, sizeof Dev->BlockIoMedia, 0x00);
 }
 
@@ -860,7 +1433,8 @@ VirtioBlkUninit (
 
   @retval EFI_SUCCESS           Driver instance has been created and
                                 initialized  for the virtio-blk device, it
-                                is now accessibla via EFI_BLOCK_IO_PROTOCOL.
+                                is now accessibla via EFI_BLOCK_IO_PROTOCOL
+                                and EFI_BLOCK_IO2_PROTOCOL.
 
   @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
 
@@ -902,12 +1476,14 @@ VirtioBlkDriverBindingStart (
   }
 
   //
-  // Setup complete, attempt to export the driver instance's BlockIo interface.
+  // Setup complete, attempt to export the driver instance's BlockIo and
+  // BlockIo2 interfaces.
   //
   Dev->Signature = VBLK_SIG;
-  Status = gBS->InstallProtocolInterface (&DeviceHandle,
-                  &gEfiBlockIoProtocolGuid, EFI_NATIVE_INTERFACE,
-                  &Dev->BlockIo);
+  Status = gBS->InstallMultipleProtocolInterfaces (&DeviceHandle,
+                  &gEfiBlockIoProtocolGuid, &Dev->BlockIo,
+                  &gEfiBlockIo2ProtocolGuid, &Dev->BlockIo2,
+                  NULL);
   if (EFI_ERROR (Status)) {
     goto UninitDev;
   }
@@ -930,9 +1506,11 @@ FreeVirtioBlk:
 
 /**
 
-  Stop driving a virtio-blk device and remove its BlockIo interface.
+  Stop driving a virtio-blk device and remove its BlockIo and BlockIo2
+  interfaces.
 
   This function replays the success path of DriverBindingStart() in reverse.
+  The requests in flight are completed before the device is reset.
   The host side virtio-blk device is reset, so that the OS boot loader or the
   OS may reinitialize it.
 
@@ -981,8 +1559,10 @@ VirtioBlkDriverBindingStop (
   //
   // Handle Stop() requests for in-use driver instances gracefully.
   //
-  Status = gBS->UninstallProtocolInterface (DeviceHandle,
-                  &gEfiBlockIoProtocolGuid, &Dev->BlockIo);
+  Status = gBS->UninstallMultipleProtocolInterfaces (DeviceHandle,
+                  &gEfiBlockIoProtocolGuid, &Dev->BlockIo,
+                  &gEfiBlockIo2ProtocolGuid, &Dev->BlockIo2,
+                  NULL);
   if (EFI_ERROR (Status)) {
     return Status;
   }
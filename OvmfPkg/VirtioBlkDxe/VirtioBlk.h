@@ -19,12 +19,58 @@
 #define _VIRTIO_BLK_DXE_H_
 
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/ComponentName.h>
 #include <Protocol/DriverBinding.h>
 
 #include <IndustryStandard/Virtio.h>
+#include <IndustryStandard/VirtioBlk.h>
 
 
+//
+// The maximum number of requests in flight in the virtio ring.
+//
+#define VBLK_MAX_INFLIGHT 64
+
+//
+// The period of the timer which completes the requests in flight, in 100ns
+// units.
+//
+#define VBLK_POLL_PERIOD EFI_TIMER_PERIOD_MILLISECONDS (1)
+
+//
+// A read / write / flush request, blocking or not, from its submission by the
+// BlockIo or BlockIo2 protocol to its completion.
+//
+#define VBLK_REQ_SIG SIGNATURE_32 ('V', 'B', 'R', 'Q')
+
+typedef struct {
+  UINT32              Signature;
+  LIST_ENTRY          Link;           // in VBLK_DEV.PendingQueue
+  EFI_LBA             Lba;
+  UINTN               BufferSize;     // zero for flush
+  VOID                *Buffer;
+  BOOLEAN             RequestIsWrite;
+  EFI_BLOCK_IO2_TOKEN *Token;         // NULL for blocking requests
+  BOOLEAN             Done;           // blocking requests only
+  EFI_STATUS          Status;         // blocking requests only
+} VBLK_REQ;
+
+#define VBLK_REQ_FROM_LINK(LinkPointer) \
+        CR (LinkPointer, VBLK_REQ, Link, VBLK_REQ_SIG)
+
+//
+// The state of a request in flight in the virtio ring. The request header and
+// the host status are read and written by the host, and so is the indirect
+// table of descriptors if VIRTIO_F_RING_INDIRECT_DESC has been negotiated.
+//
+typedef struct {
+  volatile VRING_DESC     IndirectTable[3];
+  volatile VIRTIO_BLK_REQ Request;
+  volatile UINT8          HostStatus;
+  VBLK_REQ                *Req;           // NULL if the slot is free
+} VBLK_SLOT;
+
 #define VBLK_SIG SIGNATURE_32 ('V', 'B', 'L', 'K')
 
 typedef struct {
@@ -39,12 +85,23 @@ typedef struct {
   VIRTIO_DEVICE_PROTOCOL *VirtIo;              // DriverBindingStart  0
   VRING                  Ring;                 // VirtioRingInit      2
   EFI_BLOCK_IO_PROTOCOL  BlockIo;              // VirtioBlkInit       1
+  EFI_BLOCK_IO2_PROTOCOL BlockIo2;             // VirtioBlkInit       1
   EFI_BLOCK_IO_MEDIA     BlockIoMedia;         // VirtioBlkInit       1
+  BOOLEAN                IndirectDesc;         // VirtioBlkInit       1
+  UINT16                 NumSlots;             // VirtioBlkInit       1
+  VBLK_SLOT              *Slots;               // VirtioBlkInit       1
+  UINT16                 LastUsedIdx;          // VirtioBlkInit       1
+  UINT16                 InFlight;             // VirtioBlkInit       1
+  LIST_ENTRY             PendingQueue;         // VirtioBlkInit       1
+  EFI_EVENT              PollTimer;            // VirtioBlkInit       1
 } VBLK_DEV;
 
 #define VIRTIO_BLK_FROM_BLOCK_IO(BlockIoPointer) \
         CR (BlockIoPointer, VBLK_DEV, BlockIo, VBLK_SIG)
 
+#define VIRTIO_BLK_FROM_BLOCK_IO2(BlockIo2Pointer) \
+        CR (BlockIo2Pointer, VBLK_DEV, BlockIo2, VBLK_SIG)
+
 
 /**
 
@@ -110,7 +167,8 @@ VirtioBlkDriverBindingSupported (
 
   @retval EFI_SUCCESS           Driver instance has been created and
                                 initialized  for the virtio-blk device, it
-                                is now accessibla via EFI_BLOCK_IO_PROTOCOL.
+                                is now accessibla via EFI_BLOCK_IO_PROTOCOL
+                                and EFI_BLOCK_IO2_PROTOCOL.
 
   @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
 
@@ -131,9 +189,11 @@ VirtioBlkDriverBindingStart (
 
 /**
 
-  Stop driving a virtio-blk device and remove its BlockIo interface.
+  Stop driving a virtio-blk device and remove its BlockIo and BlockIo2
+  interfaces.
 
   This function replays the success path of DriverBindingStart() in reverse.
+  The requests in flight are completed before the device is reset.
   The host side virtio-blk device is reset, so that the OS boot loader or the
   OS may reinitialize it.
 
@@ -257,6 +317,98 @@ VirtioBlkFlushBlocks (
   );
 
 
+//
+// UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol
+// Driver Writer's Guide for UEFI 2.3.1 v1.01,
+//   24.2 Block I/O Protocol Implementations
+//
+EFI_STATUS
+EFIAPI
+VirtioBlkResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL *This,
+  IN BOOLEAN                ExtendedVerification
+  );
+
+
+/**
+
+  ReadBlocksEx() operation for virtio-blk.
+
+  See
+  - UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol,
+    EFI_BLOCK_IO2_PROTOCOL.ReadBlocksEx().
+  - Driver Writer's Guide for UEFI 2.3.1 v1.01, 24.2.2. ReadBlocks() and
+    ReadBlocksEx() Implementation.
+
+  If Token is NULL or Token->Event is NULL, the request is blocking, like
+  ReadBlocks(). Otherwise the request is queued, and Token->Event is signaled
+  when it completes, with the result in Token->TransactionStatus.
+
+**/
+
+EFI_STATUS
+EFIAPI
+VirtioBlkReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  OUT    VOID                   *Buffer
+  );
+
+
+/**
+
+  WriteBlocksEx() operation for virtio-blk.
+
+  See
+  - UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol,
+    EFI_BLOCK_IO2_PROTOCOL.WriteBlocksEx().
+  - Driver Writer's Guide for UEFI 2.3.1 v1.01, 24.2.3 WriteBlocks() and
+    WriteBlockEx() Implementation.
+
+  If Token is NULL or Token->Event is NULL, the request is blocking, like
+  WriteBlocks(). Otherwise the request is queued, and Token->Event is signaled
+  when it completes, with the result in Token->TransactionStatus.
+
+**/
+
+EFI_STATUS
+EFIAPI
+VirtioBlkWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN     VOID                   *Buffer
+  );
+
+
+/**
+
+  FlushBlocksEx() operation for virtio-blk.
+
+  See
+  - UEFI Spec 2.4, 12.10 EFI Block I/O 2 Protocol,
+    EFI_BLOCK_IO2_PROTOCOL.FlushBlocksEx().
+  - Driver Writer's Guide for UEFI 2.3.1 v1.01, 24.2.4 FlushBlocks() and
+    FlushBlocksEx() Implementation.
+
+  The requests in flight are completed first, then the flush is blocking, and
+  Token->Event is signaled when it is done.
+
+**/
+
+EFI_STATUS
+EFIAPI
+VirtioBlkFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token
+  );
+
+
 //
 // The purpose of the following scaffolding (EFI_COMPONENT_NAME_PROTOCOL and
 // EFI_COMPONENT_NAME2_PROTOCOL implementation) is to format the driver's name